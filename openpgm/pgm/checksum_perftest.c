@@ -99,7 +99,7 @@ static
 void
 mock_setup (void)
 {
-	g_assert (pgm_time_init (NULL));
+	g_assert (pgm_time_init (NULL, NULL));
 }
 
 static
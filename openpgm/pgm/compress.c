@@ -0,0 +1,559 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * APDU payload transform.  A source encodes each APDU before fragmentation
+ * and tags every fragment with OPT_TRANSFORM, receivers decode the
+ * reassembled APDU into a buffer of their own.  The built-in codec is a
+ * byte-oriented LZ77 in the LZ4 block layout: a token of literal and match
+ * length nibbles, literals, a 16-bit little-endian offset and length
+ * extension bytes.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+
+
+//#define COMPRESS_DEBUG
+
+#define LZ_MINMATCH		4
+#define LZ_LASTLITERALS		5	/* final bytes always literals */
+#define LZ_MFLIMIT		12	/* no match starts closer to the end */
+#define LZ_MAX_OFFSET		UINT16_MAX
+#define LZ_SKIP_TRIGGER		6	/* search step grows every 2^n misses */
+
+
+static inline
+uint32_t
+_pgm_lz_read32 (
+	const uint8_t*		p
+	)
+{
+	uint32_t v;
+	memcpy (&v, p, sizeof (v));
+	return v;
+}
+
+static inline
+uint32_t
+_pgm_lz_hash (
+	const uint8_t*		p
+	)
+{
+	return (_pgm_lz_read32 (p) * 2654435761U) >> (32 - PGM_LZ_HASH_LOG);
+}
+
+/* length beyond the token nibble as a run of 255s and a remainder.
+ */
+
+static inline
+uint8_t*
+_pgm_lz_write_length (
+	uint8_t*		op,
+	size_t			len
+	)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/* compress src into dst, positions of previous four byte sequences are kept
+ * in the caller's hash table, inputs are limited to 64KB by the table width.
+ *
+ * returns encoded length, or 0 if the output would exceed dst_len.
+ */
+
+PGM_GNUC_INTERNAL
+size_t
+pgm_lz_compress (
+	uint16_t*   restrict	hash,
+	const void* restrict	src,
+	const size_t		src_len,
+	void*	    restrict	dst,
+	const size_t		dst_len
+	)
+{
+	const uint8_t* const base	= src;
+	const uint8_t* const iend	= base + src_len;
+	const uint8_t*	     ip		= base;
+	const uint8_t*	     anchor	= base;
+	uint8_t*	     op		= dst;
+	uint8_t* const	     oend	= op + dst_len;
+
+/* pre-conditions */
+	pgm_assert (NULL != hash);
+	pgm_assert (NULL != src);
+	pgm_assert (NULL != dst);
+
+	if (PGM_UNLIKELY(src_len > UINT16_MAX))
+		return 0;
+
+	if (src_len > LZ_MFLIMIT)
+	{
+		const uint8_t* const mflimit	= iend - LZ_MFLIMIT;
+		const uint8_t* const matchlimit	= iend - LZ_LASTLITERALS;
+		unsigned misses = 1 << LZ_SKIP_TRIGGER;
+
+		memset (hash, 0, sizeof(uint16_t) << PGM_LZ_HASH_LOG);
+		ip++;
+		while (ip < mflimit)
+		{
+			const uint32_t h = _pgm_lz_hash (ip);
+			const uint8_t* ref = base + hash[ h ];
+			hash[ h ] = (uint16_t)(ip - base);
+			if (ref >= ip || _pgm_lz_read32 (ref) != _pgm_lz_read32 (ip)) {
+/* incompressible runs are skipped at an increasing stride */
+				ip += misses++ >> LZ_SKIP_TRIGGER;
+				continue;
+			}
+			misses = 1 << LZ_SKIP_TRIGGER;
+
+/* extend backwards over pending literals */
+			while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+
+			const uint8_t* mp = ip + LZ_MINMATCH;
+			const uint8_t* rp = ref + LZ_MINMATCH;
+			while (mp < matchlimit && *mp == *rp) {
+				mp++;
+				rp++;
+			}
+
+			const size_t lit_len	= ip - anchor;
+			const size_t match_len	= mp - ip - LZ_MINMATCH;
+			if (PGM_UNLIKELY((size_t)(oend - op) < 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1))
+				return 0;
+
+			uint8_t* token = op++;
+			if (lit_len >= 15) {
+				*token = 15 << 4;
+				op = _pgm_lz_write_length (op, lit_len - 15);
+			} else
+				*token = (uint8_t)(lit_len << 4);
+			memcpy (op, anchor, lit_len);
+			op += lit_len;
+
+			const size_t offset = ip - ref;
+			*op++ = (uint8_t)(offset & 0xff);
+			*op++ = (uint8_t)(offset >> 8);
+
+			if (match_len >= 15) {
+				*token |= 15;
+				op = _pgm_lz_write_length (op, match_len - 15);
+			} else
+				*token |= (uint8_t)match_len;
+
+			ip = anchor = mp;
+/* seed the position just behind the match */
+			if (ip < mflimit)
+				hash[ _pgm_lz_hash (ip - 2) ] = (uint16_t)(ip - 2 - base);
+		}
+	}
+
+/* last literals */
+	const size_t lit_len = iend - anchor;
+	if (PGM_UNLIKELY((size_t)(oend - op) < 1 + lit_len / 255 + 1 + lit_len))
+		return 0;
+	if (lit_len >= 15) {
+		*op++ = 15 << 4;
+		op = _pgm_lz_write_length (op, lit_len - 15);
+	} else
+		*op++ = (uint8_t)(lit_len << 4);
+	memcpy (op, anchor, lit_len);
+	op += lit_len;
+	return op - (uint8_t*)dst;
+}
+
+/* decompress src into dst, every length and offset is checked against both
+ * buffers as the input is from the network.
+ *
+ * returns decoded length, or -1 on malformed input or insufficient space.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_lz_decompress (
+	const void* restrict	src,
+	const size_t		src_len,
+	void*	    restrict	dst,
+	const size_t		dst_len
+	)
+{
+	const uint8_t*	     ip		= src;
+	const uint8_t* const iend	= ip + src_len;
+	uint8_t*	     op		= dst;
+	uint8_t* const	     oend	= op + dst_len;
+	unsigned	     b;
+
+/* pre-conditions */
+	pgm_assert (NULL != src);
+	pgm_assert (NULL != dst);
+
+	for (;;)
+	{
+		if (PGM_UNLIKELY(ip >= iend))
+			return -1;
+		const unsigned token = *ip++;
+
+		size_t lit_len = token >> 4;
+		if (15 == lit_len) {
+			do {
+				if (PGM_UNLIKELY(ip >= iend))
+					return -1;
+				b = *ip++;
+				lit_len += b;
+			} while (255 == b);
+		}
+		if (PGM_UNLIKELY(lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op)))
+			return -1;
+		memcpy (op, ip, lit_len);
+		op += lit_len;
+		ip += lit_len;
+
+/* final sequence carries only literals */
+		if (ip == iend)
+			break;
+
+		if (PGM_UNLIKELY(iend - ip < 2))
+			return -1;
+		const size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (PGM_UNLIKELY(0 == offset || offset > (size_t)(op - (uint8_t*)dst)))
+			return -1;
+
+		size_t match_len = token & 15;
+		if (15 == match_len) {
+			do {
+				if (PGM_UNLIKELY(ip >= iend))
+					return -1;
+				b = *ip++;
+				match_len += b;
+			} while (255 == b);
+		}
+		match_len += LZ_MINMATCH;
+		if (PGM_UNLIKELY(match_len > (size_t)(oend - op)))
+			return -1;
+
+/* an overlapping match repeats the last offset bytes, the run that can be
+ * copied without overlap doubles with each pass.
+ */
+		const uint8_t* ref = op - offset;
+		while (match_len) {
+			const size_t run = MIN( (size_t)(op - ref), match_len );
+			memcpy (op, ref, run);
+			op	  += run;
+			match_len -= run;
+		}
+	}
+	return op - (uint8_t*)dst;
+}
+
+/* create transform state, encode buffers only for a source with a codec.
+ *
+ * returns new transform state.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_compress_t*
+pgm_compress_create (
+	const struct pgm_compressinfo_t* const restrict	info,
+	const size_t					max_apdu	/* 0 for receive only */
+	)
+{
+	pgm_compress_t* compress;
+
+/* pre-conditions */
+	pgm_assert (NULL != info);
+
+	compress = pgm_new0 (pgm_compress_t, 1);
+	memcpy (&compress->info, info, sizeof (struct pgm_compressinfo_t));
+	if (PGM_CODEC_NONE != info->ci_codec && max_apdu > 0) {
+		compress->buf_len = max_apdu;
+		compress->buf	  = pgm_malloc (compress->buf_len);
+		compress->gather  = pgm_malloc (max_apdu);
+	}
+	return compress;
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_compress_destroy (
+	pgm_compress_t*		compress
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != compress);
+
+	pgm_compress_release (compress);
+	if (compress->held_skbs)
+		pgm_free (compress->held_skbs);
+	if (compress->scratch)
+		pgm_free (compress->scratch);
+	if (compress->gather)
+		pgm_free (compress->gather);
+	if (compress->buf)
+		pgm_free (compress->buf);
+	pgm_free (compress);
+}
+
+/* encode one APDU into the transform buffer, only when the result saves at
+ * least one byte including the transform header.
+ *
+ * returns TRUE if compress::buf holds the encoded APDU, FALSE to send the
+ * APDU unchanged.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_compress_encode (
+	pgm_compress_t* const restrict	compress,
+	const void*	      restrict	apdu,
+	const size_t			apdu_length
+	)
+{
+	struct pgm_transform_header_t* header;
+	size_t encoded;
+
+/* pre-conditions */
+	pgm_assert (NULL != compress);
+
+	if (NULL == compress->buf)
+		return FALSE;
+	if (apdu_length < compress->info.ci_min_length ||
+	    apdu_length > compress->buf_len ||
+	    apdu_length <= sizeof (struct pgm_transform_header_t) + 1)
+	{
+		compress->stats.cs_skipped_msgs++;
+		return FALSE;
+	}
+
+	header = (struct pgm_transform_header_t*)compress->buf;
+	const size_t capacity = apdu_length - sizeof (struct pgm_transform_header_t) - 1;
+	const pgm_time_t start = pgm_time_update_now();
+	if (PGM_CODEC_LZ == compress->info.ci_codec)
+		encoded = pgm_lz_compress (compress->hash, apdu, apdu_length, header + 1, capacity);
+	else
+		encoded = compress->info.ci_encode (apdu, apdu_length, header + 1, capacity, compress->info.ci_user_data);
+	compress->stats.cs_encode_usecs += pgm_time_update_now() - start;
+
+	if (0 == encoded || encoded > capacity) {
+		compress->stats.cs_skipped_msgs++;
+		return FALSE;
+	}
+	header->th_codec	= (uint8_t)compress->info.ci_codec;
+	memset (header->th_reserved, 0, sizeof (header->th_reserved));
+	header->th_length	= pgm_htonl ((uint32_t)apdu_length);
+	compress->encoded_length = sizeof (struct pgm_transform_header_t) + encoded;
+
+	compress->stats.cs_encoded_msgs++;
+	compress->stats.cs_encoded_bytes_in  += apdu_length;
+	compress->stats.cs_encoded_bytes_out += compress->encoded_length;
+#ifdef COMPRESS_DEBUG
+	pgm_debug ("encoded %" PRIzu " bytes to %" PRIzu, apdu_length, compress->encoded_length);
+#endif
+	return TRUE;
+}
+
+/* as above for an APDU in a scatter/gather vector.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_compress_encodev (
+	pgm_compress_t*	        const restrict	compress,
+	const struct pgm_iovec* const restrict	vector,
+	const unsigned				count,
+	const size_t				apdu_length
+	)
+{
+	char* dst;
+
+/* pre-conditions */
+	pgm_assert (NULL != compress);
+	pgm_assert (NULL != vector);
+
+	if (NULL == compress->buf)
+		return FALSE;
+	if (apdu_length < compress->info.ci_min_length || apdu_length > compress->buf_len) {
+		compress->stats.cs_skipped_msgs++;
+		return FALSE;
+	}
+	dst = compress->gather;
+	for (unsigned i = 0; i < count; i++) {
+		memcpy (dst, vector[i].iov_base, vector[i].iov_len);
+		dst += vector[i].iov_len;
+	}
+	return pgm_compress_encode (compress, compress->gather, apdu_length);
+}
+
+/* decode one reassembled APDU into a new buffer held until the next read.
+ *
+ * returns decoded skb, or NULL if the codec is unknown or the APDU malformed.
+ */
+
+static
+struct pgm_sk_buff_t*
+_pgm_compress_decode (
+	pgm_compress_t*	         const restrict	compress,
+	const struct pgm_msgv_t* const restrict	msgv,
+	const size_t				encoded_length
+	)
+{
+	const struct pgm_transform_header_t* header;
+	const struct pgm_sk_buff_t* first = msgv->msgv_skb[0];
+	struct pgm_sk_buff_t* skb;
+	ssize_t decoded;
+
+/* fragments are contiguous only in the first skb */
+	if (1 == msgv->msgv_len)
+		header = first->data;
+	else {
+		char* dst;
+		if (compress->scratch_len < encoded_length) {
+			compress->scratch_len = encoded_length;
+			compress->scratch = pgm_realloc (compress->scratch, compress->scratch_len);
+		}
+		dst = compress->scratch;
+		for (unsigned i = 0; i < msgv->msgv_len; i++) {
+			memcpy (dst, msgv->msgv_skb[i]->data, msgv->msgv_skb[i]->len);
+			dst += msgv->msgv_skb[i]->len;
+		}
+		header = (const struct pgm_transform_header_t*)compress->scratch;
+	}
+	if (PGM_UNLIKELY(encoded_length < sizeof (struct pgm_transform_header_t)))
+		return NULL;
+
+	const size_t apdu_length = pgm_ntohl (header->th_length);
+	if (PGM_UNLIKELY(apdu_length > MIN(PGM_MAX_APDU, UINT16_MAX)))
+		return NULL;
+	if (PGM_UNLIKELY(PGM_CODEC_LZ != header->th_codec &&
+			 (header->th_codec != compress->info.ci_codec || NULL == compress->info.ci_decode)))
+		return NULL;
+
+	skb = pgm_alloc_skb ((uint16_t)apdu_length);
+	pgm_skb_put (skb, (uint16_t)apdu_length);
+	const pgm_time_t start = pgm_time_update_now();
+	if (PGM_CODEC_LZ == header->th_codec)
+		decoded = pgm_lz_decompress (header + 1, encoded_length - sizeof (struct pgm_transform_header_t),
+					     skb->data, apdu_length);
+	else
+		decoded = compress->info.ci_decode (header + 1, encoded_length - sizeof (struct pgm_transform_header_t),
+						    skb->data, apdu_length, compress->info.ci_user_data);
+	compress->stats.cs_decode_usecs += pgm_time_update_now() - start;
+	if (PGM_UNLIKELY(decoded < 0 || (size_t)decoded != apdu_length)) {
+		pgm_free_skb (skb);
+		return NULL;
+	}
+
+	skb->sock	= first->sock;
+	skb->tstamp	= first->tstamp;
+	skb->sequence	= first->sequence;
+	memcpy (&skb->tsi, &first->tsi, sizeof (pgm_tsi_t));
+
+	if (compress->held_skbs_len == compress->held_skbs_alloc) {
+		compress->held_skbs_alloc = MAX( 2 * compress->held_skbs_alloc, 16 );
+		compress->held_skbs = pgm_realloc (compress->held_skbs, compress->held_skbs_alloc * sizeof (struct pgm_sk_buff_t*));
+	}
+	compress->held_skbs[ compress->held_skbs_len++ ] = skb;
+	return skb;
+}
+
+/* replace transformed APDUs in messages [msg_first, *pmsg) with their decoded
+ * form as one buffer each, the window skbs remain owned by the receive
+ * window.  APDUs that fail to decode are dropped and the vector compacted.
+ *
+ * returns change in bytes read.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_compress_msgv (
+	pgm_compress_t*	   const restrict compress,
+	struct pgm_msgv_t*	 restrict msg_first,
+	struct pgm_msgv_t**	 restrict pmsg
+	)
+{
+	struct pgm_msgv_t *src, *dst;
+	ssize_t delta = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != compress);
+	pgm_assert (NULL != msg_first);
+	pgm_assert (NULL != pmsg);
+
+	for (src = dst = msg_first; src < *pmsg; src++)
+	{
+		const struct pgm_sk_buff_t* first = src->msgv_skb[0];
+		if (PGM_LIKELY(0 == src->msgv_len ||
+			       !first->is_transformed))
+		{
+			if (dst != src) {
+				dst->msgv_len = src->msgv_len;
+				memcpy (dst->msgv_skb, src->msgv_skb, src->msgv_len * sizeof(struct pgm_sk_buff_t*));
+			}
+			dst++;
+			continue;
+		}
+
+		size_t encoded_length = 0;
+		for (unsigned i = 0; i < src->msgv_len; i++)
+			encoded_length += src->msgv_skb[i]->len;
+		struct pgm_sk_buff_t* skb = _pgm_compress_decode (compress, src, encoded_length);
+		delta -= encoded_length;
+		if (PGM_UNLIKELY(NULL == skb)) {
+			pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Dropping APDU #%" PRIu32 " failing payload transform."),
+				   first->sequence);
+			compress->stats.cs_decode_errors++;
+			continue;
+		}
+		delta += skb->len;
+		compress->stats.cs_decoded_msgs++;
+		compress->stats.cs_decoded_bytes_in  += encoded_length;
+		compress->stats.cs_decoded_bytes_out += skb->len;
+		dst->msgv_len	 = 1;
+		dst->msgv_skb[0] = skb;
+		dst++;
+	}
+	*pmsg = dst;
+	return delta;
+}
+
+/* free buffers handed out by the previous read.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_compress_release (
+	pgm_compress_t* const	compress
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != compress);
+
+	for (unsigned i = 0; i < compress->held_skbs_len; i++)
+		pgm_free_skb (compress->held_skbs[i]);
+	compress->held_skbs_len = 0;
+}
+
+/* eof */
@@ -0,0 +1,372 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for APDU payload transform.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+#ifdef _WIN32
+#	define PGM_CHECK_NOFORK		1
+#endif
+
+
+/* mock state */
+
+#define pgm_time_update_now	mock_pgm_time_update_now
+
+#define COMPRESS_DEBUG
+#include "compress.c"
+
+static pgm_time_t _mock_pgm_time_update_now (void);
+pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+
+
+/* mock functions for external references */
+
+size_t
+pgm_transport_pkt_offset2 (
+        const bool                      can_fragment,
+        const bool                      use_pgmcc
+        )
+{
+        return 0;
+}
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+static
+pgm_time_t
+_mock_pgm_time_update_now (void)
+{
+	return 0x1;
+}
+
+/* repetitive text compresses, the trailing counter keeps it from collapsing to one match */
+
+static
+void
+generate_text (
+	char*		buf,
+	const size_t	len
+	)
+{
+	for (size_t i = 0; i < len; i++)
+		buf[i] = "the quick brown fox "[i % 20] + (char)((i / 997) & 1);
+}
+
+/* wrap a transformed APDU as one fragment of a window skb */
+
+static
+struct pgm_sk_buff_t*
+generate_transformed_skb (
+	const void*	payload,
+	const uint16_t	len
+	)
+{
+	const uint16_t opt_len = sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_fragment);
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (opt_len + len);
+	pgm_skb_reserve (skb, opt_len);
+	skb->pgm_opt_fragment = (struct pgm_opt_fragment*)((char*)skb->head + sizeof(struct pgm_opt_header));
+	skb->is_transformed = 1;
+	skb->sequence = 42;
+	memcpy (pgm_skb_put (skb, len), payload, len);
+	return skb;
+}
+
+/* target:
+ *	size_t
+ *	pgm_lz_compress (
+ *		uint16_t*		hash,
+ *		const void*		src,
+ *		const size_t		src_len,
+ *		void*			dst,
+ *		const size_t		dst_len
+ *		)
+ */
+
+START_TEST (test_lz_compress_pass_001)
+{
+	static uint16_t hash[ 1 << PGM_LZ_HASH_LOG ];
+	const size_t lengths[] = { 0, 1, 12, 13, 100, 1500, 9000, UINT16_MAX };
+	char* src = g_malloc (UINT16_MAX);
+	char* enc = g_malloc (UINT16_MAX + UINT16_MAX / 255 + 16);
+	char* dec = g_malloc (UINT16_MAX);
+	generate_text (src, UINT16_MAX);
+	for (unsigned i = 0; i < G_N_ELEMENTS(lengths); i++) {
+		const size_t enc_len = pgm_lz_compress (hash, src, lengths[i], enc, UINT16_MAX + UINT16_MAX / 255 + 16);
+		fail_unless (enc_len > 0, "compress failed");
+		if (lengths[i] > 100)
+			fail_unless (enc_len < lengths[i] / 2, "compress ineffective");
+		const ssize_t dec_len = pgm_lz_decompress (enc, enc_len, dec, lengths[i]);
+		fail_unless ((ssize_t)lengths[i] == dec_len, "decompress failed");
+		fail_unless (0 == memcmp (src, dec, lengths[i]), "round trip mismatch");
+	}
+	g_free (src);
+	g_free (enc);
+	g_free (dec);
+}
+END_TEST
+
+/* incompressible input does not fit in less space */
+START_TEST (test_lz_compress_pass_002)
+{
+	static uint16_t hash[ 1 << PGM_LZ_HASH_LOG ];
+	char src[ 1024 ], enc[ 1024 ];
+	for (unsigned i = 0; i < sizeof(src); i++)
+		src[i] = (char)g_random_int();
+	fail_unless (0 == pgm_lz_compress (hash, src, sizeof(src), enc, sizeof(src) - 1), "compress succeeded");
+}
+END_TEST
+
+START_TEST (test_lz_compress_fail_001)
+{
+	char dst[ 16 ];
+	pgm_lz_compress (NULL, "abc", 3, dst, sizeof(dst));
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	ssize_t
+ *	pgm_lz_decompress (
+ *		const void*		src,
+ *		const size_t		src_len,
+ *		void*			dst,
+ *		const size_t		dst_len
+ *		)
+ */
+
+/* truncated and corrupted input never writes beyond dst */
+START_TEST (test_lz_decompress_pass_001)
+{
+	static uint16_t hash[ 1 << PGM_LZ_HASH_LOG ];
+	char src[ 4096 ], enc[ 4096 ], dec[ 4096 + 16 ];
+	generate_text (src, sizeof(src));
+	const size_t enc_len = pgm_lz_compress (hash, src, sizeof(src), enc, sizeof(enc));
+	fail_unless (enc_len > 0, "compress failed");
+	for (unsigned i = 0; i < 1000; i++) {
+		char corrupt[ 4096 ];
+		memcpy (corrupt, enc, enc_len);
+		corrupt[ g_random_int_range (0, enc_len) ] ^= 1 << g_random_int_range (0, 8);
+		memset (dec + sizeof(src), 0xa5, 16);
+		const ssize_t dec_len = pgm_lz_decompress (corrupt, i % 2 ? enc_len : g_random_int_range (0, enc_len), dec, sizeof(src));
+		fail_unless (dec_len <= (ssize_t)sizeof(src), "decompress overrun");
+		for (unsigned j = 0; j < 16; j++)
+			fail_unless ((char)0xa5 == dec[ sizeof(src) + j ], "decompress overrun");
+	}
+}
+END_TEST
+
+/* offset before start of output */
+START_TEST (test_lz_decompress_pass_002)
+{
+	const char enc[] = { 0x14, 'a', 0x05, 0x00, 0x10, 'b' };
+	char dec[ 64 ];
+	fail_unless (-1 == pgm_lz_decompress (enc, sizeof(enc), dec, sizeof(dec)), "decompress succeeded");
+}
+END_TEST
+
+START_TEST (test_lz_decompress_fail_001)
+{
+	char dst[ 16 ];
+	pgm_lz_decompress (NULL, 3, dst, sizeof(dst));
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_compress_encode (
+ *		pgm_compress_t*		compress,
+ *		const void*		apdu,
+ *		const size_t		apdu_length
+ *		)
+ */
+
+START_TEST (test_encode_pass_001)
+{
+	const struct pgm_compressinfo_t info = { PGM_CODEC_LZ, PGM_COMPRESS_DEFAULT_MIN, NULL, NULL, NULL };
+	pgm_compress_t* compress = pgm_compress_create (&info, 9000);
+	char apdu[ 9000 ];
+	generate_text (apdu, sizeof(apdu));
+	fail_unless (TRUE == pgm_compress_encode (compress, apdu, sizeof(apdu)), "encode failed");
+	const struct pgm_transform_header_t* header = (const struct pgm_transform_header_t*)compress->buf;
+	fail_unless (PGM_CODEC_LZ == header->th_codec, "codec mismatch");
+	fail_unless (sizeof(apdu) == pgm_ntohl (header->th_length), "length mismatch");
+	fail_unless (compress->encoded_length < sizeof(apdu), "not encoded");
+	fail_unless (1 == compress->stats.cs_encoded_msgs, "stats mismatch");
+	pgm_compress_destroy (compress);
+}
+END_TEST
+
+/* below minimum length sent as is */
+START_TEST (test_encode_pass_002)
+{
+	const struct pgm_compressinfo_t info = { PGM_CODEC_LZ, PGM_COMPRESS_DEFAULT_MIN, NULL, NULL, NULL };
+	pgm_compress_t* compress = pgm_compress_create (&info, 9000);
+	char apdu[ PGM_COMPRESS_DEFAULT_MIN - 1 ];
+	generate_text (apdu, sizeof(apdu));
+	fail_unless (FALSE == pgm_compress_encode (compress, apdu, sizeof(apdu)), "encode succeeded");
+	fail_unless (1 == compress->stats.cs_skipped_msgs, "stats mismatch");
+	pgm_compress_destroy (compress);
+}
+END_TEST
+
+START_TEST (test_encode_fail_001)
+{
+	char apdu[ 1024 ];
+	pgm_compress_encode (NULL, apdu, sizeof(apdu));
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	ssize_t
+ *	pgm_compress_msgv (
+ *		pgm_compress_t*		compress,
+ *		struct pgm_msgv_t*	msg_first,
+ *		struct pgm_msgv_t**	pmsg
+ *		)
+ */
+
+START_TEST (test_msgv_pass_001)
+{
+	const struct pgm_compressinfo_t info = { PGM_CODEC_LZ, PGM_COMPRESS_DEFAULT_MIN, NULL, NULL, NULL };
+	pgm_compress_t* source = pgm_compress_create (&info, 9000);
+	pgm_compress_t* receiver = pgm_compress_create (&info, 0);
+	char apdu[ 9000 ];
+	generate_text (apdu, sizeof(apdu));
+	fail_unless (TRUE == pgm_compress_encode (source, apdu, sizeof(apdu)), "encode failed");
+	struct pgm_sk_buff_t* skb = generate_transformed_skb (source->buf, (uint16_t)source->encoded_length);
+	struct pgm_msgv_t msgv[ 1 ], *pmsg = msgv + 1;
+	msgv[0].msgv_len = 1;
+	msgv[0].msgv_skb[0] = skb;
+	const ssize_t delta = pgm_compress_msgv (receiver, msgv, &pmsg);
+	fail_unless (msgv + 1 == pmsg, "message dropped");
+	fail_unless ((ssize_t)(sizeof(apdu) - source->encoded_length) == delta, "delta mismatch");
+	fail_unless (sizeof(apdu) == msgv[0].msgv_skb[0]->len, "length mismatch");
+	fail_unless (0 == memcmp (apdu, msgv[0].msgv_skb[0]->data, sizeof(apdu)), "decode mismatch");
+	fail_unless (42 == msgv[0].msgv_skb[0]->sequence, "sequence mismatch");
+	pgm_compress_release (receiver);
+	pgm_free_skb (skb);
+	pgm_compress_destroy (receiver);
+	pgm_compress_destroy (source);
+}
+END_TEST
+
+/* malformed APDU dropped */
+START_TEST (test_msgv_pass_002)
+{
+	const struct pgm_compressinfo_t info = { PGM_CODEC_NONE, 0, NULL, NULL, NULL };
+	pgm_compress_t* receiver = pgm_compress_create (&info, 0);
+	struct pgm_transform_header_t header = { PGM_CODEC_USER, { 0, 0, 0 }, pgm_htonl (100) };
+	struct pgm_sk_buff_t* skb = generate_transformed_skb (&header, sizeof(header));
+	struct pgm_msgv_t msgv[ 1 ], *pmsg = msgv + 1;
+	msgv[0].msgv_len = 1;
+	msgv[0].msgv_skb[0] = skb;
+	pgm_compress_msgv (receiver, msgv, &pmsg);
+	fail_unless (msgv == pmsg, "message delivered");
+	fail_unless (1 == receiver->stats.cs_decode_errors, "stats mismatch");
+	pgm_free_skb (skb);
+	pgm_compress_destroy (receiver);
+}
+END_TEST
+
+START_TEST (test_msgv_fail_001)
+{
+	struct pgm_msgv_t msgv[ 1 ], *pmsg = msgv;
+	pgm_compress_msgv (NULL, msgv, &pmsg);
+	fail ("reached");
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_lz_compress = tcase_create ("lz-compress");
+	suite_add_tcase (s, tc_lz_compress);
+	tcase_add_test (tc_lz_compress, test_lz_compress_pass_001);
+	tcase_add_test (tc_lz_compress, test_lz_compress_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_lz_compress, test_lz_compress_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_lz_decompress = tcase_create ("lz-decompress");
+	suite_add_tcase (s, tc_lz_decompress);
+	tcase_add_test (tc_lz_decompress, test_lz_decompress_pass_001);
+	tcase_add_test (tc_lz_decompress, test_lz_decompress_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_lz_decompress, test_lz_decompress_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_encode = tcase_create ("encode");
+	suite_add_tcase (s, tc_encode);
+	tcase_add_test (tc_encode, test_encode_pass_001);
+	tcase_add_test (tc_encode, test_encode_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_encode, test_encode_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_msgv = tcase_create ("msgv");
+	suite_add_tcase (s, tc_msgv);
+	tcase_add_test (tc_msgv, test_msgv_pass_001);
+	tcase_add_test (tc_msgv, test_msgv_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_msgv, test_msgv_fail_001, SIGABRT);
+#endif
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -37,10 +37,17 @@
 static
 void
 __cpuidex (int cpu_info[4], int function_id, int subfunction_id) {
+/* preserve all of %rbx, cpuid zeroes the upper half */
   __asm__ volatile (
+#  if defined(__x86_64__)
+    "mov %%rbx, %%rdi\n"
+    "cpuid\n"
+    "xchg %%rdi, %%rbx\n"
+#  else
     "mov %%ebx, %%edi\n"
     "cpuid\n"
     "xchg %%edi, %%ebx\n"
+#  endif
     : "=a"(cpu_info[0]), "=D"(cpu_info[1]), "=c"(cpu_info[2]), "=d"(cpu_info[3])
     : "a"(function_id), "c"(subfunction_id)
   );
@@ -93,6 +100,32 @@ pgm_cpuid (pgm_cpu_t* cpu)
 			(cpu_info[2] & 0x08000000) != 0 /* OSXSAVE */ &&
 			(_xgetbv(0) & 6) == 6 /* XSAVE enabled by kernel */;
 	cpu->has_avx2 = cpu->has_avx && (cpu_info7[1] & 0x00000020) != 0;
+	cpu->signature = (uint32_t)cpu_info[0];
+
+/* Time Stamp Counter frequency, leaf 0x15 ratio of TSC to core crystal clock */
+	int tsc_info[4] = {0};
+	if (num_ids >= 0x15) {
+		__cpuidex (tsc_info, 0x15, 0x0);
+		if (tsc_info[0] != 0 && tsc_info[1] != 0 && tsc_info[2] != 0)
+			cpu->tsc_khz = (uint32_t)(((uint64_t)(uint32_t)tsc_info[2] * (uint32_t)tsc_info[1] / (uint32_t)tsc_info[0]) / 1000);
+	}
+/* hypervisor timing leaf 0x40000010 reports the TSC in KHz, only defined by
+ * VMware and by QEMU for KVM, other hypervisors may assign the leaf otherwise.
+ */
+	if (0 == cpu->tsc_khz && (cpu_info[2] & 0x80000000) != 0) {
+		char vendor[13];
+		__cpuidex (tsc_info, 0x40000000, 0x0);
+		memcpy (&vendor[0], &tsc_info[1], 4);
+		memcpy (&vendor[4], &tsc_info[2], 4);
+		memcpy (&vendor[8], &tsc_info[3], 4);
+		vendor[12] = '\0';
+		if ((uint32_t)tsc_info[0] >= 0x40000010 &&
+		    (0 == strcmp (vendor, "VMwareVMware") || 0 == strcmp (vendor, "KVMKVMKVM")))
+		{
+			__cpuidex (tsc_info, 0x40000010, 0x0);
+			cpu->tsc_khz = (uint32_t)tsc_info[0];
+		}
+	}
 }
 #else
 PGM_GNUC_INTERNAL
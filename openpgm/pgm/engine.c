@@ -64,6 +64,7 @@ unsigned		pgm_loss_rate PGM_GNUC_READ_MOSTLY = 0;
 /* locals */
 static bool		pgm_is_supported = FALSE;
 static volatile uint32_t pgm_ref_count	 = 0;
+static volatile uint32_t pgm_ipproto_resolved = 0;
 
 static pgm_cpu_t	pgm_cpu;
 
@@ -75,12 +76,11 @@ static pgm_cpu_t	pgm_cpu;
 #endif
 
 
-/* startup PGM engine, mainly finding PGM protocol definition, if any from NSS
+/* startup PGM engine, the PGM protocol definition and on Windows the WSARecvMsg
+ * extension are resolved on demand by the first socket that requires them.
  *
  * returns TRUE on success, returns FALSE if an error occurred, implying some form of
  * system re-configuration is required to resolve before trying again.
- *
- * NB: Valgrind loves generating errors in getprotobyname().
  */
 bool
 pgm_init (
@@ -104,6 +104,7 @@ pgm_init (
 	pgm_thread_init();
 	pgm_mem_init();
 	pgm_rand_init();
+	pgm_histograms_init();
 
 #ifdef _WIN32
 	WORD wVersionRequested = MAKEWORD (2, 2);
@@ -128,55 +129,11 @@ pgm_init (
 			       _("WSAStartup failed to provide requested version 2.2."));
 		goto err_shutdown;
 	}
-
-/* Find WSARecvMsg API.  Available in Windows XP and Wine 1.3.
- */
-	if (NULL == pgm_WSARecvMsg) {
-		GUID WSARecvMsg_GUID = WSAID_WSARECVMSG;
-		DWORD cbBytesReturned;
-		const SOCKET sock = socket (AF_INET, SOCK_DGRAM, 0);
-		if (INVALID_SOCKET == sock) {
-			WSACleanup();
-			pgm_set_error (error,
-				       PGM_ERROR_DOMAIN_ENGINE,
-				       PGM_ERROR_FAILED,
-				       _("Cannot open socket."));
-			goto err_shutdown;
-		}
-		if (SOCKET_ERROR == WSAIoctl (sock,
-					      SIO_GET_EXTENSION_FUNCTION_POINTER,
-					      &WSARecvMsg_GUID, sizeof(WSARecvMsg_GUID),
-					      &pgm_WSARecvMsg, sizeof(pgm_WSARecvMsg),
-					      &cbBytesReturned,
-					      NULL,
-					      NULL))
-		{
-			closesocket (sock);
-			WSACleanup();
-			pgm_set_error (error,
-				       PGM_ERROR_DOMAIN_ENGINE,
-				       PGM_ERROR_FAILED,
-				       _("WSARecvMsg function not found, available in Windows XP or Wine 1.3."));
-			goto err_shutdown;
-		}
-		pgm_debug ("Retrieved address of WSARecvMsg.");
-		closesocket (sock);
-	}
 #endif /* _WIN32 */
 
-/* find PGM protocol id overriding default value, use first value from NIS */
-	const struct pgm_protoent_t *proto = pgm_getprotobyname ("pgm");
-	if (proto != NULL) {
-		if (proto->p_proto != pgm_ipproto_pgm) {
-			pgm_minor (_("Setting PGM protocol number to %i from the protocols database."),
-				proto->p_proto);
-			pgm_ipproto_pgm = proto->p_proto;
-		}
-	}
-
 /* ensure timing enabled */
 	pgm_error_t* sub_error = NULL;
-	if (!pgm_time_init (&sub_error)) {
+	if (!pgm_time_init (&pgm_cpu, &sub_error)) {
 		if (sub_error)
 			pgm_propagate_error (error, sub_error);
 #ifdef _WIN32
@@ -211,6 +168,7 @@ pgm_init (
 	return TRUE;
 
 err_shutdown:
+	pgm_histograms_shutdown();
 	pgm_rand_shutdown();
 	pgm_mem_shutdown();
 	pgm_thread_shutdown();
@@ -219,6 +177,73 @@ err_shutdown:
 	return FALSE;
 }
 
+/* find PGM protocol id overriding default value, use first value from NIS.
+ *
+ * deferred from pgm_init() to the first raw socket as the NSS lookup dominates
+ * start up time and is not required for UDP encapsulation.
+ *
+ * NB: Valgrind loves generating errors in getprotobyname().
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_resolve_ipproto_pgm (void)
+{
+	if (0 == pgm_atomic_read32 (&pgm_ipproto_resolved)) {
+		const struct pgm_protoent_t *proto = pgm_getprotobyname ("pgm");
+		if (proto != NULL) {
+			if (proto->p_proto != pgm_ipproto_pgm) {
+				pgm_minor (_("Setting PGM protocol number to %i from the protocols database."),
+					proto->p_proto);
+				pgm_ipproto_pgm = proto->p_proto;
+			}
+		}
+		pgm_atomic_write32 (&pgm_ipproto_resolved, 1);
+	}
+	return pgm_ipproto_pgm;
+}
+
+#ifdef _WIN32
+/* Find WSARecvMsg API.  Available in Windows XP and Wine 1.3.
+ *
+ * deferred from pgm_init() to the first socket, which is used for the query
+ * instead of opening a temporary socket.
+ *
+ * returns TRUE on success, returns FALSE if the extension is not available.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_resolve_wsarecvmsg (
+	SOCKET		sock,
+	pgm_error_t**	error
+	)
+{
+	if (NULL == pgm_WSARecvMsg) {
+		GUID WSARecvMsg_GUID = WSAID_WSARECVMSG;
+		LPFN_WSARECVMSG WSARecvMsg_fn = NULL;
+		DWORD cbBytesReturned;
+		if (SOCKET_ERROR == WSAIoctl (sock,
+					      SIO_GET_EXTENSION_FUNCTION_POINTER,
+					      &WSARecvMsg_GUID, sizeof(WSARecvMsg_GUID),
+					      &WSARecvMsg_fn, sizeof(WSARecvMsg_fn),
+					      &cbBytesReturned,
+					      NULL,
+					      NULL))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_ENGINE,
+				       PGM_ERROR_FAILED,
+				       _("WSARecvMsg function not found, available in Windows XP or Wine 1.3."));
+			return FALSE;
+		}
+		pgm_debug ("Retrieved address of WSARecvMsg.");
+		pgm_WSARecvMsg = WSARecvMsg_fn;
+	}
+	return TRUE;
+}
+#endif /* _WIN32 */
+
 /* returns TRUE if PGM engine has been initialized
  */
 
@@ -256,6 +281,7 @@ pgm_shutdown (void)
 	WSACleanup();
 #endif
 
+	pgm_histograms_shutdown();
 	pgm_rand_shutdown();
 	pgm_mem_shutdown();
 	pgm_thread_shutdown();
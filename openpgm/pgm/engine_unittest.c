@@ -88,7 +88,8 @@ pgm_get_nprocs (void)
 PGM_GNUC_INTERNAL
 bool
 mock_pgm_time_init (
-	pgm_error_t**	error
+	const pgm_cpu_t*	cpu,
+	pgm_error_t**		error
 	)
 {
 	mock_time_init++;
@@ -139,7 +140,7 @@ END_TEST
 START_TEST (test_init_pass_003)
 {
 	pgm_error_t* err = NULL;
-	fail_unless (TRUE == pgm_time_init (&err), "time-init failed: %s", (err && err->message) ? err->message : "(null)");
+	fail_unless (TRUE == pgm_time_init (NULL, &err), "time-init failed: %s", (err && err->message) ? err->message : "(null)");
 	fail_unless (TRUE == pgm_init (&err), "init failed: %s", (err && err->message) ? err->message : "(null)");
 	fail_unless (TRUE == pgm_init (&err), "init failed: %s", (err && err->message) ? err->message : "(null)");
 
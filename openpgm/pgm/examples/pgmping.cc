@@ -101,6 +101,7 @@ using namespace std;
 static int		g_port = 0;
 static const char*	g_network = "";
 static int		g_udp_encap_port = 0;
+static int		g_xdp_queue = -1;	/* -1 = disabled */
 
 static int		g_odata_rate = 0;
 static int		g_odata_interval = 0;
@@ -184,6 +185,7 @@ usage (const char* bin)
 	fprintf (stderr, "  -n <network>    : Multicast group or unicast IP address\n");
 	fprintf (stderr, "  -s <port>       : IP port\n");
         fprintf (stderr, "  -p <port>       : Encapsulate PGM in UDP on IP port\n");
+        fprintf (stderr, "  -X <queue>      : Bypass kernel with AF_XDP on device queue, requires -p\n");
 	fprintf (stderr, "  -d <seconds>    : Terminate transport after duration.\n");
 	fprintf (stderr, "  -m <frequency>  : Number of message to send per second\n");
 	fprintf (stderr, "  -o              : Send-only mode (default send & receive mode)\n");
@@ -238,12 +240,13 @@ main (
 /* parse program arguments */
 	const char* binary_name = g_get_prgname();
 	int c;
-	while ((c = getopt (argc, argv, "s:n:p:m:old:r:O:D:cfeK:N:M:HSh")) != -1)
+	while ((c = getopt (argc, argv, "s:n:p:X:m:old:r:O:D:cfeK:N:M:HSh")) != -1)
 	{
 		switch (c) {
 		case 'n':	g_network = optarg; break;
 		case 's':	g_port = atoi (optarg); break;
 		case 'p':	g_udp_encap_port = atoi (optarg); break;
+		case 'X':	g_xdp_queue = atoi (optarg); break;
 		case 'r':	g_max_rte = atoi (optarg); break;
 		case 'O':	g_odata_rte = atoi (optarg); break;
 		case 'D':	g_rdata_rte = atoi (optarg); break;
@@ -490,6 +493,15 @@ on_startup (
 			g_error ("setting PGM_UDP_ENCAP_MCAST_PORT = %d", g_udp_encap_port);
 			goto err_abort;
 		}
+		if (g_xdp_queue >= 0) {
+			struct pgm_xdpinfo_t xdpinfo;
+			memset (&xdpinfo, 0, sizeof(xdpinfo));
+			xdpinfo.xi_queue_id = g_xdp_queue;
+			if (!pgm_setsockopt (g_sock, IPPROTO_PGM, PGM_XDP, &xdpinfo, sizeof(xdpinfo))) {
+				g_error ("setting PGM_XDP queue = %d", g_xdp_queue);
+				goto err_abort;
+			}
+		}
 	} else {
 		g_message ("create PGM/IP socket.");
 		if (!pgm_socket (&g_sock, sa_family, SOCK_SEQPACKET, IPPROTO_PGM, &pgm_err)) {
@@ -0,0 +1,378 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * プリン C++20 PGM receiver.  A port of purinrecvcc.cc to the coroutine
+ * wrapper in pgm_async.hh, a single task awaits each APDU from one epoll
+ * reactor.  Used to test C++20 builds don't break.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cassert>
+#include <clocale>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <getopt.h>
+#include <pgm/pgm.hh>
+#include <pgm/pgm_async.hh>
+
+
+/* globals */
+
+static int		port = 0;
+static const char*	network = "";
+static bool		use_multicast_loop = FALSE;
+static int		udp_encap_port = 0;
+
+static int		max_tpdu = 1500;
+static int		sqns = 100;
+
+static bool		use_fec = FALSE;
+static int		rs_k = 8;
+static int		rs_n = 255;
+
+static ip::pgm::endpoint* endpoint = NULL;
+static ip::pgm::socket*	sock = NULL;
+static volatile sig_atomic_t is_terminated = FALSE;
+
+static void on_signal (int);
+#ifndef _MSC_VER
+static void usage (const char*) __attribute__((__noreturn__));
+#else
+static void usage (const char*);
+#endif
+
+static bool on_startup (void);
+static pgm_task<void> receiver (pgm_async_socket<ip::pgm>&);
+static int on_msgv (const struct cpgm::pgm_msgv_t*);
+
+
+static void
+usage (
+	const char*	bin
+	)
+{
+	std::cerr << "Usage: " << bin << " [options]" << std::endl;
+	std::cerr << "  -n, --network NETWORK    : Multicast group or unicast IP address" << std::endl;
+	std::cerr << "  -s, --service PORT       : IP port" << std::endl;
+	std::cerr << "  -p, --port PORT          : Encapsulate PGM in UDP on IP port" << std::endl;
+	std::cerr << "  -f, --enable-fec TYPE    : Enable FEC with either proactive or ondemand parity" << std::endl;
+	std::cerr << "  -N N                     : Reed-Solomon block size (255)" << std::endl;
+	std::cerr << "  -K K                     : Reed-Solomon group size (8)" << std::endl;
+	std::cerr << "  -l, --enable-loop        : Enable multicast loopback and address sharing" << std::endl;
+	std::cerr << "  -i, --list               : List available interfaces" << std::endl;
+	exit (EXIT_SUCCESS);
+}
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	cpgm::pgm_error_t* pgm_err = NULL;
+
+	std::setlocale (LC_ALL, "");
+
+	std::cout << "プリン プリン" << std::endl;
+
+	if (!cpgm::pgm_init (&pgm_err)) {
+		std::cerr << "Unable to start PGM engine: " << pgm_err->message << std::endl;
+		cpgm::pgm_error_free (pgm_err);
+		return EXIT_FAILURE;
+	}
+
+/* parse program arguments */
+	const char* binary_name = std::strrchr (argv[0], '/');
+
+	static struct option long_options[] = {
+		{ "network",        required_argument, NULL, 'n' },
+		{ "service",        required_argument, NULL, 's' },
+		{ "port",           required_argument, NULL, 'p' },
+		{ "enable-loop",    no_argument,       NULL, 'l' },
+		{ "enable-fec",     required_argument, NULL, 'f' },
+		{ "list",           no_argument,       NULL, 'i' },
+		{ "help",           no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int c;
+	while ((c = getopt_long (argc, argv, "s:n:p:f:K:N:lih", long_options, NULL)) != -1)
+	{
+		switch (c) {
+		case 'n':	network = optarg; break;
+		case 's':	port = atoi (optarg); break;
+		case 'p':	udp_encap_port = atoi (optarg); break;
+		case 'f':	use_fec = TRUE; break;
+		case 'K':	rs_k = atoi (optarg); break;
+		case 'N':	rs_n = atoi (optarg); break;
+		case 'l':	use_multicast_loop = TRUE; break;
+
+		case 'i':
+			cpgm::pgm_if_print_all();
+			return EXIT_SUCCESS;
+
+		case 'h':
+		case '?': usage (binary_name);
+		}
+	}
+
+	if (use_fec && ( !rs_n || !rs_k )) {
+		std::cerr << "Invalid Reed-Solomon parameters RS(" << rs_n << "," << rs_k << ")." << std::endl;
+		usage (binary_name);
+	}
+
+/* setup signal handlers, delivery interrupts the reactor wait */
+	struct sigaction sa;
+	std::memset (&sa, 0, sizeof (sa));
+	sa.sa_handler = on_signal;
+	sigaction (SIGINT,  &sa, NULL);
+	sigaction (SIGTERM, &sa, NULL);
+#ifdef SIGHUP
+	std::signal (SIGHUP,  SIG_IGN);
+#endif
+
+	if (!on_startup()) {
+		std::cerr << "Startup failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+/* dispatch loop */
+	{
+		pgm_reactor reactor;
+		pgm_async_socket<ip::pgm> async_sock (reactor, *sock);
+		if (!reactor.is_valid() || !async_sock.open()) {
+			std::cerr << "Registering PGM socket with reactor failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+		reactor.spawn (receiver (async_sock));
+		std::cout << "Entering PGM message loop ... " << std::endl;
+		while (!is_terminated)
+			reactor.run_once (-1);
+		async_sock.close();
+	}
+
+	std::cout << "Message loop terminated, cleaning up." << std::endl;
+
+/* cleanup */
+	if (sock) {
+		std::cout << "Closing PGM socket." << std::endl;
+		sock->close (TRUE);
+		sock = NULL;
+	}
+
+	std::cout << "PGM engine shutdown." << std::endl;
+	cpgm::pgm_shutdown ();
+	std::cout << "finished." << std::endl;
+	return EXIT_SUCCESS;
+}
+
+static
+void
+on_signal (
+	int		signum
+	)
+{
+	(void)signum;
+	is_terminated = TRUE;
+}
+
+static
+bool
+on_startup (void)
+{
+	struct cpgm::pgm_addrinfo_t* res = NULL;
+	cpgm::pgm_error_t* pgm_err = NULL;
+	sa_family_t sa_family = AF_UNSPEC;
+
+/* parse network parameter into PGM socket address structure */
+	if (!cpgm::pgm_getaddrinfo (network, NULL, &res, &pgm_err)) {
+		std::cerr << "Parsing network parameter: " << pgm_err->message << std::endl;
+		goto err_abort;
+	}
+
+	sa_family = res->ai_send_addrs[0].gsr_group.ss_family;
+
+	sock = new ip::pgm::socket();
+
+	if (udp_encap_port) {
+		std::cout << "Create PGM/UDP socket." << std::endl;
+		if (!sock->open (sa_family, SOCK_SEQPACKET, IPPROTO_UDP, &pgm_err)) {
+			std::cerr << "Creating PGM/UDP socket: " << pgm_err->message << std::endl;
+			goto err_abort;
+		}
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_UDP_ENCAP_UCAST_PORT, &udp_encap_port, sizeof(udp_encap_port));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_UDP_ENCAP_MCAST_PORT, &udp_encap_port, sizeof(udp_encap_port));
+	} else {
+		std::cout << "Create PGM/IP socket." << std::endl;
+		if (!sock->open (sa_family, SOCK_SEQPACKET, IPPROTO_PGM, &pgm_err)) {
+			std::cerr << "Creating PGM/IP socket: " << pgm_err->message << std::endl;
+			goto err_abort;
+		}
+	}
+
+	{
+/* Use RFC 2113 tagging for PGM Router Assist */
+		const int no_router_assist = 0;
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_IP_ROUTER_ALERT, &no_router_assist, sizeof(no_router_assist));
+	}
+
+	cpgm::pgm_drop_superuser();
+
+	{
+/* set PGM parameters */
+		const int recv_only = 1,
+			  passive = 0,
+			  peer_expiry = pgm_secs (300),
+			  spmr_expiry = pgm_msecs (250),
+			  nak_bo_ivl = pgm_msecs (50),
+			  nak_rpt_ivl = pgm_secs (2),
+			  nak_rdata_ivl = pgm_secs (2),
+			  nak_data_retries = 50,
+			  nak_ncf_retries = 50;
+
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_RECV_ONLY, &recv_only, sizeof(recv_only));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_PASSIVE, &passive, sizeof(passive));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_MTU, &max_tpdu, sizeof(max_tpdu));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_RXW_SQNS, &sqns, sizeof(sqns));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_PEER_EXPIRY, &peer_expiry, sizeof(peer_expiry));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_SPMR_EXPIRY, &spmr_expiry, sizeof(spmr_expiry));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NAK_BO_IVL, &nak_bo_ivl, sizeof(nak_bo_ivl));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NAK_RPT_IVL, &nak_rpt_ivl, sizeof(nak_rpt_ivl));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NAK_RDATA_IVL, &nak_rdata_ivl, sizeof(nak_rdata_ivl));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NAK_DATA_RETRIES, &nak_data_retries, sizeof(nak_data_retries));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NAK_NCF_RETRIES, &nak_ncf_retries, sizeof(nak_ncf_retries));
+	}
+	if (use_fec) {
+		struct cpgm::pgm_fecinfo_t fecinfo;
+		fecinfo.block_size		= rs_n;
+		fecinfo.proactive_packets	= 0;
+		fecinfo.group_size		= rs_k;
+		fecinfo.ondemand_parity_enabled	= TRUE;
+		fecinfo.var_pktlen_enabled	= FALSE;
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_USE_FEC, &fecinfo, sizeof(fecinfo));
+	}
+
+/* create global session identifier */
+	endpoint = new ip::pgm::endpoint (DEFAULT_DATA_DESTINATION_PORT);
+
+/* assign socket to specified address */
+	if (!sock->bind (*endpoint, &pgm_err)) {
+		std::cerr << "Binding PGM socket: " << pgm_err->message << std::endl;
+		goto err_abort;
+	}
+
+/* join IP multicast groups */
+	for (unsigned i = 0; i < res->ai_recv_addrs_len; i++)
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct cpgm::pgm_group_source_req));
+	sock->set_option (IPPROTO_PGM, cpgm::PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct cpgm::pgm_group_source_req));
+	cpgm::pgm_freeaddrinfo (res);
+
+	{
+/* set IP parameters */
+		const int nonblocking = 1,
+			  multicast_loop = use_multicast_loop ? 1 : 0,
+			  multicast_hops = 16,
+			  dscp = 0x2e << 2;		/* Expedited Forwarding PHB for network elements, no ECN. */
+
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_MULTICAST_LOOP, &multicast_loop, sizeof(multicast_loop));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_MULTICAST_HOPS, &multicast_hops, sizeof(multicast_hops));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_TOS, &dscp, sizeof(dscp));
+		sock->set_option (IPPROTO_PGM, cpgm::PGM_NOBLOCK, &nonblocking, sizeof(nonblocking));
+	}
+
+	if (!sock->connect (&pgm_err)) {
+		std::cerr << "Connecting PGM socket: " << pgm_err->message << std::endl;
+		goto err_abort;
+	}
+
+	std::cout << "Startup complete." << std::endl;
+	return TRUE;
+
+err_abort:
+	if (NULL != sock) {
+		sock->close (FALSE);
+		sock = NULL;
+	}
+	if (NULL != res) {
+		cpgm::pgm_freeaddrinfo (res);
+		res = NULL;
+	}
+	if (NULL != pgm_err) {
+		cpgm::pgm_error_free (pgm_err);
+		pgm_err = NULL;
+	}
+	return FALSE;
+}
+
+/* receive until terminated, the task suspends inside the reactor whenever the
+ * socket would block or is waiting on a NAK or rate timer.
+ */
+
+static
+pgm_task<void>
+receiver (
+	pgm_async_socket<ip::pgm>&	async_sock
+	)
+{
+	struct cpgm::pgm_msgv_t msgv[20];
+
+	while (!is_terminated) {
+		pgm_async_result result = co_await async_sock.async_receive (std::span<cpgm::pgm_msgv_t> (msgv));
+		if (cpgm::PGM_IO_STATUS_NORMAL == result.status) {
+			for (const cpgm::pgm_msgv_t& apdu : result.msgv)
+				on_msgv (&apdu);
+			continue;
+		}
+		if (NULL != result.error) {
+			std::cerr << result.error->message << std::endl;
+			cpgm::pgm_error_free (result.error);
+		}
+		if (cpgm::PGM_IO_STATUS_ERROR == result.status)
+			break;
+	}
+}
+
+static
+int
+on_msgv (
+	const struct cpgm::pgm_msgv_t*	msgv
+	)
+{
+/* protect against non-null terminated strings */
+	char buf[1024], tsi[PGM_TSISTRLEN];
+	size_t buflen = 0, apdu_len = 0;
+	for (unsigned i = 0; i < msgv->msgv_len; i++) {
+		const std::span<const std::byte> data = pgm_async_socket<ip::pgm>::data (msgv->msgv_skb[i]);
+		const size_t copylen = MIN(sizeof(buf) - 1 - buflen, data.size());
+		std::memcpy (buf + buflen, data.data(), copylen);
+		buflen += copylen;
+		apdu_len += data.size();
+	}
+	buf[buflen] = '\0';
+	cpgm::pgm_tsi_print_r (&msgv->msgv_skb[0]->tsi, tsi, sizeof(tsi));
+	std::cout << "\"" << buf << "\" (" << apdu_len << " bytes from " << tsi << ")" << std::endl;
+	return 0;
+}
+
+/* eof */
@@ -0,0 +1,424 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * AF_XDP datapath benchmark.  One side sends a fixed count of messages as
+ * fast as the rate limit allows, the other receives them and reports the
+ * per-message cost, with and without the XDP datapath.  Intended for a veth
+ * pair between two network namespaces, see xdpbench.sh.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/select.h>
+#include <pgm/pgm.h>
+
+
+/* globals */
+
+static int		port = 0;
+static const char*	network = "";
+static int		udp_encap_port = 7500;
+
+static int		max_tpdu = 1500;
+static int		max_rte = 100*1000*1000;
+static int		sqns = 1000;
+
+static bool		is_sender = FALSE;
+static unsigned		count = 100000;
+static unsigned		size = 1000;
+static unsigned		idle_secs = 2;
+
+static bool		use_xdp = FALSE;
+static struct pgm_xdpinfo_t xdpinfo;
+
+static pgm_sock_t*	sock = NULL;
+
+static void usage (const char*) __attribute__((__noreturn__));
+static bool create_sock (void);
+static int on_send (void);
+static int on_recv (void);
+
+
+static void
+usage (
+	const char*	bin
+	)
+{
+	fprintf (stderr, "Usage: %s [options]\n", bin);
+	fprintf (stderr, "  -n, --network NETWORK    : Multicast group or unicast IP address\n");
+	fprintf (stderr, "  -s, --service PORT       : IP port\n");
+	fprintf (stderr, "  -p, --port PORT          : Encapsulate PGM in UDP on IP port (7500)\n");
+	fprintf (stderr, "  -r, --speed-limit RATE   : Regulate to RATE bytes per second\n");
+	fprintf (stderr, "  -S, --send               : Send instead of receive\n");
+	fprintf (stderr, "  -c, --count COUNT        : Number of messages (100000)\n");
+	fprintf (stderr, "  -z, --size SIZE          : Message size in bytes (1000)\n");
+	fprintf (stderr, "  -t, --idle SECONDS       : Receiver gives up after SECONDS idle (2)\n");
+	fprintf (stderr, "  -x, --xdp QUEUE          : Enable the AF_XDP datapath on QUEUE\n");
+	fprintf (stderr, "  -X, --skb-mode           : Use generic XDP and copy mode\n");
+	fprintf (stderr, "  -R, --recv-only-xdp      : Transmit through the socket path\n");
+	exit (EXIT_SUCCESS);
+}
+
+static
+double
+now_secs (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static
+void
+report (
+	const char*	mode,
+	const unsigned	messages,
+	const double	elapsed
+	)
+{
+	if (0 == messages || elapsed <= 0.0) {
+		printf ("%s: no messages\n", mode);
+		return;
+	}
+	printf ("%s: %s %u/%u msgs in %.3f s, %.0f msg/s, %.3f us/msg, %.1f MB/s\n",
+		use_xdp ? ((xdpinfo.xi_flags & PGM_XDP_SKB_MODE) ? "xdp-skb" : "xdp") : "socket",
+		mode, messages, count, elapsed,
+		(double)messages / elapsed,
+		elapsed * 1e6 / (double)messages,
+		(double)messages * size / elapsed / 1e6);
+}
+
+int
+main (
+	int	argc,
+	char   *argv[]
+	)
+{
+	pgm_error_t* pgm_err = NULL;
+	int retval = EXIT_FAILURE;
+
+	setlocale (LC_ALL, "");
+
+	if (!pgm_init (&pgm_err)) {
+		fprintf (stderr, "Unable to start PGM engine: %s\n", pgm_err->message);
+		pgm_error_free (pgm_err);
+		return EXIT_FAILURE;
+	}
+
+/* parse program arguments */
+	const char* binary_name = strrchr (argv[0], '/');
+	if (NULL == binary_name)	binary_name = argv[0];
+	else				binary_name++;
+
+	static struct option long_options[] = {
+		{ "network",        required_argument, NULL, 'n' },
+		{ "service",        required_argument, NULL, 's' },
+		{ "port",           required_argument, NULL, 'p' },
+		{ "speed-limit",    required_argument, NULL, 'r' },
+		{ "send",           no_argument,       NULL, 'S' },
+		{ "count",          required_argument, NULL, 'c' },
+		{ "size",           required_argument, NULL, 'z' },
+		{ "idle",           required_argument, NULL, 't' },
+		{ "xdp",            required_argument, NULL, 'x' },
+		{ "skb-mode",       no_argument,       NULL, 'X' },
+		{ "recv-only-xdp",  no_argument,       NULL, 'R' },
+		{ "help",           no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int c;
+	while ((c = getopt_long (argc, argv, "s:n:p:r:Sc:z:t:x:XRh", long_options, NULL)) != -1)
+	{
+		switch (c) {
+		case 'n':	network = optarg; break;
+		case 's':	port = atoi (optarg); break;
+		case 'p':	udp_encap_port = atoi (optarg); break;
+		case 'r':	max_rte = atoi (optarg); break;
+		case 'S':	is_sender = TRUE; break;
+		case 'c':	count = (unsigned)atoi (optarg); break;
+		case 'z':	size = (unsigned)atoi (optarg); break;
+		case 't':	idle_secs = (unsigned)atoi (optarg); break;
+		case 'x':	use_xdp = TRUE; xdpinfo.xi_queue_id = (uint32_t)atoi (optarg); break;
+		case 'X':	xdpinfo.xi_flags |= PGM_XDP_SKB_MODE; break;
+		case 'R':	xdpinfo.xi_flags |= PGM_XDP_RECV_ONLY; break;
+
+		case 'h':
+		case '?':
+			usage (binary_name);
+		}
+	}
+
+	if (0 == udp_encap_port || 0 == count || 0 == size || size > 65000) {
+		fprintf (stderr, "Invalid parameters.\n");
+		usage (binary_name);
+	}
+
+	if (create_sock())
+		retval = is_sender ? on_send() : on_recv();
+
+/* cleanup */
+	if (sock) {
+		pgm_close (sock, TRUE);
+		sock = NULL;
+	}
+	pgm_shutdown();
+	return retval;
+}
+
+static
+int
+on_send (void)
+{
+	char* buffer = calloc (1, size);
+	unsigned sent = 0;
+
+	const double start = now_secs();
+	while (sent < count) {
+		const int status = pgm_send (sock, buffer, size, NULL);
+		if (PGM_IO_STATUS_NORMAL != status) {
+			fprintf (stderr, "pgm_send() failed.\n");
+			break;
+		}
+		sent++;
+	}
+	report ("sent", sent, now_secs() - start);
+	free (buffer);
+
+/* linger for repairs */
+	sleep (idle_secs);
+	return sent == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static
+int
+on_recv (void)
+{
+	pgm_error_t* pgm_err = NULL;
+	const size_t buflen = size > (unsigned)max_tpdu ? size : (size_t)max_tpdu;
+	char* buffer = malloc (buflen);
+	unsigned received = 0, resets = 0;
+	double start = 0.0, last = 0.0;
+
+	do {
+		struct timeval tv;
+		fd_set readfds;
+		int fds = 0;
+		size_t len;
+		const int status = pgm_recv (sock, buffer, buflen, 0, &len, &pgm_err);
+		switch (status) {
+		case PGM_IO_STATUS_NORMAL:
+			last = now_secs();
+			if (0 == received++)
+				start = last;
+			break;
+		case PGM_IO_STATUS_TIMER_PENDING:
+			{
+				socklen_t optlen = sizeof (tv);
+				pgm_getsockopt (sock, IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen);
+			}
+			goto block;
+		case PGM_IO_STATUS_RATE_LIMITED:
+			{
+				socklen_t optlen = sizeof (tv);
+				pgm_getsockopt (sock, IPPROTO_PGM, PGM_RATE_REMAIN, &tv, &optlen);
+			}
+			goto block;
+		case PGM_IO_STATUS_WOULD_BLOCK:
+			tv.tv_sec = idle_secs;
+			tv.tv_usec = 0;
+block:
+			if (received > 0 && now_secs() - last > (double)idle_secs)
+				goto out;
+			FD_ZERO(&readfds);
+			pgm_select_info (sock, &readfds, NULL, &fds);
+			if (0 == select (fds, &readfds, NULL, NULL, &tv) &&
+			    PGM_IO_STATUS_WOULD_BLOCK == status &&
+			    received > 0)
+				goto out;
+			break;
+
+		case PGM_IO_STATUS_RESET:
+			resets++;
+			if (pgm_err) {
+				pgm_error_free (pgm_err);
+				pgm_err = NULL;
+			}
+			break;
+
+		default:
+			if (pgm_err) {
+				fprintf (stderr, "%s\n", pgm_err->message);
+				pgm_error_free (pgm_err);
+				pgm_err = NULL;
+			}
+			if (PGM_IO_STATUS_ERROR == status)
+				goto out;
+		}
+	} while (received < count);
+
+out:
+	report ("received", received, last - start);
+	if (resets > 0)
+		printf ("%u resets on unrecoverable loss.\n", resets);
+	free (buffer);
+	return received == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static
+bool
+create_sock (void)
+{
+	struct pgm_addrinfo_t* res = NULL;
+	pgm_error_t* pgm_err = NULL;
+	sa_family_t sa_family = AF_UNSPEC;
+
+/* parse network parameter into PGM socket address structure */
+	if (!pgm_getaddrinfo (network, NULL, &res, &pgm_err)) {
+		fprintf (stderr, "Parsing network parameter: %s\n", pgm_err->message);
+		goto err_abort;
+	}
+
+	sa_family = res->ai_send_addrs[0].gsr_group.ss_family;
+
+	if (!pgm_socket (&sock, sa_family, SOCK_SEQPACKET, IPPROTO_UDP, &pgm_err)) {
+		fprintf (stderr, "Creating PGM/UDP socket: %s\n", pgm_err->message);
+		goto err_abort;
+	}
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_UDP_ENCAP_UCAST_PORT, &udp_encap_port, sizeof(udp_encap_port));
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_UDP_ENCAP_MCAST_PORT, &udp_encap_port, sizeof(udp_encap_port));
+
+/* superuser privileges are retained as binding AF_XDP requires CAP_NET_ADMIN */
+
+/* set PGM parameters */
+	const int ambient_spm = pgm_secs (30),
+		  heartbeat_spm[] = { pgm_msecs (100),
+				      pgm_msecs (100),
+				      pgm_msecs (100),
+				      pgm_msecs (100),
+				      pgm_msecs (1300),
+				      pgm_secs  (7),
+				      pgm_secs  (16),
+				      pgm_secs  (25),
+				      pgm_secs  (30) },
+		  peer_expiry = pgm_secs (300),
+		  spmr_expiry = pgm_msecs (250),
+		  nak_bo_ivl = pgm_msecs (50),
+		  nak_rpt_ivl = pgm_secs (2),
+		  nak_rdata_ivl = pgm_secs (2),
+		  nak_data_retries = 50,
+		  nak_ncf_retries = 50,
+		  no_router_assist = 0,
+		  rcvbuf = 4*1024*1024,
+		  on = 1;
+
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_IP_ROUTER_ALERT, &no_router_assist, sizeof(no_router_assist));
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_MTU, &max_tpdu, sizeof(max_tpdu));
+	if (is_sender) {
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_SEND_ONLY, &on, sizeof(on));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_TXW_SQNS, &sqns, sizeof(sqns));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_TXW_MAX_RTE, &max_rte, sizeof(max_rte));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_AMBIENT_SPM, &ambient_spm, sizeof(ambient_spm));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_HEARTBEAT_SPM, &heartbeat_spm, sizeof(heartbeat_spm));
+	} else {
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_RECV_ONLY, &on, sizeof(on));
+		pgm_setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_RXW_SQNS, &sqns, sizeof(sqns));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_PEER_EXPIRY, &peer_expiry, sizeof(peer_expiry));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_SPMR_EXPIRY, &spmr_expiry, sizeof(spmr_expiry));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_BO_IVL, &nak_bo_ivl, sizeof(nak_bo_ivl));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RPT_IVL, &nak_rpt_ivl, sizeof(nak_rpt_ivl));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RDATA_IVL, &nak_rdata_ivl, sizeof(nak_rdata_ivl));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_DATA_RETRIES, &nak_data_retries, sizeof(nak_data_retries));
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_NCF_RETRIES, &nak_ncf_retries, sizeof(nak_ncf_retries));
+	}
+	if (use_xdp)
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_XDP, &xdpinfo, sizeof(xdpinfo));
+
+/* create global session identifier */
+	struct pgm_sockaddr_t addr;
+	memset (&addr, 0, sizeof(addr));
+	addr.sa_port = port ? port : DEFAULT_DATA_DESTINATION_PORT;
+	addr.sa_addr.sport = DEFAULT_DATA_SOURCE_PORT;
+	if (!pgm_gsi_create_from_hostname (&addr.sa_addr.gsi, &pgm_err)) {
+		fprintf (stderr, "Creating GSI: %s\n", pgm_err->message);
+		goto err_abort;
+	}
+
+/* assign socket to specified address */
+	struct pgm_interface_req_t if_req;
+	memset (&if_req, 0, sizeof(if_req));
+	if_req.ir_interface = res->ai_recv_addrs[0].gsr_interface;
+	memcpy (&if_req.ir_address, &res->ai_send_addrs[0].gsr_addr, sizeof(struct sockaddr_storage));
+	if (!pgm_bind3 (sock,
+			&addr, sizeof(addr),
+			&if_req, sizeof(if_req),	/* tx interface */
+			&if_req, sizeof(if_req),	/* rx interface */
+			&pgm_err))
+	{
+		fprintf (stderr, "Binding PGM socket: %s\n", pgm_err->message);
+		goto err_abort;
+	}
+
+/* join IP multicast groups */
+	unsigned i;
+	for (i = 0; i < res->ai_recv_addrs_len; i++)
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct pgm_group_source_req));
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct pgm_group_source_req));
+	pgm_freeaddrinfo (res);
+	res = NULL;
+
+/* set IP parameters */
+	const int blocking = 0,
+		  nonblocking = 1,
+		  multicast_hops = 16;
+
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &multicast_hops, sizeof(multicast_hops));
+	if (is_sender)
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NOBLOCK, &blocking, sizeof(blocking));
+	else
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_NOBLOCK, &nonblocking, sizeof(nonblocking));
+
+	if (!pgm_connect (sock, &pgm_err)) {
+		fprintf (stderr, "Connecting PGM socket: %s\n", pgm_err->message);
+		goto err_abort;
+	}
+
+	return TRUE;
+
+err_abort:
+	if (NULL != sock) {
+		pgm_close (sock, FALSE);
+		sock = NULL;
+	}
+	if (NULL != res) {
+		pgm_freeaddrinfo (res);
+		res = NULL;
+	}
+	if (NULL != pgm_err) {
+		pgm_error_free (pgm_err);
+		pgm_err = NULL;
+	}
+	return FALSE;
+}
+
+/* eof */
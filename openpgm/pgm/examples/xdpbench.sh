@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# Run xdpbench across a veth pair between two network namespaces comparing
+# the socket datapath with native and generic AF_XDP.  Requires root.
+#
+#   xdpbench.sh [path/to/xdpbench] [count] [size]
+
+BENCH=${1:-./xdpbench}
+COUNT=${2:-100000}
+SIZE=${3:-1000}
+GROUP="239.192.0.1"
+PORT=7500
+
+cleanup() {
+	ip netns del pgmbench-a 2>/dev/null
+	ip netns del pgmbench-b 2>/dev/null
+}
+trap cleanup EXIT
+
+cleanup
+ip netns add pgmbench-a || exit 1
+ip netns add pgmbench-b || exit 1
+ip link add veth-a numtxqueues 2 numrxqueues 2 netns pgmbench-a \
+	type veth peer name veth-b numtxqueues 2 numrxqueues 2 netns pgmbench-b || exit 1
+ip -n pgmbench-a addr add 10.9.0.1/24 dev veth-a
+ip -n pgmbench-b addr add 10.9.0.2/24 dev veth-b
+ip -n pgmbench-a link set veth-a up
+ip -n pgmbench-b link set veth-b up
+ip -n pgmbench-a link set lo up
+ip -n pgmbench-b link set lo up
+# native XDP on veth requires a program, or GRO, on the peer
+ip netns exec pgmbench-a ethtool -K veth-a gro on >/dev/null 2>&1
+
+run() {
+	local mode=$1; shift
+	echo "== $mode"
+	ip netns exec pgmbench-b "$BENCH" -n "10.9.0.2;$GROUP" -p $PORT -c $COUNT -z $SIZE "$@" &
+	local receiver=$!
+	sleep 1
+	ip netns exec pgmbench-a "$BENCH" -S -n "10.9.0.1;$GROUP" -p $PORT -c $COUNT -z $SIZE
+	wait $receiver
+}
+
+run socket
+run xdp -x 0
+run xdp-skb -x 0 -X
+
+# eof
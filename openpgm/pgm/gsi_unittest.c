@@ -366,7 +366,7 @@ main (void)
 	g_assert (LOBYTE (wsaData.wVersion) == 2 && HIBYTE (wsaData.wVersion) == 2);
 #endif
 /* GSI depends upond PRNG which depends upon time */
-	g_assert (pgm_time_init(NULL));
+	g_assert (pgm_time_init (NULL, NULL));
 	pgm_messages_init();
 	pgm_rand_init();
 	SRunner* sr = srunner_create (make_master_suite ());
@@ -34,6 +34,10 @@
 
 pgm_slist_t* pgm_histograms = NULL;
 
+/* global list lock, registration and unregistration race the HTTP thread */
+static volatile uint32_t histograms_ref_count = 0;
+static pgm_mutex_t histograms_mutex;
+
 
 static void sample_set_accumulate (pgm_sample_set_t*, pgm_sample_t, pgm_count_t, unsigned);
 static pgm_count_t sample_set_total_count (const pgm_sample_set_t*) PGM_GNUC_PURE;
@@ -70,19 +74,41 @@ pgm_histogram_add (
 	accumulate (histogram, value, 1, i);
 }
 
+PGM_GNUC_INTERNAL
+void
+pgm_histograms_init (void)
+{
+	if (pgm_atomic_exchange_and_add32 (&histograms_ref_count, 1) > 0)
+		return;
+
+	pgm_mutex_init (&histograms_mutex);
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_histograms_shutdown (void)
+{
+	pgm_return_if_fail (pgm_atomic_read32 (&histograms_ref_count) > 0);
+
+	if (pgm_atomic_exchange_and_add32 (&histograms_ref_count, (uint32_t)-1) != 1)
+		return;
+
+	pgm_mutex_free (&histograms_mutex);
+}
+
 void
 pgm_histogram_write_html_graph_all (
 	pgm_string_t*		string
 	)
 {
-	if (!pgm_histograms)
-		return;
+	pgm_mutex_lock (&histograms_mutex);
 	pgm_slist_t* snapshot = pgm_histograms;
 	while (snapshot) {
 		pgm_histogram_t* histogram = snapshot->data;
 		pgm_histogram_write_html_graph (histogram, string);
 		snapshot = snapshot->next;
 	}
+	pgm_mutex_unlock (&histograms_mutex);
 }
 
 static
@@ -142,10 +168,42 @@ pgm_histogram_init (
 	initialize_bucket_range (histogram);
 
 /* register with global list */
+	pgm_mutex_lock (&histograms_mutex);
 	histogram->histograms_link.data = histogram;
 	histogram->histograms_link.next = pgm_histograms;
 	pgm_histograms = &histogram->histograms_link;
 	histogram->is_registered = TRUE;
+	pgm_mutex_unlock (&histograms_mutex);
+}
+
+/* remove a dynamically allocated histogram from the global list.
+ */
+
+void
+pgm_histogram_unregister (
+	pgm_histogram_t*	histogram
+	)
+{
+	pgm_slist_t *prev = NULL, *link;
+
+	pgm_mutex_lock (&histograms_mutex);
+	if (!histogram->is_registered) {
+		pgm_mutex_unlock (&histograms_mutex);
+		return;
+	}
+	for (link = pgm_histograms; NULL != link; prev = link, link = link->next)
+	{
+		if (link != &histogram->histograms_link)
+			continue;
+		if (NULL == prev)
+			pgm_histograms = link->next;
+		else
+			prev->next = link->next;
+		break;
+	}
+	histogram->histograms_link.next = NULL;
+	histogram->is_registered = FALSE;
+	pgm_mutex_unlock (&histograms_mutex);
 }
 
 static
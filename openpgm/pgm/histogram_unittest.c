@@ -0,0 +1,239 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for histograms.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+
+/* mock state */
+
+#define HISTOGRAM_DEBUG
+#include "histogram.c"
+
+#define TEST_BUCKETS		10
+
+struct test_histogram_t {
+	pgm_histogram_t		histogram;
+	pgm_count_t		counts[ TEST_BUCKETS ];
+	pgm_sample_t		ranges[ TEST_BUCKETS + 1 ];
+};
+
+static
+pgm_histogram_t*
+generate_histogram (
+	const char*		name
+	)
+{
+	struct test_histogram_t* t = g_malloc0 (sizeof(struct test_histogram_t));
+	t->histogram.histogram_name	= name;
+	t->histogram.bucket_count	= TEST_BUCKETS;
+	t->histogram.declared_min	= 1;
+	t->histogram.declared_max	= 1000;
+	t->histogram.ranges		= t->ranges;
+	t->histogram.sample.counts	= t->counts;
+	t->histogram.sample.counts_len	= TEST_BUCKETS;
+	return &t->histogram;
+}
+
+static
+bool
+is_registered (
+	const pgm_histogram_t*	histogram
+	)
+{
+	for (const pgm_slist_t* list = pgm_histograms; NULL != list; list = list->next)
+		if (list->data == histogram)
+			return TRUE;
+	return FALSE;
+}
+
+
+/* mock functions for external references */
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+static
+void
+mock_setup (void)
+{
+	pgm_histograms_init();
+	pgm_histograms = NULL;
+}
+
+static
+void
+mock_teardown (void)
+{
+	pgm_histograms_shutdown();
+}
+
+
+/* target:
+ *	void
+ *	pgm_histogram_init (
+ *		pgm_histogram_t*	histogram
+ *	)
+ */
+
+START_TEST (test_init_pass_001)
+{
+	pgm_histogram_t* histogram = generate_histogram ("init");
+	pgm_histogram_init (histogram);
+	fail_unless (TRUE == histogram->is_registered, "not registered");
+	fail_unless (is_registered (histogram), "not in list");
+	fail_unless (histogram->ranges[ 0 ] < histogram->ranges[ TEST_BUCKETS - 1 ], "bucket ranges not set");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_histogram_unregister (
+ *		pgm_histogram_t*	histogram
+ *	)
+ */
+
+/* head of list */
+START_TEST (test_unregister_pass_001)
+{
+	pgm_histogram_t* a = generate_histogram ("a");
+	pgm_histogram_t* b = generate_histogram ("b");
+	pgm_histogram_init (a);
+	pgm_histogram_init (b);
+	pgm_histogram_unregister (b);
+	fail_unless (FALSE == b->is_registered, "still registered");
+	fail_unless (!is_registered (b), "still in list");
+	fail_unless (is_registered (a), "sibling removed");
+	fail_unless (1 == pgm_slist_length (pgm_histograms), "list length");
+}
+END_TEST
+
+/* middle and tail of list */
+START_TEST (test_unregister_pass_002)
+{
+	pgm_histogram_t* a = generate_histogram ("a");
+	pgm_histogram_t* b = generate_histogram ("b");
+	pgm_histogram_t* c = generate_histogram ("c");
+	pgm_histogram_init (a);
+	pgm_histogram_init (b);
+	pgm_histogram_init (c);
+	pgm_histogram_unregister (b);
+	fail_unless (!is_registered (b), "still in list");
+	fail_unless (is_registered (a) && is_registered (c), "sibling removed");
+	pgm_histogram_unregister (a);
+	fail_unless (!is_registered (a), "still in list");
+	fail_unless (is_registered (c), "sibling removed");
+	fail_unless (1 == pgm_slist_length (pgm_histograms), "list length");
+}
+END_TEST
+
+/* unregistered histograms are ignored */
+START_TEST (test_unregister_pass_003)
+{
+	pgm_histogram_t* a = generate_histogram ("a");
+	pgm_histogram_t* b = generate_histogram ("b");
+	pgm_histogram_init (a);
+	pgm_histogram_unregister (b);
+	pgm_histogram_unregister (a);
+	pgm_histogram_unregister (a);
+	fail_unless (NULL == pgm_histograms, "list not empty");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_histogram_write_html_graph_all (
+ *		pgm_string_t*		string
+ *	)
+ */
+
+START_TEST (test_write_html_graph_all_pass_001)
+{
+	pgm_histogram_t* a = generate_histogram ("alpha");
+	pgm_histogram_t* b = generate_histogram ("beta");
+	pgm_histogram_init (a);
+	pgm_histogram_init (b);
+	pgm_histogram_add (a, 10);
+	pgm_histogram_unregister (b);
+	pgm_string_t* string = pgm_string_new (NULL);
+	pgm_histogram_write_html_graph_all (string);
+	fail_unless (NULL != strstr (string->str, "alpha"), "missing histogram");
+	fail_unless (NULL == strstr (string->str, "beta"), "unregistered histogram");
+	pgm_string_free (string, TRUE);
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_init = tcase_create ("init");
+	suite_add_tcase (s, tc_init);
+	tcase_add_checked_fixture (tc_init, mock_setup, mock_teardown);
+	tcase_add_test (tc_init, test_init_pass_001);
+
+	TCase* tc_unregister = tcase_create ("unregister");
+	suite_add_tcase (s, tc_unregister);
+	tcase_add_checked_fixture (tc_unregister, mock_setup, mock_teardown);
+	tcase_add_test (tc_unregister, test_unregister_pass_001);
+	tcase_add_test (tc_unregister, test_unregister_pass_002);
+	tcase_add_test (tc_unregister, test_unregister_pass_003);
+
+	TCase* tc_write_html_graph_all = tcase_create ("write-html-graph-all");
+	suite_add_tcase (s, tc_write_html_graph_all);
+	tcase_add_checked_fixture (tc_write_html_graph_all, mock_setup, mock_teardown);
+	tcase_add_test (tc_write_html_graph_all, test_write_html_graph_all_pass_001);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
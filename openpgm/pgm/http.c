@@ -730,6 +730,9 @@ http_routine (
 	)
 {
 	const SOCKET notify_fd = pgm_notify_get_socket (&http_notify);
+
+/* follow processor affinity of bound sockets */
+	pgm_sock_apply_service_affinity();
 	const int max_fd = MAX( notify_fd, http_sock );
 
 	FD_ZERO( &http_readfds );
@@ -0,0 +1,82 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * APDU payload transform and built-in LZ codec.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_COMPRESS_H__
+#define __PGM_IMPL_COMPRESS_H__
+
+typedef struct pgm_compress_t pgm_compress_t;
+
+#include <pgm/types.h>
+#include <pgm/msgv.h>
+#include <pgm/skbuff.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+#define PGM_COMPRESS_DEFAULT_MIN	128		/* bytes, shorter APDUs gain little over the headers */
+#define PGM_LZ_HASH_LOG			12
+
+/* leads every transformed APDU, tagged by OPT_TRANSFORM.
+ */
+struct pgm_transform_header_t {
+	uint8_t			th_codec;
+	uint8_t			th_reserved[3];
+	uint32_t		th_length;		/* decoded length */
+};
+
+struct pgm_compress_t {
+	struct pgm_compressinfo_t	info;
+	struct pgm_compress_stats_t	stats;
+
+/* source, encoded APDU of the current send */
+	char*				buf;
+	size_t				buf_len;
+	size_t				encoded_length;
+	char*				gather;			/* pgm_sendv() of one APDU */
+	uint16_t			hash[ 1 << PGM_LZ_HASH_LOG ];
+
+/* receiver, decoded buffers held until the next read */
+	char*				scratch;		/* fragments of one APDU */
+	size_t				scratch_len;
+	struct pgm_sk_buff_t**		held_skbs;
+	unsigned			held_skbs_len;
+	unsigned			held_skbs_alloc;
+};
+
+PGM_GNUC_INTERNAL pgm_compress_t* pgm_compress_create (const struct pgm_compressinfo_t*const restrict, const size_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_compress_destroy (pgm_compress_t*);
+PGM_GNUC_INTERNAL bool pgm_compress_encode (pgm_compress_t*const restrict, const void*restrict, const size_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_compress_encodev (pgm_compress_t*const restrict, const struct pgm_iovec*const restrict, const unsigned, const size_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL ssize_t pgm_compress_msgv (pgm_compress_t*const restrict, struct pgm_msgv_t*restrict, struct pgm_msgv_t**restrict);
+PGM_GNUC_INTERNAL void pgm_compress_release (pgm_compress_t*const);
+PGM_GNUC_INTERNAL size_t pgm_lz_compress (uint16_t*restrict, const void*restrict, const size_t, void*restrict, const size_t);
+PGM_GNUC_INTERNAL ssize_t pgm_lz_decompress (const void*restrict, const size_t, void*restrict, const size_t);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_COMPRESS_H__ */
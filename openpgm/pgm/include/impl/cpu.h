@@ -45,6 +45,8 @@ struct pgm_cpu_t {
 	bool		has_sse42;
 	bool		has_avx;
 	bool		has_avx2;
+	uint32_t	signature;		/* family, model, and stepping */
+	uint32_t	tsc_khz;		/* nominal TSC frequency, 0 if not reported */
 };
 
 PGM_GNUC_INTERNAL void pgm_cpuid (pgm_cpu_t*);
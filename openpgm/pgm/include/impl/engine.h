@@ -41,6 +41,11 @@ extern LPFN_WSARECVMSG pgm_WSARecvMsg;
 extern unsigned pgm_loss_rate;
 #endif
 
+PGM_GNUC_INTERNAL int pgm_resolve_ipproto_pgm (void);
+#ifdef _WIN32
+PGM_GNUC_INTERNAL bool pgm_resolve_wsarecvmsg (SOCKET, pgm_error_t**);
+#endif
+
 PGM_END_DECLS
 
 #endif /* __PGM_IMPL_ENGINE_H__ */
@@ -44,6 +44,7 @@
 
 #include <impl/byteorder.h>
 #include <impl/checksum.h>
+#include <impl/compress.h>
 #include <impl/cpu.h>
 #include <impl/endian.h>
 #include <impl/errno.h>
@@ -60,12 +61,17 @@
 #include <impl/indextoname.h>
 #include <impl/inet_network.h>
 #include <impl/ip.h>
+#include <impl/journal.h>
+#include <impl/layer.h>
 #include <impl/list.h>
 #include <impl/math.h>
 #include <impl/md5.h>
+#include <impl/membership.h>
 #include <impl/messages.h>
 #include <impl/nametoindex.h>
 #include <impl/notify.h>
+#include <impl/numa.h>
+#include <impl/packet_mmap.h>
 #include <impl/processor.h>
 #include <impl/queue.h>
 #include <impl/rand.h>
@@ -78,8 +84,12 @@
 #include <impl/string.h>
 #include <impl/thread.h>
 #include <impl/time.h>
+#include <impl/timestamping.h>
+#include <impl/topic.h>
 #include <impl/tsi.h>
+#include <impl/txw_archive.h>
 #include <impl/wsastrerror.h>
+#include <impl/xdp.h>
 
 #undef __PGM_IMPL_FRAMEWORK_H_INSIDE__
 
@@ -111,7 +111,10 @@ typedef struct pgm_histogram_t pgm_histogram_t;
 
 extern pgm_slist_t*	pgm_histograms;
 
+PGM_GNUC_INTERNAL void pgm_histograms_init (void);
+PGM_GNUC_INTERNAL void pgm_histograms_shutdown (void);
 void pgm_histogram_init (pgm_histogram_t*);
+void pgm_histogram_unregister (pgm_histogram_t*);
 void pgm_histogram_add (pgm_histogram_t*, int);
 void pgm_histogram_write_html_graph_all (pgm_string_t*);
 
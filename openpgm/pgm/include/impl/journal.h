@@ -0,0 +1,121 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * Receiver journal of delivered APDUs.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_JOURNAL_H__
+#define __PGM_IMPL_JOURNAL_H__
+
+typedef struct pgm_journal_t pgm_journal_t;
+
+#include <pgm/types.h>
+#include <pgm/error.h>
+#include <pgm/msgv.h>
+#include <pgm/time.h>
+#include <pgm/tsi.h>
+#include <impl/hashtable.h>
+
+PGM_BEGIN_DECLS
+
+#define PGM_JOURNAL_MAGIC		0x4a4d4750	/* "PGMJ" */
+#define PGM_JOURNAL_VERSION		1
+#define PGM_JOURNAL_DEFAULT_SIZE	(64 * 1024 * 1024)
+#define PGM_JOURNAL_HEADER_SIZE		4096		/* records start on the next page */
+#define PGM_JOURNAL_SYNC_IVL		pgm_msecs(100)	/* asynchronous write-back */
+
+/* file header, head and tail are logical byte offsets increasing without
+ * wrap, the record area is addressed modulo size.
+ */
+struct pgm_journal_header_t {
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		size;			/* record area in bytes */
+	uint64_t		head;			/* oldest record */
+	uint64_t		tail;			/* next record */
+};
+
+/* followed by fragment_count uint16_t lengths, padding to 8 bytes, then
+ * the APDU.  zero length marks padding to the end of the record area.
+ */
+struct pgm_journal_record_t {
+	uint32_t		length;			/* including header, multiple of 8 */
+	pgm_tsi_t		tsi;
+	uint32_t		first_sqn;
+	uint32_t		apdu_length;
+	uint16_t		fragment_count;
+	uint16_t		reserved;
+};
+
+/* last journalled sequence per source, resumes a new peer's window */
+struct pgm_journal_peer_t {
+	pgm_tsi_t			tsi;
+	uint32_t			last_sqn;
+	struct pgm_journal_peer_t*	next;
+};
+
+struct pgm_journal_t {
+	struct pgm_journal_header_t*	header;
+	char*				records;
+	size_t				map_len;
+#ifndef _WIN32
+	int				fd;
+#else
+	HANDLE				file;
+	HANDLE				mapping;
+#endif
+	uint64_t			tail;			/* unpublished */
+	pgm_time_t			next_sync;
+	pgm_hashtable_t*		peers_hashtable;
+	struct pgm_journal_peer_t*	peers;
+
+/* replay of records found on open */
+	bool				is_replaying;
+	uint64_t			replay_offset;
+	uint64_t			replay_end;
+	struct pgm_sk_buff_t**		replay_skbs;		/* delivered by last call */
+	unsigned			replay_skbs_len;
+	unsigned			replay_skbs_alloc;
+};
+
+PGM_GNUC_INTERNAL pgm_journal_t* pgm_journal_create (const char*const restrict, const uint64_t, const bool, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_journal_destroy (pgm_journal_t*const);
+PGM_GNUC_INTERNAL void pgm_journal_append (pgm_journal_t*const restrict, const struct pgm_msgv_t*restrict, const struct pgm_msgv_t*const restrict, const pgm_time_t);
+PGM_GNUC_INTERNAL bool pgm_journal_lookup (const pgm_journal_t*const restrict, const pgm_tsi_t*const restrict, uint32_t*restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_journal_release_replay (pgm_journal_t*const);
+PGM_GNUC_INTERNAL void pgm_journal_replay (pgm_journal_t*const restrict, struct pgm_msgv_t**restrict, const struct pgm_msgv_t*const restrict, size_t*const restrict, unsigned*const restrict);
+
+static inline
+bool
+pgm_journal_is_replaying (
+	const pgm_journal_t*const journal
+	)
+{
+	return journal->is_replaying;
+}
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_JOURNAL_H__ */
@@ -0,0 +1,69 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * Layered multi-rate multicast, cumulative enhancement layers above the
+ * session joined and left by receivers on measured loss.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_LAYER_H__
+#define __PGM_IMPL_LAYER_H__
+
+typedef struct pgm_layer_t pgm_layer_t;
+
+#include <pgm/types.h>
+#include <pgm/socket.h>
+#include <pgm/time.h>
+#include <pgm/tsi.h>
+#include <impl/rate_control.h>
+#include <impl/thread.h>
+
+PGM_BEGIN_DECLS
+
+#define PGM_LAYER_DEFAULT_LOSS		50		/* permille */
+#define PGM_LAYER_CHECK_IVL		pgm_secs(1)	/* loss sample period */
+#define PGM_LAYER_JOIN_MIN_IVL		pgm_secs(2)	/* join-experiment back-off */
+#define PGM_LAYER_JOIN_MAX_IVL		pgm_secs(64)
+#define PGM_LAYER_PROBE_CHECKS		2		/* clean samples to keep a new layer */
+
+/* enhancement layer n is sock::layers[n - 1], the session is layer 0.  the
+ * source sends each on its own group and source port tsi.sport + n.
+ */
+struct pgm_layer_t {
+	struct group_req		gr;			/* group with encapsulation port */
+	ssize_t				max_rte;
+	pgm_tsi_t			tsi;
+	struct pgm_txw_t*		window;			/* source only */
+	pgm_rate_t			rate_control;		/* odata and rdata */
+	uint32_t			spm_sqn;
+	pgm_mutex_t			mutex;
+};
+
+PGM_GNUC_INTERNAL pgm_layer_t* pgm_layer_find (pgm_sock_t*const, const uint16_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_layer_is_refused (const pgm_sock_t*const restrict, const struct sockaddr*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_layer_check (pgm_sock_t*const, const pgm_time_t);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_LAYER_H__ */
@@ -0,0 +1,63 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Multicast group membership set spread over a pool of kernel sockets.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_MEMBERSHIP_H__
+#define __PGM_IMPL_MEMBERSHIP_H__
+
+typedef struct pgm_membership_t pgm_membership_t;
+
+#include <pgm/types.h>
+#include <pgm/socket.h>
+#include <impl/hashtable.h>
+#include <impl/list.h>
+#include <impl/messages.h>
+#include <impl/sockaddr.h>
+
+PGM_BEGIN_DECLS
+
+struct pgm_membership_t {
+	pgm_hashtable_t*	hashtable;		/* group address → link in group_list */
+	pgm_list_t*		group_list;		/* owned struct pgm_group_t */
+	SOCKET*			pool;			/* membership-only sockets */
+	unsigned*		pool_count;		/* memberships held per pool socket */
+	unsigned		pool_len;
+	unsigned		pool_limit;		/* memberships per kernel socket */
+	unsigned		len;			/* including sock::recv_gsr */
+};
+
+PGM_GNUC_INTERNAL void pgm_membership_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL bool pgm_membership_is_duplicate (const pgm_sock_t*const restrict, const struct group_source_req*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL int pgm_membership_join (pgm_sock_t*const restrict, const struct group_source_req*const restrict, const bool);
+PGM_GNUC_INTERNAL int pgm_membership_leave (pgm_sock_t*const restrict, const struct group_source_req*const restrict, const bool);
+PGM_GNUC_INTERNAL bool pgm_membership_is_joined (const pgm_sock_t*const restrict, const struct sockaddr*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL SOCKET pgm_membership_sock (const pgm_sock_t*const restrict, const struct sockaddr*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL unsigned pgm_membership_groups (const pgm_sock_t*const restrict, struct sockaddr_storage*restrict, const unsigned);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_MEMBERSHIP_H__ */
@@ -32,7 +32,12 @@
 
 PGM_BEGIN_DECLS
 
+/* unicast fan-out receivers, and datagrams per sendmmsg() call */
+#define PGM_MAX_DESTINATIONS		1024
+#define PGM_FANOUT_BATCH		64
+
 PGM_GNUC_INTERNAL ssize_t pgm_sendto_hops (pgm_sock_t*restrict, bool, pgm_rate_t*restrict, bool, int, const void*restrict, size_t, const struct sockaddr*restrict, socklen_t);
+PGM_GNUC_INTERNAL ssize_t pgm_sendtov_hops (pgm_sock_t*restrict, bool, pgm_rate_t*restrict, bool, int, const struct pgm_iovec*restrict, unsigned, const struct pgm_sk_buff_t*restrict, const struct sockaddr*restrict, socklen_t);
 PGM_GNUC_INTERNAL int pgm_set_nonblocking (SOCKET fd[2]);
 
 static inline
@@ -51,6 +56,61 @@ pgm_sendto (
 	return pgm_sendto_hops (sock, use_rate_limit, minor_rate_control, use_router_alert, -1, buf, len, to, tolen);
 }
 
+static inline
+ssize_t
+pgm_sendtov (
+	pgm_sock_t*restrict		sock,
+	bool				use_rate_limit,
+	pgm_rate_t*restrict		minor_rate_control,
+	bool				use_router_alert,
+	const struct pgm_iovec*restrict	vector,
+	unsigned			count,
+	const struct sockaddr*restrict	to,
+	socklen_t			tolen
+	)
+{
+	return pgm_sendtov_hops (sock, use_rate_limit, minor_rate_control, use_router_alert, -1, vector, count, NULL, to, tolen);
+}
+
+/* data packets sent from skb::head, the skb carries the library timestamp */
+
+static inline
+ssize_t
+pgm_sendtov_skb (
+	pgm_sock_t*restrict			sock,
+	bool					use_rate_limit,
+	pgm_rate_t*restrict			minor_rate_control,
+	bool					use_router_alert,
+	const struct pgm_sk_buff_t*restrict	skb,
+	const struct pgm_iovec*restrict		vector,
+	unsigned				count,
+	const struct sockaddr*restrict		to,
+	socklen_t				tolen
+	)
+{
+	return pgm_sendtov_hops (sock, use_rate_limit, minor_rate_control, use_router_alert, -1, vector, count, skb, to, tolen);
+}
+
+static inline
+ssize_t
+pgm_sendto_skb (
+	pgm_sock_t*restrict			sock,
+	bool					use_rate_limit,
+	pgm_rate_t*restrict			minor_rate_control,
+	bool					use_router_alert,
+	const struct pgm_sk_buff_t*restrict	skb,
+	size_t					len,
+	const struct sockaddr*restrict		to,
+	socklen_t				tolen
+	)
+{
+	const struct pgm_iovec vector = {
+		.iov_base	= skb->head,
+		.iov_len	= len
+	};
+	return pgm_sendtov_hops (sock, use_rate_limit, minor_rate_control, use_router_alert, -1, &vector, 1, skb, to, tolen);
+}
+
 PGM_END_DECLS
 
 #endif /* __PGM_IMPL_NET_H__ */
@@ -0,0 +1,47 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * NUMA node discovery, memory placement and processor affinity.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_NUMA_H__
+#define __PGM_IMPL_NUMA_H__
+
+#include <pgm/types.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+/* upper bound on node identifiers accepted for memory placement */
+#define PGM_NUMA_MAX_NODES	256
+
+PGM_GNUC_INTERNAL int pgm_numa_node_of_ifindex (const unsigned) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL int pgm_numa_node_of_cpuset (const struct pgm_cpuset_t*) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_numa_bind_memory (void*, const size_t, const int);
+PGM_GNUC_INTERNAL bool pgm_numa_set_thread_affinity (const struct pgm_cpuset_t*);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_NUMA_H__ */
@@ -0,0 +1,66 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Memory-mapped packet receive ring for raw IP sockets.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_PACKET_MMAP_H__
+#define __PGM_IMPL_PACKET_MMAP_H__
+
+typedef struct pgm_packet_mmap_t pgm_packet_mmap_t;
+
+#include <pgm/types.h>
+#include <pgm/skbuff.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+/* defaults for struct pgm_packet_mmapinfo_t zero fields */
+#define PGM_PACKET_MMAP_BLOCK_SIZE	(1 << 20)
+#define PGM_PACKET_MMAP_BLOCK_NR	16
+#define PGM_PACKET_MMAP_BLOCK_TOV	1		/* milliseconds */
+
+struct pgm_packet_mmap_t {
+	SOCKET			ip_sock;		/* raw socket holding group memberships */
+	char*			map;
+	size_t			map_len;
+	unsigned		block_size;
+	unsigned		block_nr;
+	unsigned		block_idx;
+	void*			block;			/* user owned block, NULL if none */
+	char*			frame;
+	unsigned		frames_left;
+	struct pgm_sk_buff_t	skb;			/* control packets parsed in place */
+};
+
+PGM_GNUC_INTERNAL bool pgm_packet_mmap_create (pgm_sock_t*const restrict, const struct pgm_packet_mmapinfo_t*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_packet_mmap_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL bool pgm_packet_mmap_set_filter (pgm_sock_t*const);
+PGM_GNUC_INTERNAL bool pgm_packet_mmap_bind (pgm_sock_t*const);
+PGM_GNUC_INTERNAL ssize_t pgm_packet_mmap_recv (pgm_sock_t*const restrict, struct pgm_sk_buff_t**restrict, struct sockaddr*restrict, const socklen_t);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_PACKET_MMAP_H__ */
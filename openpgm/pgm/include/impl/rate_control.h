@@ -30,8 +30,11 @@
 #define __PGM_IMPL_RATE_CONTROL_H__
 
 typedef struct pgm_rate_t pgm_rate_t;
+typedef struct pgm_rate_share_t pgm_rate_share_t;
 
 #include <pgm/types.h>
+#include <pgm/list.h>
+#include <pgm/socket.h>
 #include <pgm/time.h>
 #include <impl/thread.h>
 
@@ -45,14 +48,45 @@ struct pgm_rate_t {
 	ssize_t		rate_limit;		/* signed for math */
 	pgm_time_t	last_rate_check;
 	pgm_spinlock_t	spinlock;
+
+	pgm_rate_share_t* share;		/* shared parent, NULL if not attached */
+};
+
+/* one traffic class of one socket within a rate group */
+struct pgm_rate_share_t {
+	pgm_rate_group_t*	group;
+	pgm_rate_t		assured;		/* guaranteed portion of the group rate */
+	uint32_t		weight;
+	uint16_t		max_tpdu;
+	bool			is_rdata;
+	pgm_list_t		link;
+};
+
+/* parent bucket shared by several sockets, e.g. per interface or per process */
+struct pgm_rate_group_t {
+	pgm_rate_t		bucket;			/* aggregate limit */
+	unsigned		rdata_share;		/* percent reserved for repairs */
+	uint32_t		odata_weight;
+	uint32_t		rdata_weight;
+	uint16_t		max_tpdu;
+	pgm_list_t*		shares;
+	pgm_mutex_t		mutex;
+	volatile uint32_t	ref_count;
 };
 
 PGM_GNUC_INTERNAL void pgm_rate_create (pgm_rate_t*, const ssize_t, const size_t, const uint16_t);
 PGM_GNUC_INTERNAL void pgm_rate_destroy (pgm_rate_t*);
+PGM_GNUC_INTERNAL void pgm_rate_set (pgm_rate_t*, const ssize_t, const uint16_t);
 PGM_GNUC_INTERNAL bool pgm_rate_check2 (pgm_rate_t*, pgm_rate_t*, const size_t, const bool);
 PGM_GNUC_INTERNAL bool pgm_rate_check (pgm_rate_t*, const size_t, const bool);
+PGM_GNUC_INTERNAL void pgm_rate_debit (pgm_rate_t*, const size_t);
 PGM_GNUC_INTERNAL pgm_time_t pgm_rate_remaining2 (pgm_rate_t*, pgm_rate_t*, const size_t);
 PGM_GNUC_INTERNAL pgm_time_t pgm_rate_remaining (pgm_rate_t*, const size_t);
+PGM_GNUC_INTERNAL pgm_rate_group_t* pgm_rate_group_ref (pgm_rate_group_t*);
+PGM_GNUC_INTERNAL void pgm_rate_share_attach (pgm_rate_group_t*const restrict, pgm_rate_share_t*const restrict, const bool, const uint32_t, const size_t, const uint16_t);
+PGM_GNUC_INTERNAL void pgm_rate_share_detach (pgm_rate_share_t*);
+PGM_GNUC_INTERNAL bool pgm_rate_share_check (pgm_rate_share_t*, const size_t, const bool);
+PGM_GNUC_INTERNAL pgm_time_t pgm_rate_share_remaining (pgm_rate_share_t*, const size_t);
 
 PGM_END_DECLS
 
@@ -35,6 +35,9 @@ typedef struct pgm_peer_t pgm_peer_t;
 
 PGM_BEGIN_DECLS
 
+/* limit of SPMR back-off scaling by receiver group size */
+#define PGM_MAX_SPMR_GROUP	65536
+
 /* Performance Counters */
 
 enum {
@@ -84,8 +87,18 @@ enum {
 	PGM_PC_RECEIVER_MAX
 };
 
+/* preallocated peers with receive windows, refilled as peers expire */
+struct pgm_peer_pool_t {
+	pgm_spinlock_t			lock;
+	pgm_slist_t*			free_list;
+	unsigned			len;			    /* free peers */
+	unsigned			max;			    /* 0 = disabled */
+};
+
 struct pgm_peer_t {
 	volatile uint32_t		ref_count;		    /* atomic integer */
+	struct pgm_peer_pool_t*		pool;			    /* NULL when not pooled */
+	pgm_slist_t			pool_link;
 
 	pgm_tsi_t			tsi;
 	struct sockaddr_storage		group_nla;
@@ -103,8 +116,11 @@ struct pgm_peer_t {
 	unsigned			is_fec_enabled:1;
 	unsigned			has_proactive_parity:1;	    /* indicating availability from this source */
 	unsigned			has_ondemand_parity:1;
+	unsigned			is_resumed:1;		    /* journalled session, awaiting first SPM */
+	unsigned			has_layer_sample:1;	    /* layer_lead and layer_odata valid */
 
 	uint32_t			spm_sqn;
+	uint32_t			resume_sqn;		    /* last sequence journalled, valid with is_resumed */
 	pgm_time_t			expiry;
 
 	pgm_time_t			ack_rb_expiry;			/* 0 = no ACK pending */
@@ -117,7 +133,12 @@ struct pgm_peer_t {
 	pgm_time_t			last_data_tstamp;		/* local timestamp of ack_last_tstamp */
 	unsigned			last_commit;
 	uint32_t			lost_count;
+	uint32_t			ce_count;			/* ECN congestion experienced */
+	uint32_t			ce_rate;
 	uint32_t			last_cumulative_losses;
+	uint32_t			odata_count;			/* original transmissions, layer loss */
+	uint32_t			layer_lead;			/* at last layer sample */
+	uint32_t			layer_odata;
 	volatile uint32_t		cumulative_stats[PGM_PC_RECEIVER_MAX];
 	uint32_t			snap_stats[PGM_PC_RECEIVER_MAX];
 
@@ -127,6 +148,8 @@ struct pgm_peer_t {
 
 PGM_GNUC_INTERNAL pgm_peer_t* pgm_new_peer (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, const struct sockaddr*const restrict, const socklen_t, const struct sockaddr*const restrict, const socklen_t, const pgm_time_t);
 PGM_GNUC_INTERNAL void pgm_peer_unref (pgm_peer_t*);
+PGM_GNUC_INTERNAL void pgm_peer_pool_create (pgm_sock_t*const, const unsigned);
+PGM_GNUC_INTERNAL void pgm_peer_pool_destroy (pgm_sock_t*const);
 PGM_GNUC_INTERNAL int pgm_flush_peers_pending (pgm_sock_t*const restrict, struct pgm_msgv_t**restrict, const struct pgm_msgv_t*const, size_t*const restrict, unsigned*const restrict);
 PGM_GNUC_INTERNAL bool pgm_peer_has_pending (pgm_peer_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_peer_set_pending (pgm_sock_t*const restrict, pgm_peer_t*const restrict);
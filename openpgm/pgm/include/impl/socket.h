@@ -37,6 +37,9 @@ PGM_BEGIN_DECLS
 #	define IP_MAX_MEMBERSHIPS	20
 #endif
 
+/* APDUs delivered per pgm_recv_forward() read */
+#define PGM_FORWARD_MSGV_LEN		64
+
 struct pgm_sock_t {
 	sa_family_t			family;				/* communications domain */
 	int				socket_type;
@@ -59,6 +62,7 @@ struct pgm_sock_t {
 	bool				is_destroyed;
 	bool	            		is_reset;
 	bool				is_abort_on_reset;
+	bool				use_streaming_read;		/* partial APDU delivery */
 
 	bool				can_send_data;			/* and SPMs */
 	bool				can_send_nak;			/* muted receiver */
@@ -68,11 +72,16 @@ struct pgm_sock_t {
 
 	struct group_source_req		send_gsr;			/* multicast */
 	struct sockaddr_storage		send_addr;			/* unicast nla */
+	struct sockaddr_storage*	destinations;			/* unicast fan-out in place of send_gsr */
+	unsigned			destinations_len;
+	unsigned			destinations_alloc;
+	pgm_mutex_t			destination_mutex;
 	SOCKET				send_sock;
 	SOCKET				send_with_router_alert_sock;
 	struct group_source_req 	recv_gsr[IP_MAX_MEMBERSHIPS];	/* sa_family = 0 terminated */
 	unsigned			recv_gsr_len;
 	SOCKET				recv_sock;
+	pgm_membership_t*		membership;			/* all groups, NULL before first join */
 
 	size_t				max_apdu;
 	uint16_t			max_tpdu;
@@ -87,11 +96,29 @@ struct pgm_sock_t {
 	ssize_t				odata_max_rte;
 	ssize_t				rdata_max_rte;
 	size_t				sndbuf, rcvbuf;		    /* setsockopt (SO_SNDBUF/SO_RCVBUF) */
+	int				numa_node;		    /* window placement, or PGM_NUMA_NODE_ANY */
+	bool				use_cpu_affinity;
+	struct pgm_cpuset_t		cpu_affinity;
 
 	pgm_txw_t* restrict    		window;
 	pgm_rate_t			rate_control;
 	pgm_rate_t			odata_rate_control;
 	pgm_rate_t			rdata_rate_control;
+	pgm_rate_group_t*		rate_group;		/* shared parent limit */
+	uint32_t			rate_group_weight;
+	pgm_rate_share_t		odata_share;
+	pgm_rate_share_t		rdata_share;
+	int				tx_tstamp_flags;	/* PGM_TX_TIMESTAMPING_* */
+	pgm_tx_tstamp_t*		tx_tstamp;
+	bool				use_packet_mmap;
+	struct pgm_packet_mmapinfo_t	packet_mmap_info;
+	pgm_packet_mmap_t*		packet_mmap;		/* TPACKET_V3 receive ring */
+	bool				use_xdp;
+	struct pgm_xdpinfo_t		xdp_info;
+	pgm_xdp_t*			xdp;			/* AF_XDP datapath */
+	struct pgm_retaininfo_t		retain_info;		/* pgm_send_retained() */
+	struct pgm_txwarchiveinfo_t	txw_archive_info;	/* owns ta_path */
+	unsigned			late_join_sqns;		/* OPT_JOIN repair horizon, 0 = disabled */
 	pgm_time_t			adv_ivl;		/* advancing with data */
 	unsigned			adv_mode;		/* 0 = time, 1 = data */
 	bool				is_controlled_spm;
@@ -118,6 +145,21 @@ struct pgm_sock_t {
 	pgm_time_t			ack_bo_ivl;
 	struct sockaddr_storage		acker_nla;
 	uint64_t			acker_loss;
+	uint32_t			acker_rtt;		/* milliseconds */
+	uint16_t			acker_loss_rate;	/* fp16 */
+
+	bool				use_rate_cc;		/* equation-based rate control */
+	bool				is_rate_cc_slow_start;
+	ssize_t				cc_rate;		/* bytes per second, timer_mutex */
+	ssize_t				cc_max_rate;		/* ODATA or TXW ceiling */
+	uint32_t			cc_srtt;		/* smoothed RTT, milliseconds in fp8 */
+	pgm_time_t			cc_next_increase;
+
+	bool				use_ecn;		/* explicit congestion notification */
+	bool				has_acker_ce_count;
+	int				tos;
+	uint16_t			acker_ce_rate;		/* fp16 */
+	uint32_t			acker_ce_count;
 
 	pgm_notify_t			ack_notify;
 	pgm_notify_t			rdata_notify;
@@ -140,8 +182,54 @@ struct pgm_sock_t {
 		unsigned			vector_index;
 		size_t				vector_offset;
 		bool				is_rate_limited;
+		bool				is_transformed;	/* resumes the encoded APDU */
 	} pkt_dontwait_state;
 
+/* ODATA headers pre-built at bind, variable fields zeroed */
+	char				odata_template[ PGM_ODATA_TEMPLATE_LEN ];
+	char				apdu_template[ PGM_APDU_TEMPLATE_LEN ];	    /* + OPT_LENGTH, OPT_FRAGMENT */
+	char				apdu_transform_template[ PGM_APDU_TRANSFORM_TEMPLATE_LEN ];    /* + OPT_TRANSFORM */
+	uint32_t			odata_template_csum;	    /* unfolded */
+	uint32_t			apdu_template_csum;
+	uint32_t			apdu_transform_template_csum;
+
+/* streaming APDU, pgm_send_begin() … pgm_send_end() */
+	struct {
+		bool			is_active;
+		bool			is_pending;		    /* committed fragment awaiting transmit */
+		bool			is_rate_limited;
+		size_t			apdu_length;		    /* declared total */
+		size_t			data_bytes_offset;	    /* accepted from application */
+		uint32_t		first_sqn;
+		struct pgm_sk_buff_t*	skb;			    /* fragment being filled or pending */
+		uint16_t		tsdu_length;		    /* fragment payload size */
+		uint16_t		tsdu_offset;		    /* fragment payload filled */
+		uint32_t		unfolded_odata;
+		bool			is_topic;		    /* pgm_send_topic() */
+		bool			is_fragmented;		    /* carries OPT_FRAGMENT */
+		uint8_t			topic_len;		    /* OPT_TOPIC when non-zero */
+		char			topic[PGM_MAX_TOPIC];
+	} stream_state;
+
+/* urgent messages, pgm_send_priority() on a companion session sharing the GSI */
+	uint16_t			priority_lane;		    /* lane source port, 0 = disabled */
+	struct {
+		pgm_tsi_t		tsi;
+		pgm_txw_t*		window;			    /* source only */
+		uint32_t		spm_sqn;
+		pgm_mutex_t		mutex;
+	} lane;
+
+/* cumulative layers on their own groups, pgm_send_layer() */
+	pgm_layer_t*			layers;			    /* layers_len enhancement layers */
+	unsigned			layers_len;
+	uint32_t			layer_loss_threshold;	    /* permille */
+	unsigned			layer_level;		    /* receiver: enhancement layers joined */
+	unsigned			layer_probe;		    /* clean samples awaited after a join */
+	pgm_time_t			layer_join_ivl;
+	pgm_time_t			next_layer_join;
+	pgm_time_t			next_layer_check;
+
 	uint32_t			spm_sqn;
 	unsigned			spm_ambient_interval;	    /* microseconds */
 	unsigned* restrict		spm_heartbeat_interval;     /* zero terminated, zero lead-pad */
@@ -149,6 +237,10 @@ struct pgm_sock_t {
 	unsigned			spm_heartbeat_len;
 	unsigned			peer_expiry;		    /* from absence of SPMs */
 	unsigned			spmr_expiry;		    /* waiting for peer SPMRs */
+	unsigned			spmr_group_size;	    /* expected receivers, 0 = fixed back-off */
+	unsigned			spmr_group_estimate;	    /* grows on duplicate peer SPMRs */
+	unsigned			peer_rate;		    /* new peers per second, 0 = unlimited */
+	pgm_time_t			peer_rate_tat;		    /* next admission at steady rate */
 
 	pgm_rand_t			rand_;			    /* for calculating nak_rb_ivl from nak_bo_ivl */
 	unsigned			nak_data_retries, nak_ncf_retries;
@@ -168,6 +260,17 @@ struct pgm_sock_t {
 	pgm_hashtable_t* restrict	peers_hashtable;	    /* fast lookup */
 	pgm_list_t*      restrict	peers_list;		    /* easy iteration */
 	pgm_slist_t*     restrict	peers_pending;		    /* rxw: have or lost data */
+	unsigned			peer_pool_size;		    /* preallocated peers, 0 = disabled */
+	struct pgm_peer_pool_t		peer_pool;
+	pgm_topic_filter_t*		topic_filter;		    /* subscriptions, NULL delivers all */
+	pgm_journal_t*			journal;		    /* delivered APDUs */
+	struct pgm_journalinfo_t	journal_info;		    /* owns jl_path */
+	pgm_compress_t*			compress;		    /* payload transform */
+	struct pgm_compressinfo_t	compress_info;
+	struct pgm_msgv_t*		forward_msgv;		    /* pgm_recv_forward() */
+	struct pgm_iovec*		forward_iov;		    /* payload of forward_msgv */
+	unsigned			forward_iov_len;
+	unsigned			forward_iov_offset;	    /* first entry not written */
 	pgm_notify_t			pending_notify;		    /* timer to rx */
 	bool				is_pending_read;
 	pgm_time_t			next_poll;
@@ -178,11 +281,29 @@ struct pgm_sock_t {
 };
 
 
+/* with a packet ring or AF_XDP sock::recv_sock is the AF_PACKET or XSK socket
+ * and memberships remain with the original IP socket.
+ */
+
+static inline
+SOCKET
+pgm_sock_ip_recv_sock (
+	const pgm_sock_t* const	sock
+	)
+{
+	if (NULL != sock->packet_mmap)
+		return sock->packet_mmap->ip_sock;
+	if (NULL != sock->xdp)
+		return sock->xdp->ip_sock;
+	return sock->recv_sock;
+}
+
 /* global variables */
 extern pgm_rwlock_t pgm_sock_list_lock;
 extern pgm_slist_t* pgm_sock_list;
 
 size_t pgm_pkt_offset (bool, sa_family_t);
+bool pgm_sock_apply_service_affinity (void);
 
 PGM_END_DECLS
 
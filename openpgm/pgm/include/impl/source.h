@@ -65,6 +65,16 @@ enum {
 	PGM_PC_SOURCE_MAX
 };
 
+/* rate congestion control starting bucket, packets per second */
+#define PGM_RATE_CC_INITIAL_PACKETS	4
+
+/* ODATA header templates */
+#define PGM_ODATA_TEMPLATE_LEN		( sizeof(struct pgm_header) + sizeof(struct pgm_data) )
+#define PGM_APDU_TEMPLATE_LEN		( PGM_ODATA_TEMPLATE_LEN + sizeof(struct pgm_opt_length) + sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_fragment) )
+#define PGM_OPT_TRANSFORM_LEN		( sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_transform) )
+#define PGM_APDU_TRANSFORM_TEMPLATE_LEN	( PGM_APDU_TEMPLATE_LEN + PGM_OPT_TRANSFORM_LEN )
+
+PGM_GNUC_INTERNAL void pgm_source_build_templates (pgm_sock_t*const);
 PGM_GNUC_INTERNAL bool pgm_send_spm (pgm_sock_t*const, const int) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL bool pgm_on_deferred_nak (pgm_sock_t*const);
 PGM_GNUC_INTERNAL bool pgm_on_spmr (pgm_sock_t*const restrict, pgm_peer_t*const restrict, struct pgm_sk_buff_t*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
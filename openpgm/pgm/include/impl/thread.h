@@ -44,6 +44,7 @@ typedef struct pgm_rwlock_t pgm_rwlock_t;
 extern bool pgm_smp_system;
 
 #ifndef _WIN32
+#	include <errno.h>
 #	include <pthread.h>
 #	include <unistd.h>
 #	if defined( __sun )
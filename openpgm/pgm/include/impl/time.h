@@ -32,6 +32,7 @@
 #include <pgm/types.h>
 #include <pgm/error.h>
 #include <pgm/time.h>
+#include <impl/cpu.h>
 
 PGM_BEGIN_DECLS
 
@@ -45,7 +46,7 @@ typedef pgm_time_t (*pgm_time_update_func)(void);
 
 extern pgm_time_update_func		pgm_time_update_now;
 
-PGM_GNUC_INTERNAL bool pgm_time_init (pgm_error_t**) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_time_init (const pgm_cpu_t*, pgm_error_t**) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL bool pgm_time_shutdown (void);
 
 PGM_END_DECLS
@@ -0,0 +1,89 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Transmit timestamping of data packets for send latency histograms.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_TIMESTAMPING_H__
+#define __PGM_IMPL_TIMESTAMPING_H__
+
+typedef struct pgm_tx_tstamp_t pgm_tx_tstamp_t;
+
+#include <pgm/types.h>
+#include <pgm/socket.h>
+#include <pgm/tsi.h>
+#include <pgm/skbuff.h>
+#include <impl/histogram.h>
+#include <impl/sockaddr.h>
+#include <impl/thread.h>
+
+PGM_BEGIN_DECLS
+
+/* datagrams awaiting a kernel timestamp per send socket, power of 2 */
+#define PGM_TX_TSTAMP_RING		1024
+#define PGM_TX_TSTAMP_BUCKETS		50
+
+enum {
+	PGM_TX_TSTAMP_LIBRARY = 0,	/* send_apdu() to sendto() */
+	PGM_TX_TSTAMP_KERNEL,		/* sendto() to driver software stamp */
+	PGM_TX_TSTAMP_WIRE,		/* driver to NIC hardware stamp */
+	PGM_TX_TSTAMP_MAX
+};
+
+struct pgm_tx_tstamp_entry_t {
+	uint32_t		id;
+	int64_t			sent;			/* CLOCK_REALTIME nanoseconds at sendto(), 0 = not data */
+	int64_t			software;
+	int64_t			library;		/* nanoseconds, -1 = not ODATA */
+};
+
+/* kernel numbers each datagram on a socket with SOF_TIMESTAMPING_OPT_ID */
+struct pgm_tx_tstamp_socket_t {
+	SOCKET			fd;
+	uint32_t		next_id;
+	uint32_t		reap_id;
+	struct pgm_tx_tstamp_entry_t ring[ PGM_TX_TSTAMP_RING ];
+};
+
+struct pgm_tx_tstamp_t {
+	pgm_mutex_t		mutex;
+	int			flags;
+	struct pgm_tx_tstamp_socket_t socket[ 2 ];	/* regular, router alert */
+
+	pgm_histogram_t		histogram[ PGM_TX_TSTAMP_MAX ];
+	pgm_count_t		counts[ PGM_TX_TSTAMP_MAX ][ PGM_TX_TSTAMP_BUCKETS ];
+	pgm_sample_t		ranges[ PGM_TX_TSTAMP_MAX ][ PGM_TX_TSTAMP_BUCKETS + 1 ];
+	char			names[ PGM_TX_TSTAMP_MAX ][ 32 + PGM_TSISTRLEN ];
+};
+
+PGM_GNUC_INTERNAL bool pgm_tx_tstamp_enable (pgm_sock_t*const, const int) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_tx_tstamp_disable (pgm_sock_t*const);
+PGM_GNUC_INTERNAL void pgm_tx_tstamp_prepare (pgm_tx_tstamp_t*const restrict, const bool, const void*restrict, const struct pgm_sk_buff_t*restrict);
+PGM_GNUC_INTERNAL void pgm_tx_tstamp_commit (pgm_tx_tstamp_t*const, const bool);
+PGM_GNUC_INTERNAL void pgm_tx_tstamp_reap (pgm_tx_tstamp_t*const);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_TIMESTAMPING_H__ */
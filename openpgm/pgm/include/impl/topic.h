@@ -0,0 +1,63 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * topic subscription filter.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_TOPIC_H__
+#define __PGM_IMPL_TOPIC_H__
+
+typedef struct pgm_topic_filter_t pgm_topic_filter_t;
+
+#include <pgm/types.h>
+#include <pgm/msgv.h>
+#include <pgm/packet.h>
+#include <pgm/skbuff.h>
+#include <impl/hashtable.h>
+#include <impl/list.h>
+
+PGM_BEGIN_DECLS
+
+struct pgm_topic_filter_t {
+	pgm_hashtable_t*	exact_hashtable;	/* topic → link in exact_list */
+	pgm_list_t*		exact_list;		/* owned topic strings */
+	pgm_hashtable_t*	prefix_hashtable;
+	pgm_list_t*		prefix_list;
+	unsigned		prefix_len_count[PGM_MAX_TOPIC + 1];	/* subscriptions per prefix length */
+	unsigned		prefix_len_max;
+};
+
+PGM_GNUC_INTERNAL pgm_topic_filter_t* pgm_topic_filter_new (void) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_topic_filter_destroy (pgm_topic_filter_t*);
+PGM_GNUC_INTERNAL bool pgm_topic_filter_subscribe (pgm_topic_filter_t*restrict, const char*restrict, const size_t, const bool);
+PGM_GNUC_INTERNAL bool pgm_topic_filter_unsubscribe (pgm_topic_filter_t*restrict, const char*restrict, const size_t, const bool);
+PGM_GNUC_INTERNAL bool pgm_topic_filter_is_empty (const pgm_topic_filter_t*) PGM_GNUC_PURE;
+PGM_GNUC_INTERNAL bool pgm_topic_filter_match (const pgm_topic_filter_t*restrict, const struct pgm_sk_buff_t*restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL size_t pgm_topic_filter_msgv (const pgm_topic_filter_t*restrict, struct pgm_msgv_t*restrict, struct pgm_msgv_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_topic_is_valid (const char*, const size_t) PGM_GNUC_PURE;
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_TOPIC_H__ */
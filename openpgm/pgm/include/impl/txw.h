@@ -37,11 +37,17 @@ struct pgm_txw_state_t {
 	uint32_t	unfolded_checksum;	/* first 32-bit word must be checksum */
 
 	unsigned	waiting_retransmit:1;	/* in retransmit queue */
-	unsigned	retransmit_count:15;
+	unsigned	is_archived:1;		/* read back from archive, freed on dequeue */
+	unsigned	retransmit_count:14;
 	unsigned	nak_elimination_count:16;
 
 	uint8_t		pkt_cnt_requested;	/* # parity packets to send */
 	uint8_t		pkt_cnt_sent;		/* # parity packets already sent */
+	union {
+		struct sockaddr		sa;
+		struct sockaddr_in	s4;
+		struct sockaddr_in6	s6;
+	}		requester;		/* fan-out destination of the only NAKer, sa_family 0 = all */
 };
 
 struct pgm_txw_t {
@@ -66,6 +72,12 @@ struct pgm_txw_t {
 	unsigned			is_fec_enabled:1;
 	unsigned			adv_mode:1;		/* 0 = advance by time, 1 = advance by data */
 
+/* packets older than trail, NULL if repairs end at the window */
+	pgm_txw_archive_t*		archive;
+	volatile uint32_t		archive_trail;
+	uint32_t			archive_prefetch_lead;	/* read-ahead issued before */
+	pgm_hashtable_t*		archive_pending;	/* queued archive copies by sequence */
+
 	size_t				size;			/* window content size in bytes */
 	unsigned			alloc;			/* length of pdata[] */
 /* C90 and older */
@@ -76,13 +88,15 @@ PGM_GNUC_INTERNAL pgm_txw_t* pgm_txw_create (const pgm_tsi_t*const, const uint16
 PGM_GNUC_INTERNAL void pgm_txw_shutdown (pgm_txw_t*const);
 PGM_GNUC_INTERNAL void pgm_txw_add (pgm_txw_t*const restrict, struct pgm_sk_buff_t*const restrict);
 PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_txw_peek (const pgm_txw_t*const, const uint32_t) PGM_GNUC_WARN_UNUSED_RESULT;
-PGM_GNUC_INTERNAL bool pgm_txw_retransmit_push (pgm_txw_t*const, const uint32_t, const bool, const uint8_t) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL bool pgm_txw_retransmit_push (pgm_txw_t*const restrict, const uint32_t, const bool, const uint8_t, const struct sockaddr*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_txw_retransmit_try_peek (pgm_txw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
 PGM_GNUC_INTERNAL void pgm_txw_retransmit_remove_head (pgm_txw_t*const);
 PGM_GNUC_INTERNAL uint32_t pgm_txw_get_unfolded_checksum (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE;
 PGM_GNUC_INTERNAL void pgm_txw_set_unfolded_checksum (struct pgm_sk_buff_t*const, const uint32_t);
 PGM_GNUC_INTERNAL void pgm_txw_inc_retransmit_count (struct pgm_sk_buff_t*const);
+PGM_GNUC_INTERNAL const struct sockaddr* pgm_txw_get_requester (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE;
 PGM_GNUC_INTERNAL bool pgm_txw_retransmit_is_empty (const pgm_txw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_txw_set_archive (pgm_txw_t*const restrict, pgm_txw_archive_t*const restrict);
 
 /* declare for GCC attributes */
 static inline size_t pgm_txw_max_length (const pgm_txw_t*const) PGM_GNUC_WARN_UNUSED_RESULT;
@@ -177,6 +191,7 @@ pgm_txw_next_lead (
 	return (uint32_t)(pgm_txw_lead (window) + 1);
 }
 
+/* repair horizon, including any archived sequences */
 static inline
 uint32_t
 pgm_txw_trail (
@@ -184,7 +199,7 @@ pgm_txw_trail (
 	)
 {
 	pgm_assert (NULL != window);
-	return window->trail;
+	return window->archive ? window->archive_trail : window->trail;
 }
 
 static inline
@@ -194,7 +209,7 @@ pgm_txw_trail_atomic (
 	)
 {
 	pgm_assert (NULL != window);
-	return pgm_atomic_read32 (&window->trail);
+	return window->archive ? pgm_atomic_read32 (&window->archive_trail) : pgm_atomic_read32 (&window->trail);
 }
 
 PGM_END_DECLS
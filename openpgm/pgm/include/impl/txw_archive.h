@@ -0,0 +1,85 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * Memory-mapped archive extending the transmit window repair horizon.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_TXW_ARCHIVE_H__
+#define __PGM_IMPL_TXW_ARCHIVE_H__
+
+typedef struct pgm_txw_archive_t pgm_txw_archive_t;
+
+#include <pgm/types.h>
+#include <pgm/error.h>
+#include <pgm/skbuff.h>
+
+PGM_BEGIN_DECLS
+
+/* sequences read ahead when a repair request reaches the archive */
+#define PGM_TXW_ARCHIVE_PREFETCH	64
+
+/* one fixed size slot per sequence, header and payload stored contiguously */
+struct pgm_txw_archive_slot_t {
+	volatile uint32_t	version;		/* odd whilst being written */
+	uint32_t		sequence;
+	uint32_t		unfolded_checksum;	/* payload only */
+	uint16_t		header_length;
+	uint16_t		tsdu_length;
+	pgm_sock_t*		sock;			/* owner, archive is private to the process */
+	pgm_time_t		tstamp;
+};
+
+struct pgm_txw_archive_t {
+	char*			map;
+#ifndef _WIN32
+	int			fd;
+#else
+	HANDLE			file;
+	HANDLE			mapping;
+#endif
+	size_t			map_len;
+	size_t			slot_size;
+	uint32_t		slot_nr;
+	uint16_t		max_tpdu;
+};
+
+PGM_GNUC_INTERNAL pgm_txw_archive_t* pgm_txw_archive_create (const char*const restrict, const uint32_t, const uint16_t, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_txw_archive_destroy (pgm_txw_archive_t*const);
+PGM_GNUC_INTERNAL void pgm_txw_archive_write (pgm_txw_archive_t*const restrict, const struct pgm_sk_buff_t*const restrict, const uint32_t);
+PGM_GNUC_INTERNAL struct pgm_sk_buff_t* pgm_txw_archive_read (pgm_txw_archive_t*const restrict, const uint32_t, uint32_t*restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_txw_archive_prefetch (pgm_txw_archive_t*const, const uint32_t, const uint32_t);
+
+static inline
+uint32_t
+pgm_txw_archive_max_length (
+	const pgm_txw_archive_t*const archive
+	)
+{
+	return archive->slot_nr;
+}
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_TXW_ARCHIVE_H__ */
@@ -0,0 +1,83 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * AF_XDP datapath for UDP encapsulated PGM.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#if !defined (__PGM_IMPL_FRAMEWORK_H_INSIDE__) && !defined (PGM_COMPILATION)
+#	error "Only <framework.h> can be included directly."
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif
+#ifndef __PGM_IMPL_XDP_H__
+#define __PGM_IMPL_XDP_H__
+
+typedef struct pgm_xdp_t pgm_xdp_t;
+
+#include <pgm/types.h>
+#include <pgm/skbuff.h>
+#include <pgm/socket.h>
+
+PGM_BEGIN_DECLS
+
+/* defaults for struct pgm_xdpinfo_t zero fields */
+#define PGM_XDP_FRAME_NR	4096
+#define PGM_XDP_FRAME_SIZE	2048
+
+/* single producer, single consumer ring shared with the kernel */
+struct pgm_xdp_ring_t {
+	uint32_t*		producer;
+	uint32_t*		consumer;
+	uint32_t*		flags;
+	void*			desc;
+	uint32_t		mask;
+	void*			map;
+	size_t			map_len;
+};
+
+struct pgm_xdp_t {
+	SOCKET			ip_sock;		/* UDP socket holding group memberships */
+	int			map_fd;
+	int			prog_fd;
+	int			link_fd;
+	char*			umem;
+	size_t			umem_len;
+	struct pgm_xdp_ring_t	fill;
+	struct pgm_xdp_ring_t	comp;
+	struct pgm_xdp_ring_t	rx;
+	struct pgm_xdp_ring_t	tx;
+	uint64_t*		tx_free;		/* stack of idle transmit frames */
+	unsigned		tx_free_len;
+	bool			use_tx;
+	bool			has_held;
+	uint64_t		held_addr;		/* frame parsed in place */
+	uint8_t			src_mac[6];
+	uint16_t		ip_id;
+	struct pgm_sk_buff_t	skb;			/* control packets parsed in place */
+};
+
+PGM_GNUC_INTERNAL bool pgm_xdp_create (pgm_sock_t*const restrict, const struct pgm_xdpinfo_t*const restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+PGM_GNUC_INTERNAL void pgm_xdp_destroy (pgm_sock_t*const);
+PGM_GNUC_INTERNAL ssize_t pgm_xdp_recv (pgm_sock_t*const restrict, struct pgm_sk_buff_t**restrict, struct sockaddr*restrict, const socklen_t, struct sockaddr*restrict, const socklen_t);
+PGM_GNUC_INTERNAL ssize_t pgm_xdp_send (pgm_sock_t*const restrict, const struct pgm_iovec*restrict, const unsigned, const size_t, const struct sockaddr*restrict, const int);
+
+PGM_END_DECLS
+
+#endif /* __PGM_IMPL_XDP_H__ */
@@ -27,6 +27,7 @@
 
 struct pgm_iovec;
 struct pgm_msgv_t;
+struct pgm_fragment_info_t;
 
 #include <pgm/types.h>
 #include <pgm/packet.h>
@@ -52,6 +53,15 @@ struct pgm_msgv_t {
 	struct pgm_sk_buff_t*	msgv_skb[PGM_MAX_FRAGMENTS];	/* PGM socket buffer array */
 };
 
+/* position of a message within its APDU with PGM_STREAMING_READ */
+struct pgm_fragment_info_t {
+	uint32_t		fi_apdu_first_sqn;		/* identifies APDU per source */
+	size_t			fi_offset;			/* of first byte within APDU */
+	size_t			fi_length;			/* bytes in message */
+	size_t			fi_apdu_length;
+	bool			fi_is_final;			/* completes APDU */
+};
+
 PGM_END_DECLS
 
 #endif /* __PGM_MSGV_H__ */
@@ -45,7 +45,7 @@ PGM_BEGIN_DECLS
 #	define IPPROTO_PGM 		    	113
 #endif
 
-/* read from /etc/protocols if available */
+/* read from /etc/protocols if available when the first raw socket is created */
 extern int pgm_ipproto_pgm;
 
 
@@ -107,6 +107,10 @@ enum pgm_type_e {
 #define PGM_OPT_PGMCC_DATA	    0x12
 #define PGM_OPT_PGMCC_FEEDBACK	    0x13
 
+#define PGM_OPT_TOPIC		    0x14	/* subscription topic, OpenPGM extension */
+#define PGM_OPT_ECN		    0x15	/* congestion experienced feedback, OpenPGM extension */
+#define PGM_OPT_TRANSFORM	    0x16	/* APDU payload transform, OpenPGM extension */
+
 #define PGM_OPT_NAK_BO_IVL	    0x04	/* nak back-off interval */
 #define PGM_OPT_NAK_BO_RNG	    0x05	/* nak back-off range */
 #define PGM_OPT_NBR_UNREACH	    0x0b	/* neighbour unreachable */
@@ -361,6 +365,59 @@ struct pgm_opt6_pgmcc_feedback {
 	struct in6_addr	opt6_nla;		/* ACKER nla */
 };
 
+/* Topic Option - OpenPGM extension, ignored by other receivers
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |E| Option Type | Option Length |Reserved |F|OPX|U|  Topic Len  |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                   Topic octets, zero padded                  ...
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-...
+ */
+
+#define PGM_MAX_TOPIC		128
+
+struct pgm_opt_topic {
+	uint8_t		opt_reserved;		/* reserved */
+	uint8_t		opt_topic_len;		/* topic length */
+	char		opt_topic[PGM_MAX_TOPIC];	/* topic, padded to 32-bit boundary */
+};
+
+/* ECN Option - OpenPGM extension, accompanies OPT_PGMCC_FEEDBACK on ACKs with
+ * the receivers exponential moving average of CE marked data in 16-bit fixed point
+ * and the cumulative count of CE marked data packets.
+ */
+
+struct pgm_opt_ecn {
+	uint8_t		opt_reserved;		/* reserved */
+	uint16_t	opt_ce_rate;		/* fraction of data marked CE */
+	uint32_t	opt_ce_count;		/* cumulative data marked CE */
+};
+
+/* Transform Option - OpenPGM extension, every TPDU of an APDU encoded by the
+ * payload transform carries OPT_TRANSFORM after OPT_FRAGMENT.  The option
+ * header sets OPX_DISCARD so that receivers unaware of the transform drop the
+ * TPDU instead of delivering the encoded payload.
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |E| Option Type | Option Length |Reserved |F|OPX|U|  Reserved   |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+
+struct pgm_opt_transform {
+	uint8_t		opt_reserved;		/* reserved, codec leads the payload */
+};
+
+/* IP header ECN field, RFC 3168 */
+#define PGM_ECN_MASK		0x03
+#define PGM_ECN_NOT_ECT		0x00
+#define PGM_ECN_ECT1		0x01
+#define PGM_ECN_ECT0		0x02
+#define PGM_ECN_CE		0x03
+
 
 /*
  * SPM Requests
@@ -0,0 +1,527 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM asynchronous socket, C++20 coroutines over a single epoll reactor.
+ *
+ * Copyright (c) 2010 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PGM_ASYNC_HH__
+#define __PGM_ASYNC_HH__
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#	pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#if __cplusplus < 202002L
+#	error "pgm_async.hh requires C++20 coroutine support."
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <span>
+#include <utility>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <pgm/pgm_socket.hh>
+
+/// A lazily started coroutine producing a T, resumed by co_await.
+template <typename T = void> class pgm_task;
+
+namespace pgm_detail {
+
+template <typename T>
+struct task_promise_base
+{
+	std::coroutine_handle<> continuation_;
+	std::exception_ptr exception_;
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+
+	struct final_awaiter
+	{
+		bool await_ready() noexcept { return false; }
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend (std::coroutine_handle<Promise> h) noexcept
+		{
+			std::coroutine_handle<> continuation = h.promise().continuation_;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	};
+
+	final_awaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { exception_ = std::current_exception(); }
+};
+
+template <typename T>
+struct task_promise : task_promise_base<T>
+{
+	T value_;
+
+	pgm_task<T> get_return_object() noexcept;
+	void return_value (T value) { value_ = std::move (value); }
+	T result()
+	{
+		if (this->exception_) std::rethrow_exception (this->exception_);
+		return std::move (value_);
+	}
+};
+
+template <>
+struct task_promise<void> : task_promise_base<void>
+{
+	pgm_task<void> get_return_object() noexcept;
+	void return_void() noexcept {}
+	void result()
+	{
+		if (this->exception_) std::rethrow_exception (this->exception_);
+	}
+};
+
+/// Fire-and-forget coroutine frame, destroys itself on completion.
+struct detached
+{
+	struct promise_type
+	{
+		detached get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+} // namespace pgm_detail
+
+template <typename T>
+class pgm_task
+{
+public:
+	typedef pgm_detail::task_promise<T> promise_type;
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+	explicit pgm_task (handle_type handle) noexcept
+	: handle_ (handle)
+	{
+	}
+
+	pgm_task (pgm_task&& other) noexcept
+	: handle_ (std::exchange (other.handle_, nullptr))
+	{
+	}
+
+	pgm_task (const pgm_task&) = delete;
+	pgm_task& operator= (const pgm_task&) = delete;
+
+	~pgm_task()
+	{
+		if (handle_) handle_.destroy();
+	}
+
+	/// Start the task and suspend the caller until it completes.
+	auto operator co_await() && noexcept
+	{
+		struct awaiter
+		{
+			handle_type handle_;
+			bool await_ready() noexcept { return !handle_ || handle_.done(); }
+			std::coroutine_handle<> await_suspend (std::coroutine_handle<> caller) noexcept
+			{
+				handle_.promise().continuation_ = caller;
+				return handle_;
+			}
+			T await_resume() { return handle_.promise().result(); }
+		};
+		return awaiter { handle_ };
+	}
+
+private:
+	handle_type handle_;
+};
+
+template <typename T>
+inline pgm_task<T> pgm_detail::task_promise<T>::get_return_object() noexcept
+{
+	return pgm_task<T> (std::coroutine_handle<task_promise<T>>::from_promise (*this));
+}
+
+inline pgm_task<void> pgm_detail::task_promise<void>::get_return_object() noexcept
+{
+	return pgm_task<void> (std::coroutine_handle<task_promise<void>>::from_promise (*this));
+}
+
+/// Single-threaded epoll and timer event loop.  Run one reactor per thread,
+/// every socket and task attached to a reactor must only be used from its thread.
+class pgm_reactor
+{
+public:
+	typedef std::chrono::steady_clock clock;
+
+	struct waiter;
+
+	/// One descriptor registered with epoll, armed one-shot per wait.
+	struct registration
+	{
+		int		fd = -1;
+		std::uint32_t	events = 0;
+		waiter**	slot = nullptr;
+		bool		is_added = false;
+	};
+
+	/// A suspended coroutine, woken by the first of its descriptors or deadline.
+	struct waiter
+	{
+		std::coroutine_handle<> handle;
+		waiter** slot = nullptr;
+		bool has_deadline = false;
+		std::multimap<clock::time_point, waiter*>::iterator timer;
+	};
+
+	pgm_reactor()
+	: epfd_ (::epoll_create1 (EPOLL_CLOEXEC)),
+	  is_stopped_ (false)
+	{
+	}
+
+	~pgm_reactor()
+	{
+		if (-1 != epfd_) ::close (epfd_);
+	}
+
+	pgm_reactor (const pgm_reactor&) = delete;
+	pgm_reactor& operator= (const pgm_reactor&) = delete;
+
+	/// Whether the epoll descriptor was created.
+	bool is_valid() const
+	{
+		return -1 != epfd_;
+	}
+
+	/// Start a task, running until its first suspension point.
+	void spawn (pgm_task<void> task)
+	{
+		run_detached (std::move (task));
+	}
+
+	/// Awaitable for a wait on descriptors and/or a deadline.
+	struct wait_awaiter
+	{
+		pgm_reactor&		reactor_;
+		registration* const*	regs_;
+		std::size_t		nregs_;
+		waiter**		slot_;
+		clock::time_point	deadline_;
+		bool			has_deadline_;
+		waiter			waiter_;
+
+		bool await_ready() noexcept { return false; }
+		void await_suspend (std::coroutine_handle<> h)
+		{
+			waiter_.handle = h;
+			waiter_.slot = slot_;
+			if (slot_) *slot_ = &waiter_;
+			for (std::size_t i = 0; i < nregs_; i++)
+				reactor_.arm (*regs_[i]);
+			if (has_deadline_) {
+				waiter_.has_deadline = true;
+				waiter_.timer = reactor_.timers_.emplace (deadline_, &waiter_);
+			}
+		}
+		void await_resume() noexcept {}
+	};
+
+	/// Suspend until any of the registrations is ready, or the optional deadline.
+	wait_awaiter wait (registration* const* regs, std::size_t nregs, waiter** slot, clock::time_point deadline, bool has_deadline)
+	{
+		return wait_awaiter { *this, regs, nregs, slot, deadline, has_deadline, {} };
+	}
+
+	/// Suspend until the duration elapses.
+	wait_awaiter sleep (clock::duration duration)
+	{
+		return wait (nullptr, 0, nullptr, clock::now() + duration, true);
+	}
+
+	/// Remove a registration, e.g. before closing the descriptor.
+	void remove (registration& reg)
+	{
+		if (reg.is_added) {
+			::epoll_ctl (epfd_, EPOLL_CTL_DEL, reg.fd, nullptr);
+			reg.is_added = false;
+		}
+	}
+
+	/// Dispatch events until stop() is called.
+	void run()
+	{
+		is_stopped_ = false;
+		while (!is_stopped_)
+			run_once (-1);
+	}
+
+	/// Dispatch ready events, blocking up to timeout_ms (-1 = until the next deadline).
+	/// Returns the number of coroutines resumed.
+	std::size_t run_once (int timeout_ms)
+	{
+		struct epoll_event events[64];
+		const int next = next_timeout_ms();
+		if (-1 == timeout_ms || (-1 != next && next < timeout_ms))
+			timeout_ms = next;
+		const int nfds = ::epoll_wait (epfd_, events, 64, timeout_ms);
+/* collect all wakeups before resuming, resumed coroutines may destroy registrations */
+		std::coroutine_handle<> ready[64 + 64];
+		std::size_t nready = 0;
+		for (int i = 0; i < nfds; i++) {
+			registration* reg = static_cast<registration*> (events[i].data.ptr);
+			if (nullptr == reg->slot || nullptr == *reg->slot)
+				continue;
+			ready[nready++] = wake (*reg->slot);
+		}
+		const clock::time_point now = clock::now();
+		while (!timers_.empty() && timers_.begin()->first <= now && nready < sizeof (ready) / sizeof (ready[0]))
+			ready[nready++] = wake (timers_.begin()->second);
+		for (std::size_t i = 0; i < nready; i++)
+			ready[i].resume();
+		return nready;
+	}
+
+	/// Request run() to return after the current dispatch.
+	void stop()
+	{
+		is_stopped_ = true;
+	}
+
+private:
+	static pgm_detail::detached run_detached (pgm_task<void> task)
+	{
+		co_await std::move (task);
+	}
+
+	void arm (registration& reg)
+	{
+		struct epoll_event event;
+		event.events = reg.events | EPOLLONESHOT;
+		event.data.ptr = &reg;
+		if (0 == ::epoll_ctl (epfd_, reg.is_added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, reg.fd, &event))
+			reg.is_added = true;
+	}
+
+	std::coroutine_handle<> wake (waiter* w)
+	{
+		if (w->slot) *w->slot = nullptr;
+		if (w->has_deadline) {
+			timers_.erase (w->timer);
+			w->has_deadline = false;
+		}
+		return w->handle;
+	}
+
+	int next_timeout_ms() const
+	{
+		if (timers_.empty())
+			return -1;
+		const clock::duration remain = timers_.begin()->first - clock::now();
+		if (remain <= clock::duration::zero())
+			return 0;
+/* round up, epoll only has millisecond resolution */
+		return (int)std::chrono::ceil<std::chrono::milliseconds> (remain).count();
+	}
+
+	int		epfd_;
+	bool		is_stopped_;
+	std::multimap<clock::time_point, waiter*> timers_;
+};
+
+/// Result of an asynchronous receive, entries of msgv reference library owned
+/// skbs which remain valid until the next receive on the socket.
+struct pgm_async_result
+{
+	int				status = cpgm::PGM_IO_STATUS_ERROR;
+	std::size_t			bytes = 0;
+	std::span<cpgm::pgm_msgv_t>	msgv;
+	cpgm::pgm_error_t*		error = nullptr;	/* caller frees with pgm_error_free */
+};
+
+/// Coroutine adapter for a connected, non-blocking (PGM_NOBLOCK) pgm_socket.
+/// A single receive loop must run per socket, it also services NAKs, ACKs and
+/// timers for the send side.
+template <typename Protocol>
+class pgm_async_socket
+{
+public:
+	typedef pgm_socket<Protocol> socket_type;
+
+	pgm_async_socket (pgm_reactor& reactor, socket_type& socket)
+	: reactor_ (reactor),
+	  socket_ (socket),
+	  reader_ (nullptr),
+	  writer_ (nullptr)
+	{
+	}
+
+	~pgm_async_socket()
+	{
+		close();
+	}
+
+	pgm_async_socket (const pgm_async_socket&) = delete;
+	pgm_async_socket& operator= (const pgm_async_socket&) = delete;
+
+	/// Collect event descriptors from the connected socket.
+	bool open()
+	{
+		int noblock = 0;
+		::socklen_t optlen = sizeof (noblock);
+		if (!socket_.get_option (IPPROTO_PGM, cpgm::PGM_NOBLOCK, &noblock, &optlen) || !noblock)
+			return false;
+		const int recv_optnames[] = { cpgm::PGM_RECV_SOCK, cpgm::PGM_PENDING_SOCK, cpgm::PGM_REPAIR_SOCK };
+		nrecv_ = 0;
+		for (int optname : recv_optnames)
+			if (add_fd (optname, EPOLLIN, &reader_, recv_[nrecv_]))
+				nrecv_++;
+		add_fd (cpgm::PGM_SEND_SOCK, EPOLLOUT, &writer_, send_);
+		add_fd (cpgm::PGM_ACK_SOCK, EPOLLIN, &writer_, ack_);
+		return nrecv_ > 0;
+	}
+
+	/// Deregister event descriptors, the pgm_socket remains open.
+	void close()
+	{
+		for (std::size_t i = 0; i < nrecv_; i++)
+			reactor_.remove (recv_[i]);
+		reactor_.remove (send_);
+		reactor_.remove (ack_);
+		nrecv_ = 0;
+	}
+
+	/// Receive into msgv, suspending on would-block, pending timers and NAK rate limits.
+	pgm_task<pgm_async_result> async_receive (std::span<cpgm::pgm_msgv_t> msgv, int flags = 0)
+	{
+		pgm_reactor::registration* regs[3] = { &recv_[0], &recv_[1], &recv_[2] };
+		for (;;) {
+			pgm_async_result result;
+			result.status = cpgm::pgm_recvmsgv (socket_.native(), msgv.data(), msgv.size(), flags, &result.bytes, &result.error);
+			switch (result.status) {
+			case cpgm::PGM_IO_STATUS_TIMER_PENDING:
+				co_await reactor_.wait (regs, nrecv_, &reader_, deadline (cpgm::PGM_TIME_REMAIN), true);
+				continue;
+			case cpgm::PGM_IO_STATUS_RATE_LIMITED:
+				co_await reactor_.wait (regs, nrecv_, &reader_, deadline (cpgm::PGM_RATE_REMAIN), true);
+				continue;
+			case cpgm::PGM_IO_STATUS_WOULD_BLOCK:
+				co_await reactor_.wait (regs, nrecv_, &reader_, pgm_reactor::clock::time_point(), false);
+				continue;
+			case cpgm::PGM_IO_STATUS_NORMAL:
+				result.msgv = msgv.first (count (msgv, result.bytes));
+				break;
+			default:
+				break;
+			}
+			co_return result;
+		}
+	}
+
+	/// Send an APDU, suspending on rate limits, kernel buffers and PGMCC congestion.
+	pgm_task<int> async_send (const void* buf, std::size_t len, std::size_t* bytes_written = nullptr)
+	{
+		pgm_reactor::registration* send_regs[1] = { &send_ };
+		pgm_reactor::registration* ack_regs[1] = { &ack_ };
+		for (;;) {
+			const int status = socket_.send (buf, len, bytes_written);
+			switch (status) {
+/* resume with identical arguments, the library continues the partial APDU */
+			case cpgm::PGM_IO_STATUS_RATE_LIMITED:
+				co_await reactor_.wait (nullptr, 0, &writer_, deadline (cpgm::PGM_RATE_REMAIN), true);
+				continue;
+			case cpgm::PGM_IO_STATUS_WOULD_BLOCK:
+				co_await reactor_.wait (send_regs, -1 == send_.fd ? 0 : 1, &writer_, pgm_reactor::clock::time_point(), false);
+				continue;
+			case cpgm::PGM_IO_STATUS_CONGESTION:
+				co_await reactor_.wait (ack_regs, -1 == ack_.fd ? 0 : 1, &writer_, deadline (cpgm::PGM_TIME_REMAIN), true);
+				continue;
+			default:
+				break;
+			}
+			co_return status;
+		}
+	}
+
+	/// Zero-copy view of a received skb payload.
+	static std::span<const std::byte> data (const struct cpgm::pgm_sk_buff_t* skb)
+	{
+		return std::span<const std::byte> (static_cast<const std::byte*> (skb->data), skb->len);
+	}
+
+	/// Get the underlying pgm_socket.
+	socket_type& socket()
+	{
+		return socket_;
+	}
+
+private:
+	bool add_fd (int optname, std::uint32_t events, pgm_reactor::waiter** slot, pgm_reactor::registration& reg)
+	{
+		int fd = -1;
+		::socklen_t optlen = sizeof (fd);
+		if (!socket_.get_option (IPPROTO_PGM, optname, &fd, &optlen) || fd < 0)
+			return false;
+		reg.fd = fd;
+		reg.events = events;
+		reg.slot = slot;
+		reg.is_added = false;
+		return true;
+	}
+
+	pgm_reactor::clock::time_point deadline (int optname)
+	{
+		struct timeval tv = { 0, 0 };
+		::socklen_t optlen = sizeof (tv);
+		socket_.get_option (IPPROTO_PGM, optname, &tv, &optlen);
+		return pgm_reactor::clock::now() + std::chrono::seconds (tv.tv_sec) + std::chrono::microseconds (tv.tv_usec);
+	}
+
+/* number of msgv entries filled for bytes of payload */
+	static std::size_t count (std::span<cpgm::pgm_msgv_t> msgv, std::size_t bytes)
+	{
+		std::size_t i = 0;
+		while (bytes > 0 && i < msgv.size()) {
+			for (std::uint32_t j = 0; j < msgv[i].msgv_len; j++)
+				bytes -= msgv[i].msgv_skb[j]->len;
+			i++;
+		}
+		return i;
+	}
+
+	pgm_reactor&			reactor_;
+	socket_type&			socket_;
+	pgm_reactor::waiter*		reader_;
+	pgm_reactor::waiter*		writer_;
+	pgm_reactor::registration	recv_[3];
+	std::size_t			nrecv_ = 0;
+	pgm_reactor::registration	send_;
+	pgm_reactor::registration	ack_;
+};
+
+#endif /* __PGM_ASYNC_HH__ */
@@ -40,41 +40,64 @@ struct pgm_sk_buff_t;
 
 PGM_BEGIN_DECLS
 
+/* Field order follows the receive fast path.  The first cache line holds what
+ * parsing, window insert and delivery touch, the second the window control
+ * buffer, the rest is cold and carries the atomic reference count away from
+ * read-mostly fields.  link_ must stay first as queues cast the list link.
+ *
+ * ABI: this order, is_retained and is_transformed arrived with shared library
+ * version 1 (libpgm-5.2.so.1), applications built against libpgm-5.2.so.0
+ * read the wrong fields and must be recompiled.  The pgm_skb_*() accessors below are
+ * exported functions and keep working across future layout changes.
+ */
+
 struct pgm_sk_buff_t {
 	pgm_list_t			link_;
 
-	pgm_sock_t* restrict		sock;
-	pgm_time_t			tstamp;
-	pgm_tsi_t			tsi;
-
+	void			       *data,		/* all may-alias */
+				       *tail;
+	struct pgm_header*		pgm_header;
+	struct pgm_data*		pgm_data;
 	uint32_t			sequence;
-	uint32_t			__padding;	/* push alignment of pgm_sk_buff_t::cb to 8 bytes */
-
-	char				cb[48];		/* control buffer */
-
 	uint16_t			len;		/* actual data */
-	unsigned			zero_padded:1;
-	unsigned			__padding2:31;	/* fix bit field */
+	uint16_t			zero_padded:1;
+	uint16_t			is_ce:1;	/* ECN congestion experienced */
+	uint16_t			is_retained:1;	/* data … tail in application memory */
+	uint16_t			is_transformed:1;	/* OPT_TRANSFORM, encoded APDU payload */
+	uint16_t			__padding:12;	/* fix bit field */
 
-	struct pgm_header*		pgm_header;
+	char				cb[48];		/* control buffer */
+	pgm_time_t			tstamp;
 	struct pgm_opt_fragment* 	pgm_opt_fragment;
 #define of_apdu_first_sqn		pgm_opt_fragment->opt_sqn
 #define of_frag_offset			pgm_opt_fragment->opt_frag_off
 #define of_apdu_len			pgm_opt_fragment->opt_frag_len
-	struct pgm_opt_pgmcc_data*	pgm_opt_pgmcc_data;
-	struct pgm_data*		pgm_data;
 
-	void			       *head,		/* all may-alias */
-				       *data,
-				       *tail,
+	void			       *head,
 				       *end;
+	pgm_tsi_t			tsi;
+	pgm_sock_t* restrict		sock;
+	struct pgm_opt_pgmcc_data*	pgm_opt_pgmcc_data;
 	uint32_t			truesize;
 	volatile uint32_t		users;		/* atomic */
+#if (defined( __SIZEOF_POINTER__ ) && ( __SIZEOF_POINTER__ == 8 )) || defined( _WIN64 )
+	uint32_t			__padding2[4];	/* headroom on a cache line boundary */
+#endif
 };
 
+/* ABI stable accessors, field offsets may change between shared library
+ * versions, unlike direct field access and the inline helpers below.
+ */
+const void* pgm_skb_data (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+uint16_t pgm_skb_len (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+uint32_t pgm_skb_sequence (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+pgm_time_t pgm_skb_tstamp (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+const pgm_tsi_t* pgm_skb_tsi (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+
 void pgm_skb_over_panic (const struct pgm_sk_buff_t*const, const uint16_t) PGM_GNUC_NORETURN;
 void pgm_skb_under_panic (const struct pgm_sk_buff_t*const, const uint16_t) PGM_GNUC_NORETURN;
 bool pgm_skb_is_valid (const struct pgm_sk_buff_t*const) PGM_GNUC_PURE PGM_GNUC_WARN_UNUSED_RESULT;
+void pgm_skb_release_retained (struct pgm_sk_buff_t*const);
 
 /* attribute __pure__ only valid for platforms with atomic ops.
  * attribute __malloc__ not used as only part of the memory should be aliased.
@@ -125,8 +148,11 @@ pgm_free_skb (
 	struct pgm_sk_buff_t*const skb
 	)
 {
-	if (pgm_atomic_exchange_and_add32 (&skb->users, (uint32_t)-1) == 1)
+	if (pgm_atomic_exchange_and_add32 (&skb->users, (uint32_t)-1) == 1) {
+		if (PGM_UNLIKELY(skb->is_retained))
+			pgm_skb_release_retained (skb);
 		pgm_free (skb);
+	}
 }
 
 /* add data */
@@ -214,9 +240,8 @@ pgm_skb_copy (
 {
 	struct pgm_sk_buff_t* newskb;
 	newskb = (struct pgm_sk_buff_t*)pgm_malloc (skb->truesize);
-	memcpy (newskb, skb, PGM_OFFSETOF(struct pgm_sk_buff_t, pgm_header));
+	memcpy (newskb, skb, sizeof(struct pgm_sk_buff_t));
 	newskb->zero_padded = 0;
-	newskb->truesize = skb->truesize;
 	pgm_atomic_write32 (&newskb->users, 1);
 	newskb->head = newskb + 1;
 	newskb->end  = (char*)newskb->head + ((char*)skb->end  - (char*)skb->head);
@@ -224,6 +249,7 @@ pgm_skb_copy (
 	newskb->tail = (char*)newskb->head + ((char*)skb->tail - (char*)skb->head);
 	newskb->pgm_header = skb->pgm_header ? (struct pgm_header*)((char*)newskb->head + ((char*)skb->pgm_header - (char*)skb->head)) : skb->pgm_header;
 	newskb->pgm_opt_fragment = skb->pgm_opt_fragment ? (struct pgm_opt_fragment*)((char*)newskb->head + ((char*)skb->pgm_opt_fragment - (char*)skb->head)) : skb->pgm_opt_fragment;
+	newskb->pgm_opt_pgmcc_data = skb->pgm_opt_pgmcc_data ? (struct pgm_opt_pgmcc_data*)((char*)newskb->head + ((char*)skb->pgm_opt_pgmcc_data - (char*)skb->head)) : skb->pgm_opt_pgmcc_data;
 	newskb->pgm_data = skb->pgm_data ? (struct pgm_data*)((char*)newskb->head + ((char*)skb->pgm_data - (char*)skb->head)) : skb->pgm_data;
 	memcpy (newskb->head, skb->head, (char*)skb->end - (char*)skb->head);
 	return newskb;
@@ -94,6 +94,144 @@ struct pgm_pgmccinfo_t {
 	uint32_t				ack_c_p;
 };
 
+/* Rate limit shared between sockets, see PGM_RATE_GROUP. */
+typedef struct pgm_rate_group_t pgm_rate_group_t;
+
+struct pgm_rate_groupinfo_t {
+	pgm_rate_group_t*			rg_group;
+	uint32_t				rg_weight;	/* share relative to other members */
+};
+
+/* Memory-mapped raw receive ring, zero fields take defaults. */
+struct pgm_packet_mmapinfo_t {
+	uint32_t				pm_block_size;	/* bytes, multiple of page size */
+	uint32_t				pm_block_nr;
+	uint32_t				pm_block_tov;	/* block retire timeout in milliseconds */
+	uint16_t				pm_fanout_group;/* 0 for no fanout */
+};
+
+/* AF_XDP datapath for UDP encapsulation, zero fields take defaults. */
+struct pgm_xdpinfo_t {
+	uint32_t				xi_ifindex;	/* 0 for the send interface */
+	uint32_t				xi_queue_id;
+	uint32_t				xi_frame_nr;	/* UMEM frames, power of two */
+	uint32_t				xi_flags;	/* PGM_XDP_* */
+};
+
+/* Application-owned payload for pgm_send_retained(), the release function is
+ * called with each packet's payload once the transmit window drops it.
+ */
+typedef void (*pgm_retain_release_func) (const void*, size_t, void*);
+
+struct pgm_retaininfo_t {
+	pgm_retain_release_func			ri_release;
+	void*					ri_user_data;
+};
+
+/* Archive of packets dropped from the transmit window, still available for
+ * repair.  Sized by ta_sqns, or when zero by ta_secs at TXW_MAX_RTE.
+ */
+struct pgm_txwarchiveinfo_t {
+	const char*				ta_path;	/* directory for the archive file */
+	uint32_t				ta_sqns;
+	uint32_t				ta_secs;
+};
+
+/* Receiver journal of delivered APDUs, a restarted receiver resumes each
+ * source after its last journalled sequence.
+ */
+struct pgm_journalinfo_t {
+	const char*				jl_path;
+	uint64_t				jl_size;	/* record area, 0 for default */
+	uint32_t				jl_flags;	/* PGM_JOURNAL_* */
+};
+
+/* Cumulative enhancement layers above the session, each a companion session
+ * on its own group at a fixed rate.  Receivers join the layers in order while
+ * loss stays below li_loss_threshold and leave the top layer above it.
+ */
+#define PGM_MAX_LAYERS			8
+
+struct pgm_layer_req {
+	struct group_req			lr_group;
+	uint32_t				lr_max_rte;	/* bytes per second */
+};
+
+struct pgm_layerinfo_t {
+	uint32_t				li_loss_threshold; /* permille, 0 for default */
+	uint32_t				li_count;
+	struct pgm_layer_req			li_layers[ PGM_MAX_LAYERS ];
+};
+
+/* Payload transform of each APDU ahead of fragmentation, reversed after
+ * reassembly.  The built-in LZ codec is always decoded, a custom codec
+ * requires the receiver to set the same codec.  encode returns the encoded
+ * length or 0 when the output does not fit, decode returns the decoded
+ * length or -1 on malformed input.  Encoded TPDUs carry OPT_TRANSFORM with
+ * OPX_DISCARD, receivers without the transform drop them and report the APDU
+ * lost, earlier OpenPGM releases ignore OPX and deliver the encoded payload.
+ */
+#define PGM_CODEC_NONE			0
+#define PGM_CODEC_LZ			1
+#define PGM_CODEC_USER			128		/* first custom codec identifier */
+
+typedef size_t (*pgm_compress_encode_func) (const void*restrict, size_t, void*restrict, size_t, void*);
+typedef ssize_t (*pgm_compress_decode_func) (const void*restrict, size_t, void*restrict, size_t, void*);
+
+struct pgm_compressinfo_t {
+	uint32_t				ci_codec;	/* PGM_CODEC_* or custom identifier */
+	uint32_t				ci_min_length;	/* smaller APDUs sent as is, 0 for default */
+	pgm_compress_encode_func		ci_encode;	/* custom codec only */
+	pgm_compress_decode_func		ci_decode;
+	void*					ci_user_data;
+};
+
+/* PGM_COMPRESS_STATS, ratio is bytes in over bytes out */
+struct pgm_compress_stats_t {
+	uint64_t				cs_encoded_msgs;	/* includes retries of rate limited sends */
+	uint64_t				cs_encoded_bytes_in;
+	uint64_t				cs_encoded_bytes_out;
+	uint64_t				cs_encode_usecs;
+	uint64_t				cs_skipped_msgs;	/* short or incompressible */
+	uint64_t				cs_decoded_msgs;
+	uint64_t				cs_decoded_bytes_in;
+	uint64_t				cs_decoded_bytes_out;
+	uint64_t				cs_decode_usecs;
+	uint64_t				cs_decode_errors;	/* dropped APDUs */
+};
+
+/* PGM_RXW_JOURNAL flags */
+#define PGM_JOURNAL_REPLAY		0x1		/* deliver journalled APDUs before live data */
+
+/* PGM_XDP flags */
+#define PGM_XDP_SKB_MODE		0x1		/* generic XDP and copy mode */
+#define PGM_XDP_ZEROCOPY		0x2		/* fail unless driver supports zero-copy */
+#define PGM_XDP_RECV_ONLY		0x4		/* transmit through the socket path */
+
+/* PGM_TX_TIMESTAMPING flags, hardware stamps enable transmit stamping on the
+ * send interface with SIOCSHWTSTAMP which requires CAP_NET_ADMIN and a NIC with
+ * PTP support, otherwise only software stamps are recorded.
+ */
+#define PGM_TX_TIMESTAMPING_SOFTWARE	0x1
+#define PGM_TX_TIMESTAMPING_HARDWARE	0x2
+
+/* Portable processor set for PGM_CPU_AFFINITY, compatible in size with glibc cpu_set_t. */
+#define PGM_CPU_SETSIZE		1024
+#define PGM_NCPUBITS		(8 * sizeof (unsigned long))
+
+struct pgm_cpuset_t {
+	unsigned long				cpu_bits[PGM_CPU_SETSIZE / PGM_NCPUBITS];
+};
+
+#define PGM_CPU_ZERO(set)	memset ((set), 0, sizeof (struct pgm_cpuset_t))
+#define PGM_CPU_SET(cpu, set)	((set)->cpu_bits[(cpu) / PGM_NCPUBITS] |= (1UL << ((cpu) % PGM_NCPUBITS)))
+#define PGM_CPU_CLR(cpu, set)	((set)->cpu_bits[(cpu) / PGM_NCPUBITS] &= ~(1UL << ((cpu) % PGM_NCPUBITS)))
+#define PGM_CPU_ISSET(cpu, set)	(0 != ((set)->cpu_bits[(cpu) / PGM_NCPUBITS] & (1UL << ((cpu) % PGM_NCPUBITS))))
+
+/* PGM_NUMA_NODE special values */
+#define PGM_NUMA_NODE_ANY	(-1)		/* no placement, default */
+#define PGM_NUMA_NODE_LOCAL	(-2)		/* node local to the bound interface */
+
 /* socket options */
 enum {
 	PGM_SEND_SOCK		= 0x2000,
@@ -149,7 +287,30 @@ enum {
 	PGM_UNCONTROLLED_ODATA,
 	PGM_UNCONTROLLED_RDATA,
 	PGM_ODATA_MAX_RTE,
-	PGM_RDATA_MAX_RTE
+	PGM_RDATA_MAX_RTE,
+	PGM_CPU_AFFINITY,
+	PGM_NUMA_NODE,
+	PGM_STREAMING_READ,
+	PGM_USE_RATE_CC,
+	PGM_USE_ECN,
+	PGM_RATE_GROUP,
+	PGM_TX_TIMESTAMPING,
+	PGM_PACKET_MMAP,
+	PGM_XDP,
+	PGM_TXW_RETAIN,
+	PGM_TXW_ARCHIVE,
+	PGM_RXW_JOURNAL,
+	PGM_LATE_JOIN,
+	PGM_SPMR_GROUP_SIZE,
+	PGM_PEER_RATE,
+	PGM_PEER_POOL,
+	PGM_PRIORITY_LANE,
+	PGM_ADD_DESTINATION,
+	PGM_DEL_DESTINATION,
+	PGM_LAYERS,
+	PGM_LAYER_LEVEL,
+	PGM_COMPRESS,
+	PGM_COMPRESS_STATS
 };
 
 /* IO status */
@@ -185,12 +346,27 @@ void pgm_freeaddrinfo (struct pgm_addrinfo_t*);
 int pgm_send (pgm_sock_t*const restrict, const void*restrict, const size_t, size_t*restrict);
 int pgm_sendv (pgm_sock_t*const restrict, const struct pgm_iovec*const restrict, const unsigned, const bool, size_t*restrict);
 int pgm_send_skbv (pgm_sock_t*const restrict, struct pgm_sk_buff_t**const restrict, const unsigned, const bool, size_t*restrict);
+int pgm_send_retained (pgm_sock_t*const restrict, const void*restrict, const size_t, size_t*restrict);
+int pgm_send_begin (pgm_sock_t*const, const size_t);
+int pgm_send_append (pgm_sock_t*const restrict, const void*restrict, const size_t, size_t*restrict);
+int pgm_send_end (pgm_sock_t*const);
+int pgm_send_topic (pgm_sock_t*const restrict, const char*restrict, const void*restrict, const size_t, size_t*restrict);
+int pgm_send_priority (pgm_sock_t*const restrict, const void*restrict, const size_t, size_t*restrict);
+int pgm_send_layer (pgm_sock_t*const restrict, const unsigned, const void*restrict, const size_t, size_t*restrict);
 int pgm_recvmsg (pgm_sock_t*const restrict, struct pgm_msgv_t*const restrict, const int, size_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 int pgm_recvmsgv (pgm_sock_t*const restrict, struct pgm_msgv_t*const restrict, const size_t, const int, size_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 int pgm_recv (pgm_sock_t*const restrict, void*restrict, const size_t, const int, size_t*const restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
 int pgm_recvfrom (pgm_sock_t*const restrict, void*restrict, const size_t, const int, size_t*restrict, struct pgm_sockaddr_t*restrict, socklen_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+#ifndef _WIN32
+int pgm_recv_forward (pgm_sock_t*const restrict, const int, const int, size_t*restrict, pgm_error_t**restrict) PGM_GNUC_WARN_UNUSED_RESULT;
+#endif
+bool pgm_msgv_get_fragment_info (const struct pgm_msgv_t*const restrict, struct pgm_fragment_info_t*const restrict);
 
 bool pgm_getsockname (pgm_sock_t*const restrict, struct pgm_sockaddr_t*restrict, socklen_t*restrict);
+pgm_rate_group_t* pgm_rate_group_new (const ssize_t, const unsigned);
+void pgm_rate_group_unref (pgm_rate_group_t*);
+bool pgm_subscribe (pgm_sock_t*const restrict, const char*restrict, const size_t, const bool);
+bool pgm_unsubscribe (pgm_sock_t*const restrict, const char*restrict, const size_t, const bool);
 int pgm_select_info (pgm_sock_t*const restrict, fd_set*const restrict, fd_set*const restrict, int*const restrict);
 #if defined( POLLIN ) && defined( POLLOUT )
 int pgm_poll_info (pgm_sock_t*const restrict, struct pollfd*const restrict, int*const restrict, const short);
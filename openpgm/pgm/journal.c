@@ -0,0 +1,559 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Receiver journal: delivered APDUs are appended with their TSI and sequence
+ * numbers to a memory-mapped ring file.  A restarted receiver replays the
+ * file and resumes each source after its last journalled sequence.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+
+
+//#define JOURNAL_DEBUG
+
+#ifndef JOURNAL_DEBUG
+#	define PGM_DISABLE_ASSERT
+#endif
+
+#define PGM_JOURNAL_ALIGN(x)	(((x) + 7) & ~(uint64_t)7)
+
+
+static inline
+struct pgm_journal_record_t*
+_pgm_journal_record (
+	const pgm_journal_t*const	journal,
+	const uint64_t			offset
+	)
+{
+	return (struct pgm_journal_record_t*)(journal->records + (offset % journal->header->size));
+}
+
+/* logical offset of the record following offset, stepping over padding at
+ * the end of the record area.
+ */
+
+static inline
+uint64_t
+_pgm_journal_next (
+	const pgm_journal_t*const	journal,
+	const uint64_t			offset
+	)
+{
+	const uint64_t remaining = journal->header->size - (offset % journal->header->size);
+	if (remaining < sizeof(struct pgm_journal_record_t))
+		return offset + remaining;
+	const struct pgm_journal_record_t* record = _pgm_journal_record (journal, offset);
+	if (0 == record->length)
+		return offset + remaining;
+	return offset + record->length;
+}
+
+static inline
+const uint16_t*
+_pgm_journal_fragment_lengths (
+	const struct pgm_journal_record_t*const	record
+	)
+{
+	return (const uint16_t*)(record + 1);
+}
+
+static inline
+const char*
+_pgm_journal_apdu (
+	const struct pgm_journal_record_t*const	record
+	)
+{
+	return (const char*)record + PGM_JOURNAL_ALIGN(sizeof(struct pgm_journal_record_t) + record->fragment_count * sizeof(uint16_t));
+}
+
+static
+void
+_pgm_journal_index (
+	pgm_journal_t*		 const restrict	journal,
+	const pgm_tsi_t*	 const restrict	tsi,
+	const uint32_t				last_sqn
+	)
+{
+	struct pgm_journal_peer_t* peer = pgm_hashtable_lookup (journal->peers_hashtable, tsi);
+	if (NULL == peer) {
+		peer = pgm_new0 (struct pgm_journal_peer_t, 1);
+		memcpy (&peer->tsi, tsi, sizeof(pgm_tsi_t));
+		peer->next = journal->peers;
+		journal->peers = peer;
+		pgm_hashtable_insert (journal->peers_hashtable, &peer->tsi, peer);
+	}
+	peer->last_sqn = last_sqn;
+}
+
+/* walk records from head to the published tail, truncating at the first
+ * record that fails validation, and index each source's last sequence.
+ */
+
+static
+void
+_pgm_journal_recover (
+	pgm_journal_t* const	journal
+	)
+{
+	struct pgm_journal_header_t* header = journal->header;
+	uint64_t offset = header->head;
+	unsigned count = 0;
+
+	if (PGM_UNLIKELY(pgm_uint64_gt (header->head, header->tail) ||
+			 header->tail - header->head > header->size))
+	{
+		pgm_warn (_("Journal offsets corrupt, discarding contents."));
+		header->head = header->tail = 0;
+		journal->tail = 0;
+		return;
+	}
+
+	while (offset != header->tail)
+	{
+		const uint64_t remaining = header->size - (offset % header->size);
+		const struct pgm_journal_record_t* record = _pgm_journal_record (journal, offset);
+		if (remaining < sizeof(struct pgm_journal_record_t) || 0 == record->length) {
+			offset += remaining;
+			continue;
+		}
+		if (PGM_UNLIKELY(record->length < sizeof(struct pgm_journal_record_t) ||
+				 record->length & 7 ||
+				 record->length > remaining ||
+				 0 == record->fragment_count ||
+				 record->fragment_count > PGM_MAX_FRAGMENTS ||
+				 offset + record->length > header->tail))
+		{
+			pgm_warn (_("Journal truncated at invalid record after %u records."), count);
+			header->tail = offset;
+			break;
+		}
+		_pgm_journal_index (journal, &record->tsi, record->first_sqn + record->fragment_count - 1);
+		offset += record->length;
+		count++;
+	}
+	journal->tail = header->tail;
+	pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Journal holds %u APDUs."), count);
+}
+
+/* open or create the journal at path with a record area of size bytes, an
+ * existing journal keeps its original size.
+ *
+ * returns pointer to journal on success, returns NULL on failure and sets error.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_journal_t*
+pgm_journal_create (
+	const char*	const restrict path,
+	const uint64_t		   size,
+	const bool		   is_replay,
+	pgm_error_t**	      restrict error
+	)
+{
+	pgm_journal_t* journal;
+	bool is_new;
+
+/* pre-conditions */
+	pgm_assert (NULL != path);
+	pgm_assert_cmpuint (size, >, 0);
+
+	journal = pgm_new0 (pgm_journal_t, 1);
+
+#ifndef _WIN32
+	struct stat st;
+	char errbuf[1024];
+	journal->fd = open (path, O_RDWR | O_CREAT, 0600);
+	if (-1 == journal->fd || 0 != fstat (journal->fd, &st)) {
+		const int save_errno = errno;
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Opening journal %s: %s"),
+			       path,
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		if (-1 != journal->fd)
+			close (journal->fd);
+		pgm_free (journal);
+		return NULL;
+	}
+	is_new = (0 == st.st_size);
+	journal->map_len = is_new ? (size_t)(PGM_JOURNAL_HEADER_SIZE + size) : (size_t)st.st_size;
+	if (is_new) {
+		if (0 != ftruncate (journal->fd, (off_t)journal->map_len)) {
+			const int save_errno = errno;
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       pgm_error_from_errno (save_errno),
+				       _("Sizing journal %s to %" PRIzu " bytes: %s"),
+				       path,
+				       journal->map_len,
+				       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			goto err_close;
+		}
+	}
+	if (PGM_UNLIKELY(journal->map_len <= PGM_JOURNAL_HEADER_SIZE)) {
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       PGM_ERROR_INVAL,
+			       _("Journal %s is not a PGM journal."),
+			       path);
+		goto err_close;
+	}
+	journal->header = mmap (NULL, journal->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+	if (MAP_FAILED == journal->header) {
+		const int save_errno = errno;
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Mapping journal %s: %s"),
+			       path,
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_close;
+	}
+#else
+	char winstr[1024];
+	LARGE_INTEGER file_size;
+	journal->file = CreateFileA (path,
+				     GENERIC_READ | GENERIC_WRITE,
+				     0,
+				     NULL,
+				     OPEN_ALWAYS,
+				     FILE_ATTRIBUTE_NORMAL,
+				     NULL);
+	if (INVALID_HANDLE_VALUE == journal->file || !GetFileSizeEx (journal->file, &file_size)) {
+		const DWORD save_errno = GetLastError();
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_win_errno (save_errno),
+			       _("Opening journal %s: %s"),
+			       path,
+			       pgm_win_strerror (winstr, sizeof (winstr), save_errno));
+		if (INVALID_HANDLE_VALUE != journal->file)
+			CloseHandle (journal->file);
+		pgm_free (journal);
+		return NULL;
+	}
+	is_new = (0 == file_size.QuadPart);
+	journal->map_len = is_new ? (size_t)(PGM_JOURNAL_HEADER_SIZE + size) : (size_t)file_size.QuadPart;
+	if (PGM_UNLIKELY(journal->map_len <= PGM_JOURNAL_HEADER_SIZE)) {
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       PGM_ERROR_INVAL,
+			       _("Journal %s is not a PGM journal."),
+			       path);
+		goto err_close;
+	}
+/* mapping extends a new file */
+	journal->mapping = CreateFileMappingA (journal->file,
+					       NULL,
+					       PAGE_READWRITE,
+					       (DWORD)((uint64_t)journal->map_len >> 32),
+					       (DWORD)(journal->map_len & 0xffffffff),
+					       NULL);
+	if (NULL == journal->mapping ||
+	    NULL == (journal->header = MapViewOfFile (journal->mapping, FILE_MAP_ALL_ACCESS, 0, 0, journal->map_len)))
+	{
+		const DWORD save_errno = GetLastError();
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_win_errno (save_errno),
+			       _("Mapping journal %s: %s"),
+			       path,
+			       pgm_win_strerror (winstr, sizeof (winstr), save_errno));
+		if (NULL != journal->mapping)
+			CloseHandle (journal->mapping);
+		goto err_close;
+	}
+#endif
+
+	journal->records = (char*)journal->header + PGM_JOURNAL_HEADER_SIZE;
+	if (is_new) {
+		journal->header->magic		= PGM_JOURNAL_MAGIC;
+		journal->header->version	= PGM_JOURNAL_VERSION;
+		journal->header->size		= journal->map_len - PGM_JOURNAL_HEADER_SIZE;
+		journal->header->head		= journal->header->tail = 0;
+	} else if (PGM_UNLIKELY(PGM_JOURNAL_MAGIC != journal->header->magic ||
+				PGM_JOURNAL_VERSION != journal->header->version ||
+				journal->header->size != journal->map_len - PGM_JOURNAL_HEADER_SIZE))
+	{
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       PGM_ERROR_INVAL,
+			       _("Journal %s is not a PGM journal."),
+			       path);
+		goto err_unmap;
+	} else if (journal->header->size != size) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Keeping existing journal size of %" PRIu64 " bytes."),
+			   journal->header->size);
+	}
+
+	journal->peers_hashtable = pgm_hashtable_new (pgm_tsi_hash, pgm_tsi_equal);
+	_pgm_journal_recover (journal);
+	if (is_replay && journal->header->head != journal->header->tail) {
+		journal->is_replaying	= TRUE;
+		journal->replay_offset	= journal->header->head;
+		journal->replay_end	= journal->header->tail;
+	}
+	return journal;
+
+err_unmap:
+#ifndef _WIN32
+	munmap (journal->header, journal->map_len);
+#else
+	UnmapViewOfFile (journal->header);
+	CloseHandle (journal->mapping);
+#endif
+err_close:
+#ifndef _WIN32
+	close (journal->fd);
+#else
+	CloseHandle (journal->file);
+#endif
+	pgm_free (journal);
+	return NULL;
+}
+
+/* flush and close, waiting for write-back as the receive path has stopped.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_journal_destroy (
+	pgm_journal_t* const	journal
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != journal);
+
+	pgm_journal_release_replay (journal);
+	pgm_free (journal->replay_skbs);
+	journal->header->tail = journal->tail;
+#ifndef _WIN32
+	msync (journal->header, journal->map_len, MS_SYNC);
+	munmap (journal->header, journal->map_len);
+	close (journal->fd);
+#else
+	FlushViewOfFile (journal->header, 0);
+	FlushFileBuffers (journal->file);
+	UnmapViewOfFile (journal->header);
+	CloseHandle (journal->mapping);
+	CloseHandle (journal->file);
+#endif
+	pgm_hashtable_destroy (journal->peers_hashtable);
+	while (journal->peers) {
+		struct pgm_journal_peer_t* next = journal->peers->next;
+		pgm_free (journal->peers);
+		journal->peers = next;
+	}
+	pgm_free (journal);
+}
+
+/* append the APDUs in msgv [first, last) and publish the new tail once for
+ * the batch.  the oldest records are dropped to make room.  write-back is
+ * requested asynchronously at most every PGM_JOURNAL_SYNC_IVL, the receive
+ * path never waits on the disk.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_journal_append (
+	pgm_journal_t*		 const restrict	journal,
+	const struct pgm_msgv_t*       restrict	msgv,
+	const struct pgm_msgv_t* const restrict	msgv_end,
+	const pgm_time_t			now
+	)
+{
+	struct pgm_journal_header_t* header;
+
+/* pre-conditions */
+	pgm_assert (NULL != journal);
+	pgm_assert (NULL != msgv);
+	pgm_assert (!journal->is_replaying);
+
+	header = journal->header;
+	for (; msgv < msgv_end; msgv++)
+	{
+		const struct pgm_sk_buff_t* first_skb = msgv->msgv_skb[0];
+		size_t apdu_length = 0;
+		for (unsigned i = 0; i < msgv->msgv_len; i++)
+			apdu_length += msgv->msgv_skb[i]->len;
+		const uint64_t prefix_length = PGM_JOURNAL_ALIGN(sizeof(struct pgm_journal_record_t) + msgv->msgv_len * sizeof(uint16_t));
+		const uint64_t length = PGM_JOURNAL_ALIGN(prefix_length + apdu_length);
+		if (PGM_UNLIKELY(length > header->size / 2)) {
+			pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("APDU of %" PRIzu " bytes too large for journal."), apdu_length);
+			continue;
+		}
+
+/* records are contiguous, pad to the end of the area when short */
+		const uint64_t remaining = header->size - (journal->tail % header->size);
+		const uint64_t pad = (remaining < length) ? remaining : 0;
+		while (journal->tail + pad + length - header->head > header->size)
+			header->head = _pgm_journal_next (journal, header->head);
+		if (pad) {
+			if (pad >= sizeof(uint32_t))
+				_pgm_journal_record (journal, journal->tail)->length = 0;
+			journal->tail += pad;
+		}
+
+		struct pgm_journal_record_t* record = _pgm_journal_record (journal, journal->tail);
+		uint16_t* fragment_lengths = (uint16_t*)(record + 1);
+		char* dst = (char*)record + prefix_length;
+		record->length		= (uint32_t)length;
+		memcpy (&record->tsi, &first_skb->tsi, sizeof(pgm_tsi_t));
+		record->first_sqn	= first_skb->sequence;
+		record->apdu_length	= (uint32_t)apdu_length;
+		record->fragment_count	= (uint16_t)msgv->msgv_len;
+		record->reserved	= 0;
+		for (unsigned i = 0; i < msgv->msgv_len; i++) {
+			const struct pgm_sk_buff_t* skb = msgv->msgv_skb[i];
+			fragment_lengths[i] = skb->len;
+			memcpy (dst, skb->data, skb->len);
+			dst += skb->len;
+		}
+		journal->tail += length;
+		_pgm_journal_index (journal, &first_skb->tsi, first_skb->sequence + msgv->msgv_len - 1);
+	}
+
+/* publish */
+	header->tail = journal->tail;
+	if (pgm_time_after_eq (now, journal->next_sync)) {
+#ifndef _WIN32
+		msync (header, journal->map_len, MS_ASYNC);
+#else
+		FlushViewOfFile (header, 0);
+#endif
+		journal->next_sync = now + PGM_JOURNAL_SYNC_IVL;
+	}
+}
+
+/* last journalled sequence number from source tsi.
+ *
+ * returns TRUE if found, returns FALSE if source is not in the journal.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_journal_lookup (
+	const pgm_journal_t* const restrict journal,
+	const pgm_tsi_t*     const restrict tsi,
+	uint32_t*		   restrict last_sqn
+	)
+{
+	const struct pgm_journal_peer_t* peer;
+
+/* pre-conditions */
+	pgm_assert (NULL != journal);
+	pgm_assert (NULL != tsi);
+	pgm_assert (NULL != last_sqn);
+
+	peer = pgm_hashtable_lookup (journal->peers_hashtable, tsi);
+	if (NULL == peer)
+		return FALSE;
+	*last_sqn = peer->last_sqn;
+	return TRUE;
+}
+
+/* free buffers handed out by the previous replay call.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_journal_release_replay (
+	pgm_journal_t* const	journal
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != journal);
+
+	for (unsigned i = 0; i < journal->replay_skbs_len; i++)
+		pgm_free_skb (journal->replay_skbs[i]);
+	journal->replay_skbs_len = 0;
+}
+
+/* fill the message vector from the journal as pgm_rxw_readv() would, each
+ * fragment copied to its own buffer.  buffers stay valid until the next
+ * call.  replay completes when the tail found on open is reached.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_journal_replay (
+	pgm_journal_t*		 const restrict	journal,
+	struct pgm_msgv_t**	       restrict	pmsg,
+	const struct pgm_msgv_t* const restrict	msg_end,
+	size_t*			 const restrict	bytes_read,
+	unsigned*		 const restrict	data_read
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != journal);
+	pgm_assert (NULL != pmsg);
+	pgm_assert (NULL != msg_end);
+	pgm_assert (journal->is_replaying);
+
+	while (journal->replay_offset != journal->replay_end && *pmsg <= msg_end)
+	{
+		const uint64_t remaining = journal->header->size - (journal->replay_offset % journal->header->size);
+		const struct pgm_journal_record_t* record = _pgm_journal_record (journal, journal->replay_offset);
+		if (remaining < sizeof(struct pgm_journal_record_t) || 0 == record->length) {
+			journal->replay_offset += remaining;
+			continue;
+		}
+
+		if (journal->replay_skbs_len + record->fragment_count > journal->replay_skbs_alloc) {
+			journal->replay_skbs_alloc = MAX( 2 * journal->replay_skbs_alloc, journal->replay_skbs_len + record->fragment_count );
+			journal->replay_skbs = pgm_realloc (journal->replay_skbs, journal->replay_skbs_alloc * sizeof(struct pgm_sk_buff_t*));
+		}
+
+		const uint16_t* fragment_lengths = _pgm_journal_fragment_lengths (record);
+		const char* src = _pgm_journal_apdu (record);
+		for (unsigned i = 0; i < record->fragment_count; i++) {
+			struct pgm_sk_buff_t* skb = pgm_alloc_skb (fragment_lengths[i]);
+			memcpy (&skb->tsi, &record->tsi, sizeof(pgm_tsi_t));
+			skb->sequence = record->first_sqn + i;
+			memcpy (pgm_skb_put (skb, fragment_lengths[i]), src, fragment_lengths[i]);
+			src += fragment_lengths[i];
+			(*pmsg)->msgv_skb[i] = skb;
+			journal->replay_skbs[journal->replay_skbs_len++] = skb;
+		}
+		(*pmsg)->msgv_len = record->fragment_count;
+		(*pmsg)++;
+		(*bytes_read) += record->apdu_length;
+		(*data_read)++;
+		journal->replay_offset += record->length;
+	}
+
+	if (journal->replay_offset == journal->replay_end) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Journal replay complete."));
+		journal->is_replaying = FALSE;
+	}
+}
+
+/* eof */
@@ -0,0 +1,232 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Layered multi-rate multicast.  The source sends cumulative layers, the
+ * session and enhancement layers at increasing rates each on its own group.
+ * Receivers sample loss of original transmissions across all layers, leave
+ * the top layer when it exceeds the threshold and periodically try joining
+ * the next, backing off exponentially on failed attempts.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+#include <impl/receiver.h>
+#include <impl/rxw.h>
+
+
+//#define LAYER_DEBUG
+
+
+/* enhancement layer sending with source port sport, NAKs and SPMRs for the
+ * layer session are addressed to it.
+ *
+ * returns the layer, or NULL if sport belongs to no layer.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_layer_t*
+pgm_layer_find (
+	pgm_sock_t* const	sock,
+	const uint16_t		sport		/* network order */
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	for (unsigned i = 0; i < sock->layers_len; i++)
+		if (NULL != sock->layers[i].window && sport == sock->layers[i].tsi.sport)
+			return &sock->layers[i];
+	return NULL;
+}
+
+/* a receiver creates no peer from packets on a layer above its level, data
+ * in flight after a leave would otherwise revive the session just expired.
+ *
+ * returns TRUE if dst_addr is the group of a layer not joined.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_layer_is_refused (
+	const pgm_sock_t*      const restrict sock,
+	const struct sockaddr* const restrict dst_addr
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != dst_addr);
+
+	for (unsigned i = sock->layer_level; i < sock->layers_len; i++)
+		if (0 == pgm_sockaddr_cmp (dst_addr, (const struct sockaddr*)&sock->layers[i].gr.gr_group))
+			return TRUE;
+	return FALSE;
+}
+
+/* any-source membership of the layer group on its interface.
+ */
+
+static
+void
+layer_gsr (
+	const pgm_layer_t*       const restrict	layer,
+	struct group_source_req* const restrict	gsr
+	)
+{
+	memset (gsr, 0, sizeof(struct group_source_req));
+	gsr->gsr_interface = layer->gr.gr_interface;
+	memcpy (&gsr->gsr_group, &layer->gr.gr_group, pgm_sockaddr_len ((const struct sockaddr*)&layer->gr.gr_group));
+	memcpy (&gsr->gsr_source, &layer->gr.gr_group, pgm_sockaddr_len ((const struct sockaddr*)&layer->gr.gr_group));
+}
+
+/* join the next enhancement layer.
+ *
+ * returns TRUE on success, FALSE if the membership failed.
+ */
+
+static
+bool
+layer_join (
+	pgm_sock_t* const	sock
+	)
+{
+	struct group_source_req gsr;
+	pgm_layer_t* layer = &sock->layers[ sock->layer_level ];
+
+	layer_gsr (layer, &gsr);
+	if (SOCKET_ERROR == pgm_membership_join (sock, &gsr, FALSE)) {
+		const int save_errno = pgm_get_last_sock_error();
+		char errbuf[1024];
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Join of layer %u failed: %s"),
+			   sock->layer_level + 1,
+			   pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		return FALSE;
+	}
+	sock->layer_level++;
+	if (NULL != sock->packet_mmap)
+		pgm_packet_mmap_set_filter (sock);
+	return TRUE;
+}
+
+/* leave the top enhancement layer, its sessions expire at the next peer
+ * state check rather than chase repairs that will no longer arrive.
+ */
+
+static
+void
+layer_leave (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	now
+	)
+{
+	struct group_source_req gsr;
+	pgm_layer_t* layer = &sock->layers[ sock->layer_level - 1 ];
+
+	layer_gsr (layer, &gsr);
+	pgm_membership_leave (sock, &gsr, FALSE);
+	sock->layer_level--;
+	if (NULL != sock->packet_mmap)
+		pgm_packet_mmap_set_filter (sock);
+
+	for (pgm_list_t* it = sock->peers_list; NULL != it; it = it->next)
+	{
+		pgm_peer_t* peer = it->data;
+		if (0 == pgm_sockaddr_cmp ((const struct sockaddr*)&peer->group_nla, (const struct sockaddr*)&layer->gr.gr_group))
+			peer->expiry = now;
+	}
+}
+
+/* sample loss of original data since the last check over every source,
+ * repairs excluded so that a congested receiver is not masked by NAKs.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_layer_check (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	now
+	)
+{
+	uint64_t expected = 0, received = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (sock->layers_len > 0);
+
+	sock->next_layer_check = now + PGM_LAYER_CHECK_IVL;
+
+	for (pgm_list_t* it = sock->peers_list; NULL != it; it = it->next)
+	{
+		pgm_peer_t* peer = it->data;
+		if (!peer->window->is_defined)
+			continue;
+		const uint32_t lead = pgm_rxw_lead (peer->window);
+		if (peer->has_layer_sample) {
+			expected += (uint32_t)(lead - peer->layer_lead);
+			received += (uint32_t)(peer->odata_count - peer->layer_odata);
+		}
+		peer->layer_lead	= lead;
+		peer->layer_odata	= peer->odata_count;
+		peer->has_layer_sample	= 1;
+	}
+
+/* idle sources neither promote nor demote */
+	if (0 == expected)
+		return;
+	if (received > expected)
+		received = expected;
+	const uint32_t loss = (uint32_t)(((expected - received) * 1000) / expected);
+
+#ifdef LAYER_DEBUG
+	pgm_debug ("layer level %u loss %" PRIu32 " permille over %" PRIu64 " packets",
+		sock->layer_level, loss, expected);
+#endif
+
+	if (loss > sock->layer_loss_threshold)
+	{
+		sock->layer_probe = 0;
+		if (0 == sock->layer_level)
+			return;
+		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Loss %" PRIu32 " permille, leaving layer %u."),
+			   loss, sock->layer_level);
+		layer_leave (sock, now);
+		sock->layer_join_ivl = MIN(sock->layer_join_ivl * 2, PGM_LAYER_JOIN_MAX_IVL);
+		sock->next_layer_join = now + sock->layer_join_ivl;
+		return;
+	}
+
+/* join-experiment succeeded, retry sooner */
+	if (sock->layer_probe && 0 == --sock->layer_probe)
+		sock->layer_join_ivl = MAX(sock->layer_join_ivl / 2, PGM_LAYER_JOIN_MIN_IVL);
+
+	if (0 == sock->layer_probe &&
+	    sock->layer_level < sock->layers_len &&
+	    pgm_time_after_eq (now, sock->next_layer_join) &&
+	    layer_join (sock))
+	{
+		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Loss %" PRIu32 " permille, joined layer %u."),
+			   loss, sock->layer_level);
+		sock->layer_probe = PGM_LAYER_PROBE_CHECKS;
+		sock->next_layer_join = now + sock->layer_join_ivl;
+	}
+}
+
+/* eof */
@@ -0,0 +1,402 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for layered multi-rate multicast.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#	include <sys/types.h>
+#	include <sys/socket.h>
+#	include <netinet/in.h>
+#	include <arpa/inet.h>
+#else
+#	include <ws2tcpip.h>
+#endif
+#include <glib.h>
+#include <check.h>
+
+#ifdef _WIN32
+#	define PGM_CHECK_NOFORK		1
+#endif
+
+
+/* mock state */
+
+#define TEST_LAYERS		2
+
+static int mock_join_count = 0;
+static int mock_leave_count = 0;
+static int mock_join_errno = 0;
+
+
+#define pgm_membership_join		mock_pgm_membership_join
+#define pgm_membership_leave		mock_pgm_membership_leave
+#define pgm_packet_mmap_set_filter	mock_pgm_packet_mmap_set_filter
+
+#define LAYER_DEBUG
+#include "layer.c"
+
+
+static
+void
+mock_setup (void)
+{
+	mock_join_count = mock_leave_count = 0;
+	mock_join_errno = 0;
+}
+
+/* receiver with TEST_LAYERS enhancement layers on 239.192.0.2 … */
+
+static
+pgm_sock_t*
+generate_sock (void)
+{
+	pgm_sock_t* sock = g_new0 (pgm_sock_t, 1);
+	sock->tsi.sport = g_htons (1000);
+	sock->layers_len = TEST_LAYERS;
+	sock->layers = g_new0 (pgm_layer_t, TEST_LAYERS);
+	for (unsigned i = 0; i < TEST_LAYERS; i++) {
+		pgm_layer_t* layer = &sock->layers[i];
+		struct sockaddr_in* group = (struct sockaddr_in*)&layer->gr.gr_group;
+		group->sin_family	= AF_INET;
+		group->sin_addr.s_addr	= htonl (ntohl (inet_addr ("239.192.0.2")) + i);
+		layer->tsi.sport	= g_htons (1001 + i);
+	}
+	sock->layer_loss_threshold	= PGM_LAYER_DEFAULT_LOSS;
+	sock->layer_join_ivl		= PGM_LAYER_JOIN_MIN_IVL;
+	return sock;
+}
+
+/* source on the group of layer, 0 for the session */
+
+static
+pgm_peer_t*
+generate_peer (
+	pgm_sock_t*		sock,
+	const unsigned		layer
+	)
+{
+	pgm_peer_t* peer = g_new0 (pgm_peer_t, 1);
+	peer->window = g_malloc0 (sizeof(pgm_rxw_t));
+	peer->window->is_defined = TRUE;
+	if (layer > 0)
+		memcpy (&peer->group_nla, &sock->layers[ layer - 1 ].gr.gr_group, sizeof(struct sockaddr_storage));
+	pgm_list_t* link = g_new0 (pgm_list_t, 1);
+	link->data = peer;
+	link->next = sock->peers_list;
+	sock->peers_list = link;
+	return peer;
+}
+
+/* advance a peer by expected original sequences of which received arrived */
+
+static
+void
+advance_peer (
+	pgm_peer_t*		peer,
+	const uint32_t		expected,
+	const uint32_t		received
+	)
+{
+	peer->window->lead += expected;
+	peer->odata_count  += received;
+}
+
+
+/* mock functions for external references */
+
+size_t
+pgm_pkt_offset (
+        const bool                      can_fragment,
+        const sa_family_t		pgmcc_family	/* 0 = disable */
+        )
+{
+        return 0;
+}
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+PGM_GNUC_INTERNAL
+int
+mock_pgm_membership_join (
+	pgm_sock_t*		      const restrict sock,
+	const struct group_source_req* const restrict gsr,
+	const bool				     is_ssm
+	)
+{
+	g_debug ("mock_pgm_membership_join (sock:%p gsr:%p is-ssm:%s)",
+		(gpointer)sock, (gconstpointer)gsr, is_ssm ? "TRUE" : "FALSE");
+	if (mock_join_errno) {
+		pgm_set_last_sock_error (mock_join_errno);
+		return SOCKET_ERROR;
+	}
+	mock_join_count++;
+	return 0;
+}
+
+PGM_GNUC_INTERNAL
+int
+mock_pgm_membership_leave (
+	pgm_sock_t*		      const restrict sock,
+	const struct group_source_req* const restrict gsr,
+	const bool				     is_ssm
+	)
+{
+	g_debug ("mock_pgm_membership_leave (sock:%p gsr:%p is-ssm:%s)",
+		(gpointer)sock, (gconstpointer)gsr, is_ssm ? "TRUE" : "FALSE");
+	mock_leave_count++;
+	return 0;
+}
+
+PGM_GNUC_INTERNAL
+bool
+mock_pgm_packet_mmap_set_filter (
+	pgm_sock_t* const	sock
+	)
+{
+	return TRUE;
+}
+
+
+/* target:
+ *	pgm_layer_t*
+ *	pgm_layer_find (
+ *		pgm_sock_t* const	sock,
+ *		const uint16_t		sport
+ *	)
+ */
+
+START_TEST (test_find_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->layers[0].window = (pgm_txw_t*)0x1;
+	sock->layers[1].window = (pgm_txw_t*)0x1;
+	fail_unless (&sock->layers[1] == pgm_layer_find (sock, g_htons (1002)), "layer not found");
+	fail_unless (NULL == pgm_layer_find (sock, sock->tsi.sport), "session found as layer");
+	fail_unless (NULL == pgm_layer_find (sock, g_htons (1003)), "unknown port found");
+}
+END_TEST
+
+/* receivers have no layer windows */
+START_TEST (test_find_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_unless (NULL == pgm_layer_find (sock, g_htons (1001)), "receiver layer found");
+}
+END_TEST
+
+START_TEST (test_find_fail_001)
+{
+	pgm_layer_find (NULL, g_htons (1001));
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_layer_is_refused (
+ *		const pgm_sock_t* const		sock,
+ *		const struct sockaddr* const	dst_addr
+ *	)
+ */
+
+START_TEST (test_is_refused_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->layer_level = 1;
+	const struct sockaddr* layer1 = (const struct sockaddr*)&sock->layers[0].gr.gr_group;
+	const struct sockaddr* layer2 = (const struct sockaddr*)&sock->layers[1].gr.gr_group;
+	struct sockaddr_in session = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("239.192.0.1")
+	};
+	fail_unless (FALSE == pgm_layer_is_refused (sock, layer1), "joined layer refused");
+	fail_unless (TRUE == pgm_layer_is_refused (sock, layer2), "layer above level accepted");
+	fail_unless (FALSE == pgm_layer_is_refused (sock, (struct sockaddr*)&session), "session refused");
+}
+END_TEST
+
+START_TEST (test_is_refused_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	const bool is_refused = pgm_layer_is_refused (sock, NULL);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_layer_check (
+ *		pgm_sock_t* const	sock,
+ *		const pgm_time_t	now
+ *	)
+ */
+
+/* the first sample only records a baseline, a clean second joins the next
+ * layer once the join interval passed.
+ */
+START_TEST (test_check_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer (sock, 0);
+	advance_peer (peer, 100, 100);
+	pgm_layer_check (sock, pgm_secs (1));
+	fail_unless (0 == sock->layer_level, "joined on baseline");
+	fail_unless (pgm_secs (2) == sock->next_layer_check, "next check");
+	advance_peer (peer, 100, 100);
+	pgm_layer_check (sock, pgm_secs (2));
+	fail_unless (1 == mock_join_count, "join count");
+	fail_unless (1 == sock->layer_level, "layer level");
+	fail_unless (PGM_LAYER_PROBE_CHECKS == sock->layer_probe, "layer probe");
+	fail_unless (pgm_secs (2) + sock->layer_join_ivl == sock->next_layer_join, "next join");
+}
+END_TEST
+
+/* loss over the threshold leaves the top layer, expiring its sources and
+ * doubling the join interval.
+ */
+START_TEST (test_check_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->layer_level = 2;
+	pgm_peer_t* session = generate_peer (sock, 0);
+	pgm_peer_t* top = generate_peer (sock, 2);
+	session->expiry = top->expiry = pgm_secs (300);
+	pgm_layer_check (sock, pgm_secs (1));
+	advance_peer (session, 100, 100);
+	advance_peer (top, 100, 80);
+	pgm_layer_check (sock, pgm_secs (2));
+	fail_unless (1 == mock_leave_count, "leave count");
+	fail_unless (1 == sock->layer_level, "layer level");
+	fail_unless (pgm_secs (2) == top->expiry, "layer source not expired");
+	fail_unless (pgm_secs (300) == session->expiry, "session source expired");
+	fail_unless (2 * PGM_LAYER_JOIN_MIN_IVL == sock->layer_join_ivl, "join interval");
+	fail_unless (pgm_secs (2) + sock->layer_join_ivl == sock->next_layer_join, "next join");
+}
+END_TEST
+
+/* idle sources neither join nor leave, loss without layers is ignored */
+START_TEST (test_check_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer (sock, 0);
+	pgm_layer_check (sock, pgm_secs (1));
+	pgm_layer_check (sock, pgm_secs (2));
+	fail_unless (0 == mock_join_count, "join count");
+	advance_peer (peer, 100, 10);
+	pgm_layer_check (sock, pgm_secs (3));
+	fail_unless (0 == mock_leave_count, "leave count");
+	fail_unless (0 == sock->layer_level, "layer level");
+}
+END_TEST
+
+/* a failed join keeps the level and retries at the next check */
+START_TEST (test_check_pass_004)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_peer_t* peer = generate_peer (sock, 0);
+	pgm_layer_check (sock, pgm_secs (1));
+	advance_peer (peer, 100, 100);
+	mock_join_errno = PGM_SOCK_EINVAL;
+	pgm_layer_check (sock, pgm_secs (2));
+	fail_unless (0 == sock->layer_level, "layer level");
+	mock_join_errno = 0;
+	advance_peer (peer, 100, 100);
+	pgm_layer_check (sock, pgm_secs (3));
+	fail_unless (1 == sock->layer_level, "layer level");
+}
+END_TEST
+
+START_TEST (test_check_fail_001)
+{
+	pgm_layer_check (NULL, pgm_secs (1));
+	fail ("reached");
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_find = tcase_create ("find");
+	suite_add_tcase (s, tc_find);
+	tcase_add_checked_fixture (tc_find, mock_setup, NULL);
+	tcase_add_test (tc_find, test_find_pass_001);
+	tcase_add_test (tc_find, test_find_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_find, test_find_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_is_refused = tcase_create ("is-refused");
+	suite_add_tcase (s, tc_is_refused);
+	tcase_add_checked_fixture (tc_is_refused, mock_setup, NULL);
+	tcase_add_test (tc_is_refused, test_is_refused_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_is_refused, test_is_refused_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_check = tcase_create ("check");
+	suite_add_tcase (s, tc_check);
+	tcase_add_checked_fixture (tc_check, mock_setup, NULL);
+	tcase_add_test (tc_check, test_check_pass_001);
+	tcase_add_test (tc_check, test_check_pass_002);
+	tcase_add_test (tc_check, test_check_pass_003);
+	tcase_add_test (tc_check, test_check_pass_004);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_check, test_check_fail_001, SIGABRT);
+#endif
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -0,0 +1,528 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Multicast group membership set.  The kernel caps memberships per socket,
+ * IP_MAX_MEMBERSHIPS or sysctl net.ipv4.igmp_max_memberships on Linux, so
+ * once the receive socket is full further groups are joined on a pool of
+ * membership-only sockets.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+
+
+//#define MEMBERSHIP_DEBUG
+
+/* Linux delivers a datagram for any group joined on the host to every socket
+ * bound to the port, or every raw socket of the protocol, unless
+ * IP_MULTICAST_ALL is cleared.  Pool sockets therefore never need reading and
+ * all traffic arrives on sock::recv_sock for one peers table.  Other stacks
+ * filter on the memberships of each socket and keep the per-socket limit.
+ */
+#if defined( IP_MULTICAST_ALL ) && !defined( DISABLE_IP_MULTICAST_ALL )
+#	define USE_MEMBERSHIP_POOL
+#endif
+
+struct pgm_member_t {
+	struct pgm_member_t*	next;
+	struct group_source_req	gsr;
+	bool			is_ssm;
+	int			pool_idx;		/* -1 for sock::recv_sock */
+};
+
+struct pgm_group_t {
+	struct sockaddr_storage	group;			/* hash key */
+	struct pgm_member_t*	members;
+	pgm_list_t		link_;
+};
+
+
+static
+pgm_hash_t
+_pgm_group_hash (
+	const void*	p
+	)
+{
+	const struct sockaddr* sa = p;
+
+	switch (sa->sa_family) {
+	case AF_INET: {
+		struct sockaddr_in s4;
+		memcpy (&s4, sa, sizeof(s4));
+		return (pgm_hash_t)s4.sin_addr.s_addr;
+	}
+	case AF_INET6: {
+		struct sockaddr_in6 s6;
+		uint32_t w[4];
+		memcpy (&s6, sa, sizeof(s6));
+		memcpy (w, &s6.sin6_addr, sizeof(w));
+		return (pgm_hash_t)(w[0] ^ w[1] ^ w[2] ^ w[3]);
+	}
+	default:
+		return 0;
+	}
+}
+
+static
+bool
+_pgm_group_equal (
+	const void* restrict p1,
+	const void* restrict p2
+	)
+{
+	return (0 == pgm_sockaddr_cmp ((const struct sockaddr*)p1, (const struct sockaddr*)p2));
+}
+
+/* identical group, source and interface, or an existing membership on all
+ * interfaces.
+ */
+
+static inline
+bool
+_pgm_gsr_is_covered (
+	const struct group_source_req* const restrict gsr,
+	const struct group_source_req* const restrict existing
+	)
+{
+	return (0 == pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_group, (const struct sockaddr*)&existing->gsr_group) &&
+		0 == pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_source, (const struct sockaddr*)&existing->gsr_source) &&
+		(gsr->gsr_interface == existing->gsr_interface || 0 == existing->gsr_interface));
+}
+
+static inline
+bool
+_pgm_membership_is_exhausted (
+	const int	save_errno
+	)
+{
+#ifdef _WIN32
+	return (WSAENOBUFS == save_errno);
+#else
+	return (ENOBUFS == save_errno || ENOMEM == save_errno
+#	ifdef ETOOMANYREFS
+		|| ETOOMANYREFS == save_errno
+#	endif
+		);
+#endif
+}
+
+static
+int
+_pgm_membership_kernel_join (
+	const SOCKET				 s,
+	const struct group_source_req* const	 gsr,
+	const bool				 is_ssm
+	)
+{
+	if (is_ssm)
+		return pgm_sockaddr_join_source_group (s, gsr->gsr_group.ss_family, gsr);
+	else {
+		struct group_req gr;
+		memset (&gr, 0, sizeof(gr));
+		gr.gr_interface = gsr->gsr_interface;
+		memcpy (&gr.gr_group, &gsr->gsr_group, sizeof(struct sockaddr_storage));
+		return pgm_sockaddr_join_group (s, gsr->gsr_group.ss_family, &gr);
+	}
+}
+
+static
+int
+_pgm_membership_kernel_leave (
+	const SOCKET				 s,
+	const struct group_source_req* const	 gsr,
+	const bool				 is_ssm
+	)
+{
+	if (is_ssm)
+		return pgm_sockaddr_leave_source_group (s, gsr->gsr_group.ss_family, gsr);
+	else {
+		struct group_req gr;
+		memset (&gr, 0, sizeof(gr));
+		gr.gr_interface = gsr->gsr_interface;
+		memcpy (&gr.gr_group, &gsr->gsr_group, sizeof(struct sockaddr_storage));
+		return pgm_sockaddr_leave_group (s, gsr->gsr_group.ss_family, &gr);
+	}
+}
+
+/* join on the first pool socket with capacity, opening another when all are
+ * full.
+ *
+ * returns pool index on success, -1 on failure with the socket error set.
+ */
+
+static
+int
+_pgm_membership_pool_join (
+	pgm_membership_t*		 const restrict	membership,
+	const struct group_source_req*	 const restrict	gsr,
+	const bool					is_ssm
+	)
+{
+#ifdef USE_MEMBERSHIP_POOL
+	SOCKET s;
+
+	for (unsigned i = 0; i < membership->pool_len; i++)
+	{
+		if (membership->pool_count[ i ] >= membership->pool_limit)
+			continue;
+		if (SOCKET_ERROR != _pgm_membership_kernel_join (membership->pool[ i ], gsr, is_ssm)) {
+			membership->pool_count[ i ]++;
+			return (int)i;
+		}
+		const int save_errno = pgm_get_last_sock_error();
+		if (!_pgm_membership_is_exhausted (save_errno) || 0 == membership->pool_count[ i ])
+			return -1;
+/* lower administrative limit */
+		membership->pool_limit = membership->pool_count[ i ];
+	}
+
+	if (INVALID_SOCKET == (s = socket (gsr->gsr_group.ss_family, SOCK_DGRAM, 0)))
+		return -1;
+	if (SOCKET_ERROR == _pgm_membership_kernel_join (s, gsr, is_ssm)) {
+		const int save_errno = pgm_get_last_sock_error();
+		closesocket (s);
+		pgm_set_last_sock_error (save_errno);
+		return -1;
+	}
+	membership->pool       = pgm_realloc (membership->pool, (membership->pool_len + 1) * sizeof(SOCKET));
+	membership->pool_count = pgm_realloc (membership->pool_count, (membership->pool_len + 1) * sizeof(unsigned));
+	membership->pool[ membership->pool_len ]       = s;
+	membership->pool_count[ membership->pool_len ] = 1;
+	pgm_trace (PGM_LOG_ROLE_NETWORK,_("Opened membership socket %u for %u groups."),
+		membership->pool_len + 1, membership->len + 1);
+	return (int)membership->pool_len++;
+#else
+	(void)membership;
+	(void)gsr;
+	(void)is_ssm;
+	return -1;
+#endif /* USE_MEMBERSHIP_POOL */
+}
+
+static
+void
+_pgm_recv_gsr_remove (
+	pgm_sock_t*		      const restrict sock,
+	const struct group_source_req* const restrict gsr
+	)
+{
+	for (unsigned i = 0; i < sock->recv_gsr_len; i++)
+	{
+		if (0 == pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_group, (const struct sockaddr*)&sock->recv_gsr[ i ].gsr_group) &&
+		    0 == pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_source, (const struct sockaddr*)&sock->recv_gsr[ i ].gsr_source) &&
+		    gsr->gsr_interface == sock->recv_gsr[ i ].gsr_interface)
+		{
+			sock->recv_gsr_len--;
+			memmove (&sock->recv_gsr[ i ], &sock->recv_gsr[ i + 1 ], (sock->recv_gsr_len - i) * sizeof(struct group_source_req));
+			return;
+		}
+	}
+}
+
+/* returns TRUE if the group, source and interface are already covered by a
+ * membership.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_membership_is_duplicate (
+	const pgm_sock_t*	      const restrict sock,
+	const struct group_source_req* const restrict gsr
+	)
+{
+	const struct pgm_group_t* group;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != gsr);
+
+	if (NULL == sock->membership) {
+		for (unsigned i = 0; i < sock->recv_gsr_len; i++)
+			if (_pgm_gsr_is_covered (gsr, &sock->recv_gsr[ i ]))
+				return TRUE;
+		return FALSE;
+	}
+	group = pgm_hashtable_lookup (sock->membership->hashtable, &gsr->gsr_group);
+	if (NULL == group)
+		return FALSE;
+	for (const struct pgm_member_t* member = group->members; NULL != member; member = member->next)
+		if (_pgm_gsr_is_covered (gsr, &member->gsr))
+			return TRUE;
+	return FALSE;
+}
+
+/* join an any-source group, gsr_source equal to gsr_group, or a group and
+ * source pair.  sock::recv_gsr lists memberships on the receive socket.
+ *
+ * returns 0 on success, SOCKET_ERROR on failure with the socket error set.
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_membership_join (
+	pgm_sock_t*		      const restrict sock,
+	const struct group_source_req* const restrict gsr,
+	const bool				     is_ssm
+	)
+{
+	pgm_membership_t* membership;
+	struct pgm_group_t* group;
+	struct pgm_member_t* member;
+	int pool_idx = -1;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != gsr);
+
+	if (NULL == sock->membership) {
+		membership = pgm_new0 (pgm_membership_t, 1);
+		membership->hashtable  = pgm_hashtable_new (_pgm_group_hash, _pgm_group_equal);
+		membership->pool_limit = IP_MAX_MEMBERSHIPS;
+		sock->membership = membership;
+	}
+	membership = sock->membership;
+
+	if (sock->recv_gsr_len < IP_MAX_MEMBERSHIPS &&
+	    SOCKET_ERROR != _pgm_membership_kernel_join (pgm_sock_ip_recv_sock (sock), gsr, is_ssm))
+	{
+		memcpy (&sock->recv_gsr[ sock->recv_gsr_len++ ], gsr, sizeof(struct group_source_req));
+	}
+	else
+	{
+		if (sock->recv_gsr_len < IP_MAX_MEMBERSHIPS) {
+			const int save_errno = pgm_get_last_sock_error();
+			if (!_pgm_membership_is_exhausted (save_errno))
+				return SOCKET_ERROR;
+			if (sock->recv_gsr_len > 0 && sock->recv_gsr_len < membership->pool_limit)
+				membership->pool_limit = sock->recv_gsr_len;
+		}
+		pool_idx = _pgm_membership_pool_join (membership, gsr, is_ssm);
+		if (pool_idx < 0)
+			return SOCKET_ERROR;
+	}
+
+	member = pgm_new0 (struct pgm_member_t, 1);
+	memcpy (&member->gsr, gsr, sizeof(struct group_source_req));
+	member->is_ssm   = is_ssm;
+	member->pool_idx = pool_idx;
+
+	group = pgm_hashtable_lookup (membership->hashtable, &gsr->gsr_group);
+	if (NULL == group) {
+		group = pgm_new0 (struct pgm_group_t, 1);
+		memcpy (&group->group, &gsr->gsr_group, pgm_sockaddr_len ((const struct sockaddr*)&gsr->gsr_group));
+		group->link_.data = group;
+		membership->group_list = pgm_list_prepend_link (membership->group_list, &group->link_);
+		pgm_hashtable_insert (membership->hashtable, &group->group, group);
+	}
+	member->next = group->members;
+	group->members = member;
+	membership->len++;
+#ifdef MEMBERSHIP_DEBUG
+	pgm_debug ("join %s membership %u on %s", is_ssm ? "source" : "group",
+		membership->len, pool_idx < 0 ? "receive socket" : "pool");
+#endif
+	return 0;
+}
+
+/* leave a group and source pair, or for any-source every membership of the
+ * group on the interface, all interfaces when gsr_interface is zero.
+ *
+ * returns 0 if at least one membership was dropped, SOCKET_ERROR otherwise.
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_membership_leave (
+	pgm_sock_t*		      const restrict sock,
+	const struct group_source_req* const restrict gsr,
+	const bool				     is_ssm
+	)
+{
+	pgm_membership_t* membership;
+	struct pgm_group_t* group;
+	struct pgm_member_t** pmember;
+	int retval = SOCKET_ERROR;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != gsr);
+
+	membership = sock->membership;
+	if (NULL == membership ||
+	    NULL == (group = pgm_hashtable_lookup (membership->hashtable, &gsr->gsr_group)))
+	{
+#ifdef _WIN32
+		pgm_set_last_sock_error (WSAEADDRNOTAVAIL);
+#else
+		pgm_set_last_sock_error (EADDRNOTAVAIL);
+#endif
+		return SOCKET_ERROR;
+	}
+
+	pmember = &group->members;
+	while (NULL != *pmember)
+	{
+		struct pgm_member_t* member = *pmember;
+		const bool is_match = is_ssm ?
+			(0 == pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_source, (const struct sockaddr*)&member->gsr.gsr_source) &&
+			 gsr->gsr_interface == member->gsr.gsr_interface) :
+			(0 == gsr->gsr_interface || gsr->gsr_interface == member->gsr.gsr_interface);
+		if (!is_match) {
+			pmember = &member->next;
+			continue;
+		}
+		if (member->pool_idx < 0) {
+			if (SOCKET_ERROR != _pgm_membership_kernel_leave (pgm_sock_ip_recv_sock (sock), &member->gsr, member->is_ssm))
+				retval = 0;
+			_pgm_recv_gsr_remove (sock, &member->gsr);
+		} else {
+			if (SOCKET_ERROR != _pgm_membership_kernel_leave (membership->pool[ member->pool_idx ], &member->gsr, member->is_ssm))
+				retval = 0;
+			membership->pool_count[ member->pool_idx ]--;
+		}
+		*pmember = member->next;
+		pgm_free (member);
+		membership->len--;
+	}
+
+	if (NULL == group->members) {
+		pgm_hashtable_remove (membership->hashtable, &group->group);
+		membership->group_list = pgm_list_remove_link (membership->group_list, &group->link_);
+		pgm_free (group);
+	}
+	return retval;
+}
+
+/* returns TRUE if any membership exists for the group address.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_membership_is_joined (
+	const pgm_sock_t*      const restrict sock,
+	const struct sockaddr* const restrict group
+	)
+{
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != group);
+
+	if (NULL == sock->membership) {
+		for (unsigned i = 0; i < sock->recv_gsr_len; i++)
+			if (0 == pgm_sockaddr_cmp (group, (const struct sockaddr*)&sock->recv_gsr[ i ].gsr_group))
+				return TRUE;
+		return FALSE;
+	}
+	return (NULL != pgm_hashtable_lookup (sock->membership->hashtable, group));
+}
+
+/* returns the kernel socket holding memberships for the group, source filters
+ * must be applied there.
+ */
+
+PGM_GNUC_INTERNAL
+SOCKET
+pgm_membership_sock (
+	const pgm_sock_t*      const restrict sock,
+	const struct sockaddr* const restrict group
+	)
+{
+	const struct pgm_group_t* group_;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != group);
+
+	if (NULL == sock->membership ||
+	    NULL == (group_ = pgm_hashtable_lookup (sock->membership->hashtable, group)) ||
+	    group_->members->pool_idx < 0)
+	{
+		return pgm_sock_ip_recv_sock (sock);
+	}
+	return sock->membership->pool[ group_->members->pool_idx ];
+}
+
+/* copy up to len joined group addresses.
+ *
+ * returns total count of joined groups which may exceed len.
+ */
+
+PGM_GNUC_INTERNAL
+unsigned
+pgm_membership_groups (
+	const pgm_sock_t*	 const restrict sock,
+	struct sockaddr_storage*       restrict groups,
+	const unsigned			        len
+	)
+{
+	unsigned count = 0;
+
+	pgm_assert (NULL != sock);
+
+	if (NULL == sock->membership) {
+		for (unsigned i = 0; i < sock->recv_gsr_len; i++, count++)
+			if (count < len)
+				memcpy (&groups[ count ], &sock->recv_gsr[ i ].gsr_group, sizeof(struct sockaddr_storage));
+		return count;
+	}
+	for (const pgm_list_t* list = sock->membership->group_list; NULL != list; list = list->next, count++)
+		if (count < len) {
+			const struct pgm_group_t* group = list->data;
+			memcpy (&groups[ count ], &group->group, sizeof(struct sockaddr_storage));
+		}
+	return count;
+}
+
+/* closing the pool sockets drops their memberships, those on sock::recv_sock
+ * go with the socket.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_membership_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_membership_t* membership;
+
+	pgm_assert (NULL != sock);
+
+	membership = sock->membership;
+	if (NULL == membership)
+		return;
+	for (unsigned i = 0; i < membership->pool_len; i++)
+		closesocket (membership->pool[ i ]);
+	while (NULL != membership->group_list) {
+		struct pgm_group_t* group = membership->group_list->data;
+		membership->group_list = pgm_list_remove_link (membership->group_list, &group->link_);
+		while (NULL != group->members) {
+			struct pgm_member_t* next = group->members->next;
+			pgm_free (group->members);
+			group->members = next;
+		}
+		pgm_free (group);
+	}
+	pgm_hashtable_destroy (membership->hashtable);
+	pgm_free (membership->pool);
+	pgm_free (membership->pool_count);
+	pgm_free (membership);
+	sock->membership = NULL;
+}
+
+/* eof */
@@ -22,6 +22,11 @@
 #ifdef HAVE_CONFIG_H
 #	include <config.h>
 #endif
+
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE	/* sendmmsg */
+#endif
+
 #include <errno.h>
 #ifdef HAVE_POLL
 #	include <poll.h>
@@ -39,6 +44,219 @@
 
 //#define NET_DEBUG
 
+#if defined( __linux__ ) && defined( MSG_WAITFORONE )
+#	define USE_SENDMMSG
+#endif
+
+
+#ifndef _WIN32
+/* ancillary data carrying the type-of-service or traffic class of one datagram.
+ */
+
+typedef union {
+	char		buf[ CMSG_SPACE(sizeof(int)) ];
+	struct cmsghdr	align;
+} net_tos_cmsg_t;
+
+/* attach tos to msg, the socket option is left untouched.  no-op on platforms
+ * without a per-datagram IPv6 traffic class.
+ */
+
+static inline
+void
+net_set_tos_cmsg (
+	struct msghdr*	restrict msg,
+	net_tos_cmsg_t*	restrict control,
+	const sa_family_t	 sa_family,
+	const int		 tos
+	)
+{
+	int level, type;
+
+	switch (sa_family) {
+	case AF_INET:
+		level = IPPROTO_IP;
+		type  = IP_TOS;
+		break;
+#ifdef IPV6_TCLASS
+	case AF_INET6:
+		level = IPPROTO_IPV6;
+		type  = IPV6_TCLASS;
+		break;
+#endif
+	default:
+		return;
+	}
+	memset (control, 0, sizeof (net_tos_cmsg_t));
+	msg->msg_control	= control->buf;
+	msg->msg_controllen	= sizeof (control->buf);
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level	= level;
+	cmsg->cmsg_type		= type;
+	cmsg->cmsg_len		= CMSG_LEN(sizeof(int));
+	memcpy (CMSG_DATA(cmsg), &tos, sizeof (int));
+}
+#endif /* !_WIN32 */
+
+/* gather datagram send, a single element takes plain sendto().  tos of -1
+ * keeps the socket type-of-service, otherwise it applies to this datagram only.
+ */
+
+static inline
+ssize_t
+net_sendtov (
+	const SOCKET			  send_sock,
+	const struct pgm_iovec*	restrict  vector,
+	const unsigned			  count,
+	const int			  tos,
+	const struct sockaddr*	restrict  to,
+	const socklen_t			  tolen
+	)
+{
+	if (PGM_LIKELY(1 == count && -1 == tos))
+		return sendto (send_sock, vector[0].iov_base, vector[0].iov_len, 0, to, tolen);
+#ifndef _WIN32
+	net_tos_cmsg_t control;
+	struct msghdr msg = {
+		.msg_name	= (void*)to,
+		.msg_namelen	= tolen,
+		.msg_iov	= (struct iovec*)vector,	/* struct pgm_iovec matches struct iovec */
+		.msg_iovlen	= count
+	};
+	if (-1 != tos)
+		net_set_tos_cmsg (&msg, &control, to->sa_family, tos);
+	return sendmsg (send_sock, &msg, 0);
+#else
+/* WinSock2 has no per-datagram type-of-service, IP_TOS is ignored too */
+	DWORD bytes_sent;
+	if (SOCKET_ERROR == WSASendTo (send_sock, (LPWSABUF)vector, count, &bytes_sent, 0, to, tolen, NULL, NULL))
+		return SOCKET_ERROR;
+	return (ssize_t)bytes_sent;
+#endif
+}
+
+/* ECN-capable transport is only signalled on original data: a sending socket
+ * carries ECT(0) on the regular send socket from connect, and anything else
+ * leaving that socket, i.e. RDATA, NCF, and the ACK and SPMR of its receiver
+ * half, is sent Not-ECT with a per-datagram type-of-service.
+ *
+ * returns the type-of-service to send with, or -1 for the socket default.
+ */
+
+static inline
+int
+net_ecn_tos (
+	const pgm_sock_t*      restrict	sock,
+	const bool			use_router_alert,
+	const struct pgm_iovec* restrict vector
+	)
+{
+	if (!sock->use_ecn || use_router_alert || !sock->can_send_data)
+		return -1;
+	if (vector[0].iov_len >= sizeof (struct pgm_header) &&
+	    PGM_ODATA == ((const struct pgm_header*)vector[0].iov_base)->pgm_type)
+		return -1;
+	return sock->tos & ~PGM_ECN_MASK;
+}
+
+/* copy a TPDU to every unicast fan-out destination, in batches with
+ * sendmmsg() where available.  unreachable destinations are skipped.  caller
+ * holds the destination mutex.
+ *
+ * returns the TPDU length when any copy was sent, otherwise -1 and the socket
+ * error of the first destination.  the number of copies sent is returned in
+ * copies.
+ */
+
+static
+ssize_t
+net_sendtov_fanout (
+	pgm_sock_t*	       restrict	sock,
+	const SOCKET			send_sock,
+	const bool			use_router_alert,
+	const struct pgm_iovec* restrict vector,
+	const unsigned			count,
+	const int			tos,
+	const struct pgm_sk_buff_t* restrict skb,
+	const size_t			len,
+	unsigned*	       restrict	copies
+	)
+{
+	unsigned sent_count = 0, first_error = 0;
+
+	*copies = 0;
+
+#ifdef USE_SENDMMSG
+	struct mmsghdr msgs[PGM_FANOUT_BATCH];
+	net_tos_cmsg_t control;
+	unsigned i = 0;
+
+	while (i < sock->destinations_len)
+	{
+		const unsigned batch = MIN( PGM_FANOUT_BATCH, sock->destinations_len - i );
+		for (unsigned j = 0; j < batch; j++) {
+			const struct sockaddr* to = (const struct sockaddr*)&sock->destinations[ i + j ];
+			msgs[j].msg_hdr.msg_name	= (void*)to;
+			msgs[j].msg_hdr.msg_namelen	= pgm_sockaddr_len (to);
+			msgs[j].msg_hdr.msg_iov		= (struct iovec*)vector;
+			msgs[j].msg_hdr.msg_iovlen	= count;
+			msgs[j].msg_hdr.msg_control	= NULL;
+			msgs[j].msg_hdr.msg_controllen	= 0;
+			msgs[j].msg_hdr.msg_flags	= 0;
+/* ancillary data is only read by the kernel, one copy serves the batch */
+			if (-1 != tos)
+				net_set_tos_cmsg (&msgs[j].msg_hdr, &control, to->sa_family, tos);
+		}
+		if (sock->tx_tstamp)
+			pgm_tx_tstamp_prepare (sock->tx_tstamp, use_router_alert, vector[0].iov_base, skb);
+		const int sent = sendmmsg (send_sock, msgs, batch, 0);
+		if (sent > 0) {
+/* one timestamp id per datagram */
+			for (int j = 0; j < sent && sock->tx_tstamp; j++) {
+				if (j > 0)
+					pgm_tx_tstamp_prepare (sock->tx_tstamp, use_router_alert, vector[0].iov_base, skb);
+				pgm_tx_tstamp_commit (sock->tx_tstamp, use_router_alert);
+			}
+			sent_count += sent;
+			i += sent;
+			continue;
+		}
+/* the failed datagram heads the batch */
+		const int save_errno = pgm_get_last_sock_error();
+		if (PGM_SOCK_EINTR == save_errno)
+			continue;
+		if (PGM_SOCK_EAGAIN == save_errno && 0 == sent_count)
+			return (const ssize_t)-1;
+		if (!first_error)
+			first_error = save_errno;
+		i++;
+	}
+#else
+	for (unsigned i = 0; i < sock->destinations_len; i++)
+	{
+		const struct sockaddr* to = (const struct sockaddr*)&sock->destinations[ i ];
+		if (sock->tx_tstamp)
+			pgm_tx_tstamp_prepare (sock->tx_tstamp, use_router_alert, vector[0].iov_base, skb);
+		if (net_sendtov (send_sock, vector, count, tos, to, pgm_sockaddr_len (to)) < 0) {
+			const int save_errno = pgm_get_last_sock_error();
+			if (PGM_SOCK_EAGAIN == save_errno && 0 == sent_count)
+				return (const ssize_t)-1;
+			if (!first_error)
+				first_error = save_errno;
+			continue;
+		}
+		if (sock->tx_tstamp)
+			pgm_tx_tstamp_commit (sock->tx_tstamp, use_router_alert);
+		sent_count++;
+	}
+#endif /* USE_SENDMMSG */
+	*copies = sent_count;
+	if (0 == sent_count && first_error) {
+		pgm_set_last_sock_error (first_error);
+		return (const ssize_t)-1;
+	}
+	return (const ssize_t)len;
+}
 
 /* locked and rate regulated sendto
  *
@@ -60,21 +278,58 @@ pgm_sendto_hops (
 	socklen_t			tolen
 	)
 {
-	pgm_assert( NULL != sock );
+	struct pgm_iovec vector;
+
 	pgm_assert( NULL != buf );
-	pgm_assert( len > 0 );
+
+	vector.iov_base	= (void*)buf;
+	vector.iov_len	= len;
+	return pgm_sendtov_hops (sock, use_rate_limit, minor_rate_control, use_router_alert, hops, &vector, 1, NULL, to, tolen);
+}
+
+/* as above gathering the datagram from count vector elements, i.e. a header
+ * and payload that are not contiguous.  skb is the data packet the vector
+ * was taken from, or NULL.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_sendtov_hops (
+	pgm_sock_t*	       restrict	sock,
+	bool				use_rate_limit,
+	pgm_rate_t*	       restrict	minor_rate_control,
+	bool				use_router_alert,
+	int				hops,			/* -1 == system default */
+	const struct pgm_iovec* restrict vector,
+	unsigned			count,
+	const struct pgm_sk_buff_t* restrict skb,
+	const struct sockaddr* restrict	to,
+	socklen_t			tolen
+	)
+{
+	size_t len = 0;
+
+	pgm_assert( NULL != sock );
+	pgm_assert( NULL != vector );
+	pgm_assert( count > 0 );
+	pgm_assert( NULL != vector[0].iov_base );
 	pgm_assert( NULL != to );
 	pgm_assert( tolen > 0 );
 
+	for (unsigned i = 0; i < count; i++)
+		len += vector[i].iov_len;
+	pgm_assert( len > 0 );
+
 #ifdef NET_DEBUG
 	char saddr[INET_ADDRSTRLEN];
 	pgm_sockaddr_ntop (to, saddr, sizeof(saddr));
-	pgm_debug ("pgm_sendto (sock:%p use_rate_limit:%s minor_rate_control:%p use_router_alert:%s buf:%p len:%" PRIzu " to:%s [toport:%d] tolen:%d)",
+	pgm_debug ("pgm_sendtov (sock:%p use_rate_limit:%s minor_rate_control:%p use_router_alert:%s vector:%p count:%u len:%" PRIzu " to:%s [toport:%d] tolen:%d)",
 		(const void*)sock,
 		use_rate_limit ? "TRUE" : "FALSE",
 		(const void*)minor_rate_control,
 		use_router_alert ? "TRUE" : "FALSE",
-		(const void*)buf,
+		(const void*)vector,
+		count,
 		len,
 		saddr,
 		pgm_ntohs (((const struct sockaddr_in*)to)->sin_port),
@@ -103,13 +358,60 @@ pgm_sendto_hops (
 		}
 	}
 
+/* unicast fan-out replaces the multicast group */
+	if (PGM_UNLIKELY(0 != sock->destinations_len &&
+			 to == (const struct sockaddr*)&sock->send_gsr.gsr_group))
+	{
+		if (!use_router_alert && sock->can_send_data)
+			pgm_mutex_lock (&sock->send_mutex);
+		if (sock->tx_tstamp)
+			pgm_mutex_lock (&sock->tx_tstamp->mutex);
+		pgm_mutex_lock (&sock->destination_mutex);
+		unsigned copies;
+		const ssize_t sent = net_sendtov_fanout (sock, send_sock, use_router_alert, vector, count,
+							 net_ecn_tos (sock, use_router_alert, vector),
+							 skb, len, &copies);
+		pgm_mutex_unlock (&sock->destination_mutex);
+/* rate check above covered the first copy, every further copy is on the wire too */
+		if (use_rate_limit) {
+			for (unsigned i = 1; i < copies; i++) {
+				pgm_rate_debit (&sock->rate_control, len);
+				if (NULL != minor_rate_control)
+					pgm_rate_debit (minor_rate_control, len);
+			}
+		}
+		if (sock->tx_tstamp)
+			pgm_mutex_unlock (&sock->tx_tstamp->mutex);
+		if (!use_router_alert && sock->can_send_data)
+			pgm_mutex_unlock (&sock->send_mutex);
+		return sent;
+	}
+
 	if (!use_router_alert && sock->can_send_data)
+	{
 		pgm_mutex_lock (&sock->send_mutex);
+/* stack bypass, otherwise fall through to the socket */
+		if (sock->xdp) {
+			const ssize_t sent = pgm_xdp_send (sock, vector, count, len, to, (-1 == hops) ? (int)sock->hops : hops);
+			if (sent >= 0) {
+				pgm_mutex_unlock (&sock->send_mutex);
+				return sent;
+			}
+		}
+	}
+/* datagram order must match kernel timestamp numbering */
+	if (sock->tx_tstamp)
+		pgm_mutex_lock (&sock->tx_tstamp->mutex);
 	if (-1 != hops)
 		pgm_sockaddr_multicast_hops (send_sock, sock->send_gsr.gsr_group.ss_family, hops);
+	const int tos = net_ecn_tos (sock, use_router_alert, vector);
 
-	ssize_t sent = sendto (send_sock, buf, len, 0, to, (socklen_t)tolen);
+	if (sock->tx_tstamp)
+		pgm_tx_tstamp_prepare (sock->tx_tstamp, use_router_alert, vector[0].iov_base, skb);
+	ssize_t sent = net_sendtov (send_sock, vector, count, tos, to, (socklen_t)tolen);
 	pgm_debug ("sendto returned %" PRIzd, sent);
+	if (sent >= 0 && sock->tx_tstamp)
+		pgm_tx_tstamp_commit (sock->tx_tstamp, use_router_alert);
 	if (sent < 0) {
 		int save_errno = pgm_get_last_sock_error();
 		if (PGM_UNLIKELY(save_errno != PGM_SOCK_ENETUNREACH &&	/* Network is unreachable */
@@ -141,7 +443,11 @@ pgm_sendto_hops (
 #endif /* HAVE_POLL */
 			if (ready > 0)
 			{
-				sent = sendto (send_sock, buf, len, 0, to, (socklen_t)tolen);
+				if (sock->tx_tstamp)
+					pgm_tx_tstamp_prepare (sock->tx_tstamp, use_router_alert, vector[0].iov_base, skb);
+				sent = net_sendtov (send_sock, vector, count, tos, to, (socklen_t)tolen);
+				if (sent >= 0 && sock->tx_tstamp)
+					pgm_tx_tstamp_commit (sock->tx_tstamp, use_router_alert);
 				if ( sent < 0 )
 				{
 					char errbuf[1024];
@@ -172,6 +478,8 @@ pgm_sendto_hops (
 /* revert to default value hop limit */
 	if (-1 != hops)
 		pgm_sockaddr_multicast_hops (send_sock, sock->send_gsr.gsr_group.ss_family, sock->hops);
+	if (sock->tx_tstamp)
+		pgm_mutex_unlock (&sock->tx_tstamp->mutex);
 	if (!use_router_alert && sock->can_send_data)
 		pgm_mutex_unlock (&sock->send_mutex);
 	return sent;
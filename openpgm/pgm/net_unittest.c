@@ -43,14 +43,22 @@
 
 #ifndef _WIN32
 ssize_t mock_sendto (int, const void*, size_t, int, const struct sockaddr*, socklen_t);
+ssize_t mock_sendmsg (int, const struct msghdr*, int);
 #else
 int mock_sendto (SOCKET, const char*, int, int, const struct sockaddr*, int);
 int mock_select (int, fd_set*, fd_set*, fd_set*, struct timeval*);
 #endif
+#if defined( __linux__ ) && defined( MSG_WAITFORONE )
+int mock_sendmmsg (int, struct mmsghdr*, unsigned int, int);
+#endif
 
 
 #define pgm_rate_check		mock_pgm_rate_check
+#define pgm_rate_debit		mock_pgm_rate_debit
+#define pgm_sockaddr_tos	mock_pgm_sockaddr_tos
 #define sendto			mock_sendto
+#define sendmsg			mock_sendmsg
+#define sendmmsg		mock_sendmmsg
 #define poll			mock_poll
 #define select			mock_select
 #define fcntl			mock_fcntl
@@ -59,6 +67,15 @@ int mock_select (int, fd_set*, fd_set*, fd_set*, struct timeval*);
 #include "net.c"
 
 
+static int mock_tos[4];
+static unsigned mock_tos_len = 0;
+static int mock_cmsg_tos[4];
+static unsigned mock_cmsg_tos_len = 0;
+static unsigned mock_sendto_count = 0;
+static unsigned mock_debit_count = 0;
+static size_t mock_debit_size = 0;
+
+
 static
 pgm_sock_t*
 generate_sock (void)
@@ -67,6 +84,46 @@ generate_sock (void)
 	return sock;
 }
 
+/* sending socket with ECN enabled */
+static
+pgm_sock_t*
+generate_ecn_sock (void)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->family = AF_INET;
+	sock->tos = 0x10;
+	sock->use_ecn = TRUE;
+	sock->can_send_data = TRUE;
+	pgm_mutex_init (&sock->send_mutex);
+	mock_tos_len = mock_cmsg_tos_len = 0;
+	return sock;
+}
+
+/* unicast fan-out to three receivers on two hosts */
+static
+pgm_sock_t*
+generate_fanout_sock (void)
+{
+	static const char* receivers[] = { "172.12.90.1", "172.12.90.1", "172.12.90.2" };
+	pgm_sock_t* sock = generate_sock ();
+	sock->family = AF_INET;
+	((struct sockaddr_in*)&sock->send_gsr.gsr_group)->sin_family = AF_INET;
+	((struct sockaddr_in*)&sock->send_gsr.gsr_group)->sin_addr.s_addr = inet_addr ("239.192.0.1");
+	sock->destinations_alloc = G_N_ELEMENTS(receivers);
+	sock->destinations = g_malloc0 (sock->destinations_alloc * sizeof(struct sockaddr_storage));
+	for (unsigned i = 0; i < G_N_ELEMENTS(receivers); i++) {
+		struct sockaddr_in* dst = (struct sockaddr_in*)&sock->destinations[i];
+		dst->sin_family		= AF_INET;
+		dst->sin_port		= g_htons (7500 + i);
+		dst->sin_addr.s_addr	= inet_addr (receivers[i]);
+	}
+	sock->destinations_len = G_N_ELEMENTS(receivers);
+	pgm_mutex_init (&sock->destination_mutex);
+	mock_sendto_count = mock_debit_count = 0;
+	mock_debit_size = 0;
+	return sock;
+}
+
 static
 char*
 flags_string (
@@ -173,7 +230,82 @@ mock_pgm_rate_check (
 	return TRUE;
 }
 
+PGM_GNUC_INTERNAL
+void
+mock_pgm_rate_debit (
+	pgm_rate_t*		bucket,
+	const size_t		data_size
+	)
+{
+	g_debug ("mock_pgm_rate_debit (bucket:%p data-size:%" PRIzu ")",
+		(gpointer)bucket, data_size);
+	mock_debit_count++;
+	mock_debit_size += data_size;
+}
+
+PGM_GNUC_INTERNAL
+int
+mock_pgm_sockaddr_tos (
+	const SOCKET		s,
+	const sa_family_t	sa_family,
+	const int		tos
+	)
+{
+	g_debug ("mock_pgm_sockaddr_tos (s:%d sa-family:%d tos:0x%x)", (int)s, (int)sa_family, tos);
+	g_assert (mock_tos_len < G_N_ELEMENTS(mock_tos));
+	mock_tos[ mock_tos_len++ ] = tos;
+	return 0;
+}
+
 #ifndef _WIN32
+/* per-datagram type-of-service of a message, -1 if not present */
+static
+int
+msghdr_tos (
+	const struct msghdr*	msg
+	)
+{
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); NULL != cmsg; cmsg = CMSG_NXTHDR((struct msghdr*)msg, cmsg))
+	{
+		if (IPPROTO_IP == cmsg->cmsg_level && IP_TOS == cmsg->cmsg_type) {
+			int tos;
+			memcpy (&tos, CMSG_DATA(cmsg), sizeof (tos));
+			return tos;
+		}
+	}
+	return -1;
+}
+
+static
+void
+record_cmsg_tos (
+	const struct msghdr*	msg
+	)
+{
+	const int tos = msghdr_tos (msg);
+	if (-1 == tos)
+		return;
+	g_assert (mock_cmsg_tos_len < G_N_ELEMENTS(mock_cmsg_tos));
+	mock_cmsg_tos[ mock_cmsg_tos_len++ ] = tos;
+}
+
+ssize_t
+mock_sendmsg (
+	int			s,
+	const struct msghdr*	msg,
+	int			flags
+	)
+{
+	size_t len = 0;
+	for (size_t i = 0; i < msg->msg_iovlen; i++)
+		len += msg->msg_iov[i].iov_len;
+	g_debug ("mock_sendmsg (s:%i msg:%p len:%u flags:%s)",
+		s, (gconstpointer)msg, (unsigned)len, flags_string (flags));
+	record_cmsg_tos (msg);
+	mock_sendto_count++;
+	return len;
+}
+
 ssize_t
 mock_sendto (
 	int			s,
@@ -199,9 +331,33 @@ mock_sendto (
 	pgm_sockaddr_ntop (to, saddr, sizeof(saddr));
 	g_debug ("mock_sendto (s:%i buf:%p len:%u flags:%s to:%s tolen:%d)",
 		s, buf, (unsigned)len, flags_string (flags), saddr, tolen);
+	mock_sendto_count++;
 	return len;
 }
 
+#if defined( __linux__ ) && defined( MSG_WAITFORONE )
+int
+mock_sendmmsg (
+	int			s,
+	struct mmsghdr*		msgvec,
+	unsigned int		vlen,
+	int			flags
+	)
+{
+	g_debug ("mock_sendmmsg (s:%i msgvec:%p vlen:%u flags:%s)",
+		s, (gpointer)msgvec, vlen, flags_string (flags));
+	for (unsigned i = 0; i < vlen; i++) {
+		char saddr[INET6_ADDRSTRLEN];
+		pgm_sockaddr_ntop (msgvec[i].msg_hdr.msg_name, saddr, sizeof(saddr));
+		g_debug ("mock_sendmmsg [%u] to:%s port:%u", i, saddr,
+			(unsigned)g_ntohs (((struct sockaddr_in*)msgvec[i].msg_hdr.msg_name)->sin_port));
+		record_cmsg_tos (&msgvec[i].msg_hdr);
+	}
+	mock_sendto_count += vlen;
+	return vlen;
+}
+#endif
+
 #ifdef HAVE_POLL
 int
 mock_poll (
@@ -286,6 +442,61 @@ START_TEST (test_sendto_pass_001)
 }
 END_TEST
 
+/* original data keeps ECT(0) on the send socket */
+START_TEST (test_sendto_pass_002)
+{
+	pgm_sock_t* sock = generate_ecn_sock ();
+	struct pgm_header header;
+	memset (&header, 0, sizeof(header));
+	header.pgm_type = PGM_ODATA;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("239.192.0.1")
+	};
+	gssize len = pgm_sendto (sock, FALSE, NULL, FALSE, &header, sizeof(header), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (sizeof(header) == len, "sendto underrun");
+	fail_unless (0 == mock_tos_len, "tos changed");
+	fail_unless (0 == mock_cmsg_tos_len, "datagram tos set");
+}
+END_TEST
+
+/* anything else on the send socket is Not-ECT per datagram, socket left as is */
+START_TEST (test_sendto_pass_003)
+{
+	pgm_sock_t* sock = generate_ecn_sock ();
+	struct pgm_header header;
+	memset (&header, 0, sizeof(header));
+	header.pgm_type = PGM_ACK;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	gssize len = pgm_sendto (sock, FALSE, NULL, FALSE, &header, sizeof(header), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (sizeof(header) == len, "sendto underrun");
+	fail_unless (0 == mock_tos_len, "tos changed");
+	fail_unless (1 == mock_cmsg_tos_len, "datagram tos not set");
+	fail_unless (0x10 == mock_cmsg_tos[0], "ECN not cleared");
+}
+END_TEST
+
+/* router alert socket is never marked */
+START_TEST (test_sendto_pass_004)
+{
+	pgm_sock_t* sock = generate_ecn_sock ();
+	struct pgm_header header;
+	memset (&header, 0, sizeof(header));
+	header.pgm_type = PGM_NCF;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("239.192.0.1")
+	};
+	gssize len = pgm_sendto (sock, FALSE, NULL, TRUE, &header, sizeof(header), (struct sockaddr*)&addr, sizeof(addr));
+	fail_unless (sizeof(header) == len, "sendto underrun");
+	fail_unless (0 == mock_tos_len, "tos changed");
+	fail_unless (0 == mock_cmsg_tos_len, "datagram tos set");
+}
+END_TEST
+
 START_TEST (test_sendto_fail_001)
 {
 	const char* buf = "i am not a string";
@@ -350,6 +561,55 @@ START_TEST (test_sendto_fail_005)
 }
 END_TEST
 
+/* send group fan-out copies to every destination, charging the rate for each */
+START_TEST (test_sendto_pass_005)
+{
+	pgm_sock_t* sock = generate_fanout_sock ();
+	const char buf[] = "i am not a string";
+	gssize len = pgm_sendto (sock, TRUE, NULL, FALSE, buf, sizeof(buf), (struct sockaddr*)&sock->send_gsr.gsr_group, sizeof(struct sockaddr_in));
+	fail_unless (sizeof(buf) == len, "sendto underrun");
+	fail_unless (3 == mock_sendto_count, "copies sent");
+	fail_unless (2 == mock_debit_count, "rate debits");
+	fail_unless (2 * sizeof(buf) == mock_debit_size, "rate debit size");
+}
+END_TEST
+
+/* unregulated fan-out is not charged */
+START_TEST (test_sendto_pass_006)
+{
+	pgm_sock_t* sock = generate_fanout_sock ();
+	const char buf[] = "i am not a string";
+	gssize len = pgm_sendto (sock, FALSE, NULL, FALSE, buf, sizeof(buf), (struct sockaddr*)&sock->send_gsr.gsr_group, sizeof(struct sockaddr_in));
+	fail_unless (sizeof(buf) == len, "sendto underrun");
+	fail_unless (3 == mock_sendto_count, "copies sent");
+	fail_unless (0 == mock_debit_count, "rate debits");
+}
+END_TEST
+
+/* repairs fanned out on the send socket are Not-ECT per copy */
+#ifndef _WIN32
+START_TEST (test_sendto_pass_007)
+{
+	pgm_sock_t* sock = generate_fanout_sock ();
+	sock->tos = 0x10;
+	sock->use_ecn = TRUE;
+	sock->can_send_data = TRUE;
+	pgm_mutex_init (&sock->send_mutex);
+	mock_tos_len = mock_cmsg_tos_len = 0;
+	struct pgm_header header;
+	memset (&header, 0, sizeof(header));
+	header.pgm_type = PGM_RDATA;
+	gssize len = pgm_sendto (sock, FALSE, NULL, FALSE, &header, sizeof(header), (struct sockaddr*)&sock->send_gsr.gsr_group, sizeof(struct sockaddr_in));
+	fail_unless (sizeof(header) == len, "sendto underrun");
+	fail_unless (3 == mock_sendto_count, "copies sent");
+	fail_unless (0 == mock_tos_len, "tos changed");
+	fail_unless (3 == mock_cmsg_tos_len, "datagram tos not set");
+	for (unsigned i = 0; i < mock_cmsg_tos_len; i++)
+		fail_unless (0x10 == mock_cmsg_tos[i], "ECN not cleared");
+}
+END_TEST
+#endif
+
 /* target:
  * 	int
  * 	pgm_set_nonblocking (
@@ -384,6 +644,14 @@ make_test_suite (void)
 	TCase* tc_sendto = tcase_create ("sendto");
 	suite_add_tcase (s, tc_sendto);
 	tcase_add_test (tc_sendto, test_sendto_pass_001);
+	tcase_add_test (tc_sendto, test_sendto_pass_002);
+	tcase_add_test (tc_sendto, test_sendto_pass_003);
+	tcase_add_test (tc_sendto, test_sendto_pass_004);
+	tcase_add_test (tc_sendto, test_sendto_pass_005);
+	tcase_add_test (tc_sendto, test_sendto_pass_006);
+#ifndef _WIN32
+	tcase_add_test (tc_sendto, test_sendto_pass_007);
+#endif
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_sendto, test_sendto_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_sendto, test_sendto_fail_002, SIGABRT);
@@ -0,0 +1,229 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * NUMA node discovery, memory placement and processor affinity.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#	include <dirent.h>
+#	include <pthread.h>
+#	include <sched.h>
+#	include <unistd.h>
+#	include <net/if.h>
+#	if defined( __linux__ )
+#		include <sys/syscall.h>
+#	endif
+#endif
+#include <impl/framework.h>
+
+
+//#define NUMA_DEBUG
+
+/* Linux memory policy ABI, <numaif.h> is part of libnuma and not always present.
+ */
+#if defined( __linux__ ) && defined( SYS_mbind )
+#	ifndef MPOL_PREFERRED
+#		define MPOL_PREFERRED	1
+#	endif
+#	ifndef MPOL_MF_MOVE
+#		define MPOL_MF_MOVE	(1 << 1)
+#	endif
+#endif
+
+
+/* returns the NUMA node of the network device behind interface index ifindex,
+ * or PGM_NUMA_NODE_ANY if unknown, e.g. virtual devices or single node systems.
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_numa_node_of_ifindex (
+	const unsigned		ifindex
+	)
+{
+#if defined( __linux__ )
+	char ifname[IF_NAMESIZE];
+	char path[PATH_MAX];
+	FILE* fp;
+	int node = PGM_NUMA_NODE_ANY;
+
+	if (0 == ifindex || NULL == pgm_if_indextoname (ifindex, ifname))
+		return PGM_NUMA_NODE_ANY;
+	pgm_snprintf_s (path, sizeof (path), _TRUNCATE, "/sys/class/net/%s/device/numa_node", ifname);
+	fp = fopen (path, "r");
+	if (NULL == fp)
+		return PGM_NUMA_NODE_ANY;
+	if (1 != fscanf (fp, "%d", &node) || node < 0)
+		node = PGM_NUMA_NODE_ANY;
+	fclose (fp);
+	pgm_debug ("pgm_numa_node_of_ifindex (ifindex:%u) = %d", ifindex, node);
+	return node;
+#else
+/* unsupported */
+	(void)ifindex;
+	return PGM_NUMA_NODE_ANY;
+#endif
+}
+
+/* returns the NUMA node of the first processor in set, or PGM_NUMA_NODE_ANY.
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_numa_node_of_cpuset (
+	const struct pgm_cpuset_t*	cpuset
+	)
+{
+	pgm_return_val_if_fail (NULL != cpuset, PGM_NUMA_NODE_ANY);
+
+#if defined( __linux__ )
+	for (unsigned cpu = 0; cpu < PGM_CPU_SETSIZE; cpu++)
+	{
+		char path[PATH_MAX];
+		DIR* dir;
+		struct dirent* entry;
+		int node = PGM_NUMA_NODE_ANY;
+
+		if (!PGM_CPU_ISSET (cpu, cpuset))
+			continue;
+/* sysfs publishes a nodeN link per processor */
+		pgm_snprintf_s (path, sizeof (path), _TRUNCATE, "/sys/devices/system/cpu/cpu%u", cpu);
+		dir = opendir (path);
+		if (NULL == dir)
+			return PGM_NUMA_NODE_ANY;
+		while (NULL != (entry = readdir (dir))) {
+			if (0 == strncmp (entry->d_name, "node", strlen ("node")) &&
+			    isdigit ((unsigned char)entry->d_name[strlen ("node")]))
+			{
+				node = atoi (entry->d_name + strlen ("node"));
+				break;
+			}
+		}
+		closedir (dir);
+		return node;
+	}
+	return PGM_NUMA_NODE_ANY;
+#else
+	return PGM_NUMA_NODE_ANY;
+#endif
+}
+
+/* prefer placement of the pages wholly contained within [addr, addr+len) on
+ * NUMA node.  Partial pages at either end are shared with other allocations
+ * and left alone.  Pages already resident are migrated where possible.
+ *
+ * returns TRUE on success, returns FALSE if the policy could not be applied.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_numa_bind_memory (
+	void*			addr,
+	const size_t		len,
+	const int		node
+	)
+{
+	pgm_return_val_if_fail (NULL != addr, FALSE);
+	if (node < 0 || node >= PGM_NUMA_MAX_NODES)
+		return FALSE;
+
+#if defined( __linux__ ) && defined( SYS_mbind )
+	const uintptr_t page_size = (uintptr_t)sysconf (_SC_PAGESIZE);
+	const uintptr_t start = ((uintptr_t)addr + page_size - 1) & ~(page_size - 1);
+	const uintptr_t end   = ((uintptr_t)addr + len) & ~(page_size - 1);
+	unsigned long nodemask[PGM_NUMA_MAX_NODES / (8 * sizeof (unsigned long))];
+
+/* allocation smaller than one page */
+	if (end <= start)
+		return TRUE;
+
+	memset (nodemask, 0, sizeof (nodemask));
+	nodemask[node / (8 * sizeof (unsigned long))] |= 1UL << (node % (8 * sizeof (unsigned long)));
+	if (0 != syscall (SYS_mbind, (void*)start, (unsigned long)(end - start), MPOL_PREFERRED,
+			  nodemask, (unsigned long)PGM_NUMA_MAX_NODES + 1, MPOL_MF_MOVE))
+	{
+		char errbuf[1024];
+		pgm_trace (PGM_LOG_ROLE_MEMORY,_("mbind failed on node %d: %s"),
+			node, pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+		return FALSE;
+	}
+#	ifdef NUMA_DEBUG
+	pgm_debug ("pgm_numa_bind_memory (addr:%p len:%" PRIzu " node:%d) bound %lu pages",
+		addr, len, node, (unsigned long)((end - start) / page_size));
+#	endif
+	return TRUE;
+#else
+	(void)len;
+	return FALSE;
+#endif
+}
+
+/* pin the calling thread to the processors in cpuset.
+ *
+ * returns TRUE on success, returns FALSE if the platform does not support
+ * thread affinity or the set is invalid.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_numa_set_thread_affinity (
+	const struct pgm_cpuset_t*	cpuset
+	)
+{
+	pgm_return_val_if_fail (NULL != cpuset, FALSE);
+
+#if defined( CPU_SETSIZE ) && defined( __linux__ )
+	cpu_set_t cpu_set;
+	CPU_ZERO (&cpu_set);
+	for (unsigned cpu = 0; cpu < PGM_CPU_SETSIZE && cpu < CPU_SETSIZE; cpu++)
+		if (PGM_CPU_ISSET (cpu, cpuset))
+			CPU_SET (cpu, &cpu_set);
+	const int status = pthread_setaffinity_np (pthread_self(), sizeof (cpu_set), &cpu_set);
+	if (0 != status) {
+		char errbuf[1024];
+		pgm_warn (_("Setting thread affinity: %s"),
+			pgm_strerror_s (errbuf, sizeof (errbuf), status));
+		return FALSE;
+	}
+	return TRUE;
+#elif defined( _WIN32 )
+/* processor groups are not supported, only the first 64 processors */
+	DWORD_PTR mask = 0;
+	for (unsigned cpu = 0; cpu < 8 * sizeof (DWORD_PTR); cpu++)
+		if (PGM_CPU_ISSET (cpu, cpuset))
+			mask |= (DWORD_PTR)1 << cpu;
+	return (0 != SetThreadAffinityMask (GetCurrentThread(), mask));
+#else
+	return FALSE;
+#endif
+}
+
+/* eof */
@@ -0,0 +1,265 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for NUMA node discovery, memory placement and processor affinity.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#ifndef _WIN32
+#	include <sched.h>
+#	include <unistd.h>
+#endif
+#include <glib.h>
+#include <check.h>
+
+
+/* mock state */
+
+static char* mock_ifname = NULL;
+
+#define pgm_if_indextoname	mock_pgm_if_indextoname
+
+#define NUMA_DEBUG
+#include "numa.c"
+
+static
+void
+mock_setup (void)
+{
+	mock_ifname = NULL;
+}
+
+static
+void
+mock_teardown (void)
+{
+}
+
+PGM_GNUC_INTERNAL
+char*
+mock_pgm_if_indextoname (
+	unsigned int		ifindex,
+	char*			ifname
+	)
+{
+	(void)ifindex;
+	if (NULL == mock_ifname)
+		return NULL;
+	strcpy (ifname, mock_ifname);
+	return ifname;
+}
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+/* target:
+ *	int
+ *	pgm_numa_node_of_ifindex (
+ *		const unsigned		ifindex
+ *	)
+ */
+
+START_TEST (test_node_of_ifindex_pass_001)
+{
+/* loopback has no backing device */
+	mock_ifname = "lo";
+	fail_unless (PGM_NUMA_NODE_ANY == pgm_numa_node_of_ifindex (1), "node_of_ifindex failed");
+}
+END_TEST
+
+START_TEST (test_node_of_ifindex_fail_001)
+{
+	mock_ifname = "lo";
+	fail_unless (PGM_NUMA_NODE_ANY == pgm_numa_node_of_ifindex (0), "node_of_ifindex failed");
+}
+END_TEST
+
+/* unknown interface index */
+START_TEST (test_node_of_ifindex_fail_002)
+{
+	fail_unless (PGM_NUMA_NODE_ANY == pgm_numa_node_of_ifindex (1), "node_of_ifindex failed");
+}
+END_TEST
+
+/* target:
+ *	int
+ *	pgm_numa_node_of_cpuset (
+ *		const struct pgm_cpuset_t*	cpuset
+ *	)
+ */
+
+START_TEST (test_node_of_cpuset_pass_001)
+{
+	struct pgm_cpuset_t cpuset;
+	PGM_CPU_ZERO (&cpuset);
+	PGM_CPU_SET (0, &cpuset);
+	const int node = pgm_numa_node_of_cpuset (&cpuset);
+	fail_unless (PGM_NUMA_NODE_ANY == node || (node >= 0 && node < PGM_NUMA_MAX_NODES), "node_of_cpuset failed");
+}
+END_TEST
+
+/* empty set */
+START_TEST (test_node_of_cpuset_pass_002)
+{
+	struct pgm_cpuset_t cpuset;
+	PGM_CPU_ZERO (&cpuset);
+	fail_unless (PGM_NUMA_NODE_ANY == pgm_numa_node_of_cpuset (&cpuset), "node_of_cpuset failed");
+}
+END_TEST
+
+START_TEST (test_node_of_cpuset_fail_001)
+{
+	fail_unless (PGM_NUMA_NODE_ANY == pgm_numa_node_of_cpuset (NULL), "node_of_cpuset failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_numa_bind_memory (
+ *		void*		addr,
+ *		const size_t	len,
+ *		const int	node
+ *	)
+ */
+
+/* allocation smaller than one page is left alone */
+START_TEST (test_bind_memory_pass_001)
+{
+	char buf[64];
+#if defined( __linux__ ) && defined( SYS_mbind )
+	fail_unless (TRUE == pgm_numa_bind_memory (buf, sizeof (buf), 0), "bind_memory failed");
+#else
+	fail_unless (FALSE == pgm_numa_bind_memory (buf, sizeof (buf), 0), "bind_memory failed");
+#endif
+}
+END_TEST
+
+START_TEST (test_bind_memory_fail_001)
+{
+	fail_unless (FALSE == pgm_numa_bind_memory (NULL, 4096, 0), "bind_memory failed");
+}
+END_TEST
+
+/* node out of range */
+START_TEST (test_bind_memory_fail_002)
+{
+	char buf[64];
+	fail_unless (FALSE == pgm_numa_bind_memory (buf, sizeof (buf), -1), "bind_memory failed");
+	fail_unless (FALSE == pgm_numa_bind_memory (buf, sizeof (buf), PGM_NUMA_MAX_NODES), "bind_memory failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_numa_set_thread_affinity (
+ *		const struct pgm_cpuset_t*	cpuset
+ *	)
+ */
+
+/* pin to the first processor currently permitted and read it back */
+START_TEST (test_set_thread_affinity_pass_001)
+{
+#if defined( CPU_SETSIZE ) && defined( __linux__ )
+	struct pgm_cpuset_t cpuset;
+	cpu_set_t cpu_set;
+	int cpu;
+	fail_unless (0 == sched_getaffinity (0, sizeof (cpu_set), &cpu_set), "sched_getaffinity failed");
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET (cpu, &cpu_set))
+			break;
+	fail_unless (cpu < CPU_SETSIZE, "no permitted processor");
+	PGM_CPU_ZERO (&cpuset);
+	PGM_CPU_SET (cpu, &cpuset);
+	fail_unless (TRUE == pgm_numa_set_thread_affinity (&cpuset), "set_thread_affinity failed");
+	fail_unless (0 == sched_getaffinity (0, sizeof (cpu_set), &cpu_set), "sched_getaffinity failed");
+	fail_unless (1 == CPU_COUNT (&cpu_set), "affinity not applied");
+	fail_unless (CPU_ISSET (cpu, &cpu_set), "affinity not applied");
+#endif
+}
+END_TEST
+
+START_TEST (test_set_thread_affinity_fail_001)
+{
+	fail_unless (FALSE == pgm_numa_set_thread_affinity (NULL), "set_thread_affinity failed");
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_node_of_ifindex = tcase_create ("node-of-ifindex");
+	suite_add_tcase (s, tc_node_of_ifindex);
+	tcase_add_checked_fixture (tc_node_of_ifindex, mock_setup, mock_teardown);
+	tcase_add_test (tc_node_of_ifindex, test_node_of_ifindex_pass_001);
+	tcase_add_test (tc_node_of_ifindex, test_node_of_ifindex_fail_001);
+	tcase_add_test (tc_node_of_ifindex, test_node_of_ifindex_fail_002);
+
+	TCase* tc_node_of_cpuset = tcase_create ("node-of-cpuset");
+	suite_add_tcase (s, tc_node_of_cpuset);
+	tcase_add_checked_fixture (tc_node_of_cpuset, mock_setup, mock_teardown);
+	tcase_add_test (tc_node_of_cpuset, test_node_of_cpuset_pass_001);
+	tcase_add_test (tc_node_of_cpuset, test_node_of_cpuset_pass_002);
+	tcase_add_test (tc_node_of_cpuset, test_node_of_cpuset_fail_001);
+
+	TCase* tc_bind_memory = tcase_create ("bind-memory");
+	suite_add_tcase (s, tc_bind_memory);
+	tcase_add_checked_fixture (tc_bind_memory, mock_setup, mock_teardown);
+	tcase_add_test (tc_bind_memory, test_bind_memory_pass_001);
+	tcase_add_test (tc_bind_memory, test_bind_memory_fail_001);
+	tcase_add_test (tc_bind_memory, test_bind_memory_fail_002);
+
+	TCase* tc_set_thread_affinity = tcase_create ("set-thread-affinity");
+	suite_add_tcase (s, tc_set_thread_affinity);
+	tcase_add_checked_fixture (tc_set_thread_affinity, mock_setup, mock_teardown);
+	tcase_add_test (tc_set_thread_affinity, test_set_thread_affinity_pass_001);
+	tcase_add_test (tc_set_thread_affinity, test_set_thread_affinity_fail_001);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
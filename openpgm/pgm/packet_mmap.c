@@ -0,0 +1,411 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * TPACKET_V3 memory-mapped receive ring replacing recvmsg() on the raw PGM
+ * socket, frames are parsed in the ring and blocks returned to the kernel
+ * once every frame has been consumed.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#	include <sys/mman.h>
+#	include <sys/socket.h>
+#	if defined( __linux__ )
+#		include <linux/filter.h>
+#		include <linux/if_ether.h>
+#		include <linux/if_packet.h>
+#	endif
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+
+
+//#define PACKET_MMAP_DEBUG
+
+#if defined( TPACKET3_HDRLEN ) && defined( PACKET_FANOUT_HASH )
+#	define USE_PACKET_MMAP
+#endif
+
+#ifdef USE_PACKET_MMAP
+/* classic BPF jump offsets are 8 bits */
+#define PGM_PACKET_MMAP_MAX_FILTER_GROUPS	240
+#endif
+
+
+/* attach socket filter accepting IPv4 PGM, unfragmented, to any unicast
+ * address or to a joined group.  AF_PACKET sees every frame on the link
+ * whereas the raw socket relied on the IP layer to discard other groups.
+ *
+ * returns TRUE on success, FALSE on failure.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_packet_mmap_set_filter (
+	pgm_sock_t* const	sock
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->packet_mmap);
+
+#ifdef USE_PACKET_MMAP
+	struct sock_filter code[ 10 + PGM_PACKET_MMAP_MAX_FILTER_GROUPS ];
+	struct sock_fprog prog;
+	unsigned n_groups = 0, pc = 0;
+	uint32_t groups[ PGM_PACKET_MMAP_MAX_FILTER_GROUPS ];
+	struct sockaddr_storage joined[ PGM_PACKET_MMAP_MAX_FILTER_GROUPS ];
+	const unsigned n_joined = pgm_membership_groups (sock, joined, PGM_N_ELEMENTS(joined));
+/* too many groups to test inline, pass all multicast as the raw socket would */
+	const bool is_any_group = (n_joined > PGM_N_ELEMENTS(joined));
+
+	for (unsigned i = 0; i < n_joined && !is_any_group; i++)
+	{
+		const struct sockaddr_in* sin = (const struct sockaddr_in*)&joined[ i ];
+		if (AF_INET != sin->sin_family)
+			continue;
+		groups[ n_groups++ ] = ntohl (sin->sin_addr.s_addr);
+	}
+
+/* ldh proto; jeq #ETH_P_IP, required when bound to ETH_P_ALL */
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL);
+	code[ pc++ ] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 6 + n_groups);
+/* ldb [9]; jeq #113 */
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, offsetof(struct pgm_ip, ip_p));
+	code[ pc++ ] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_PGM, 0, 4 + n_groups);
+/* ldh [6]; jset #MF|offset, fragments cannot be parsed */
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, offsetof(struct pgm_ip, ip_off));
+	code[ pc++ ] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3fff, 2 + n_groups, 0);
+/* ld [16]; unicast passes, multicast must match a group */
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, offsetof(struct pgm_ip, ip_dst));
+	code[ pc++ ] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0xe0000000, is_any_group ? 1 : 0, 1 + n_groups);
+	for (unsigned i = 0; i < n_groups; i++)
+		code[ pc++ ] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, groups[ i ], n_groups - i, 0);
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+	code[ pc++ ] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffff);
+
+	prog.len    = pc;
+	prog.filter = code;
+	if (SOCKET_ERROR == setsockopt (sock->recv_sock, SOL_SOCKET, SO_ATTACH_FILTER, (const char*)&prog, sizeof(prog))) {
+		char errbuf[1024];
+		pgm_warn (_("Attaching packet ring filter failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+	return TRUE;
+#else
+	return FALSE;
+#endif /* USE_PACKET_MMAP */
+}
+
+/* bind the packet socket to the receive interface.  outgoing frames are only
+ * tapped to ETH_P_ALL handlers and unicast between local peers crosses the
+ * loopback device, so multicast loop needs the wider binding on all interfaces
+ * and relies upon the filter to discard other protocols.
+ *
+ * returns TRUE on success, FALSE on failure.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_packet_mmap_bind (
+	pgm_sock_t* const	sock
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->packet_mmap);
+
+#ifdef USE_PACKET_MMAP
+	struct sockaddr_ll sll;
+
+	memset (&sll, 0, sizeof(sll));
+	sll.sll_family		= AF_PACKET;
+	sll.sll_protocol	= htons (sock->use_multicast_loop ? ETH_P_ALL : ETH_P_IP);
+	sll.sll_ifindex		= sock->use_multicast_loop ? 0 : (int)sock->recv_gsr[ 0 ].gsr_interface;
+	if (SOCKET_ERROR == bind (sock->recv_sock, (const struct sockaddr*)&sll, sizeof(sll))) {
+		char errbuf[1024];
+		pgm_warn (_("Binding packet socket failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+	return TRUE;
+#else
+	return FALSE;
+#endif /* USE_PACKET_MMAP */
+}
+
+/* replace receive path of a raw IPv4 socket with an AF_PACKET TPACKET_V3 ring.
+ * the original raw socket is retained for multicast membership and filtered
+ * to discard everything, sock::recv_sock becomes the packet socket so event
+ * handling is unchanged.
+ *
+ * returns TRUE on success, FALSE if unsupported or on failure.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_packet_mmap_create (
+	pgm_sock_t*			   const restrict sock,
+	const struct pgm_packet_mmapinfo_t* const restrict info
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != info);
+	pgm_assert (NULL == sock->packet_mmap);
+
+#ifdef USE_PACKET_MMAP
+	pgm_packet_mmap_t* packet_mmap;
+	struct tpacket_req3 req;
+	struct sock_filter drop = BPF_STMT(BPF_RET | BPF_K, 0);
+	struct sock_fprog drop_prog = { .len = 1, .filter = &drop };
+	const int version = TPACKET_V3;
+	char errbuf[1024];
+	SOCKET fd;
+
+	if (sock->udp_encap_ucast_port || AF_INET != sock->family) {
+		pgm_warn (_("Packet ring requires raw IPv4 sockets."));
+		return FALSE;
+	}
+
+	memset (&req, 0, sizeof(req));
+	req.tp_block_size	= info->pm_block_size ? info->pm_block_size : PGM_PACKET_MMAP_BLOCK_SIZE;
+	req.tp_block_nr		= info->pm_block_nr ? info->pm_block_nr : PGM_PACKET_MMAP_BLOCK_NR;
+	req.tp_frame_size	= TPACKET_ALIGN(TPACKET3_HDRLEN + sock->max_tpdu);
+	req.tp_frame_nr		= (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+	req.tp_retire_blk_tov	= info->pm_block_tov ? info->pm_block_tov : PGM_PACKET_MMAP_BLOCK_TOV;
+
+	if (INVALID_SOCKET == (fd = socket (AF_PACKET, SOCK_DGRAM, 0))) {
+		pgm_warn (_("Creating packet socket failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+	if (SOCKET_ERROR == setsockopt (fd, SOL_PACKET, PACKET_VERSION, (const char*)&version, sizeof(version)) ||
+	    SOCKET_ERROR == setsockopt (fd, SOL_PACKET, PACKET_RX_RING, (const char*)&req, sizeof(req)))
+	{
+		pgm_warn (_("Configuring TPACKET_V3 ring failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		closesocket (fd);
+		return FALSE;
+	}
+
+	packet_mmap = pgm_new0 (pgm_packet_mmap_t, 1);
+	packet_mmap->block_size	= req.tp_block_size;
+	packet_mmap->block_nr	= req.tp_block_nr;
+	packet_mmap->map_len	= (size_t)req.tp_block_size * req.tp_block_nr;
+	packet_mmap->map	= mmap (NULL, packet_mmap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+	if (MAP_FAILED == packet_mmap->map)
+		packet_mmap->map = mmap (NULL, packet_mmap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == packet_mmap->map) {
+		pgm_warn (_("Mapping packet ring failed: %s"), strerror (errno));
+		pgm_free (packet_mmap);
+		closesocket (fd);
+		return FALSE;
+	}
+
+/* swap so polling and PGM_RECV_SOCK follow the ring */
+	packet_mmap->ip_sock	= sock->recv_sock;
+	sock->recv_sock		= fd;
+	sock->packet_mmap	= packet_mmap;
+	if (!pgm_packet_mmap_set_filter (sock))
+		goto err_destroy;
+
+/* bind after the filter so no unfiltered frame reaches the ring */
+	if (!pgm_packet_mmap_bind (sock))
+		goto err_destroy;
+	if (0 != info->pm_fanout_group) {
+		const int fanout = info->pm_fanout_group | (PACKET_FANOUT_HASH << 16);
+		if (SOCKET_ERROR == setsockopt (fd, SOL_PACKET, PACKET_FANOUT, (const char*)&fanout, sizeof(fanout))) {
+			pgm_warn (_("Joining packet fanout group %u failed: %s"),
+				  (unsigned)info->pm_fanout_group,
+				  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+			goto err_destroy;
+		}
+	}
+	pgm_sockaddr_nonblocking (fd, TRUE);
+
+/* raw socket now only holds memberships */
+	if (SOCKET_ERROR == setsockopt (packet_mmap->ip_sock, SOL_SOCKET, SO_ATTACH_FILTER, (const char*)&drop_prog, sizeof(drop_prog)))
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Raw socket drop filter failed, packets will be received twice by the kernel."));
+
+	pgm_trace (PGM_LOG_ROLE_NETWORK,_("Receiving through TPACKET_V3 ring of %u blocks of %u bytes."),
+		   packet_mmap->block_nr, packet_mmap->block_size);
+	return TRUE;
+
+err_destroy:
+	munmap (packet_mmap->map, packet_mmap->map_len);
+	closesocket (fd);
+	sock->recv_sock		= packet_mmap->ip_sock;
+	sock->packet_mmap	= NULL;
+	pgm_free (packet_mmap);
+	return FALSE;
+#else
+	pgm_warn (_("Packet ring not supported on this platform."));
+	return FALSE;
+#endif /* USE_PACKET_MMAP */
+}
+
+/* release the ring and the membership socket, sock::recv_sock is the packet
+ * socket and closed with the other transport sockets.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_packet_mmap_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_packet_mmap_t* packet_mmap;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	packet_mmap = sock->packet_mmap;
+	if (NULL == packet_mmap)
+		return;
+	sock->packet_mmap = NULL;
+#ifdef USE_PACKET_MMAP
+	munmap (packet_mmap->map, packet_mmap->map_len);
+#endif
+	closesocket (packet_mmap->ip_sock);
+	pgm_free (packet_mmap);
+}
+
+/* next PGM packet from the ring.  ODATA and RDATA are copied into
+ * sock::rx_buffer as the receive window keeps them, other packets are
+ * presented in place in the ring.  the block is handed back to the kernel on
+ * the call after its last frame.
+ *
+ * on success returns packet length and sets skb, returns -1 with EAGAIN when
+ * the ring is empty.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_packet_mmap_recv (
+	pgm_sock_t*	       const restrict sock,
+	struct pgm_sk_buff_t**	     restrict pskb,
+	struct sockaddr*	     restrict src_addr,
+	const socklen_t			      src_addrlen
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->packet_mmap);
+	pgm_assert (NULL != pskb);
+	pgm_assert (NULL != src_addr);
+	pgm_assert (src_addrlen >= sizeof(struct sockaddr_in));
+
+#ifdef USE_PACKET_MMAP
+	pgm_packet_mmap_t* packet_mmap = sock->packet_mmap;
+
+	for (;;)
+	{
+		struct tpacket_block_desc* block = packet_mmap->block;
+		if (NULL == block)
+		{
+			block = (struct tpacket_block_desc*)(packet_mmap->map + (size_t)packet_mmap->block_idx * packet_mmap->block_size);
+			if (!(*(volatile uint32_t*)&block->hdr.bh1.block_status & TP_STATUS_USER)) {
+				pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+				return SOCKET_ERROR;
+			}
+			__sync_synchronize();
+			packet_mmap->block	 = block;
+			packet_mmap->frames_left = block->hdr.bh1.num_pkts;
+			packet_mmap->frame	 = (char*)block + block->hdr.bh1.offset_to_first_pkt;
+		}
+		if (0 == packet_mmap->frames_left)
+		{
+/* window insertion complete, return ownership */
+			__sync_synchronize();
+			block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+			packet_mmap->block	= NULL;
+			packet_mmap->block_idx	= (packet_mmap->block_idx + 1) % packet_mmap->block_nr;
+			continue;
+		}
+
+		const struct tpacket3_hdr* hdr = (const struct tpacket3_hdr*)packet_mmap->frame;
+		const struct sockaddr_ll* sll = (const struct sockaddr_ll*)((const char*)hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+		char* packet = (char*)hdr + hdr->tp_net;
+		const unsigned len = hdr->tp_snaplen;
+		packet_mmap->frame += hdr->tp_next_offset;
+		packet_mmap->frames_left--;
+
+		if (PACKET_OTHERHOST == sll->sll_pkttype)
+			continue;
+		if (PGM_UNLIKELY(len < sizeof(struct pgm_ip) || len > sock->max_tpdu))
+			continue;
+
+		const struct pgm_ip* ip = (const struct pgm_ip*)packet;
+/* packet sockets never see PACKET_LOOPBACK, local multicast senders are only
+ * visible as outgoing frames so accept those in place of IP_MULTICAST_LOOP.
+ */
+		if (PACKET_OUTGOING == sll->sll_pkttype &&
+		    (!sock->use_multicast_loop || !IN_MULTICAST(ntohl (ip->ip_dst.s_addr))))
+			continue;
+		const size_t ip_header_length = ip->ip_hl * 4;
+		struct pgm_sk_buff_t* skb;
+		if (ip_header_length + sizeof(struct pgm_header) <= len &&
+		    (PGM_ODATA == ((const struct pgm_header*)(packet + ip_header_length))->pgm_type ||
+		     PGM_RDATA == ((const struct pgm_header*)(packet + ip_header_length))->pgm_type))
+		{
+			skb = sock->rx_buffer;
+			memcpy (skb->head, packet, len);
+		}
+		else
+		{
+			skb = &packet_mmap->skb;
+			skb->head = packet;
+			skb->end  = packet + len;
+		}
+
+		struct sockaddr_in* sin = (struct sockaddr_in*)src_addr;
+		memset (sin, 0, sizeof(struct sockaddr_in));
+		sin->sin_family		= AF_INET;
+		sin->sin_addr.s_addr	= ip->ip_src.s_addr;
+
+		skb->sock		= sock;
+		skb->tstamp		= pgm_time_update_now();
+		skb->data		= skb->head;
+		skb->len		= (uint16_t)len;
+		skb->zero_padded	= 0;
+		skb->is_ce		= sock->use_ecn && (PGM_ECN_CE == (ip->ip_tos & PGM_ECN_MASK));
+		skb->tail		= (char*)skb->data + len;
+#ifdef PACKET_MMAP_DEBUG
+		pgm_debug ("ring block %u frame len %u%s",
+			   packet_mmap->block_idx, len, (skb == sock->rx_buffer) ? " copied" : "");
+#endif
+		*pskb = skb;
+		return (ssize_t)len;
+	}
+#else
+	(void)pskb;
+	(void)src_addr;
+	(void)src_addrlen;
+	pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+	return SOCKET_ERROR;
+#endif /* USE_PACKET_MMAP */
+}
+
+/* eof */
@@ -1003,6 +1003,14 @@ pgm_print_options (
 			printf ("OPT_PGMCC_FEEDBACK ");
 			break;
 
+		case PGM_OPT_ECN:
+			printf ("OPT_ECN ");
+			break;
+
+		case PGM_OPT_TRANSFORM:
+			printf ("OPT_TRANSFORM ");
+			break;
+
 		case PGM_OPT_NAK_BO_IVL:
 			printf ("OPT_NAK_BO_IVL ");
 			break;
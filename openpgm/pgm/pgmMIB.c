@@ -647,10 +647,9 @@ pgmSourceConfigTable_handler (
 				}
 				break;
 
-/* FIXED: pgmSourceLateJoin = disable(2) */
 			case COLUMN_PGMSOURCELATEJOIN:
 				{
-					const unsigned late_join = PGMSOURCELATEJOIN_DISABLE;
+					const unsigned late_join = sock->late_join_sqns ? PGMSOURCELATEJOIN_ENABLE : PGMSOURCELATEJOIN_DISABLE;
 					snmp_set_var_typed_value (var, ASN_INTEGER,
 								  (const u_char*)&late_join, sizeof(late_join) );
 				}
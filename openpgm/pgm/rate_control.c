@@ -24,6 +24,8 @@
 #endif
 #include <impl/framework.h>
 
+static void _pgm_rate_share_debit (pgm_rate_share_t*, const size_t);
+
 
 /* create machinery for rate regulation.
  * the rate_per_sec is ammortized over millisecond time periods.
@@ -57,6 +59,36 @@ pgm_rate_create (
 	pgm_spinlock_init (&bucket->spinlock);
 }
 
+/* re-tune an active bucket to a new rate, as driven by congestion control.
+ * accumulated credit is clamped to the new bucket depth.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rate_set (
+	pgm_rate_t*		bucket,
+	const ssize_t		rate_per_sec,
+	const uint16_t		max_tpdu
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != bucket);
+	pgm_assert (rate_per_sec >= max_tpdu);
+
+	pgm_spinlock_lock (&bucket->spinlock);
+	bucket->rate_per_sec	= rate_per_sec;
+	if ((rate_per_sec / 1000) >= max_tpdu) {
+		bucket->rate_per_msec	= bucket->rate_per_sec / 1000;
+		if (bucket->rate_limit > bucket->rate_per_msec)
+			bucket->rate_limit = bucket->rate_per_msec;
+	} else {
+		bucket->rate_per_msec	= 0;
+		if (bucket->rate_limit > bucket->rate_per_sec)
+			bucket->rate_limit = bucket->rate_per_sec;
+	}
+	pgm_spinlock_unlock (&bucket->spinlock);
+}
+
 PGM_GNUC_INTERNAL
 void
 pgm_rate_destroy (
@@ -84,7 +116,7 @@ pgm_rate_check2 (
 	const bool		is_nonblocking
 	)
 {
-	int64_t new_major_limit, new_minor_limit;
+	int64_t new_major_limit = 0, new_minor_limit = 0;
 	pgm_time_t now;
 
 /* pre-conditions */
@@ -92,7 +124,7 @@ pgm_rate_check2 (
 	pgm_assert (NULL != minor_bucket);
 	pgm_assert (data_size > 0);
 
-	if (0 == major_bucket->rate_per_sec && 0 == minor_bucket->rate_per_sec)
+	if (0 == major_bucket->rate_per_sec && 0 == minor_bucket->rate_per_sec && NULL == minor_bucket->share)
 		return TRUE;
 
 	if (0 != major_bucket->rate_per_sec)
@@ -177,7 +209,20 @@ pgm_rate_check2 (
 				pgm_spinlock_unlock (&major_bucket->spinlock);
 			return FALSE;
 		}
+	}
+
+/* shared parent last so that a refusal leaves the socket buckets untouched */
+	if (is_nonblocking &&
+	    NULL != minor_bucket->share &&
+	    !pgm_rate_share_check (minor_bucket->share, data_size, TRUE))
+	{
+		if (0 != major_bucket->rate_per_sec)
+			pgm_spinlock_unlock (&major_bucket->spinlock);
+		return FALSE;
+	}
 
+	if (0 != minor_bucket->rate_per_sec)
+	{
 /* commit new rate limit */
 		minor_bucket->rate_limit = new_minor_limit;
 		minor_bucket->last_rate_check = now;
@@ -189,6 +234,10 @@ pgm_rate_check2 (
 		pgm_spinlock_unlock (&major_bucket->spinlock);
 	}
 
+/* wait on shared parent outside of lock */
+	if (!is_nonblocking && NULL != minor_bucket->share)
+		pgm_rate_share_check (minor_bucket->share, data_size, FALSE);
+
 /* sleep on minor bucket outside of lock */
 	if (minor_bucket->rate_limit < 0) {
 		ssize_t sleep_amount;
@@ -285,7 +334,7 @@ pgm_rate_remaining2 (
 	pgm_assert (NULL != minor_bucket);
 
 	if (PGM_UNLIKELY(0 == major_bucket->rate_per_sec && 0 == minor_bucket->rate_per_sec))
-		return remaining;
+		return (NULL != minor_bucket->share) ? pgm_rate_share_remaining (minor_bucket->share, n) : remaining;
 
 	if (0 != major_bucket->rate_per_sec)
 	{
@@ -321,6 +370,12 @@ pgm_rate_remaining2 (
 		pgm_spinlock_unlock (&major_bucket->spinlock);
 	}
 
+	if (NULL != minor_bucket->share)
+	{
+		const pgm_time_t share_remaining = pgm_rate_share_remaining (minor_bucket->share, n);
+		remaining = MAX(remaining, share_remaining);
+	}
+
 	return remaining;
 }
 
@@ -352,4 +407,331 @@ pgm_rate_remaining (
 	return remaining;
 }
 
+/* credit available in a bucket at time now, capped at the bucket depth.
+ */
+
+static inline
+int64_t
+_pgm_rate_refill (
+	const pgm_rate_t*	bucket,
+	const pgm_time_t	now
+	)
+{
+	const pgm_time_t time_since_last_rate_check = now - bucket->last_rate_check;
+	int64_t new_limit;
+
+	if (bucket->rate_per_msec)
+	{
+		if (time_since_last_rate_check > pgm_msecs(1))
+			return bucket->rate_per_msec;
+		new_limit = bucket->rate_limit + ((bucket->rate_per_msec * time_since_last_rate_check) / 1000UL);
+		return MIN(new_limit, bucket->rate_per_msec);
+	}
+	if (time_since_last_rate_check > pgm_secs(1))
+		return bucket->rate_per_sec;
+	new_limit = bucket->rate_limit + ((bucket->rate_per_sec * time_since_last_rate_check) / 1000000UL);
+	return MIN(new_limit, bucket->rate_per_sec);
+}
+
+/* charge data_size bytes that have already been sent without waiting, the
+ * bucket and any rate group share may go negative so that the next rate
+ * check pays back the debt.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rate_debit (
+	pgm_rate_t*		bucket,
+	const size_t		data_size
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != bucket);
+
+	if (0 != bucket->rate_per_sec)
+	{
+		pgm_spinlock_lock (&bucket->spinlock);
+		const pgm_time_t now = pgm_time_update_now();
+		bucket->rate_limit = (ssize_t)(_pgm_rate_refill (bucket, now) - (int64_t)( bucket->iphdr_len + data_size ));
+		bucket->last_rate_check = now;
+		pgm_spinlock_unlock (&bucket->spinlock);
+	}
+	if (NULL != bucket->share)
+		_pgm_rate_share_debit (bucket->share, data_size);
+}
+
+/* create a rate group of rate_per_sec bytes per second shared by all attached
+ * sockets, rdata_share percent of which is reserved for repair data.
+ *
+ * returns NULL on invalid parameters.
+ */
+
+pgm_rate_group_t*
+pgm_rate_group_new (
+	const ssize_t		rate_per_sec,
+	const unsigned		rdata_share
+	)
+{
+	pgm_rate_group_t* group;
+
+	pgm_return_val_if_fail (rate_per_sec > 0, NULL);
+	pgm_return_val_if_fail (rdata_share <= 100, NULL);
+
+	group = pgm_new0 (pgm_rate_group_t, 1);
+/* bucket depth is re-tuned once the largest attached TPDU is known */
+	pgm_rate_create (&group->bucket, rate_per_sec, 0, 0);
+	group->rdata_share = rdata_share;
+	group->ref_count = 1;
+	pgm_mutex_init (&group->mutex);
+	return group;
+}
+
+PGM_GNUC_INTERNAL
+pgm_rate_group_t*
+pgm_rate_group_ref (
+	pgm_rate_group_t*	group
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != group);
+
+	pgm_atomic_inc32 (&group->ref_count);
+	return group;
+}
+
+void
+pgm_rate_group_unref (
+	pgm_rate_group_t*	group
+	)
+{
+	pgm_return_if_fail (NULL != group);
+
+	if (pgm_atomic_exchange_and_add32 (&group->ref_count, (uint32_t)-1) != 1)
+		return;
+
+	pgm_assert (NULL == group->shares);
+	pgm_mutex_free (&group->mutex);
+	pgm_rate_destroy (&group->bucket);
+	pgm_free (group);
+}
+
+/* distribute the group rate to attached shares: each traffic class pool is
+ * divided by weight into guaranteed rates, idle capacity remains borrowable.
+ *
+ * called with group mutex held.
+ */
+
+static
+void
+_pgm_rate_group_rebalance (
+	pgm_rate_group_t*	group
+	)
+{
+	const ssize_t rdata_rate = (group->bucket.rate_per_sec * group->rdata_share) / 100;
+	const ssize_t odata_rate = group->bucket.rate_per_sec - rdata_rate;
+
+	for (pgm_list_t* list = group->shares; NULL != list; list = list->next)
+	{
+		pgm_rate_share_t* share = list->data;
+		const ssize_t pool = share->is_rdata ? rdata_rate : odata_rate;
+		const uint32_t total_weight = share->is_rdata ? group->rdata_weight : group->odata_weight;
+		const ssize_t rate = (ssize_t)(((int64_t)pool * share->weight) / total_weight);
+		pgm_rate_set (&share->assured, MAX(rate, (ssize_t)share->max_tpdu), share->max_tpdu);
+	}
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_rate_share_attach (
+	pgm_rate_group_t* const restrict group,
+	pgm_rate_share_t* const restrict share,
+	const bool			 is_rdata,
+	const uint32_t			 weight,
+	const size_t			 iphdr_len,
+	const uint16_t			 max_tpdu
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != group);
+	pgm_assert (NULL != share);
+	pgm_assert (weight > 0);
+	pgm_assert (group->bucket.rate_per_sec >= max_tpdu);
+
+	pgm_rate_create (&share->assured, max_tpdu, iphdr_len, max_tpdu);
+	share->group	= group;
+	share->weight	= weight;
+	share->max_tpdu	= max_tpdu;
+	share->is_rdata	= is_rdata;
+	share->link.data = share;
+
+	pgm_mutex_lock (&group->mutex);
+	group->shares = pgm_list_prepend_link (group->shares, &share->link);
+	if (is_rdata)
+		group->rdata_weight += weight;
+	else
+		group->odata_weight += weight;
+	if (max_tpdu > group->max_tpdu) {
+		group->max_tpdu = max_tpdu;
+		pgm_rate_set (&group->bucket, group->bucket.rate_per_sec, max_tpdu);
+	}
+	group->bucket.iphdr_len = MAX(group->bucket.iphdr_len, iphdr_len);
+	_pgm_rate_group_rebalance (group);
+	pgm_mutex_unlock (&group->mutex);
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_rate_share_detach (
+	pgm_rate_share_t*	share
+	)
+{
+	pgm_rate_group_t* group;
+
+/* pre-conditions */
+	pgm_assert (NULL != share);
+	pgm_assert (NULL != share->group);
+
+	group = share->group;
+	pgm_mutex_lock (&group->mutex);
+	group->shares = pgm_list_remove_link (group->shares, &share->link);
+	if (share->is_rdata)
+		group->rdata_weight -= share->weight;
+	else
+		group->odata_weight -= share->weight;
+	_pgm_rate_group_rebalance (group);
+	pgm_mutex_unlock (&group->mutex);
+	pgm_rate_destroy (&share->assured);
+	share->group = NULL;
+}
+
+/* a share may always spend its guaranteed rate, pushing the parent into debt
+ * of at most one bucket, otherwise it borrows whatever the parent has left.
+ *
+ * returns TRUE when permitted unless non-blocking flag is set.
+ * returns FALSE if operation should block and non-blocking flag is set.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_rate_share_check (
+	pgm_rate_share_t*	share,
+	const size_t		data_size,
+	const bool		is_nonblocking
+	)
+{
+	pgm_rate_t *assured, *parent;
+
+/* pre-conditions */
+	pgm_assert (NULL != share);
+	pgm_assert (NULL != share->group);
+	pgm_assert (data_size > 0);
+
+	assured = &share->assured;
+	parent  = &share->group->bucket;
+	const int64_t cost = assured->iphdr_len + data_size;
+
+	for (;;)
+	{
+		bool is_permitted = TRUE;
+
+		pgm_spinlock_lock (&assured->spinlock);
+		pgm_spinlock_lock (&parent->spinlock);
+		const pgm_time_t now = pgm_time_update_now();
+		int64_t assured_limit = _pgm_rate_refill (assured, now);
+		int64_t parent_limit  = _pgm_rate_refill (parent, now);
+
+		if (assured_limit > 0) {
+			const int64_t parent_depth = parent->rate_per_msec ? parent->rate_per_msec : parent->rate_per_sec;
+			assured_limit -= cost;
+			parent_limit  -= cost;
+			if (parent_limit < -parent_depth)
+				parent_limit = -parent_depth;
+		} else if (parent_limit > 0) {
+			parent_limit  -= cost;
+		} else
+			is_permitted = FALSE;
+
+		if (is_permitted) {
+			assured->rate_limit = assured_limit;
+			assured->last_rate_check = now;
+			parent->rate_limit = parent_limit;
+			parent->last_rate_check = now;
+		}
+		pgm_spinlock_unlock (&parent->spinlock);
+		pgm_spinlock_unlock (&assured->spinlock);
+
+		if (is_permitted || is_nonblocking)
+			return is_permitted;
+		pgm_thread_yield();
+	}
+}
+
+/* charge a send already made to the share and the parent, as
+ * pgm_rate_share_check() spending the guaranteed rate.
+ */
+
+static
+void
+_pgm_rate_share_debit (
+	pgm_rate_share_t*	share,
+	const size_t		data_size
+	)
+{
+	pgm_rate_t *assured, *parent;
+
+/* pre-conditions */
+	pgm_assert (NULL != share);
+	pgm_assert (NULL != share->group);
+
+	assured = &share->assured;
+	parent  = &share->group->bucket;
+	const int64_t cost = assured->iphdr_len + data_size;
+	const int64_t parent_depth = parent->rate_per_msec ? parent->rate_per_msec : parent->rate_per_sec;
+
+	pgm_spinlock_lock (&assured->spinlock);
+	pgm_spinlock_lock (&parent->spinlock);
+	const pgm_time_t now = pgm_time_update_now();
+	assured->rate_limit = (ssize_t)(_pgm_rate_refill (assured, now) - cost);
+	assured->last_rate_check = now;
+	parent->rate_limit = (ssize_t)MAX(_pgm_rate_refill (parent, now) - cost, -parent_depth);
+	parent->last_rate_check = now;
+	pgm_spinlock_unlock (&parent->spinlock);
+	pgm_spinlock_unlock (&assured->spinlock);
+}
+
+/* time until either the guaranteed share or the parent can carry n bytes.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_time_t
+pgm_rate_share_remaining (
+	pgm_rate_share_t*	share,
+	const size_t		n
+	)
+{
+	pgm_rate_t *assured, *parent;
+	pgm_time_t assured_remaining = 0, parent_remaining = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != share);
+	pgm_assert (NULL != share->group);
+
+	assured = &share->assured;
+	parent  = &share->group->bucket;
+
+	pgm_spinlock_lock (&assured->spinlock);
+	pgm_spinlock_lock (&parent->spinlock);
+	const pgm_time_t now = pgm_time_update_now();
+	const int64_t assured_bytes = _pgm_rate_refill (assured, now) - (int64_t)n;
+	const int64_t parent_bytes  = _pgm_rate_refill (parent, now) - (int64_t)n;
+	if (assured_bytes < 0)
+		assured_remaining = (1000000UL * -assured_bytes) / assured->rate_per_sec;
+	if (parent_bytes < 0)
+		parent_remaining = (1000000UL * -parent_bytes) / parent->rate_per_sec;
+	pgm_spinlock_unlock (&parent->spinlock);
+	pgm_spinlock_unlock (&assured->spinlock);
+
+	return MIN(assured_remaining, parent_remaining);
+}
+
 /* eof */
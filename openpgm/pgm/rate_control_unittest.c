@@ -121,6 +121,60 @@ START_TEST (test_destroy_fail_001)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_rate_set (
+ *		pgm_rate_t*		bucket,
+ *		const ssize_t		rate_per_sec,
+ *		const uint16_t		max_tpdu
+ *	)
+ *
+ * 001: lowering the rate to seconds resolution should clamp accumulated credit.
+ */
+
+START_TEST (test_set_pass_001)
+{
+	pgm_rate_t rate;
+	memset (&rate, 0, sizeof(rate));
+	pgm_rate_create (&rate, 2*1010*1000, 10, 1500);
+	fail_unless (2*1010 == rate.rate_per_msec, "rate_per_msec failed");
+	pgm_rate_set (&rate, 2*1010, 1500);
+	fail_unless (2*1010 == rate.rate_per_sec, "rate_per_sec failed");
+	fail_unless (0 == rate.rate_per_msec, "rate_per_msec failed");
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	fail_unless (TRUE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	fail_unless (FALSE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	pgm_rate_destroy (&rate);
+}
+END_TEST
+
+/* 002: raising the rate should switch to millisecond fills.
+ */
+
+START_TEST (test_set_pass_002)
+{
+	pgm_rate_t rate;
+	memset (&rate, 0, sizeof(rate));
+	pgm_rate_create (&rate, 2*900, 10, 1500);
+	pgm_rate_set (&rate, 2*1010*1000, 1500);
+	fail_unless (2*1010*1000 == rate.rate_per_sec, "rate_per_sec failed");
+	fail_unless (2*1010 == rate.rate_per_msec, "rate_per_msec failed");
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	fail_unless (TRUE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	fail_unless (FALSE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	pgm_rate_destroy (&rate);
+}
+END_TEST
+
+START_TEST (test_set_fail_001)
+{
+	pgm_rate_set (NULL, 100*1000, 1500);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	bool
  *	pgm_rate_check (
@@ -519,6 +573,227 @@ START_TEST (test_check2_pass_003)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_rate_debit (
+ *		pgm_rate_t*		bucket,
+ *		const size_t		data_size
+ *	)
+ *
+ * 001: debit beyond the bucket depth should fault checks until repaid.
+ */
+
+START_TEST (test_debit_pass_001)
+{
+	pgm_rate_t rate;
+	memset (&rate, 0, sizeof(rate));
+	pgm_rate_create (&rate, 2*1010, 10, 1500);
+	mock_pgm_time_now += pgm_secs(2);
+	pgm_rate_debit (&rate, 3000);
+	fail_unless (FALSE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+/* advance time to repay the debt and fill one packet */
+	mock_pgm_time_now += pgm_msecs(999);
+	fail_unless (TRUE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	fail_unless (FALSE == pgm_rate_check (&rate, 1000, TRUE), "rate_check failed");
+	pgm_rate_destroy (&rate);
+}
+END_TEST
+
+/* 002: debit is charged to an attached rate group share.
+ */
+
+START_TEST (test_debit_pass_002)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (2*1010*1000, 50);
+	pgm_rate_share_t odata;
+	pgm_rate_t rate;
+	memset (&odata, 0, sizeof(odata));
+	memset (&rate, 0, sizeof(rate));
+	pgm_rate_share_attach (group, &odata, FALSE, 1, 10, 1000);
+	rate.share = &odata;
+	mock_pgm_time_now += pgm_secs(2);
+	pgm_rate_debit (&rate, 1000);
+	fail_unless (TRUE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (FALSE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	pgm_rate_share_detach (&odata);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+START_TEST (test_debit_fail_001)
+{
+	pgm_rate_debit (NULL, 1000);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	pgm_rate_group_t*
+ *	pgm_rate_group_new (
+ *		const ssize_t		rate_per_sec,
+ *		const unsigned		rdata_share
+ *	)
+ */
+
+START_TEST (test_group_new_pass_001)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (100*1000, 10);
+	fail_if (NULL == group, "group_new failed");
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+START_TEST (test_group_new_fail_001)
+{
+	fail_unless (NULL == pgm_rate_group_new (0, 10), "group_new failed");
+	fail_unless (NULL == pgm_rate_group_new (100*1000, 101), "group_new failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_rate_share_check (
+ *		pgm_rate_share_t*	share,
+ *		const size_t		data_size,
+ *		const bool		is_nonblocking
+ *	)
+ *
+ * 001: a lone share borrows the idle remainder of the group.
+ */
+
+START_TEST (test_share_check_pass_001)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (2*1010*1000, 50);
+	pgm_rate_share_t odata;
+	memset (&odata, 0, sizeof(odata));
+	pgm_rate_share_attach (group, &odata, FALSE, 1, 10, 1000);
+	fail_unless (1010 == odata.assured.rate_per_msec, "attach failed");
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (TRUE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (FALSE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	pgm_rate_share_detach (&odata);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+/* 002: repairs keep their guaranteed share after original data drains the group.
+ */
+
+START_TEST (test_share_check_pass_002)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (2*1010*1000, 50);
+	pgm_rate_share_t odata, rdata;
+	memset (&odata, 0, sizeof(odata));
+	memset (&rdata, 0, sizeof(rdata));
+	pgm_rate_share_attach (group, &odata, FALSE, 1, 10, 1000);
+	pgm_rate_share_attach (group, &rdata, TRUE, 1, 10, 1000);
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (TRUE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (FALSE == pgm_rate_share_check (&odata, 1000, TRUE), "share_check failed");
+	fail_unless (TRUE == pgm_rate_share_check (&rdata, 1000, TRUE), "share_check failed");
+	fail_unless (FALSE == pgm_rate_share_check (&rdata, 1000, TRUE), "share_check failed");
+	pgm_rate_share_detach (&rdata);
+	pgm_rate_share_detach (&odata);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+/* 003: guaranteed rates follow weights within a class.
+ */
+
+START_TEST (test_share_check_pass_003)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (4*1010*1000, 0);
+	pgm_rate_share_t a, b;
+	memset (&a, 0, sizeof(a));
+	memset (&b, 0, sizeof(b));
+	pgm_rate_share_attach (group, &a, FALSE, 1, 10, 1000);
+	pgm_rate_share_attach (group, &b, FALSE, 3, 10, 1000);
+	fail_unless (1010 == a.assured.rate_per_msec, "weight failed");
+	fail_unless (3*1010 == b.assured.rate_per_msec, "weight failed");
+	pgm_rate_share_detach (&b);
+	fail_unless (4*1010 == a.assured.rate_per_msec, "rebalance failed");
+	pgm_rate_share_detach (&a);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+/* 004: socket buckets defer to an attached share.
+ */
+
+START_TEST (test_share_check_pass_004)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (2*1010*1000, 50);
+	pgm_rate_t major, minor;
+	pgm_rate_share_t odata;
+	memset (&major, 0, sizeof(major));
+	memset (&minor, 0, sizeof(minor));
+	memset (&odata, 0, sizeof(odata));
+	pgm_rate_share_attach (group, &odata, FALSE, 1, 10, 1000);
+	minor.share = &odata;
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	fail_unless (TRUE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	fail_unless (FALSE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	pgm_rate_share_detach (&odata);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+/* 005: a blocking check waits on the share with the socket buckets unlocked.
+ */
+
+static pgm_rate_t* mock_major_bucket = NULL;
+static unsigned mock_major_locked_count = 0;
+
+static
+pgm_time_t
+_mock_pgm_time_update_now_advance (void)
+{
+	if (pgm_spinlock_trylock (&mock_major_bucket->spinlock))
+		pgm_spinlock_unlock (&mock_major_bucket->spinlock);
+	else
+		mock_major_locked_count++;
+	mock_pgm_time_now += pgm_msecs(1);
+	return mock_pgm_time_now;
+}
+
+START_TEST (test_share_check_pass_005)
+{
+	pgm_rate_group_t* group = pgm_rate_group_new (2*1010*1000, 50);
+	pgm_rate_t major, minor;
+	pgm_rate_share_t odata;
+	memset (&minor, 0, sizeof(minor));
+	memset (&odata, 0, sizeof(odata));
+	pgm_rate_create (&major, 100*1000*1000, 10, 1000);
+	pgm_rate_share_attach (group, &odata, FALSE, 1, 10, 1000);
+	minor.share = &odata;
+	mock_pgm_time_now += pgm_secs(2);
+	fail_unless (TRUE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	fail_unless (TRUE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	fail_unless (FALSE == pgm_rate_check2 (&major, &minor, 1000, TRUE), "rate_check2 failed");
+	mock_major_bucket = &major;
+	mock_major_locked_count = 0;
+	mock_pgm_time_update_now = _mock_pgm_time_update_now_advance;
+	fail_unless (TRUE == pgm_rate_check2 (&major, &minor, 1000, FALSE), "rate_check2 failed");
+	mock_pgm_time_update_now = _mock_pgm_time_update_now;
+/* only the socket bucket refill itself runs under the lock */
+	fail_unless (1 == mock_major_locked_count, "share wait under lock");
+	pgm_rate_share_detach (&odata);
+	pgm_rate_destroy (&major);
+	pgm_rate_group_unref (group);
+}
+END_TEST
+
+START_TEST (test_share_check_fail_001)
+{
+	pgm_rate_share_check (NULL, 1000, FALSE);
+	fail ("reached");
+}
+END_TEST
+
 
 static
 Suite*
@@ -542,6 +817,14 @@ make_test_suite (void)
 	tcase_add_test_raise_signal (tc_destroy, test_destroy_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_set = tcase_create ("set");
+	suite_add_tcase (s, tc_set);
+	tcase_add_test (tc_set, test_set_pass_001);
+	tcase_add_test (tc_set, test_set_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_set, test_set_fail_001, SIGABRT);
+#endif
+
 	TCase* tc_check = tcase_create ("check");
 	suite_add_tcase (s, tc_check);
 	tcase_add_test (tc_check, test_check_pass_001);
@@ -559,6 +842,30 @@ make_test_suite (void)
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_check2, test_check2_fail_001, SIGABRT);
 #endif
+
+	TCase* tc_debit = tcase_create ("debit");
+	suite_add_tcase (s, tc_debit);
+	tcase_add_test (tc_debit, test_debit_pass_001);
+	tcase_add_test (tc_debit, test_debit_pass_002);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_debit, test_debit_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_group_new = tcase_create ("group-new");
+	suite_add_tcase (s, tc_group_new);
+	tcase_add_test (tc_group_new, test_group_new_pass_001);
+	tcase_add_test (tc_group_new, test_group_new_fail_001);
+
+	TCase* tc_share_check = tcase_create ("share-check");
+	suite_add_tcase (s, tc_share_check);
+	tcase_add_test (tc_share_check, test_share_check_pass_001);
+	tcase_add_test (tc_share_check, test_share_check_pass_002);
+	tcase_add_test (tc_share_check, test_share_check_pass_003);
+	tcase_add_test (tc_share_check, test_share_check_pass_004);
+	tcase_add_test (tc_share_check, test_share_check_pass_005);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_share_check, test_share_check_fail_001, SIGABRT);
+#endif
 	return s;
 }
 
@@ -301,6 +301,25 @@ pgm_peer_unref (
 	if (pgm_atomic_exchange_and_add32 (&peer->ref_count, (uint32_t)-1) != 1)
 		return;
 
+/* return to the socket pool with an empty receive window */
+	if (NULL != peer->pool) {
+		struct pgm_peer_pool_t* pool = peer->pool;
+		pgm_spinlock_lock (&pool->lock);
+		if (pool->len < pool->max) {
+			pgm_rxw_t* window = peer->window;
+			pgm_rxw_reset (window);
+			memset (peer, 0, sizeof(pgm_peer_t));
+			peer->window = window;
+			peer->pool = pool;
+			peer->pool_link.data = peer;
+			pool->free_list = pgm_slist_prepend_link (pool->free_list, &peer->pool_link);
+			pool->len++;
+			pgm_spinlock_unlock (&pool->lock);
+			return;
+		}
+		pgm_spinlock_unlock (&pool->lock);
+	}
+
 /* receive window */
 	pgm_rxw_destroy (peer->window);
 	peer->window = NULL;
@@ -310,9 +329,160 @@ pgm_peer_unref (
 	peer = NULL;
 }
 
+/* allocate a peer object and receive window sized from the socket.
+ */
+
+static
+pgm_peer_t*
+_pgm_peer_alloc (
+	pgm_sock_t*		sock
+	)
+{
+	pgm_peer_t* peer;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	peer = pgm_new0 (pgm_peer_t, 1);
+	peer->window = pgm_rxw_create (&peer->tsi,
+					sock->max_tpdu,
+					sock->rxw_sqns,
+					sock->rxw_secs,
+					sock->rxw_max_rte,
+					sock->ack_c_p);
+	if (sock->numa_node >= 0)
+		pgm_numa_bind_memory (peer->window,
+				      sizeof(pgm_rxw_t) + ( pgm_rxw_max_length (peer->window) * sizeof(struct pgm_sk_buff_t*) ),
+				      sock->numa_node);
+	if (sock->peer_pool.max)
+		peer->pool = &sock->peer_pool;
+	return peer;
+}
+
+/* preallocate peers so that a burst of new sessions does not contend on the
+ * allocator, expired peers are returned to the pool up to the same limit.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_peer_pool_create (
+	pgm_sock_t* const	sock,
+	const unsigned		peer_count
+	)
+{
+	struct pgm_peer_pool_t* pool;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert_cmpuint (peer_count, >, 0);
+
+	pgm_debug ("pgm_peer_pool_create (sock:%p peer-count:%u)",
+		(const void*)sock, peer_count);
+
+	pool = &sock->peer_pool;
+	pgm_spinlock_init (&pool->lock);
+	pool->max = peer_count;
+	for (unsigned i = 0; i < peer_count; i++) {
+		pgm_peer_t* peer = _pgm_peer_alloc (sock);
+		peer->pool_link.data = peer;
+		pool->free_list = pgm_slist_prepend_link (pool->free_list, &peer->pool_link);
+		pool->len++;
+	}
+}
+
+/* free pooled peers, peers returned afterwards are destroyed on last reference.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_peer_pool_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	struct pgm_peer_pool_t* pool;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	pgm_debug ("pgm_peer_pool_destroy (sock:%p)", (const void*)sock);
+
+	pool = &sock->peer_pool;
+	if (0 == pool->max)
+		return;
+	pgm_spinlock_lock (&pool->lock);
+	pool->max = 0;
+	while (pool->free_list) {
+		pgm_peer_t* peer = pool->free_list->data;
+		pool->free_list = pgm_slist_remove_first (pool->free_list);
+		pgm_rxw_destroy (peer->window);
+		pgm_free (peer);
+	}
+	pool->len = 0;
+	pgm_spinlock_unlock (&pool->lock);
+	pgm_spinlock_free (&pool->lock);
+}
+
+/* admit a new peer within the configured rate, bursts up to one second of
+ * peers pass immediately.  generic cell rate algorithm on the theoretical
+ * arrival time of the next peer.
+ *
+ * returns TRUE if the peer may be created.
+ */
+
+static
+bool
+admit_new_peer (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	now
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	if (0 == sock->peer_rate)
+		return TRUE;
+
+	const pgm_time_t ivl = pgm_secs (1) / sock->peer_rate;
+	const pgm_time_t tat = pgm_time_after (sock->peer_rate_tat, now) ? sock->peer_rate_tat : now;
+	if (tat - now > pgm_secs (1) - ivl)
+		return FALSE;
+	sock->peer_rate_tat = tat + ivl;
+	return TRUE;
+}
+
+/* calculate SPMR back-off for a new peer.  a peer resumed from the journal
+ * requests immediately, without a group size the fixed SPMR_EXPIRY is used,
+ * otherwise a random interval up to SPMR_EXPIRY scaled by log2 of the
+ * estimated number of receivers so that one receiver's multicast SPMR
+ * suppresses the rest.
+ */
+
+static
+pgm_time_t
+spmr_ivl (
+	pgm_sock_t* const	sock,	/* not const as rand() updates the seed */
+	const bool		is_resumed
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	if (is_resumed)
+		return 0;
+	if (0 == sock->spmr_group_size)
+		return sock->spmr_expiry;
+
+	unsigned scale = 1;
+	for (unsigned group_size = sock->spmr_group_estimate; group_size > 1; group_size >>= 1)
+		scale++;
+	const pgm_time_t range = (pgm_time_t)sock->spmr_expiry * scale;
+	return pgm_rand_int_range (&sock->rand_, 1 /* us */, (int32_t)MIN(range, INT32_MAX));
+}
+
 /* find PGM options in received SKB.
  *
- * returns TRUE if opt_fragment is found, otherwise FALSE is returned.
+ * returns FALSE if the TPDU must be discarded for an unknown option with
+ * OPX_DISCARD set, otherwise TRUE is returned.
  */
 
 static
@@ -322,7 +492,6 @@ get_pgm_options (
 	)
 {
 	struct pgm_opt_header* opt_header;
-	bool found_opt = FALSE;
 
 /* pre-conditions */
 	pgm_assert (NULL != skb);
@@ -338,6 +507,7 @@ get_pgm_options (
 
 	skb->pgm_opt_fragment = NULL;
 	skb->pgm_opt_pgmcc_data = NULL;
+	skb->is_transformed = 0;
 
 /* always at least two options, first is always opt_length */
 	do {
@@ -349,26 +519,33 @@ get_pgm_options (
 		switch (opt_header->opt_type & PGM_OPT_MASK) {
 		case PGM_OPT_FRAGMENT:
 			skb->pgm_opt_fragment = (struct pgm_opt_fragment*)(opt_header + 1);
-			found_opt = TRUE;
 			break;
 
 		case PGM_OPT_PGMCC_DATA:
 			skb->pgm_opt_pgmcc_data = (struct pgm_opt_pgmcc_data*)(opt_header + 1);
-			found_opt = TRUE;
 			break;
 
-		default: break;
+		case PGM_OPT_TRANSFORM:
+			skb->is_transformed = 1;
+			break;
+
+/* 9. options not understood are handled as the OPX bits direct */
+		default:
+			if (PGM_OPX_DISCARD == (opt_header->opt_reserved & PGM_OPX_MASK))
+				return FALSE;
+			break;
 		}
 
 	} while (!(opt_header->opt_type & PGM_OPT_END));
-	return found_opt;
+	return TRUE;
 }
 
 /* a peer in the context of the sock is another party on the network sending PGM
  * packets.  for each peer we need a receive window and network layer address (nla) to
  * which nak requests can be forwarded to.
  *
- * on success, returns new peer object.
+ * on success, returns new peer object, returns NULL if the new peer rate is exceeded
+ * or the packet arrived on a layer since left.
  */
 
 PGM_GNUC_INTERNAL
@@ -400,7 +577,27 @@ pgm_new_peer (
 		(void*)sock, pgm_tsi_print (tsi), saddr, (unsigned)src_addrlen, daddr, (unsigned)dst_addrlen);
 #endif
 
-	peer = pgm_new0 (pgm_peer_t, 1);
+	if (PGM_UNLIKELY(sock->layers_len && pgm_layer_is_refused (sock, dst_addr))) {
+		pgm_trace (PGM_LOG_ROLE_SESSION,_("Layer not joined, discarding packet from tsi %s"), pgm_tsi_print (tsi));
+		return NULL;
+	}
+	if (PGM_UNLIKELY(!admit_new_peer (sock, now))) {
+		pgm_trace (PGM_LOG_ROLE_SESSION,_("New peer rate exceeded, discarding packet from tsi %s"), pgm_tsi_print (tsi));
+		return NULL;
+	}
+
+	peer = NULL;
+	if (sock->peer_pool.max) {
+		pgm_spinlock_lock (&sock->peer_pool.lock);
+		if (sock->peer_pool.free_list) {
+			peer = sock->peer_pool.free_list->data;
+			sock->peer_pool.free_list = pgm_slist_remove_first (sock->peer_pool.free_list);
+			sock->peer_pool.len--;
+		}
+		pgm_spinlock_unlock (&sock->peer_pool.lock);
+	}
+	if (NULL == peer)
+		peer = _pgm_peer_alloc (sock);
 	peer->expiry = now + sock->peer_expiry;
 	memcpy (&peer->tsi, tsi, sizeof(pgm_tsi_t));
 	memcpy (&peer->group_nla, dst_addr, dst_addrlen);
@@ -409,14 +606,14 @@ pgm_new_peer (
 	((struct sockaddr_in*)&peer->local_nla)->sin_port = pgm_htons (sock->udp_encap_ucast_port);
 	((struct sockaddr_in*)&peer->nla)->sin_port       = pgm_htons (sock->udp_encap_ucast_port);
 
-/* lock on rx window */
-	peer->window = pgm_rxw_create (&peer->tsi,
-					sock->max_tpdu,
-					sock->rxw_sqns,
-					sock->rxw_secs,
-					sock->rxw_max_rte,
-					sock->ack_c_p);
-	peer->spmr_expiry = now + sock->spmr_expiry;
+	peer->window->is_streaming = sock->use_streaming_read;
+/* resume after the last sequence delivered before a restart once an SPM
+ * confirms the source still holds it.
+ */
+	if (sock->journal && pgm_journal_lookup (sock->journal, &peer->tsi, &peer->resume_sqn))
+		peer->is_resumed = 1;
+/* a resumed peer requests an SPM without waiting to learn where to NAK its gap */
+	peer->spmr_expiry = now + spmr_ivl (sock, peer->is_resumed);
 
 /* add peer to hash table and linked list */
 	pgm_rwlock_writer_lock (&sock->peers_lock);
@@ -464,9 +661,10 @@ pgm_flush_peers_pending (
 	while (sock->peers_pending)
 	{
 		pgm_peer_t* peer = sock->peers_pending->data;
+		struct pgm_msgv_t* msg_first = *pmsg;
 		if (peer->last_commit && peer->last_commit < sock->last_commit)
 			pgm_rxw_remove_commit (peer->window);
-		const ssize_t peer_bytes = pgm_rxw_readv (peer->window, pmsg, (unsigned)(msg_end - *pmsg + 1));
+		ssize_t peer_bytes = pgm_rxw_readv (peer->window, pmsg, (unsigned)(msg_end - *pmsg + 1));
 
 		if (peer->last_cumulative_losses != ((pgm_rxw_t*)peer->window)->cumulative_losses)
 		{
@@ -477,13 +675,29 @@ pgm_flush_peers_pending (
 
 		if (peer_bytes >= 0)
 		{
-			(*bytes_read) += peer_bytes;
-			(*data_read)  ++;
+			const bool was_full = (*pmsg > msg_end);
 			peer->last_commit = sock->last_commit;
+/* transformed APDUs are replaced by their decoded form, undecodable ones dropped */
+			if (sock->compress)
+				peer_bytes += pgm_compress_msgv (sock->compress, msg_first, pmsg);
+/* unsubscribed topics are committed in the window but not delivered, refill
+ * any vector space released by the filter.
+ */
+			if (sock->topic_filter)
+				peer_bytes -= pgm_topic_filter_msgv (sock->topic_filter, msg_first, pmsg);
+			const bool is_refill = was_full && (*pmsg <= msg_end);
+			if (*pmsg != msg_first) {
+				(*bytes_read) += peer_bytes;
+				(*data_read)  ++;
+				if (sock->journal)
+					pgm_journal_append (sock->journal, msg_first, *pmsg, pgm_time_update_now ());
+			}
 			if (*pmsg > msg_end) {			/* commit full */
 				retval = -PGM_SOCK_ENOBUFS;
 				break;
 			}
+			if (is_refill && !sock->is_reset)
+				continue;
 		} else
 			peer->last_commit = 0;
 		if (PGM_UNLIKELY(sock->is_reset)) {
@@ -516,7 +730,8 @@ pgm_peer_has_pending (
 	return FALSE;
 }
 
-/* set receiver in pending event queue
+/* set receiver in pending event queue, priority lane sources are read
+ * before all others.
  */
 
 PGM_GNUC_INTERNAL
@@ -532,6 +747,19 @@ pgm_peer_set_pending (
 
 	if (peer->pending_link.data) return;
 	peer->pending_link.data = peer;
+	if (sock->lane.tsi.sport &&
+	    peer->tsi.sport != sock->lane.tsi.sport &&
+	    NULL != sock->peers_pending &&
+	    ((pgm_peer_t*)sock->peers_pending->data)->tsi.sport == sock->lane.tsi.sport)
+	{
+		pgm_slist_t* prev = sock->peers_pending;
+		while (NULL != prev->next &&
+		       ((pgm_peer_t*)prev->next->data)->tsi.sport == sock->lane.tsi.sport)
+			prev = prev->next;
+		peer->pending_link.next = prev->next;
+		prev->next = &peer->pending_link;
+		return;
+	}
 	sock->peers_pending = pgm_slist_prepend_link (sock->peers_pending, &peer->pending_link);
 }
 
@@ -606,6 +834,25 @@ pgm_on_spm (
 /* save sequence number */
 		source->spm_sqn = spm_sqn;
 
+/* resume from the journal when the source still holds the next sequence,
+ * otherwise join as a new receiver.
+ */
+		if (source->is_resumed && !source->window->is_defined) {
+			const uint32_t spm_lead  = pgm_ntohl (spm->spm_lead);
+			const uint32_t spm_trail = pgm_ntohl (spm->spm_trail);
+			if (pgm_uint32_gte (source->resume_sqn + 1, spm_trail) &&
+			    pgm_uint32_lte (source->resume_sqn, spm_lead))
+			{
+				pgm_rxw_resume (source->window, source->resume_sqn);
+			}
+			else
+			{
+				pgm_trace (PGM_LOG_ROLE_SESSION,_("Journalled sequence #%" PRIu32 " outside source window [#%" PRIu32 ", #%" PRIu32 "], joining tsi %s as new."),
+					source->resume_sqn, spm_trail, spm_lead, pgm_tsi_print (&source->tsi));
+				source->is_resumed = 0;
+			}
+		}
+
 /* update receive window */
 		const pgm_time_t nak_rb_expiry = skb->tstamp + nak_rb_ivl (sock);
 		const unsigned naks = pgm_rxw_update (source->window,
@@ -620,15 +867,6 @@ pgm_on_spm (
 			pgm_timer_unlock (sock);
 		}
 
-/* mark receiver window for flushing on next recv() */
-		if (source->window->cumulative_losses != source->last_cumulative_losses &&
-		    !source->pending_link.data)
-		{
-			sock->is_reset = TRUE;
-			source->lost_count = source->window->cumulative_losses - source->last_cumulative_losses;
-			source->last_cumulative_losses = source->window->cumulative_losses;
-			pgm_peer_set_pending (sock, source);
-		}
 	}
 	else
 	{	/* does not advance SPM sequence number */
@@ -637,7 +875,9 @@ pgm_on_spm (
 		return FALSE;
 	}
 
-/* check whether peer can generate parity packets */
+/* check whether peer can generate parity packets or supports late join */
+	bool has_join = FALSE;
+	uint32_t join_min = 0;
 	if (skb->pgm_header->pgm_options & PGM_OPT_PRESENT)
 	{
 		const struct pgm_opt_header* opt_header;
@@ -689,9 +929,34 @@ pgm_on_spm (
 					pgm_rxw_update_fec (source->window, parity_prm_tgs);
 				}
 			}
+			else if ((opt_header->opt_type & PGM_OPT_MASK) == PGM_OPT_JOIN)
+			{
+				const struct pgm_opt_join* opt_join = (const struct pgm_opt_join*)(opt_header + 1);
+				join_min = pgm_ntohl (opt_join->opt_join_min);
+				has_join = TRUE;
+			}
 		} while (!(opt_header->opt_type & PGM_OPT_END));
 	}
 
+/* first SPM to a window resumed from the journal, repairs older than the
+ * advertised late join minimum are not requested.
+ */
+	if (source->is_resumed) {
+		if (has_join)
+			pgm_rxw_join (source->window, join_min);
+		source->is_resumed = 0;
+	}
+
+/* mark receiver window for flushing on next recv() */
+	if (source->window->cumulative_losses != source->last_cumulative_losses &&
+	    !source->pending_link.data)
+	{
+		sock->is_reset = TRUE;
+		source->lost_count = source->window->cumulative_losses - source->last_cumulative_losses;
+		source->last_cumulative_losses = source->window->cumulative_losses;
+		pgm_peer_set_pending (sock, source);
+	}
+
 /* either way bump expiration timer */
 	source->expiry = skb->tstamp + sock->peer_expiry;
 	source->spmr_expiry = 0;
@@ -718,7 +983,6 @@ pgm_on_peer_nak (
 	const struct pgm_nak   *nak;
 	const struct pgm_nak6  *nak6;
 	struct sockaddr_storage nak_src_nla, nak_grp_nla;
-	bool			found_nak_grp = FALSE;
 	int			ncf_status;
 
 /* pre-conditions */
@@ -749,16 +1013,7 @@ pgm_on_peer_nak (
 
 /* NAK_GRP_NLA contains one of our sock receive multicast groups: the sources send multicast group */ 
 	pgm_nla_to_sockaddr ((AF_INET6 == nak_src_nla.ss_family) ? &nak6->nak6_grp_nla_afi : &nak->nak_grp_nla_afi, (struct sockaddr*)&nak_grp_nla);
-	for (unsigned i = 0; i < sock->recv_gsr_len; i++)
-	{
-		if (pgm_sockaddr_cmp ((struct sockaddr*)&nak_grp_nla, (struct sockaddr*)&sock->recv_gsr[i].gsr_group) == 0)
-		{
-			found_nak_grp = TRUE;
-			break;
-		}
-	}
-
-	if (PGM_UNLIKELY(!found_nak_grp)) {
+	if (PGM_UNLIKELY(!pgm_membership_is_joined (sock, (struct sockaddr*)&nak_grp_nla))) {
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded multicast NAK on multicast group mismatch."));
 		return FALSE;
 	}
@@ -881,7 +1136,9 @@ pgm_on_ncf (
 	}
 #endif
 
-/* NCF_GRP_NLA contains our sock multicast group */ 
+/* NCF_GRP_NLA contains our sock multicast group, or the group of our NAKs
+ * which under unicast fan-out is our own address.
+ */
 	pgm_nla_to_sockaddr ((AF_INET6 == ncf_src_nla.ss_family) ? &ncf6->nak6_grp_nla_afi : &ncf->nak_grp_nla_afi, (struct sockaddr*)&ncf_grp_nla);
 
 /* copy scope id from multicast socket */
@@ -890,7 +1147,8 @@ pgm_on_ncf (
 		((struct sockaddr_in6*)&ncf_grp_nla)->sin6_scope_id = ((struct sockaddr_in6*)&sock->send_gsr.gsr_group)->sin6_scope_id;
 	}
 
-	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&ncf_grp_nla, (struct sockaddr*)&sock->send_gsr.gsr_group) != 0))
+	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&ncf_grp_nla, (struct sockaddr*)&sock->send_gsr.gsr_group) != 0 &&
+			 pgm_sockaddr_cmp ((struct sockaddr*)&ncf_grp_nla, (struct sockaddr*)&source->group_nla) != 0))
 	{
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded NCF on multicast group mismatch."));
 		return FALSE;
@@ -1326,6 +1584,8 @@ send_ack (
 	struct pgm_opt_header	      *opt_header;
 	struct pgm_opt_length	      *opt_len;
 	struct pgm_opt_pgmcc_feedback *opt_pgmcc_feedback;
+	struct pgm_opt_ecn	      *opt_ecn;
+	size_t			       opt_pgmcc_length;
 	ssize_t			       sent;
 
 /* pre-conditions */
@@ -1336,13 +1596,16 @@ send_ack (
 	pgm_debug ("send_ack (sock:%p source:%p now:%" PGM_TIME_FORMAT ")",
 		(void*)sock, (void*)source, now);
 
+	opt_pgmcc_length = sizeof(struct pgm_opt_header) +
+			   ( (AF_INET6 == sock->send_addr.ss_family) ?
+				sizeof(struct pgm_opt6_pgmcc_feedback) :
+				sizeof(struct pgm_opt_pgmcc_feedback) );
 	tpdu_length = sizeof(struct pgm_header) +
 			     sizeof(struct pgm_ack) +
 			     sizeof(struct pgm_opt_length) +		/* includes header */
-			     sizeof(struct pgm_opt_header) +
-			     sizeof(struct pgm_opt_pgmcc_feedback);
-	if (AF_INET6 == sock->send_addr.ss_family)
-		tpdu_length += sizeof(struct pgm_opt6_pgmcc_feedback) - sizeof(struct pgm_opt_pgmcc_feedback);
+			     opt_pgmcc_length;
+	if (sock->use_ecn)
+		tpdu_length += sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_ecn);
 	buf = pgm_alloca (tpdu_length);
 	if (PGM_UNLIKELY(pgm_mem_gc_friendly))
 		memset (buf, 0, tpdu_length);
@@ -1365,17 +1628,10 @@ send_ack (
 	opt_len = (struct pgm_opt_length*)(ack + 1);
 	opt_len->opt_type	= PGM_OPT_LENGTH;
 	opt_len->opt_length	= sizeof(struct pgm_opt_length);
-	opt_len->opt_total_length = pgm_htons (	sizeof(struct pgm_opt_length) +
-						sizeof(struct pgm_opt_header) +
-						(AF_INET6 == sock->send_addr.ss_family) ?
-							sizeof(struct pgm_opt6_pgmcc_feedback) :
-							sizeof(struct pgm_opt_pgmcc_feedback) );
+	opt_len->opt_total_length = pgm_htons ((uint16_t)(tpdu_length - sizeof(struct pgm_header) - sizeof(struct pgm_ack)));
 	opt_header = (struct pgm_opt_header*)(opt_len + 1);
-	opt_header->opt_type	= PGM_OPT_PGMCC_FEEDBACK | PGM_OPT_END;
-	opt_header->opt_length	= sizeof(struct pgm_opt_header) +
-				  ( (AF_INET6 == sock->send_addr.ss_family) ?
-					sizeof(struct pgm_opt6_pgmcc_feedback) :
-					sizeof(struct pgm_opt_pgmcc_feedback) );
+	opt_header->opt_type	= sock->use_ecn ? PGM_OPT_PGMCC_FEEDBACK : (PGM_OPT_PGMCC_FEEDBACK | PGM_OPT_END);
+	opt_header->opt_length	= (uint8_t)opt_pgmcc_length;
 	opt_pgmcc_feedback = (struct pgm_opt_pgmcc_feedback*)(opt_header + 1);
 	opt_pgmcc_feedback->opt_reserved = 0;
 
@@ -1384,6 +1640,17 @@ send_ack (
 	pgm_sockaddr_to_nla ((struct sockaddr*)&sock->send_addr, (char*)&opt_pgmcc_feedback->opt_nla_afi);
 	opt_pgmcc_feedback->opt_loss_rate = pgm_htons ((uint16_t)source->window->data_loss);
 
+/* OPT_ECN */
+	if (sock->use_ecn) {
+		opt_header = (struct pgm_opt_header*)((char*)opt_header + opt_pgmcc_length);
+		opt_header->opt_type	= PGM_OPT_ECN | PGM_OPT_END;
+		opt_header->opt_length	= sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_ecn);
+		opt_ecn = (struct pgm_opt_ecn*)(opt_header + 1);
+		opt_ecn->opt_reserved	= 0;
+		opt_ecn->opt_ce_rate	= pgm_htons ((uint16_t)source->ce_rate);
+		opt_ecn->opt_ce_count	= pgm_htonl (source->ce_count);
+	}
+
 	header->pgm_checksum	= 0;
 	header->pgm_checksum	= pgm_csum_fold (pgm_csum_partial (buf, (uint16_t)tpdu_length, 0));
 
@@ -2166,8 +2433,18 @@ pgm_on_data (
 	pgm_debug ("pgm_on_data (sock:%p source:%p skb:%p)",
 		(void*)sock, (void*)source, (void*)skb);
 
+/* window is undefined until an SPM decides whether to resume, data is
+ * repaired after resuming.
+ */
+	if (PGM_UNLIKELY(source->is_resumed && !source->window->is_defined)) {
+		pgm_trace (PGM_LOG_ROLE_SESSION,_("Discarded data from journalled tsi %s awaiting SPM."), pgm_tsi_print (&source->tsi));
+		return FALSE;
+	}
+
 	const pgm_time_t nak_rb_expiry = skb->tstamp + nak_rb_ivl (sock);
 	const uint_fast16_t tsdu_length = pgm_ntohs (skb->pgm_header->pgm_tsdu_length);
+	const uint_fast8_t skb_type = skb->pgm_header->pgm_type;
+	const bool is_ce = skb->is_ce;
 
 	skb->pgm_data = skb->data;
 
@@ -2179,7 +2456,14 @@ pgm_on_data (
 	pgm_skb_pull (skb, (uint16_t)(sizeof(struct pgm_data) + opt_total_length));
 
 	if (opt_total_length > 0 &&			/* there are options */
-	    get_pgm_options (skb) &&			/* valid options */
+	    !get_pgm_options (skb))
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded data with unsupported option."));
+		source->cumulative_stats[PGM_PC_RECEIVER_MALFORMED_ODATA]++;
+		return FALSE;
+	}
+
+	if (opt_total_length > 0 &&			/* there are options */
 	    sock->use_pgmcc &&				/* PGMCC is enabled */
 	    NULL != skb->pgm_opt_pgmcc_data &&		/* PGMCC options */
 	    0 == source->ack_rb_expiry)			/* not partaking in a current election */
@@ -2213,11 +2497,24 @@ discarded:
 	default: pgm_assert_not_reached(); break;
 	}
 
-/* valid data */
+/* valid data, original transmissions sample loss for layers */
+	if (PGM_ODATA == skb_type)
+		source->odata_count++;
 	PGM_HISTOGRAM_COUNTS("Rx.DataBytesReceived", tsdu_length);
 	source->cumulative_stats[PGM_PC_RECEIVER_DATA_BYTES_RECEIVED] += tsdu_length;
 	source->cumulative_stats[PGM_PC_RECEIVER_DATA_MSGS_RECEIVED]  += msg_count;
 
+/* ECN marks are smoothed with the same constant as data loss */
+	if (sock->use_ecn && sock->use_pgmcc)
+	{
+		const uint32_t ack_c_p = source->window->ack_c_p;
+		if (is_ce) {
+			source->ce_count++;
+			source->ce_rate = ack_c_p + pgm_fp16mul (pgm_fp16 (1) - ack_c_p, source->ce_rate);
+		} else
+			source->ce_rate = pgm_fp16mul (source->ce_rate, pgm_fp16 (1) - ack_c_p);
+	}
+
 /* congestion control */
 	if (0 != ack_rb_expiry)
 	{
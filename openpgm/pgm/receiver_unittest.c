@@ -61,6 +61,7 @@
 #define pgm_time_update_now	mock_pgm_time_update_now
 #define pgm_rxw_destroy		mock_pgm_rxw_destroy
 #define pgm_rxw_create		mock_pgm_rxw_create
+#define pgm_rxw_reset		mock_pgm_rxw_reset
 #define pgm_rxw_update		mock_pgm_rxw_update
 #define pgm_rxw_update_fec	mock_pgm_rxw_update_fec
 #define pgm_rxw_confirm		mock_pgm_rxw_confirm
@@ -69,6 +70,10 @@
 #define pgm_rxw_add		mock_pgm_rxw_add
 #define pgm_rxw_remove_commit	mock_pgm_rxw_remove_commit
 #define pgm_rxw_readv		mock_pgm_rxw_readv
+#define pgm_rxw_resume		mock_pgm_rxw_resume
+#define pgm_rxw_join		mock_pgm_rxw_join
+#define pgm_journal_append	mock_pgm_journal_append
+#define pgm_journal_lookup	mock_pgm_journal_lookup
 #define pgm_csum_fold		mock_pgm_csum_fold
 #define pgm_compat_csum_partial	mock_pgm_compat_csum_partial
 #define pgm_histogram_init	mock_pgm_histogram_init
@@ -79,11 +84,15 @@
 #include "receiver.c"
 
 
+static gboolean mock_rxw_resumed = FALSE;
+static uint32_t mock_rxw_resume_sqn = 0;
+
 static
 void
 mock_setup (void)
 {
 	if (!g_thread_supported ()) g_thread_init (NULL);
+	mock_rxw_resumed = FALSE;
 }
 
 static
@@ -105,6 +114,33 @@ generate_peer (void)
 	return peer;
 }
 
+/* SPM advertising the source transmit window [trail, lead]
+ */
+
+static
+struct pgm_sk_buff_t*
+generate_spm (
+	const uint32_t		spm_sqn,
+	const uint32_t		trail,
+	const uint32_t		lead
+	)
+{
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (TEST_MAX_TPDU);
+	skb->tstamp = 0x1;
+	skb->pgm_header = (struct pgm_header*)skb->data;
+	pgm_skb_put (skb, sizeof(struct pgm_header) + sizeof(struct pgm_spm));
+	memset (skb->pgm_header, 0, sizeof(struct pgm_header) + sizeof(struct pgm_spm));
+	skb->pgm_header->pgm_type = PGM_SPM;
+	pgm_skb_pull (skb, sizeof(struct pgm_header));
+	struct pgm_spm* spm = (struct pgm_spm*)skb->data;
+	spm->spm_sqn	 = g_htonl (spm_sqn);
+	spm->spm_trail	 = g_htonl (trail);
+	spm->spm_lead	 = g_htonl (lead);
+	spm->spm_nla_afi = g_htons (AFI_IP);
+	spm->spm_nla.s_addr = inet_addr ("127.0.0.2");
+	return skb;
+}
+
 /** socket module */
 static
 int
@@ -233,6 +269,14 @@ mock_pgm_rxw_destroy (
 	g_free (window);
 }
 
+void
+mock_pgm_rxw_reset (
+	pgm_rxw_t* const	window
+	)
+{
+	g_assert (NULL != window);
+}
+
 int
 mock_pgm_rxw_confirm (
 	pgm_rxw_t* const	window,
@@ -274,6 +318,24 @@ mock_pgm_rxw_update (
 	return 0;
 }
 
+void
+mock_pgm_rxw_resume (
+	pgm_rxw_t* const		window,
+	const uint32_t			last_sqn
+	)
+{
+	mock_rxw_resumed = TRUE;
+	mock_rxw_resume_sqn = last_sqn;
+}
+
+void
+mock_pgm_rxw_join (
+	pgm_rxw_t* const		window,
+	const uint32_t			join_min
+	)
+{
+}
+
 void
 mock_pgm_rxw_update_fec (
 	pgm_rxw_t* const		window,
@@ -300,6 +362,27 @@ mock_pgm_rxw_remove_commit (
 {
 }
 
+/** receiver journal module */
+void
+mock_pgm_journal_append (
+	pgm_journal_t* const		journal,
+	const struct pgm_msgv_t*	msgv,
+	const struct pgm_msgv_t* const	msgv_end,
+	const pgm_time_t		now
+	)
+{
+}
+
+bool
+mock_pgm_journal_lookup (
+	const pgm_journal_t* const	journal,
+	const pgm_tsi_t* const		tsi,
+	uint32_t*			last_sqn
+	)
+{
+	return FALSE;
+}
+
 ssize_t
 mock_pgm_rxw_readv (
 	pgm_rxw_t* const		window,
@@ -400,6 +483,22 @@ START_TEST (test_peer_unref_pass_002)
 END_TEST
 
 
+/* last ref returns pooled peer */
+START_TEST (test_peer_unref_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	pgm_spinlock_init (&sock->peer_pool.lock);
+	sock->peer_pool.max = 1;
+	pgm_peer_t* peer = generate_peer();
+	peer->pool = &sock->peer_pool;
+	pgm_peer_unref (peer);
+	fail_unless (1 == sock->peer_pool.len, "pool length not 1");
+	fail_unless (peer == sock->peer_pool.free_list->data, "peer not pooled");
+	fail_unless (NULL != peer->window, "window not retained");
+	fail_unless (0 == peer->ref_count, "ref_count not reset");
+}
+END_TEST
+
 START_TEST (test_peer_unref_fail_001)
 {
 	pgm_peer_unref (NULL);
@@ -407,6 +506,159 @@ START_TEST (test_peer_unref_fail_001)
 }
 END_TEST
 
+/* target:
+ *	bool
+ *	admit_new_peer (
+ *		pgm_sock_t*		sock,
+ *		const pgm_time_t	now
+ *		)
+ */
+
+/* unlimited */
+START_TEST (test_admit_new_peer_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	for (unsigned i = 0; i < 1000; i++)
+		fail_unless (TRUE == admit_new_peer (sock, 0x1), "admit_new_peer failed");
+}
+END_TEST
+
+/* one second burst admitted, then at the steady rate */
+START_TEST (test_admit_new_peer_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->peer_rate = 10;
+	const pgm_time_t now = pgm_secs (10);
+	for (unsigned i = 0; i < 10; i++)
+		fail_unless (TRUE == admit_new_peer (sock, now), "admit_new_peer failed");
+	fail_unless (FALSE == admit_new_peer (sock, now), "burst exceeded");
+	fail_unless (FALSE == admit_new_peer (sock, now + pgm_msecs (99)), "rate exceeded");
+	fail_unless (TRUE == admit_new_peer (sock, now + pgm_msecs (100)), "admit_new_peer failed");
+	fail_unless (FALSE == admit_new_peer (sock, now + pgm_msecs (100)), "rate exceeded");
+/* idle refills the burst */
+	for (unsigned i = 0; i < 10; i++)
+		fail_unless (TRUE == admit_new_peer (sock, now + pgm_secs (5)), "admit_new_peer failed");
+	fail_unless (FALSE == admit_new_peer (sock, now + pgm_secs (5)), "burst exceeded");
+}
+END_TEST
+
+/* target:
+ *	pgm_time_t
+ *	spmr_ivl (
+ *		pgm_sock_t*		sock,
+ *		const bool		is_resumed
+ *		)
+ */
+
+/* fixed back-off */
+START_TEST (test_spmr_ivl_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->spmr_expiry = TEST_SPMR_EXPIRY;
+	fail_unless (TEST_SPMR_EXPIRY == spmr_ivl (sock, FALSE), "spmr_ivl");
+}
+END_TEST
+
+/* random back-off scaled by log2 of the group estimate */
+START_TEST (test_spmr_ivl_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->spmr_expiry = TEST_SPMR_EXPIRY;
+	sock->spmr_group_size = 8;
+	sock->spmr_group_estimate = 8;
+	pgm_rand_create (&sock->rand_);
+	pgm_time_t max_ivl = 0;
+	for (unsigned i = 0; i < 1000; i++) {
+		const pgm_time_t ivl = spmr_ivl (sock, FALSE);
+		fail_unless (ivl >= 1 && ivl < 4 * TEST_SPMR_EXPIRY, "spmr_ivl out of range");
+		max_ivl = MAX(max_ivl, ivl);
+	}
+	fail_unless (max_ivl > TEST_SPMR_EXPIRY, "spmr_ivl not scaled");
+}
+END_TEST
+
+/* resumed peers request immediately */
+START_TEST (test_spmr_ivl_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->spmr_expiry = TEST_SPMR_EXPIRY;
+	fail_unless (0 == spmr_ivl (sock, TRUE), "spmr_ivl");
+	sock->spmr_group_size = 8;
+	sock->spmr_group_estimate = 8;
+	pgm_rand_create (&sock->rand_);
+	fail_unless (0 == spmr_ivl (sock, TRUE), "spmr_ivl");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_on_spm (
+ *		pgm_sock_t*		sock,
+ *		pgm_peer_t*		source,
+ *		struct pgm_sk_buff_t*	skb
+ *		)
+ */
+
+/* journalled sequence inside the advertised window resumes */
+START_TEST (test_on_spm_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	pgm_peer_t* peer = generate_peer ();
+	peer->is_resumed = 1;
+	peer->resume_sqn = 100;
+	struct pgm_sk_buff_t* skb = generate_spm (1, 50, 200);
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (TRUE == mock_rxw_resumed, "not resumed");
+	fail_unless (100 == mock_rxw_resume_sqn, "resume sequence");
+	fail_unless (0 == peer->is_resumed, "still resuming");
+	pgm_free_skb (skb);
+}
+END_TEST
+
+/* all journalled sequences delivered, nothing to repair */
+START_TEST (test_on_spm_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	pgm_peer_t* peer = generate_peer ();
+	peer->is_resumed = 1;
+	peer->resume_sqn = 200;
+	struct pgm_sk_buff_t* skb = generate_spm (1, 50, 200);
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (TRUE == mock_rxw_resumed, "not resumed");
+	fail_unless (200 == mock_rxw_resume_sqn, "resume sequence");
+	pgm_free_skb (skb);
+}
+END_TEST
+
+/* source already trailed past the journal, or the journal is ahead of the
+ * source, joins as a new receiver.
+ */
+START_TEST (test_on_spm_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	sock->nak_bo_ivl = TEST_NAK_BO_IVL;
+	pgm_peer_t* peer = generate_peer ();
+	peer->is_resumed = 1;
+	peer->resume_sqn = 48;
+	struct pgm_sk_buff_t* skb = generate_spm (1, 50, 200);
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (FALSE == mock_rxw_resumed, "resumed");
+	fail_unless (0 == peer->is_resumed, "still resuming");
+	pgm_free_skb (skb);
+
+	peer = generate_peer ();
+	peer->is_resumed = 1;
+	peer->resume_sqn = 201;
+	skb = generate_spm (1, 50, 200);
+	fail_unless (TRUE == pgm_on_spm (sock, peer, skb), "on_spm failed");
+	fail_unless (FALSE == mock_rxw_resumed, "resumed");
+	fail_unless (0 == peer->is_resumed, "still resuming");
+	pgm_free_skb (skb);
+}
+END_TEST
+
 /* target:
  *	bool
  *	pgm_check_peer_state (
@@ -814,11 +1066,32 @@ make_test_suite (void)
 	suite_add_tcase (s, tc_peer_unref);
 	tcase_add_checked_fixture (tc_peer_unref, mock_setup, NULL);
 	tcase_add_test (tc_peer_unref, test_peer_unref_pass_001);
+	tcase_add_test (tc_peer_unref, test_peer_unref_pass_003);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_peer_unref, test_peer_unref_fail_001, SIGABRT);
 #endif
 
 /* formally check-peer-nak-state */
+	TCase* tc_admit_new_peer = tcase_create ("admit-new-peer");
+	suite_add_tcase (s, tc_admit_new_peer);
+	tcase_add_checked_fixture (tc_admit_new_peer, mock_setup, NULL);
+	tcase_add_test (tc_admit_new_peer, test_admit_new_peer_pass_001);
+	tcase_add_test (tc_admit_new_peer, test_admit_new_peer_pass_002);
+
+	TCase* tc_spmr_ivl = tcase_create ("spmr-ivl");
+	suite_add_tcase (s, tc_spmr_ivl);
+	tcase_add_checked_fixture (tc_spmr_ivl, mock_setup, NULL);
+	tcase_add_test (tc_spmr_ivl, test_spmr_ivl_pass_001);
+	tcase_add_test (tc_spmr_ivl, test_spmr_ivl_pass_002);
+	tcase_add_test (tc_spmr_ivl, test_spmr_ivl_pass_003);
+
+	TCase* tc_on_spm = tcase_create ("on-spm");
+	suite_add_tcase (s, tc_on_spm);
+	tcase_add_checked_fixture (tc_on_spm, mock_setup, NULL);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_001);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_002);
+	tcase_add_test (tc_on_spm, test_on_spm_pass_003);
+
 	TCase* tc_check_peer_state = tcase_create ("check-peer-state");
 	suite_add_tcase (s, tc_check_peer_state);
 	tcase_add_checked_fixture (tc_check_peer_state, mock_setup, NULL);
@@ -32,6 +32,9 @@
 #	include <sys/types.h>
 #	include <sys/socket.h>
 #	include <netinet/in.h>		/* _GNU_SOURCE for in6_pktinfo */
+#	include <sys/uio.h>
+#	include <limits.h>
+#	include <unistd.h>
 #else
 #	include <ws2tcpip.h>
 #	include <mswsock.h>
@@ -50,6 +53,10 @@
 #	define PGM_DISABLE_ASSERT
 #endif
 
+#if !defined( _WIN32 ) && !defined( IOV_MAX )
+#	define IOV_MAX				16	/* _XOPEN_IOV_MAX */
+#endif
+
 #ifndef _WIN32
 #	define PGM_CMSG_FIRSTHDR(msg)		CMSG_FIRSTHDR(msg)
 #	define PGM_CMSG_NXTHDR(msg, cmsg)	CMSG_NXTHDR(msg, cmsg)
@@ -76,7 +83,7 @@
 #endif
 
 
-/* read a packet into a PGM skbuff
+/* read a packet from socket s into a PGM skbuff
  * on success returns packet length, on closed socket returns 0,
  * on error returns -1.
  */
@@ -85,6 +92,7 @@ static
 ssize_t
 recvskb (
 	pgm_sock_t*           const restrict sock,
+	const SOCKET			     s,
 	struct pgm_sk_buff_t* const restrict skb,
 	const int			     flags,
 	struct sockaddr*      const restrict src_addr,
@@ -122,7 +130,7 @@ recvskb (
 		.msg_controllen = sizeof(aux),
 		.msg_flags	= 0
 	};
-	ssize_t len = recvmsg (sock->recv_sock, &msg, flags);
+	ssize_t len = recvmsg (s, &msg, flags);
 	if (len <= 0)
 		return len;
 #else /* !_WIN32 */
@@ -136,7 +144,7 @@ recvskb (
 	msg.Control.buf		= aux;
 	msg.Control.len		= sizeof(aux);
 	DWORD len;
-	if (SOCKET_ERROR == pgm_WSARecvMsg (sock->recv_sock, &msg, &len, NULL, NULL)) {
+	if (SOCKET_ERROR == pgm_WSARecvMsg (s, &msg, &len, NULL, NULL)) {
 		return SOCKET_ERROR;
 	}
 #endif /* !_WIN32 */
@@ -157,9 +165,12 @@ recvskb (
 	skb->data		= skb->head;
 	skb->len		= (uint16_t)len;
 	skb->zero_padded	= 0;
+	skb->is_ce		= 0;
+	skb->is_transformed	= 0;
 	skb->tail		= (char*)skb->data + len;
 
 	if (sock->udp_encap_ucast_port ||
+	    sock->use_ecn ||
 	    AF_INET6 == pgm_sockaddr_family (src_addr))
 	{
 		struct pgm_cmsghdr* cmsg;
@@ -186,7 +197,7 @@ recvskb (
 				s4.sin_family			= AF_INET;
 				s4.sin_addr.s_addr		= in->ipi_addr.s_addr;
 				memcpy (dst_addr, &s4, sizeof(s4));
-				break;
+				continue;
 			}
 #endif
 #ifdef IP_RECVDSTADDR
@@ -205,7 +216,7 @@ recvskb (
 				s4.sin_family			= AF_INET;
 				s4.sin_addr.s_addr		= in->s_addr;
 				memcpy (dst_addr, &s4, sizeof(s4));
-				break;
+				continue;
 			}
 #endif
 #if !defined(IP_PKTINFO) && !defined(IP_RECVDSTADDR)
@@ -229,8 +240,28 @@ recvskb (
 				s6.sin6_scope_id		= in6->ipi6_ifindex;
 				memcpy (dst_addr, &s6, sizeof(s6));
 /* does not set flow id */
-				break;
+				continue;
 			}
+
+/* ECN field of type-of-service or traffic class */
+#ifdef IP_RECVTOS
+			if (IPPROTO_IP == cmsg->cmsg_level &&
+			    IP_TOS == cmsg->cmsg_type)
+			{
+				const void* tos			= PGM_CMSG_DATA(cmsg);
+				skb->is_ce			= (PGM_ECN_CE == (*(const uint8_t*)tos & PGM_ECN_MASK));
+				continue;
+			}
+#endif
+#ifdef IPV6_RECVTCLASS
+			if (IPPROTO_IPV6 == cmsg->cmsg_level &&
+			    IPV6_TCLASS == cmsg->cmsg_type)
+			{
+				const void* tclass		= PGM_CMSG_DATA(cmsg);
+				skb->is_ce			= (PGM_ECN_CE == (*(const int*)tclass & PGM_ECN_MASK));
+				continue;
+			}
+#endif
 		}
 	}
 	return len;
@@ -254,7 +285,9 @@ on_upstream (
 /* pre-conditions */
 	pgm_assert (NULL != sock);
 	pgm_assert (NULL != skb);
-	pgm_assert_cmpuint (skb->pgm_header->pgm_dport, ==, sock->tsi.sport);
+	pgm_assert (skb->pgm_header->pgm_dport == sock->tsi.sport ||
+		    skb->pgm_header->pgm_dport == sock->lane.tsi.sport ||
+		    NULL != pgm_layer_find (sock, skb->pgm_header->pgm_dport));
 
 	pgm_debug ("on_upstream (sock:%p skb:%p)",
 		(const void*)sock, (const void*)skb);
@@ -277,6 +310,15 @@ on_upstream (
 		goto out_discarded;
 	}
 
+/* priority lane and layer sessions carry neither congestion control nor DLR traffic */
+	if (skb->pgm_header->pgm_dport != sock->tsi.sport &&
+	    PGM_NAK != skb->pgm_header->pgm_type &&
+	    PGM_SPMR != skb->pgm_header->pgm_type)
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Discarded unsupported PGM type packet for companion session."));
+		goto out_discarded;
+	}
+
 /* advance SKB pointer to PGM type header */
 	skb->data	= (char*)skb->data + sizeof(struct pgm_header);
 	skb->len       -= sizeof(struct pgm_header);
@@ -454,6 +496,8 @@ on_downstream (
 						skb->tstamp);
 		}
 		sock->last_hash_value = *source;
+		if (PGM_UNLIKELY(NULL == *source))
+			goto out_discarded;
 	}
 
 	(*source)->cumulative_stats[PGM_PC_RECEIVER_BYTES_RECEIVED] += skb->len;
@@ -537,7 +581,9 @@ on_pgm (
 
 	if (PGM_IS_DOWNSTREAM (skb->pgm_header->pgm_type))
 		return on_downstream (sock, skb, src_addr, dst_addr, source);
-	if (skb->pgm_header->pgm_dport == sock->tsi.sport)
+	if (skb->pgm_header->pgm_dport == sock->tsi.sport ||
+	    (NULL != sock->lane.window && skb->pgm_header->pgm_dport == sock->lane.tsi.sport) ||
+	    (sock->layers_len && NULL != pgm_layer_find (sock, skb->pgm_header->pgm_dport)))
 	{
 		if (PGM_IS_UPSTREAM (skb->pgm_header->pgm_type) ||
 		    PGM_IS_PEER (skb->pgm_header->pgm_type))
@@ -554,6 +600,24 @@ on_pgm (
 	return FALSE;
 }
 
+/* source has queued repairs on the session, priority lane or a layer
+ */
+
+static inline
+bool
+is_repair_pending (
+	const pgm_sock_t* const	sock
+	)
+{
+	if (!pgm_txw_retransmit_is_empty (sock->window) ||
+	    (NULL != sock->lane.window && !pgm_txw_retransmit_is_empty (sock->lane.window)))
+		return TRUE;
+	for (unsigned i = 0; i < sock->layers_len; i++)
+		if (NULL != sock->layers[i].window && !pgm_txw_retransmit_is_empty (sock->layers[i].window))
+			return TRUE;
+	return FALSE;
+}
+
 /* block on receiving socket whilst holding sock::waiting-mutex
  * returns EAGAIN for waiting data, returns EINTR for waiting timer event,
  * returns ENOENT on closed sock, and returns EFAULT for libc error.
@@ -565,7 +629,7 @@ wait_for_event (
 	pgm_sock_t* const	sock
 	)
 {
-	int n_fds = 3;
+	int n_fds = 4;
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
@@ -576,7 +640,7 @@ wait_for_event (
 		if (PGM_UNLIKELY(sock->is_destroyed))
 			return ENOENT;
 
-		if (sock->can_send_data && !pgm_txw_retransmit_is_empty (sock->window))
+		if (sock->can_send_data && is_repair_pending (sock))
 /* tight loop on blocked send */
 			pgm_on_deferred_nak (sock);
 
@@ -599,7 +663,7 @@ wait_for_event (
 		}
 
 		int timeout;
-		if (sock->can_send_data && !pgm_txw_retransmit_is_empty (sock->window))
+		if (sock->can_send_data && is_repair_pending (sock))
 			timeout = 0;
 		else
 			timeout = (int)pgm_timer_expiration (sock);
@@ -716,13 +780,19 @@ pgm_recvmsgv (
 /* NAK status */
 	else if (sock->can_send_data)
 	{
-		if (!pgm_txw_retransmit_is_empty (sock->window))
+		if (is_repair_pending (sock))
 		{
 			if (!pgm_on_deferred_nak (sock))
 				status = PGM_IO_STATUS_RATE_LIMITED;
 		}
 		else
 			pgm_notify_clear (&sock->rdata_notify);
+/* transmit timestamps */
+		if (sock->tx_tstamp) {
+			pgm_mutex_lock (&sock->tx_tstamp->mutex);
+			pgm_tx_tstamp_reap (sock->tx_tstamp);
+			pgm_mutex_unlock (&sock->tx_tstamp->mutex);
+		}
 	}
 
 	size_t bytes_read = 0;
@@ -732,6 +802,17 @@ pgm_recvmsgv (
 
 	if (PGM_UNLIKELY(0 == ++(sock->last_commit)))
 		++(sock->last_commit);
+	if (sock->compress)
+		pgm_compress_release (sock->compress);
+
+/* first, journal replay precedes live data, buffers are held until the next call */
+	if (sock->journal) {
+		pgm_journal_release_replay (sock->journal);
+		if (PGM_UNLIKELY(pgm_journal_is_replaying (sock->journal))) {
+			pgm_journal_replay (sock->journal, &pmsg, msg_end, &bytes_read, &data_read);
+			goto out;
+		}
+	}
 
 	/* second, flush any remaining contiguous messages from previous call(s) */
 	if (sock->peers_pending) {
@@ -745,18 +826,46 @@ pgm_recvmsgv (
  * We cannot actually block here as packets pushed by the timers need to be addressed too.
  */
 	struct sockaddr_storage src, dst;
+	struct pgm_sk_buff_t* skb;
 	ssize_t len;
 	size_t bytes_received = 0;
 
 recv_again:
 
-	len = recvskb (sock,
-		       sock->rx_buffer,		/* PGM skbuff */
-		       0,
-		       (struct sockaddr*)&src,
-		       sizeof(src),
-		       (struct sockaddr*)&dst,
-		       sizeof(dst));
+	skb = sock->rx_buffer;
+	if (sock->packet_mmap)
+		len = pgm_packet_mmap_recv (sock,
+					    &skb,	/* rx_buffer or in ring */
+					    (struct sockaddr*)&src,
+					    sizeof(src));
+	else if (sock->xdp) {
+		len = pgm_xdp_recv (sock,
+				    &skb,		/* rx_buffer or in UMEM */
+				    (struct sockaddr*)&src,
+				    sizeof(src),
+				    (struct sockaddr*)&dst,
+				    sizeof(dst));
+/* frames steered to queues without the XSK socket arrive through the stack */
+		if (len < 0 && PGM_SOCK_EAGAIN == pgm_get_last_sock_error()) {
+			skb = sock->rx_buffer;
+			len = recvskb (sock,
+				       sock->xdp->ip_sock,
+				       skb,
+				       0,
+				       (struct sockaddr*)&src,
+				       sizeof(src),
+				       (struct sockaddr*)&dst,
+				       sizeof(dst));
+		}
+	} else
+		len = recvskb (sock,
+			       sock->recv_sock,
+			       skb,		/* PGM skbuff */
+			       0,
+			       (struct sockaddr*)&src,
+			       sizeof(src),
+			       (struct sockaddr*)&dst,
+			       sizeof(dst));
 	if (len < 0)
 	{
 		const int save_errno = pgm_get_last_sock_error();
@@ -785,8 +894,8 @@ recv_again:
 
 	pgm_error_t* err = NULL;
 	const bool is_valid = (sock->udp_encap_ucast_port || AF_INET6 == src.ss_family) ?
-					pgm_parse_udp_encap (sock->rx_buffer, &err) :
-					pgm_parse_raw (sock->rx_buffer, (struct sockaddr*)&dst, &err);
+					pgm_parse_udp_encap (skb, &err) :
+					pgm_parse_raw (skb, (struct sockaddr*)&dst, &err);
 	if (PGM_UNLIKELY(!is_valid))
 	{
 /* inherently cannot determine PGM_PC_RECEIVER_CKSUM_ERRORS unless only one receiver */
@@ -803,7 +912,7 @@ recv_again:
 	}
 
 	pgm_peer_t* source = NULL;
-	if (PGM_UNLIKELY(!on_pgm (sock, sock->rx_buffer, (struct sockaddr*)&src, (struct sockaddr*)&dst, &source)))
+	if (PGM_UNLIKELY(!on_pgm (sock, skb, (struct sockaddr*)&src, (struct sockaddr*)&dst, &source)))
 		goto recv_again;
 
 /* check whether this source has waiting data */
@@ -910,7 +1019,8 @@ out:
 		return status;
 	}
 
-	if (sock->peers_pending)
+	if (sock->peers_pending ||
+	    (sock->journal && pgm_journal_is_replaying (sock->journal)))
 	{
 /* set event notification for additional available data */
 		if (sock->is_pending_read && sock->is_edge_triggered_recv)
@@ -958,6 +1068,48 @@ pgm_recvmsg (
 	return pgm_recvmsgv (sock, msgv, 1, flags, bytes_read, error);
 }
 
+/* describe the position of a message within its APDU.  with PGM_STREAMING_READ
+ * an APDU may span several messages, a message with offset zero following an
+ * incomplete APDU from the same source indicates the earlier APDU was lost.
+ *
+ * returns TRUE on success, returns FALSE if msgv is empty.
+ */
+
+bool
+pgm_msgv_get_fragment_info (
+	const struct pgm_msgv_t*   const restrict msgv,
+	struct pgm_fragment_info_t* const restrict info
+	)
+{
+	const struct pgm_sk_buff_t* skb;
+
+	pgm_return_val_if_fail (NULL != msgv, FALSE);
+	pgm_return_val_if_fail (NULL != info, FALSE);
+
+	if (PGM_UNLIKELY(0 == msgv->msgv_len))
+		return FALSE;
+
+	skb = msgv->msgv_skb[0];
+	info->fi_length = 0;
+	for (unsigned i = 0; i < msgv->msgv_len; i++)
+		info->fi_length += msgv->msgv_skb[i]->len;
+
+/* single TPDU APDU */
+	if (NULL == skb->pgm_opt_fragment) {
+		info->fi_apdu_first_sqn	= skb->sequence;
+		info->fi_offset		= 0;
+		info->fi_apdu_length	= info->fi_length;
+		info->fi_is_final	= TRUE;
+		return TRUE;
+	}
+
+	info->fi_apdu_first_sqn	= pgm_ntohl (skb->of_apdu_first_sqn);
+	info->fi_offset		= pgm_ntohl (skb->of_frag_offset);
+	info->fi_apdu_length	= pgm_ntohl (skb->of_apdu_len);
+	info->fi_is_final	= (info->fi_offset + info->fi_length == info->fi_apdu_length);
+	return TRUE;
+}
+
 /* vanilla read function.  copies from the receive window to the provided buffer
  * location.  the caller must provide an adequately sized buffer to store the largest
  * expected apdu or else it will be truncated.
@@ -1045,4 +1197,102 @@ pgm_recv (
 	return pgm_recvfrom (sock, buf, buflen, flags, bytes_read, NULL, NULL, error);
 }
 
+#ifndef _WIN32
+/* Forward delivered APDUs to a descriptor, such as a TCP connection or file,
+ * without copying through an application buffer.  The payload of each skb
+ * is gathered in place with writev(), up to PGM_FORWARD_MSGV_LEN APDUs per
+ * read.  On a partial write the remainder and its window skbs are held, no
+ * further data is read until the descriptor has accepted it.  APDU
+ * boundaries are not marked in the output.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL with bytes forwarded, returns
+ * PGM_IO_STATUS_WOULD_BLOCK if the descriptor accepted nothing of pending
+ * payload, PGM_IO_STATUS_ERROR on write failure, otherwise as pgm_recvmsgv().
+ */
+
+int
+pgm_recv_forward (
+	pgm_sock_t*   const restrict sock,
+	const int		     fd,
+	const int		     flags,		/* MSG_DONTWAIT for non-blocking read */
+	size_t*		    restrict _bytes_forwarded,	/* may be NULL */
+	pgm_error_t**	    restrict error
+	)
+{
+	size_t bytes_forwarded = 0;
+
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (fd >= 0, PGM_IO_STATUS_ERROR);
+
+	pgm_debug ("pgm_recv_forward (sock:%p fd:%d flags:%d bytes-forwarded:%p error:%p)",
+		(const void*)sock, fd, flags, (const void*)_bytes_forwarded, (const void*)error);
+
+	if (PGM_UNLIKELY(NULL == sock->forward_msgv)) {
+		sock->forward_msgv = pgm_new (struct pgm_msgv_t, PGM_FORWARD_MSGV_LEN);
+		sock->forward_iov  = pgm_new (struct pgm_iovec, PGM_FORWARD_MSGV_LEN * PGM_MAX_FRAGMENTS);
+	}
+
+/* payload of the previous read is written before the window is read again */
+	if (sock->forward_iov_offset == sock->forward_iov_len)
+	{
+		size_t bytes_read = 0, bytes_gathered = 0;
+		const int status = pgm_recvmsgv (sock, sock->forward_msgv, PGM_FORWARD_MSGV_LEN, flags, &bytes_read, error);
+		if (PGM_IO_STATUS_NORMAL != status)
+			return status;
+
+		sock->forward_iov_len = sock->forward_iov_offset = 0;
+		for (const struct pgm_msgv_t* msgv = sock->forward_msgv; bytes_gathered < bytes_read; msgv++) {
+			for (unsigned i = 0; i < msgv->msgv_len; i++) {
+				struct pgm_iovec* iov = &sock->forward_iov[ sock->forward_iov_len++ ];
+				iov->iov_base = msgv->msgv_skb[i]->data;
+				iov->iov_len  = msgv->msgv_skb[i]->len;
+				bytes_gathered += iov->iov_len;
+			}
+		}
+	}
+
+	while (sock->forward_iov_offset < sock->forward_iov_len)
+	{
+		struct pgm_iovec* iov = &sock->forward_iov[ sock->forward_iov_offset ];
+		const int iovcnt = (int)MIN( sock->forward_iov_len - sock->forward_iov_offset, IOV_MAX );
+		ssize_t wrote = writev (fd, (const struct iovec*)iov, iovcnt);
+		if (wrote < 0) {
+			const int save_errno = errno;
+			char errbuf[1024];
+			if (EINTR == save_errno)
+				continue;
+			if (EAGAIN == save_errno || EWOULDBLOCK == save_errno)
+				break;
+			pgm_set_error (error,
+				     PGM_ERROR_DOMAIN_RECV,
+				     pgm_error_from_errno (save_errno),
+				     _("Forwarding to descriptor %d: %s"),
+				     fd, pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			if (_bytes_forwarded)
+				*_bytes_forwarded = bytes_forwarded;
+			return PGM_IO_STATUS_ERROR;
+		}
+		bytes_forwarded += wrote;
+/* skip written entries, trim a partly written one */
+		while (sock->forward_iov_offset < sock->forward_iov_len &&
+		       (size_t)wrote >= iov->iov_len)
+		{
+			wrote -= iov->iov_len;
+			iov++;
+			sock->forward_iov_offset++;
+		}
+		if (wrote) {
+			iov->iov_base  = (char*)iov->iov_base + wrote;
+			iov->iov_len  -= wrote;
+		}
+	}
+
+	if (_bytes_forwarded)
+		*_bytes_forwarded = bytes_forwarded;
+	if (0 == bytes_forwarded && sock->forward_iov_offset < sock->forward_iov_len)
+		return PGM_IO_STATUS_WOULD_BLOCK;
+	return PGM_IO_STATUS_NORMAL;
+}
+#endif /* !_WIN32 */
+
 /* eof */
@@ -31,6 +31,8 @@
 #	include <sys/socket.h>
 #	include <netinet/in.h>		/* _GNU_SOURCE for in6_pktinfo */
 #	include <arpa/inet.h>
+#	include <fcntl.h>
+#	include <unistd.h>
 #else
 #	include <ws2tcpip.h>
 #	include <mswsock.h>
@@ -126,6 +128,8 @@ static int mock_recvfrom (SOCKET, char*, int, int, struct sockaddr*, int*);
 #define recvfrom			mock_recvfrom
 #define pgm_WSARecvMsg			mock_pgm_WSARecvMsg
 #define pgm_loss_rate			mock_pgm_loss_rate
+#define pgm_journal_release_replay	mock_pgm_journal_release_replay
+#define pgm_journal_replay		mock_pgm_journal_replay
 
 #define RECV_DEBUG
 #include "recv.c"
@@ -690,6 +694,26 @@ mock_pgm_set_reset_error (
 {
 }
 
+PGM_GNUC_INTERNAL
+void
+mock_pgm_journal_release_replay (
+	pgm_journal_t* const		journal
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_journal_replay (
+	pgm_journal_t* const		journal,
+	struct pgm_msgv_t**		pmsg,
+	const struct pgm_msgv_t* const	msg_end,
+	size_t* const			bytes_read,
+	unsigned* const			data_read
+	)
+{
+}
+
 PGM_GNUC_INTERNAL
 int
 mock_pgm_flush_peers_pending (
@@ -1636,6 +1660,221 @@ START_TEST (test_recvmsgv_fail_001)
 }
 END_TEST
 
+#ifndef _WIN32
+/* receiver with a waiting peer delivering an APDU of fragments of each
+ * length in tsdu_length, payload bytes counting up from zero.
+ *
+ * returns the APDU length.
+ */
+
+static
+gsize
+generate_forward_apdu (
+	pgm_sock_t*		sock,
+	const gsize*		tsdu_length,
+	const unsigned		fragment_count
+	)
+{
+	gsize apdu_length = 0;
+	if (NULL == mock_peer) {
+		mock_data_on_spmr = TRUE;
+		gpointer packet; gsize packet_len;
+		generate_spmr (&packet, &packet_len);
+		generate_msghdr (packet, packet_len);
+		const pgm_tsi_t peer_tsi = { { 9, 8, 7, 6, 5, 4 }, g_htons(9000) };
+		struct sockaddr_in grp_addr = {
+			.sin_family		= AF_INET,
+			.sin_addr.s_addr	= inet_addr(TEST_GROUP_ADDR)
+		}, peer_addr = {
+			.sin_family		= AF_INET,
+			.sin_addr.s_addr	= inet_addr(TEST_END_ADDR)
+		};
+		mock_peer = mock_pgm_new_peer (sock, &peer_tsi, (struct sockaddr*)&grp_addr, sizeof(grp_addr), (struct sockaddr*)&peer_addr, sizeof(peer_addr), mock_pgm_time_now);
+	}
+	struct pgm_msgv_t* msgv = g_new0 (struct pgm_msgv_t, 1);
+	for (unsigned i = 0; i < fragment_count; i++) {
+		struct pgm_sk_buff_t* skb = pgm_alloc_skb (TEST_MAX_TPDU);
+		guint8* data = pgm_skb_put (skb, (uint16_t)tsdu_length[i]);
+		for (gsize j = 0; j < tsdu_length[i]; j++)
+			data[j] = (guint8)(apdu_length + j);
+		apdu_length += tsdu_length[i];
+		msgv->msgv_skb[ msgv->msgv_len++ ] = skb;
+	}
+	mock_data_list = g_list_append (mock_data_list, msgv);
+	push_block_event ();
+	return apdu_length;
+}
+
+/* non-blocking pipe, returns bytes of filler written when full_pipe is set */
+
+static
+gsize
+generate_pipe (
+	int			filedes[2],
+	const gboolean		full_pipe
+	)
+{
+	const char filler[ 4096 ] = { 0 };
+	gsize filled = 0;
+	fail_unless (0 == pipe (filedes), "pipe failed");
+	fail_unless (0 == fcntl (filedes[1], F_SETFL, O_NONBLOCK), "fcntl failed");
+	fail_unless (0 == fcntl (filedes[0], F_SETFL, O_NONBLOCK), "fcntl failed");
+	while (full_pipe) {
+		const ssize_t wrote = write (filedes[1], filler, sizeof(filler));
+		if (wrote < 0) {
+			fail_unless (EAGAIN == errno || EWOULDBLOCK == errno, "write failed");
+			break;
+		}
+		filled += wrote;
+	}
+	return filled;
+}
+
+/* read len bytes of forwarded payload, checking it continues from offset */
+
+static
+void
+check_forwarded (
+	const int		fd,
+	const gsize		offset,
+	const gsize		len
+	)
+{
+	guint8 buffer[ TEST_MAX_TPDU ];
+	gsize done = 0;
+	while (done < len) {
+		const ssize_t got = read (fd, buffer, MIN(sizeof(buffer), len - done));
+		fail_unless (got > 0, "read failed");
+		for (ssize_t i = 0; i < got; i++)
+			fail_unless ((guint8)(offset + done + i) == buffer[i], "payload mismatch");
+		done += got;
+	}
+}
+
+static
+void
+drain_pipe (
+	const int		fd,
+	gsize			len
+	)
+{
+	guint8 buffer[ 4096 ];
+	while (len) {
+		const ssize_t got = read (fd, buffer, MIN(sizeof(buffer), len));
+		fail_unless (got > 0, "read failed");
+		len -= got;
+	}
+}
+
+/* target:
+ *	int
+ *	pgm_recv_forward (
+ *		pgm_sock_t* const	sock,
+ *		const int		fd,
+ *		const int		flags,
+ *		size_t*			bytes_forwarded,
+ *		pgm_error_t**		error
+ *		)
+ */
+
+/* fragmented APDU gathered in order */
+START_TEST (test_recv_forward_pass_001)
+{
+	const gsize fragments[] = { 1000, 1000, 500 };
+	pgm_sock_t* sock = generate_sock();
+	fail_if (NULL == sock, "generate_sock failed");
+	const gsize apdu_length = generate_forward_apdu (sock, fragments, G_N_ELEMENTS(fragments));
+	int filedes[2];
+	generate_pipe (filedes, FALSE);
+	gsize bytes_forwarded = 0;
+	pgm_error_t* err = NULL;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not normal");
+	fail_unless (NULL == err, "error raised");
+	fail_unless (apdu_length == bytes_forwarded, "forwarded length");
+	check_forwarded (filedes[0], 0, apdu_length);
+	fail_unless (sock->forward_iov_offset == sock->forward_iov_len, "payload held");
+	close (filedes[0]); close (filedes[1]);
+}
+END_TEST
+
+/* short write holds the remainder without reading the window again */
+START_TEST (test_recv_forward_pass_002)
+{
+	const gsize fragments[] = { 1400, 1400, 1400 };
+	pgm_sock_t* sock = generate_sock();
+	fail_if (NULL == sock, "generate_sock failed");
+	const gsize apdu_length = generate_forward_apdu (sock, fragments, G_N_ELEMENTS(fragments));
+	int filedes[2];
+	const gsize filled = generate_pipe (filedes, TRUE);
+	drain_pipe (filedes[0], 4096);
+	gsize bytes_forwarded = 0;
+	pgm_error_t* err = NULL;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not normal");
+	const gsize written = bytes_forwarded;
+	fail_unless (written > 0 && written < apdu_length, "not a short write");
+	fail_unless (sock->forward_iov_offset < sock->forward_iov_len, "remainder not held");
+	drain_pipe (filedes[0], filled - 4096);
+	check_forwarded (filedes[0], 0, written);
+/* another APDU waits in the window behind the remainder */
+	const gsize next[] = { 100 };
+	generate_forward_apdu (sock, next, G_N_ELEMENTS(next));
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not normal");
+	fail_unless (NULL == err, "error raised");
+	fail_unless (apdu_length - written == bytes_forwarded, "remainder length");
+	check_forwarded (filedes[0], written, apdu_length - written);
+	fail_unless (NULL != mock_data_list, "window read before remainder written");
+	close (filedes[0]); close (filedes[1]);
+}
+END_TEST
+
+/* full descriptor would block, then forwards everything once drained */
+START_TEST (test_recv_forward_pass_003)
+{
+	const gsize fragments[] = { 1000, 200 };
+	pgm_sock_t* sock = generate_sock();
+	fail_if (NULL == sock, "generate_sock failed");
+	const gsize apdu_length = generate_forward_apdu (sock, fragments, G_N_ELEMENTS(fragments));
+	int filedes[2];
+	const gsize filled = generate_pipe (filedes, TRUE);
+	gsize bytes_forwarded = 1;
+	pgm_error_t* err = NULL;
+	fail_unless (PGM_IO_STATUS_WOULD_BLOCK == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not would-block");
+	fail_unless (NULL == err, "error raised");
+	fail_unless (0 == bytes_forwarded, "forwarded length");
+	drain_pipe (filedes[0], filled);
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not normal");
+	fail_unless (apdu_length == bytes_forwarded, "forwarded length");
+	check_forwarded (filedes[0], 0, apdu_length);
+	close (filedes[0]); close (filedes[1]);
+}
+END_TEST
+
+/* closed descriptor */
+START_TEST (test_recv_forward_fail_001)
+{
+	const gsize fragments[] = { 100 };
+	pgm_sock_t* sock = generate_sock();
+	fail_if (NULL == sock, "generate_sock failed");
+	generate_forward_apdu (sock, fragments, G_N_ELEMENTS(fragments));
+	int filedes[2];
+	generate_pipe (filedes, FALSE);
+	close (filedes[1]);
+	gsize bytes_forwarded;
+	pgm_error_t* err = NULL;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_recv_forward (sock, filedes[1], MSG_DONTWAIT, &bytes_forwarded, &err), "forward not error");
+	fail_if (NULL == err, "no error raised");
+	pgm_error_free (err);
+	close (filedes[0]);
+}
+END_TEST
+
+START_TEST (test_recv_forward_fail_002)
+{
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_recv_forward (NULL, 1, 0, NULL, NULL), "forward not error");
+}
+END_TEST
+#endif /* !_WIN32 */
+
 
 static
 Suite*
@@ -1745,6 +1984,17 @@ make_test_suite (void)
 	tcase_add_checked_fixture (tc_recvmsgv, mock_setup, mock_teardown);
 	tcase_add_test (tc_recvmsgv, test_recvmsgv_fail_001);
 
+#ifndef _WIN32
+	TCase* tc_recv_forward = tcase_create ("recv-forward");
+	suite_add_tcase (s, tc_recv_forward);
+	tcase_add_checked_fixture (tc_recv_forward, mock_setup, mock_teardown);
+	tcase_add_test (tc_recv_forward, test_recv_forward_pass_001);
+	tcase_add_test (tc_recv_forward, test_recv_forward_pass_002);
+	tcase_add_test (tc_recv_forward, test_recv_forward_pass_003);
+	tcase_add_test (tc_recv_forward, test_recv_forward_fail_001);
+	tcase_add_test (tc_recv_forward, test_recv_forward_fail_002);
+#endif
+
 	return s;
 }
 
@@ -1765,7 +2015,7 @@ main (void)
 	g_assert (0 == WSAStartup (wVersionRequested, &wsaData));
 	g_assert (LOBYTE (wsaData.wVersion) == 2 && HIBYTE (wsaData.wVersion) == 2);
 #endif
-	g_assert (pgm_time_init (NULL));
+	g_assert (pgm_time_init (NULL, NULL));
 	pgm_rand_init();
 	pgm_messages_init();
 	SRunner* sr = srunner_create (make_master_suite ());
@@ -76,6 +76,7 @@ static inline void _pgm_rxw_shuffle_parity (pgm_rxw_t*const restrict, struct pgm
 static inline ssize_t _pgm_rxw_incoming_read (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict, uint32_t);
 static bool _pgm_rxw_is_apdu_complete (pgm_rxw_t*const, const uint32_t);
 static inline ssize_t _pgm_rxw_incoming_read_apdu (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict);
+static inline ssize_t _pgm_rxw_incoming_read_stream (pgm_rxw_t*const restrict, struct pgm_msgv_t**restrict);
 static inline int _pgm_rxw_recovery_update (pgm_rxw_t*const, const uint32_t, const pgm_time_t);
 static inline int _pgm_rxw_recovery_append (pgm_rxw_t*const, const pgm_time_t, const pgm_time_t);
 
@@ -268,6 +269,53 @@ pgm_rxw_destroy (
 	pgm_free (window);
 }
 
+/* return window to the empty state of pgm_rxw_create() keeping the sequence
+ * array allocation, for re-use by a new peer.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rxw_reset (
+	pgm_rxw_t* const	window
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert_cmpuint (window->alloc, >, 0);
+
+	pgm_debug ("reset (window:%p)", (const void*)window);
+
+/* contents of window */
+	while (!pgm_rxw_is_empty (window)) {
+		_pgm_rxw_remove_trail (window);
+	}
+	if (window->is_fec_available)
+		pgm_rs_destroy (&window->rs);
+
+	const pgm_tsi_t* tsi	= window->tsi;
+	const uint16_t max_tpdu	= window->max_tpdu;
+	const uint32_t ack_c_p	= window->ack_c_p;
+	const unsigned alloc	= window->alloc;
+	memset (window, 0, offsetof (pgm_rxw_t, pdata));
+	window->tsi		= tsi;
+	window->max_tpdu	= max_tpdu;
+	window->ack_c_p		= ack_c_p;
+	window->alloc		= alloc;
+
+/* as pgm_rxw_create() */
+	window->lead		= -1;
+	window->trail		= window->lead + 1;
+	window->is_constrained	= TRUE;
+	window->tg_size		= 1;
+	window->bitmap		= 0xffffffff;
+
+/* post-conditions */
+	pgm_assert_cmpuint (pgm_rxw_max_length (window), ==, alloc);
+	pgm_assert_cmpuint (pgm_rxw_length (window), ==, 0);
+	pgm_assert_cmpuint (pgm_rxw_size (window), ==, 0);
+	pgm_assert (pgm_rxw_is_empty (window));
+}
+
 /* add skb to receive window.  window has fixed size and will not grow.
  * PGM skbuff data/tail pointers must point to the PGM payload, and hence skb->len
  * is allowed to be zero.
@@ -342,15 +390,16 @@ pgm_rxw_add (
 			skb->pgm_opt_fragment = NULL;
 
 /* protocol sanity check: minimum APDU length */
-		if (PGM_UNLIKELY(pgm_ntohl (skb->of_apdu_len) < skb->len))
+		else if (PGM_UNLIKELY(pgm_ntohl (skb->of_apdu_len) < skb->len))
 			return PGM_RXW_MALFORMED;
 
 /* protocol sanity check: sequential ordering */
-		if (PGM_UNLIKELY(pgm_uint32_gt (pgm_ntohl (skb->of_apdu_first_sqn), skb->sequence)))
+		else if (PGM_UNLIKELY(pgm_uint32_gt (pgm_ntohl (skb->of_apdu_first_sqn), skb->sequence)))
 			return PGM_RXW_MALFORMED;
 
-/* protocol sanity check: maximum APDU length */
-		if (PGM_UNLIKELY(pgm_ntohl (skb->of_apdu_len) > PGM_MAX_APDU))
+/* protocol sanity check: maximum APDU length, unbounded when streaming */
+		else if (PGM_UNLIKELY(!window->is_streaming &&
+				      pgm_ntohl (skb->of_apdu_len) > PGM_MAX_APDU))
 			return PGM_RXW_MALFORMED;
 	}
 
@@ -452,6 +501,51 @@ _pgm_rxw_define (
 	pgm_assert (window->is_constrained);
 }
 
+/* resume a new window after the last sequence delivered by a previous
+ * session of this receiver.  repairs are requested from the next sequence
+ * without waiting for the advertised trail to advance, earlier sequences are
+ * dropped as duplicates.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rxw_resume (
+	pgm_rxw_t* const	window,
+	const uint32_t		last_sqn
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (!window->is_defined);
+
+	pgm_debug ("pgm_rxw_resume (window:%p last-sqn:%" PRIu32 ")",
+		(void*)window, last_sqn);
+
+	_pgm_rxw_define (window, last_sqn);
+	window->is_constrained = FALSE;
+}
+
+/* apply the source's late join minimum, sequences before it are marked lost
+ * instead of being requested.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_rxw_join (
+	pgm_rxw_t* const	window,
+	const uint32_t		join_min
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (window->is_defined);
+
+	pgm_debug ("pgm_rxw_join (window:%p join-min:%" PRIu32 ")",
+		(void*)window, join_min);
+
+	_pgm_rxw_update_trail (window, join_min);
+}
+
 /* update window with latest transmitted parameters.
  *
  * returns count of placeholders added into window, used to start sending naks.
@@ -797,9 +891,9 @@ _pgm_rxw_is_apdu_lost (
 		return FALSE;
 
 	const struct pgm_sk_buff_t* const first_skb = _pgm_rxw_peek (window, apdu_first_sqn);
-/* first fragment out-of-bounds */
+/* first fragment out-of-bounds, unless already released to a streaming read */
 	if (NULL == first_skb)
-		return TRUE;
+		return !(window->is_stream_open && apdu_first_sqn == window->stream_first_sqn);
 
 	const pgm_rxw_state_t* first_state = (pgm_rxw_state_t*)&first_skb->cb;
 	if (PGM_PKT_STATE_LOST_DATA == first_state->pkt_state)
@@ -1357,7 +1451,16 @@ _pgm_rxw_incoming_read (
 	do {
 		skb = _pgm_rxw_peek (window, window->commit_lead);
 		pgm_assert (NULL != skb);
-		if (_pgm_rxw_is_apdu_complete (window,
+/* transformed APDUs are only decoded whole */
+		if (window->is_streaming && skb->pgm_opt_fragment && !skb->is_transformed)
+		{
+			const ssize_t stream_read = _pgm_rxw_incoming_read_stream (window, pmsg);
+			if (stream_read < 0)
+				break;
+			bytes_read += stream_read;
+			data_read  ++;
+		}
+		else if (_pgm_rxw_is_apdu_complete (window,
 					      skb->pgm_opt_fragment ? pgm_ntohl (skb->of_apdu_first_sqn) : skb->sequence))
 		{
 			bytes_read += _pgm_rxw_incoming_read_apdu (window, pmsg);
@@ -1462,6 +1565,8 @@ _pgm_rxw_reconstruct (
 			pgm_skb_reserve (skb, sizeof(struct pgm_header) + sizeof(struct pgm_data));
 			skb->pgm_header = skb->head;
 			skb->pgm_data = (void*)( skb->pgm_header + 1 );
+/* header is not recovered, clear option flags so the skb reads as untagged */
+			memset (skb->pgm_header, 0, sizeof(struct pgm_header));
 			if (is_op_encoded) {
 				const uint16_t opt_total_length = sizeof(struct pgm_opt_length) +
 								 sizeof(struct pgm_opt_header) +
@@ -1709,6 +1814,114 @@ _pgm_rxw_incoming_read_apdu (
 	return contiguous_len;
 }
 
+/* returns TRUE if skb continues the open streaming APDU at offset.
+ */
+
+static inline
+bool
+_pgm_rxw_is_stream_fragment (
+	const pgm_rxw_t*	    const restrict window,
+	const struct pgm_sk_buff_t* const restrict skb,
+	const uint32_t				   offset
+	)
+{
+	return (NULL != skb->pgm_opt_fragment &&
+		pgm_ntohl (skb->of_apdu_first_sqn) == window->stream_first_sqn &&
+		pgm_ntohl (skb->of_apdu_len) == window->stream_apdu_len &&
+		pgm_ntohl (skb->of_frag_offset) == offset &&
+		skb->len <= window->stream_apdu_len - offset);
+}
+
+/* read the contiguous fragments available of one APDU without waiting for
+ * the APDU to complete, up to PGM_MAX_FRAGMENTS per message.  fragments are
+ * committed as read so the trail may advance beyond the start of the APDU.
+ *
+ * returns count of bytes read, returns -1 if nothing is available or the
+ * fragment at the commit lead cannot be delivered and has been marked lost.
+ */
+
+static inline
+ssize_t
+_pgm_rxw_incoming_read_stream (
+	pgm_rxw_t*    const restrict window,
+	struct pgm_msgv_t** restrict pmsg		/* message array, updated as messages appended */
+	)
+{
+	struct pgm_sk_buff_t *skb;
+	const pgm_rxw_state_t *state;
+	uint32_t	      contiguous_len = 0;
+	unsigned	      count = 0;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != pmsg);
+
+	pgm_debug ("_pgm_rxw_incoming_read_stream (window:%p pmsg:%p)",
+		(const void*)window, (const void*)pmsg);
+
+	skb = _pgm_rxw_peek (window, window->commit_lead);
+	pgm_assert (NULL != skb);
+	pgm_assert (NULL != skb->pgm_opt_fragment);
+
+	state = (const pgm_rxw_state_t*)&skb->cb;
+	if (PGM_PKT_STATE_HAVE_DATA != state->pkt_state)
+		return -1;
+
+	const uint32_t first_sqn = pgm_ntohl (skb->of_apdu_first_sqn);
+
+/* fragment of a following APDU abandons the open stream */
+	if (window->is_stream_open && first_sqn != window->stream_first_sqn) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Abandoning streamed APDU after %" PRIu32 " of %" PRIu32 " bytes."),
+			window->stream_offset, window->stream_apdu_len);
+		window->is_stream_open = 0;
+	}
+
+	if (!window->is_stream_open) {
+/* start of APDU lost or preceded session join */
+		if (first_sqn != skb->sequence || 0 != pgm_ntohl (skb->of_frag_offset)) {
+			pgm_rxw_lost (window, skb->sequence);
+			return -1;
+		}
+		window->is_stream_open	 = 1;
+		window->stream_first_sqn = first_sqn;
+		window->stream_apdu_len	 = pgm_ntohl (skb->of_apdu_len);
+		window->stream_offset	 = 0;
+	}
+
+	do {
+		state = (const pgm_rxw_state_t*)&skb->cb;
+		if (PGM_PKT_STATE_HAVE_DATA != state->pkt_state ||
+		    !_pgm_rxw_is_stream_fragment (window, skb, window->stream_offset + contiguous_len))
+			break;
+		_pgm_rxw_state (window, skb, PGM_PKT_STATE_COMMIT_DATA);
+		(*pmsg)->msgv_skb[ count++ ] = skb;
+		contiguous_len += skb->len;
+		window->commit_lead++;
+		if (window->stream_apdu_len == window->stream_offset + contiguous_len)
+			break;
+		skb = _pgm_rxw_peek (window, window->commit_lead);
+	} while (NULL != skb && count < PGM_MAX_FRAGMENTS);
+
+/* protocol sanity check: fragment inconsistent with stream */
+	if (PGM_UNLIKELY(0 == count)) {
+		window->is_stream_open = 0;
+		pgm_rxw_lost (window, window->commit_lead);
+		return -1;
+	}
+
+	window->stream_offset += contiguous_len;
+	if (window->stream_offset == window->stream_apdu_len)
+		window->is_stream_open = 0;
+
+	(*pmsg)->msgv_len = count;
+	(*pmsg)++;
+
+/* post-conditions */
+	pgm_assert (!_pgm_rxw_commit_is_empty (window));
+
+	return contiguous_len;
+}
+
 /* returns transmission group sequence (TG_SQN) from sequence (SQN).
  */
 
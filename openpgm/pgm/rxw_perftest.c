@@ -0,0 +1,287 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * performance tests for receive window
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+
+#define pgm_histogram_add		mock_pgm_histogram_add
+#define pgm_histogram_init		mock_pgm_histogram_init
+
+#define RXW_DEBUG
+#include "rxw.c"
+
+
+/* mock state */
+
+#define PERF_PACKETS		16384
+#define PERF_ROUNDS		8
+
+static unsigned perf_batch = 0;
+static struct pgm_sk_buff_t* perf_skb[ PERF_PACKETS ];
+
+size_t
+pgm_pkt_offset (
+        const bool                      can_fragment,
+        const sa_family_t		pgmcc_family	/* 0 = disable */
+        )
+{
+        return 0;
+}
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+void
+mock_pgm_histogram_init (
+	pgm_histogram_t*	histogram
+	)
+{
+}
+
+void
+mock_pgm_histogram_add (
+	pgm_histogram_t*	histogram,
+	int			value
+	)
+{
+}
+
+/* ODATA skb as presented by the receive path.
+ */
+
+static
+struct pgm_sk_buff_t*
+generate_odata_skb (
+	const uint32_t		sequence
+	)
+{
+	const pgm_tsi_t tsi = { { 200, 202, 203, 204, 205, 206 }, 2000 };
+	const uint16_t tsdu_length = 1000;
+	const uint16_t header_length = sizeof(struct pgm_header) + sizeof(struct pgm_data);
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (1500);
+	memcpy (&skb->tsi, &tsi, sizeof(tsi));
+	skb->sock = (pgm_sock_t*)0x1;
+	skb->tstamp = 1;
+	pgm_skb_reserve (skb, header_length);
+	memset (skb->head, 0, header_length);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	skb->pgm_data   = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_tsdu_length = g_htons (tsdu_length);
+	skb->pgm_data->data_sqn = g_htonl (sequence);
+	pgm_skb_put (skb, tsdu_length);
+	return skb;
+}
+
+static
+void
+mock_setup (void)
+{
+	g_assert (pgm_time_init (NULL, NULL));
+}
+
+static
+void
+mock_teardown (void)
+{
+	g_assert (pgm_time_shutdown ());
+}
+
+static
+void
+mock_setup_1 (void)
+{
+	perf_batch = 1;
+}
+
+static
+void
+mock_setup_64 (void)
+{
+	perf_batch = 64;
+}
+
+static
+void
+mock_setup_1024 (void)
+{
+	perf_batch = 1024;
+}
+
+/* target:
+ *	int
+ *	pgm_rxw_add (
+ *		pgm_rxw_t* const		window,
+ *		struct pgm_sk_buff_t* const	skb,
+ *		const pgm_time_t		now,
+ *		const pgm_time_t		nak_rb_expiry
+ *	)
+ *
+ *	ssize_t
+ *	pgm_rxw_readv (
+ *		pgm_rxw_t* const	window,
+ *		struct pgm_msgv_t**	pmsg,
+ *		const unsigned		msg_len
+ *	)
+ */
+
+/* in-order ODATA appended and read in batches, buffers are allocated outside
+ * the timed region so the window and skb layout dominate.
+ */
+
+START_TEST (test_add_readv)
+{
+	const pgm_tsi_t tsi = { { 200, 202, 203, 204, 205, 206 }, 2000 };
+	struct pgm_msgv_t msgv[ 1024 ], *pmsg;
+	pgm_time_t elapsed = 0;
+	uint32_t sequence = 0;
+
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 2 * perf_batch, 0, 0, 0);
+	fail_if (NULL == window, "create failed");
+
+	for (unsigned round = 0; round < PERF_ROUNDS; round++)
+	{
+		for (unsigned i = 0; i < PERF_PACKETS; i++)
+			perf_skb[i] = generate_odata_skb (sequence + i);
+
+		const pgm_time_t start = pgm_time_update_now();
+		for (unsigned i = 0; i < PERF_PACKETS; i += perf_batch)
+		{
+			for (unsigned j = 0; j < perf_batch; j++)
+				fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, perf_skb[i + j], 1, 2), "add not appended");
+			pmsg = msgv;
+			fail_unless ((ssize_t)(perf_batch * 1000) == pgm_rxw_readv (window, &pmsg, perf_batch), "readv failed");
+			pgm_rxw_remove_commit (window);
+		}
+		elapsed += pgm_time_update_now() - start;
+		sequence += PERF_PACKETS;
+	}
+	g_message ("add-readv/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns/pkt",
+		perf_batch,
+		(guint64)elapsed,
+		(guint64)(elapsed * 1000 / (PERF_ROUNDS * PERF_PACKETS)));
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* one gap per batch filled by a repair before reading, batch of at least 3.
+ */
+
+START_TEST (test_add_repair_readv)
+{
+	const pgm_tsi_t tsi = { { 200, 202, 203, 204, 205, 206 }, 2000 };
+	struct pgm_msgv_t msgv[ 1024 ], *pmsg;
+	pgm_time_t elapsed = 0;
+	uint32_t sequence = 0;
+
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 2 * perf_batch, 0, 0, 0);
+	fail_if (NULL == window, "create failed");
+
+	for (unsigned round = 0; round < PERF_ROUNDS; round++)
+	{
+		for (unsigned i = 0; i < PERF_PACKETS; i++)
+			perf_skb[i] = generate_odata_skb (sequence + i);
+
+		const pgm_time_t start = pgm_time_update_now();
+		for (unsigned i = 0; i < PERF_PACKETS; i += perf_batch)
+		{
+/* second of batch arrives last */
+			fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, perf_skb[i], 1, 2), "add not appended");
+			fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, perf_skb[i + 2], 1, 2), "add not missing");
+			for (unsigned j = 3; j < perf_batch; j++)
+				fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, perf_skb[i + j], 1, 2), "add not appended");
+			fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, perf_skb[i + 1], 1, 2), "repair not inserted");
+			pmsg = msgv;
+			fail_unless ((ssize_t)(perf_batch * 1000) == pgm_rxw_readv (window, &pmsg, perf_batch), "readv failed");
+			pgm_rxw_remove_commit (window);
+		}
+		elapsed += pgm_time_update_now() - start;
+		sequence += PERF_PACKETS;
+	}
+	g_message ("add-repair-readv/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns/pkt",
+		perf_batch,
+		(guint64)elapsed,
+		(guint64)(elapsed * 1000 / (PERF_ROUNDS * PERF_PACKETS)));
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+static
+Suite*
+make_add_readv_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Receive window add and readv performance");
+
+	TCase* tc_1 = tcase_create ("1");
+	suite_add_tcase (s, tc_1);
+	tcase_add_checked_fixture (tc_1, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_1, mock_setup_1, NULL);
+	tcase_add_test (tc_1, test_add_readv);
+
+	TCase* tc_64 = tcase_create ("64");
+	suite_add_tcase (s, tc_64);
+	tcase_add_checked_fixture (tc_64, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_64, mock_setup_64, NULL);
+	tcase_add_test (tc_64, test_add_readv);
+	tcase_add_test (tc_64, test_add_repair_readv);
+
+	TCase* tc_1024 = tcase_create ("1024");
+	suite_add_tcase (s, tc_1024);
+	tcase_add_checked_fixture (tc_1024, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_1024, mock_setup_1024, NULL);
+	tcase_add_test (tc_1024, test_add_readv);
+	tcase_add_test (tc_1024, test_add_repair_readv);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_add_readv_performance_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -139,6 +139,46 @@ generate_valid_skb (void)
 	return skb;
 }
 
+/* generate APDU fragment, data pointer pointing to PGM payload
+ */
+static
+struct pgm_sk_buff_t*
+generate_fragment_skb (
+	const uint32_t		sequence,
+	const uint32_t		first_sequence,
+	const uint32_t		apdu_length
+	)
+{
+	const pgm_tsi_t tsi = { { 200, 202, 203, 204, 205, 206 }, 2000 };
+	const guint16 tsdu_length = 1000;
+	const guint16 header_length = sizeof(struct pgm_header) + sizeof(struct pgm_data) +
+				      sizeof(struct pgm_opt_length) + sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_fragment);
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (1500);
+	memcpy (&skb->tsi, &tsi, sizeof(tsi));
+/* fake but valid socket and timestamp */
+	skb->sock = (pgm_sock_t*)0x1;
+	skb->tstamp = pgm_time_now;
+/* header with OPT_FRAGMENT between DATA and payload */
+	pgm_skb_reserve (skb, header_length);
+	memset (skb->head, 0, header_length);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	skb->pgm_data   = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_options = PGM_OPT_PRESENT;
+	skb->pgm_header->pgm_tsdu_length = g_htons (tsdu_length);
+	struct pgm_opt_length* opt_len = (struct pgm_opt_length*)(skb->pgm_data + 1);
+	struct pgm_opt_header* opt_header = (struct pgm_opt_header*)(opt_len + 1);
+	opt_header->opt_type = PGM_OPT_FRAGMENT | PGM_OPT_END;
+	skb->pgm_opt_fragment = (struct pgm_opt_fragment*)(opt_header + 1);
+/* DATA */
+	pgm_skb_put (skb, tsdu_length);
+	skb->pgm_opt_fragment->opt_sqn = g_htonl (first_sequence);
+	skb->pgm_opt_fragment->opt_frag_off = g_htonl ((sequence - first_sequence) * skb->len);
+	skb->pgm_opt_fragment->opt_frag_len = g_htonl (apdu_length);
+	skb->pgm_data->data_sqn = g_htonl (sequence);
+	return skb;
+}
+
 /* target:
  *	pgm_rxw_t*
  *	pgm_rxw_create (
@@ -266,6 +306,46 @@ START_TEST (test_destroy_fail_001)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_rxw_reset (
+ *		pgm_rxw_t* const	window
+ *		)
+ */
+
+START_TEST (test_reset_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (0);
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	fail_unless (1 == pgm_rxw_length (window), "length failed");
+	pgm_rxw_reset (window);
+	fail_unless (pgm_rxw_is_empty (window), "is_empty failed");
+	fail_unless (100 == pgm_rxw_max_length (window), "max_length failed");
+/* window is redefined by the next sequence */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (1000);
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	fail_unless (1000 == pgm_rxw_lead (window), "lead not 1000");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_reset_fail_001)
+{
+	pgm_rxw_reset (NULL);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	int
  *	pgm_rxw_add (
@@ -976,6 +1056,76 @@ START_TEST (test_readv_pass_006)
 }
 END_TEST
 
+/* streaming read of APDU delivered in parts */
+START_TEST (test_readv_pass_007)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	window->is_streaming = 1;
+	struct pgm_msgv_t msgv[2], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+/* #0,1 of three fragments */
+	for (unsigned i = 0; i < 2; i++)
+	{
+		skb = generate_fragment_skb (i, 0, 3000);
+		fail_if (NULL == skb, "generate_fragment_skb failed");
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	}
+	pmsg = msgv;
+	fail_unless (2000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (2 == msgv[0].msgv_len, "msgv_len failed");
+	fail_unless (1 == window->is_stream_open, "is_stream_open failed");
+	pmsg = msgv;
+	fail_unless (-1 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+/* release committed fragments before APDU completes */
+	pgm_rxw_remove_commit (window);
+	fail_unless (_pgm_rxw_commit_is_empty (window), "commit_is_empty failed");
+/* #2 final fragment */
+	skb = generate_fragment_skb (2, 0, 3000);
+	fail_if (NULL == skb, "generate_fragment_skb failed");
+	fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+	pmsg = msgv;
+	fail_unless (1000 == pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv)), "readv failed");
+	fail_unless (0 == window->is_stream_open, "is_stream_open failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+/* APDU beyond PGM_MAX_APDU only accepted when streaming */
+START_TEST (test_readv_pass_008)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	const uint32_t apdu_length = 70 * 1000;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	struct pgm_msgv_t msgv[1], *pmsg;
+	struct pgm_sk_buff_t* skb;
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	skb = generate_fragment_skb (0, 0, apdu_length);
+	fail_unless (PGM_RXW_MALFORMED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not malformed");
+	pgm_free_skb (skb);
+	window->is_streaming = 1;
+	gssize bytes_read = 0;
+	for (unsigned i = 0; i < 70; i++)
+	{
+		skb = generate_fragment_skb (i, 0, apdu_length);
+		fail_unless (PGM_RXW_APPENDED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not appended");
+		pmsg = msgv;
+		bytes_read += pgm_rxw_readv (window, &pmsg, G_N_ELEMENTS(msgv));
+		pgm_rxw_remove_commit (window);
+	}
+	fail_unless ((gssize)apdu_length == bytes_read, "readv failed");
+	fail_unless (0 == window->is_stream_open, "is_stream_open failed");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
 /* NULL window */
 START_TEST (test_readv_fail_001)
 {
@@ -1208,6 +1358,85 @@ START_TEST (test_update_fail_001)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_rxw_resume (
+ *		pgm_rxw_t* const	window,
+ *		const uint32_t		last_sqn
+ *		)
+ */
+
+START_TEST (test_resume_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	pgm_rxw_resume (window, 100);
+/* #1 at 100 already delivered */
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (100);
+	fail_unless (PGM_RXW_BOUNDS == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not bounds");
+/* #2 at 103 leaves a gap to repair */
+	skb->pgm_data->data_sqn = g_htonl (103);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+/* #3 at 101 fills it */
+	skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (101);
+	fail_unless (PGM_RXW_INSERTED == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not inserted");
+	fail_unless (103 == pgm_rxw_lead (window), "lead not 103");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_resume_fail_001)
+{
+	pgm_rxw_resume (NULL, 0);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	void
+ *	pgm_rxw_join (
+ *		pgm_rxw_t* const	window,
+ *		const uint32_t		join_min
+ *		)
+ */
+
+START_TEST (test_join_pass_001)
+{
+	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	const uint32_t ack_c_p = 500;
+	pgm_rxw_t* window = pgm_rxw_create (&tsi, 1500, 100, 0, 0, ack_c_p);
+	fail_if (NULL == window, "create failed");
+	const pgm_time_t now = 1;
+	const pgm_time_t nak_rb_expiry = 2;
+	pgm_rxw_resume (window, 100);
+/* #1 at 105, placeholders 101-104 */
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	skb->pgm_data->data_sqn = g_htonl (105);
+	fail_unless (PGM_RXW_MISSING == pgm_rxw_add (window, skb, now, nak_rb_expiry), "add not missing");
+/* 101-102 before late join minimum */
+	pgm_rxw_join (window, 103);
+	fail_unless (2 == window->cumulative_losses, "losses not 2");
+	fail_unless (2 == window->nak_backoff_queue.length, "backoff queue not 2");
+	pgm_rxw_destroy (window);
+}
+END_TEST
+
+START_TEST (test_join_fail_001)
+{
+	pgm_rxw_join (NULL, 0);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	int
  *	pgm_rxw_confirm (
@@ -1500,6 +1729,13 @@ make_basic_test_suite (void)
 	tcase_add_test_raise_signal (tc_destroy, test_destroy_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_reset = tcase_create ("reset");
+	suite_add_tcase (s, tc_reset);
+	tcase_add_test (tc_reset, test_reset_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_reset, test_reset_fail_001, SIGABRT);
+#endif
+
 	TCase* tc_add = tcase_create ("add");
 	suite_add_tcase (s, tc_add);
 	tcase_add_test (tc_add, test_add_pass_001);
@@ -1577,6 +1813,8 @@ make_basic_test_suite (void)
 	tcase_add_test (tc_readv, test_readv_pass_004);
 	tcase_add_test (tc_readv, test_readv_pass_005);
 	tcase_add_test (tc_readv, test_readv_pass_006);
+	tcase_add_test (tc_readv, test_readv_pass_007);
+	tcase_add_test (tc_readv, test_readv_pass_008);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_readv, test_readv_fail_001, SIGABRT);
 	tcase_add_test_raise_signal (tc_readv, test_readv_fail_002, SIGABRT);
@@ -1598,6 +1836,20 @@ make_basic_test_suite (void)
 	tcase_add_test_raise_signal (tc_update, test_update_fail_001, SIGABRT);
 #endif
 
+	TCase* tc_resume = tcase_create ("resume");
+	suite_add_tcase (s, tc_resume);
+	tcase_add_test (tc_resume, test_resume_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_resume, test_resume_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_join = tcase_create ("join");
+	suite_add_tcase (s, tc_join);
+	tcase_add_test (tc_join, test_join_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_join, test_join_fail_001, SIGABRT);
+#endif
+
         TCase* tc_confirm = tcase_create ("confirm");
 	suite_add_tcase (s, tc_confirm);
 	tcase_add_test (tc_confirm, test_confirm_pass_001);
@@ -1624,7 +1876,7 @@ make_basic_test_suite (void)
 }
 
 /* read through lost packet */
-START_TEST (test_readv_pass_007)
+START_TEST (test_readv_pass_009)
 {
 	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
 	const uint32_t ack_c_p = 500;
@@ -1697,7 +1949,7 @@ START_TEST (test_readv_pass_007)
 END_TEST
 
 /* read through loss extended window */
-START_TEST (test_readv_pass_008)
+START_TEST (test_readv_pass_010)
 {
 	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
 	const uint32_t ack_c_p = 500;
@@ -1772,7 +2024,7 @@ START_TEST (test_readv_pass_008)
 END_TEST
 
 /* read through long data-loss */
-START_TEST (test_readv_pass_009)
+START_TEST (test_readv_pass_011)
 {
 	pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
 	const uint32_t ack_c_p = 500;
@@ -1859,9 +2111,9 @@ make_best_effort_test_suite (void)
 
 	TCase* tc_readv = tcase_create ("readv");
 	suite_add_tcase (s, tc_readv);
-	tcase_add_test (tc_readv, test_readv_pass_007);
-	tcase_add_test (tc_readv, test_readv_pass_008);
 	tcase_add_test (tc_readv, test_readv_pass_009);
+	tcase_add_test (tc_readv, test_readv_pass_010);
+	tcase_add_test (tc_readv, test_readv_pass_011);
 
 	return s;
 }
@@ -23,9 +23,21 @@
 #	include <config.h>
 #endif
 #include <impl/framework.h>
+#include <impl/socket.h>
 #include "pgm/skbuff.h"
 
 
+/* receive fast path fields share the first cache line, headroom starts on a
+ * cache line boundary relative to the buffer for aligned checksum loads.
+ */
+PGM_STATIC_ASSERT(PGM_OFFSETOF(struct pgm_sk_buff_t, len) + sizeof(uint32_t) <= 64);
+#if (defined( __SIZEOF_POINTER__ ) && ( __SIZEOF_POINTER__ == 8 )) || defined( _WIN64 )
+PGM_STATIC_ASSERT(PGM_OFFSETOF(struct pgm_sk_buff_t, cb) == 64);
+PGM_STATIC_ASSERT(PGM_OFFSETOF(struct pgm_sk_buff_t, users) >= 128);
+PGM_STATIC_ASSERT(0 == (sizeof(struct pgm_sk_buff_t) % 64));
+#endif
+
+
 void
 pgm_skb_over_panic (
 	const struct pgm_sk_buff_t*const skb,
@@ -48,6 +60,65 @@ pgm_skb_under_panic (
 	pgm_assert_not_reached();
 }
 
+const void*
+pgm_skb_data (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return skb->data;
+}
+
+uint16_t
+pgm_skb_len (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return skb->len;
+}
+
+uint32_t
+pgm_skb_sequence (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return skb->sequence;
+}
+
+pgm_time_t
+pgm_skb_tstamp (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return skb->tstamp;
+}
+
+const pgm_tsi_t*
+pgm_skb_tsi (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return &skb->tsi;
+}
+
+/* last reference to a buffer sent with pgm_send_retained() has gone, the
+ * payload is handed back to the application.
+ */
+
+void
+pgm_skb_release_retained (
+	struct pgm_sk_buff_t*const skb
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != skb);
+	pgm_assert (skb->is_retained);
+	pgm_assert (NULL != skb->sock);
+
+	const pgm_sock_t* sock = skb->sock;
+	if (NULL != sock->retain_info.ri_release)
+		sock->retain_info.ri_release (skb->data, skb->len, sock->retain_info.ri_user_data);
+}
+
 #ifndef SKB_DEBUG
 bool
 pgm_skb_is_valid (
@@ -75,24 +146,31 @@ pgm_skb_is_valid (
 /* zero_padded can be any value */
 /* gpointers */
 	pgm_return_val_if_fail (NULL != skb->head, FALSE);
-	pgm_return_val_if_fail ((const char*)skb->head > (const char*)&skb->users, FALSE);
+	pgm_return_val_if_fail ((const char*)skb->head >= (const char*)(skb + 1), FALSE);
 	pgm_return_val_if_fail (NULL != skb->data, FALSE);
-	pgm_return_val_if_fail ((const char*)skb->data >= (const char*)skb->head, FALSE);
 	pgm_return_val_if_fail (NULL != skb->tail, FALSE);
 	pgm_return_val_if_fail ((const char*)skb->tail >= (const char*)skb->data, FALSE);
 	pgm_return_val_if_fail (skb->len == (char*)skb->tail - (const char*)skb->data, FALSE);
 	pgm_return_val_if_fail (NULL != skb->end, FALSE);
-	pgm_return_val_if_fail ((const char*)skb->end >= (const char*)skb->tail, FALSE);
+/* retained payload lies outside the buffer, head … end holds only headers */
+	const char* limit = skb->is_retained ? (const char*)skb->end : (const char*)skb->tail;
+	if (!skb->is_retained) {
+		pgm_return_val_if_fail ((const char*)skb->data >= (const char*)skb->head, FALSE);
+		pgm_return_val_if_fail ((const char*)skb->end >= (const char*)skb->tail, FALSE);
+	}
 /* pgm_header */
 	if (skb->pgm_header) {
 		pgm_return_val_if_fail ((const char*)skb->pgm_header >= (const char*)skb->head, FALSE);
-		pgm_return_val_if_fail ((const char*)skb->pgm_header + sizeof(struct pgm_header) <= (const char*)skb->tail, FALSE);
+		pgm_return_val_if_fail ((const char*)skb->pgm_header + sizeof(struct pgm_header) <= limit, FALSE);
 		pgm_return_val_if_fail (NULL != skb->pgm_data, FALSE);
 		pgm_return_val_if_fail ((const char*)skb->pgm_data >= (const char*)skb->pgm_header + sizeof(struct pgm_header), FALSE);
-		pgm_return_val_if_fail ((const char*)skb->pgm_data <= (const char*)skb->tail, FALSE);
+		pgm_return_val_if_fail ((const char*)skb->pgm_data <= limit, FALSE);
 		if (skb->pgm_opt_fragment) {
 			pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment > (const char*)skb->pgm_data, FALSE);
-			pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) < (const char*)skb->tail, FALSE);
+			if (skb->is_retained)
+				pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) <= limit, FALSE);
+			else
+				pgm_return_val_if_fail ((const char*)skb->pgm_opt_fragment + sizeof(struct pgm_opt_fragment) < limit, FALSE);
 /* of_apdu_first_sqn can be any value */
 /* of_frag_offset */
 			pgm_return_val_if_fail (pgm_ntohl (skb->of_frag_offset) < pgm_ntohl (skb->of_apdu_len), FALSE);
@@ -107,7 +185,8 @@ pgm_skb_is_valid (
 		pgm_return_val_if_fail (NULL == skb->pgm_opt_fragment, FALSE);
 	}
 /* truesize */
-	pgm_return_val_if_fail (skb->truesize >= sizeof(struct pgm_sk_buff_t*) + skb->len, FALSE);
+	if (!skb->is_retained)
+		pgm_return_val_if_fail (skb->truesize >= sizeof(struct pgm_sk_buff_t*) + skb->len, FALSE);
 	pgm_return_val_if_fail (skb->truesize == ((const char*)skb->end - (const char*)skb), FALSE);
 /* users */
 	pgm_return_val_if_fail (pgm_atomic_read32 (&skb->users) > 0, FALSE);
@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <impl/i18n.h>
 #include <impl/framework.h>
+#include <impl/socket.h>
 
 #include "pgm/snmp.h"
 #include "impl/pgmMIB.h"
@@ -194,6 +195,9 @@ snmp_routine (
 {
 	const SOCKET notify_fd = pgm_notify_get_socket (&snmp_notify);
 
+/* follow processor affinity of bound sockets */
+	pgm_sock_apply_service_affinity();
+
 	for (;;)
 	{
 		int fds = 0, block = 1;
@@ -591,7 +591,54 @@ pgm_sockaddr_tos (
 		break;
 	}
 
-	case AF_INET6:  /* TRAFFIC_CLASS not implemented */
+	case AF_INET6: {
+#ifdef IPV6_TCLASS
+/* Linux:ipv6(7) "IPV6_TCLASS ... Argument is a pointer to an integer."
+ */
+		const int optval = tos;
+		retval = setsockopt (s, IPPROTO_IPV6, IPV6_TCLASS, (const char*)&optval, sizeof(optval));
+#endif
+		break;
+	}
+
+	default: break;
+	}
+	return retval;
+}
+
+/* Deliver the type-of-service or traffic class byte as ancillary data for
+ * reading ECN marks.
+ *
+ * If no error occurs, pgm_sockaddr_recv_tos returns zero.  Otherwise, a value
+ * of SOCKET_ERROR is returned, and a specific error code can be retrieved by
+ * calling pgm_get_last_sock_error().
+ */
+
+PGM_GNUC_INTERNAL
+int
+pgm_sockaddr_recv_tos (
+	const SOCKET		s,
+	const sa_family_t	sa_family,
+	const bool		v
+	)
+{
+	int retval = SOCKET_ERROR;
+/* Linux:ip(7) "IP_RECVTOS ... The argument is a boolean integer flag."
+ * Linux:ipv6(7) "IPV6_RECVTCLASS ... Argument is a pointer to a boolean value in an integer."
+ */
+	const int optval = v ? 1 : 0;
+
+	switch (sa_family) {
+	case AF_INET:
+#ifdef IP_RECVTOS
+		retval = setsockopt (s, IPPROTO_IP, IP_RECVTOS, (const char*)&optval, sizeof(optval));
+#endif
+		break;
+
+	case AF_INET6:
+#ifdef IPV6_RECVTCLASS
+		retval = setsockopt (s, IPPROTO_IPV6, IPV6_RECVTCLASS, (const char*)&optval, sizeof(optval));
+#endif
 		break;
 
 	default: break;
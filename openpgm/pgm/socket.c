@@ -33,10 +33,12 @@
 #include <stdio.h>
 #include <impl/i18n.h>
 #include <impl/framework.h>
+#include <impl/engine.h>
 #include <impl/socket.h>
 #include <impl/receiver.h>
 #include <impl/source.h>
 #include <impl/timer.h>
+#include <impl/net.h>
 
 
 #define SOCK_DEBUG
@@ -51,7 +53,6 @@ pgm_slist_t* pgm_sock_list = NULL;
 static const char* pgm_sock_type_string (const int) PGM_GNUC_CONST;
 static const char* pgm_protocol_string (const int) PGM_GNUC_CONST;
 
-
 size_t
 pgm_pkt_offset (
 	bool		can_fragment,
@@ -71,6 +72,35 @@ pgm_pkt_offset (
 	return pkt_size;
 }
 
+/* pin the calling library service thread, i.e. HTTP or SNMP, to the union of
+ * processors requested by sockets with PGM_CPU_AFFINITY.  Sockets should be
+ * configured before starting the service.
+ *
+ * returns TRUE if the thread was pinned, FALSE if no affinity is requested or
+ * the platform does not support it.
+ */
+
+bool
+pgm_sock_apply_service_affinity (void)
+{
+	struct pgm_cpuset_t cpuset;
+	bool has_affinity = FALSE;
+
+	PGM_CPU_ZERO (&cpuset);
+	pgm_rwlock_reader_lock (&pgm_sock_list_lock);
+	for (pgm_slist_t* list = pgm_sock_list; NULL != list; list = list->next)
+	{
+		const pgm_sock_t* sock = list->data;
+		if (!sock->use_cpu_affinity)
+			continue;
+		for (unsigned i = 0; i < PGM_N_ELEMENTS(cpuset.cpu_bits); i++)
+			cpuset.cpu_bits[i] |= sock->cpu_affinity.cpu_bits[i];
+		has_affinity = TRUE;
+	}
+	pgm_rwlock_reader_unlock (&pgm_sock_list_lock);
+	return has_affinity ? pgm_numa_set_thread_affinity (&cpuset) : FALSE;
+}
+
 #ifdef _MSC_VER
 /* How to Determine Whether a Process or Thread Is Running As an Administrator
  * http://msdn.microsoft.com/en-us/windows/ff420334.aspx
@@ -269,6 +299,25 @@ pgm_close (
 		}
 	}
 
+	if (sock->journal) {
+		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Closing receiver journal."));
+		pgm_journal_destroy (sock->journal);
+		sock->journal = NULL;
+	}
+	if (sock->journal_info.jl_path) {
+		pgm_free ((char*)sock->journal_info.jl_path);
+		sock->journal_info.jl_path = NULL;
+	}
+	if (sock->compress) {
+		pgm_compress_destroy (sock->compress);
+		sock->compress = NULL;
+	}
+	if (sock->forward_msgv) {
+		pgm_free (sock->forward_iov);
+		pgm_free (sock->forward_msgv);
+		sock->forward_iov  = NULL;
+		sock->forward_msgv = NULL;
+	}
 	if (sock->peers_hashtable) {
 		pgm_debug ("destroying peer lookup table.");
 		pgm_hashtable_destroy (sock->peers_hashtable);
@@ -283,24 +332,82 @@ pgm_close (
 			sock->peers_list = next;
 		} while (sock->peers_list);
 	}
+	pgm_peer_pool_destroy (sock);
 
+	if (sock->topic_filter) {
+		pgm_debug ("destroying topic filter.");
+		pgm_topic_filter_destroy (sock->topic_filter);
+		sock->topic_filter = NULL;
+	}
+	if (sock->stream_state.skb && !sock->stream_state.is_pending) {
+		pgm_debug ("freeing uncommitted stream fragment.");
+		pgm_free_skb (sock->stream_state.skb);
+		sock->stream_state.skb = NULL;
+	}
 	if (sock->window) {
 		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Destroying transmit window."));
 		pgm_txw_shutdown (sock->window);
 		sock->window = NULL;
 	}
+	if (sock->lane.window) {
+		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Destroying priority lane transmit window."));
+		pgm_txw_shutdown (sock->lane.window);
+		sock->lane.window = NULL;
+	}
+	for (unsigned i = 0; i < sock->layers_len; i++) {
+		if (sock->layers[i].window) {
+			pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Destroying layer %u transmit window."), i + 1);
+			pgm_txw_shutdown (sock->layers[i].window);
+			sock->layers[i].window = NULL;
+			pgm_rate_destroy (&sock->layers[i].rate_control);
+		}
+	}
 	pgm_trace (PGM_LOG_ROLE_RATE_CONTROL,_("Destroying rate control."));
 	pgm_rate_destroy (&sock->rate_control);
+	if (sock->rate_group) {
+		if (sock->odata_share.group)
+			pgm_rate_share_detach (&sock->odata_share);
+		if (sock->rdata_share.group)
+			pgm_rate_share_detach (&sock->rdata_share);
+		pgm_rate_group_unref (sock->rate_group);
+		sock->rate_group = NULL;
+	}
+	if (sock->tx_tstamp) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Disabling transmit timestamping."));
+		pgm_tx_tstamp_disable (sock);
+	}
 	if (INVALID_SOCKET != sock->send_with_router_alert_sock) {
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Closing send with router alert socket."));
 		closesocket (sock->send_with_router_alert_sock);
 		sock->send_with_router_alert_sock = INVALID_SOCKET;
 	}
+	if (sock->txw_archive_info.ta_path) {
+		pgm_free ((char*)sock->txw_archive_info.ta_path);
+		sock->txw_archive_info.ta_path = NULL;
+	}
 	if (sock->spm_heartbeat_interval) {
 		pgm_debug ("freeing SPM heartbeat interval data.");
 		pgm_free (sock->spm_heartbeat_interval);
 		sock->spm_heartbeat_interval = NULL;
 	}
+	if (sock->packet_mmap) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Destroying packet ring."));
+		pgm_packet_mmap_destroy (sock);
+	}
+	if (sock->xdp) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Destroying AF_XDP datapath."));
+		pgm_xdp_destroy (sock);
+	}
+	if (sock->membership) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Closing membership sockets."));
+		pgm_membership_destroy (sock);
+	}
+	if (sock->destinations) {
+		pgm_debug ("freeing fan-out destinations.");
+		pgm_free (sock->destinations);
+		sock->destinations = NULL;
+		sock->destinations_len = 0;
+	}
 	if (sock->rx_buffer) {
 		pgm_debug ("freeing receive buffer.");
 		pgm_free_skb (sock->rx_buffer);
@@ -318,8 +425,13 @@ pgm_close (
 	pgm_rwlock_free (&sock->peers_lock);
 	pgm_spinlock_free (&sock->txw_spinlock);
 	pgm_mutex_free (&sock->send_mutex);
+	pgm_mutex_free (&sock->destination_mutex);
 	pgm_mutex_free (&sock->timer_mutex);
 	pgm_mutex_free (&sock->source_mutex);
+	pgm_mutex_free (&sock->lane.mutex);
+	for (unsigned i = 0; i < sock->layers_len; i++)
+		pgm_mutex_free (&sock->layers[i].mutex);
+	pgm_free (sock->layers);
 	pgm_mutex_free (&sock->receiver_mutex);
 	pgm_rwlock_writer_unlock (&sock->lock);
 	pgm_rwlock_free (&sock->lock);
@@ -357,7 +469,7 @@ pgm_socket (
 	)
 {
 	pgm_sock_t* new_sock;
-	int socket_type;
+	int socket_type, socket_protocol;
 
 	pgm_return_val_if_fail (NULL != sock, FALSE);
 	pgm_return_val_if_fail (AF_INET == family || AF_INET6 == family, FALSE);
@@ -377,16 +489,19 @@ pgm_socket (
 	new_sock->dport		= DEFAULT_DATA_DESTINATION_PORT;
 	new_sock->tsi.sport	= DEFAULT_DATA_SOURCE_PORT;
 	new_sock->adv_mode	= 0;	/* advance with time */
+	new_sock->numa_node	= PGM_NUMA_NODE_ANY;
 
 /* PGMCC */
 	new_sock->acker_nla.ss_family = family;
 
 /* source-side */
 	pgm_mutex_init (&new_sock->source_mutex);
+	pgm_mutex_init (&new_sock->lane.mutex);
 /* transmit window */
 	pgm_spinlock_init (&new_sock->txw_spinlock);
 /* send socket */
 	pgm_mutex_init (&new_sock->send_mutex);
+	pgm_mutex_init (&new_sock->destination_mutex);
 /* next timer & spm expiration */
 	pgm_mutex_init (&new_sock->timer_mutex);
 /* receiver-side */
@@ -400,16 +515,18 @@ pgm_socket (
 	if (IPPROTO_UDP == new_sock->protocol) {
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Opening UDP encapsulated sockets."));
 		socket_type = SOCK_DGRAM;
+		socket_protocol = IPPROTO_UDP;
 		new_sock->udp_encap_ucast_port = DEFAULT_UDP_ENCAP_UCAST_PORT;
 		new_sock->udp_encap_mcast_port = DEFAULT_UDP_ENCAP_MCAST_PORT;
 	} else {
 		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Opening raw sockets."));
 		socket_type = SOCK_RAW;
+		socket_protocol = pgm_resolve_ipproto_pgm();
 	}
 
 	if ((new_sock->recv_sock = socket (new_sock->family,
 					   socket_type,
-					   new_sock->protocol)) == INVALID_SOCKET)
+					   socket_protocol)) == INVALID_SOCKET)
 	{
 		const int save_errno = pgm_get_last_sock_error();
 		char errbuf[1024];
@@ -441,12 +558,17 @@ pgm_socket (
 		goto err_destroy;
 	}
 
+#ifdef _WIN32
+	if (!pgm_resolve_wsarecvmsg (new_sock->recv_sock, error))
+		goto err_destroy;
+#endif
+
 /* receive socket must always be non-blocking */
 	pgm_sockaddr_nonblocking (new_sock->recv_sock, TRUE);
 
 	if ((new_sock->send_sock = socket (new_sock->family,
 					   socket_type,
-					   new_sock->protocol)) == INVALID_SOCKET)
+					   socket_protocol)) == INVALID_SOCKET)
 	{
 		const int save_errno = pgm_get_last_sock_error();
 		char errbuf[1024];
@@ -460,7 +582,7 @@ pgm_socket (
 
 	if ((new_sock->send_with_router_alert_sock = socket (new_sock->family,
 							     socket_type,
-							     new_sock->protocol)) == INVALID_SOCKET)
+							     socket_protocol)) == INVALID_SOCKET)
 	{
 		const int save_errno = pgm_get_last_sock_error();
 		char errbuf[1024];
@@ -762,6 +884,24 @@ pgm_getsockopt (
 		status = TRUE;
 		break;
 
+/* enhancement layers joined by a layered receiver */
+	case PGM_LAYER_LEVEL:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->layer_level;
+		status = TRUE;
+		break;
+
+/* payload transform counters */
+	case PGM_COMPRESS_STATS:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_compress_stats_t)))
+			break;
+		if (PGM_UNLIKELY(NULL == sock->compress))
+			break;
+		memcpy (optval, &sock->compress->stats, sizeof (struct pgm_compress_stats_t));
+		status = TRUE;
+		break;
+
 /** read-write options **/
 /* maximum transmission packet size */
 	case PGM_MTU:
@@ -1041,6 +1181,164 @@ pgm_getsockopt (
 		status = TRUE;
 		break;
 
+	case PGM_CPU_AFFINITY:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_cpuset_t)))
+			break;
+		if (PGM_UNLIKELY(!sock->use_cpu_affinity))
+			break;
+		memcpy (optval, &sock->cpu_affinity, sizeof (struct pgm_cpuset_t));
+		status = TRUE;
+		break;
+
+	case PGM_NUMA_NODE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->numa_node;
+		status = TRUE;
+		break;
+
+	case PGM_STREAMING_READ:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_streaming_read ? 1 : 0;
+		status = TRUE;
+		break;
+
+	case PGM_USE_RATE_CC:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_rate_cc ? 1 : 0;
+		status = TRUE;
+		break;
+
+	case PGM_USE_ECN:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->use_ecn ? 1 : 0;
+		status = TRUE;
+		break;
+
+	case PGM_RATE_GROUP:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_rate_groupinfo_t)))
+			break;
+		{
+			struct pgm_rate_groupinfo_t* rg = optval;
+			rg->rg_group	= sock->rate_group;
+			rg->rg_weight	= sock->rate_group_weight;
+		}
+		status = TRUE;
+		break;
+
+	case PGM_TX_TIMESTAMPING:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = sock->tx_tstamp_flags;
+		status = TRUE;
+		break;
+
+	case PGM_PACKET_MMAP:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_packet_mmapinfo_t)))
+			break;
+		if (PGM_UNLIKELY(!sock->use_packet_mmap))
+			break;
+		memcpy (optval, &sock->packet_mmap_info, sizeof (struct pgm_packet_mmapinfo_t));
+		status = TRUE;
+		break;
+
+	case PGM_XDP:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_xdpinfo_t)))
+			break;
+		if (PGM_UNLIKELY(!sock->use_xdp))
+			break;
+		memcpy (optval, &sock->xdp_info, sizeof (struct pgm_xdpinfo_t));
+		status = TRUE;
+		break;
+
+	case PGM_TXW_RETAIN:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_retaininfo_t)))
+			break;
+		memcpy (optval, &sock->retain_info, sizeof (struct pgm_retaininfo_t));
+		status = TRUE;
+		break;
+
+	case PGM_TXW_ARCHIVE:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_txwarchiveinfo_t)))
+			break;
+		if (PGM_UNLIKELY(NULL == sock->txw_archive_info.ta_path))
+			break;
+		memcpy (optval, &sock->txw_archive_info, sizeof (struct pgm_txwarchiveinfo_t));
+		status = TRUE;
+		break;
+
+	case PGM_RXW_JOURNAL:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_journalinfo_t)))
+			break;
+		if (PGM_UNLIKELY(NULL == sock->journal_info.jl_path))
+			break;
+		memcpy (optval, &sock->journal_info, sizeof (struct pgm_journalinfo_t));
+		status = TRUE;
+		break;
+
+	case PGM_LATE_JOIN:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->late_join_sqns;
+		status = TRUE;
+		break;
+
+	case PGM_SPMR_GROUP_SIZE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->spmr_group_size;
+		status = TRUE;
+		break;
+
+	case PGM_PEER_RATE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->peer_rate;
+		status = TRUE;
+		break;
+
+	case PGM_PEER_POOL:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->peer_pool_size;
+		status = TRUE;
+		break;
+
+	case PGM_PRIORITY_LANE:
+		if (PGM_UNLIKELY(*optlen != sizeof (int)))
+			break;
+		*(int*restrict)optval = (int)sock->priority_lane;
+		status = TRUE;
+		break;
+
+	case PGM_LAYERS:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_layerinfo_t)))
+			break;
+		if (PGM_UNLIKELY(0 == sock->layers_len))
+			break;
+		{
+			struct pgm_layerinfo_t* info = optval;
+			memset (info, 0, sizeof (struct pgm_layerinfo_t));
+			info->li_loss_threshold = sock->layer_loss_threshold;
+			info->li_count		= sock->layers_len;
+			for (unsigned i = 0; i < sock->layers_len; i++) {
+				memcpy (&info->li_layers[i].lr_group, &sock->layers[i].gr, sizeof (struct group_req));
+				info->li_layers[i].lr_max_rte = (uint32_t)sock->layers[i].max_rte;
+			}
+		}
+		status = TRUE;
+		break;
+
+	case PGM_COMPRESS:
+		if (PGM_UNLIKELY(*optlen != sizeof (struct pgm_compressinfo_t)))
+			break;
+		memcpy (optval, &sock->compress_info, sizeof (struct pgm_compressinfo_t));
+		status = TRUE;
+		break;
+
 /** write-only options **/
 	case PGM_IP_ROUTER_ALERT:
 	case PGM_MULTICAST_LOOP:
@@ -1053,6 +1351,8 @@ pgm_getsockopt (
 	case PGM_JOIN_SOURCE_GROUP:
 	case PGM_LEAVE_SOURCE_GROUP:
 	case PGM_MSFILTER:
+	case PGM_ADD_DESTINATION:
+	case PGM_DEL_DESTINATION:
 	default:
 		break;
 	}
@@ -1066,6 +1366,37 @@ pgm_getsockopt (
 	return status;
 }
 
+/* copy a unicast fan-out receiver address, port defaulting to the UDP
+ * encapsulation multicast port, and look it up by address and port so that
+ * several receivers may share one host.  caller holds the destination mutex.
+ *
+ * returns the index of the destination, or destinations_len if not present.
+ */
+
+static
+unsigned
+find_destination (
+	const pgm_sock_t*        const restrict sock,
+	const struct sockaddr*   const restrict sa,
+	struct sockaddr_storage* const restrict addr
+	)
+{
+	memset (addr, 0, sizeof (struct sockaddr_storage));
+	memcpy (addr, sa, pgm_sockaddr_len (sa));
+/* port at same location for sin/sin6 */
+	if (0 == ((struct sockaddr_in*)addr)->sin_port && sock->udp_encap_mcast_port)
+		((struct sockaddr_in*)addr)->sin_port = htons (sock->udp_encap_mcast_port);
+	const struct sockaddr* key = (const struct sockaddr*)addr;
+	unsigned i;
+	for (i = 0; i < sock->destinations_len; i++) {
+		const struct sockaddr* dst = (const struct sockaddr*)&sock->destinations[i];
+		if (0 == pgm_sockaddr_cmp (key, dst) &&
+		    pgm_sockaddr_port (key) == pgm_sockaddr_port (dst))
+			break;
+	}
+	return i;
+}
+
 bool
 pgm_setsockopt (
 	pgm_sock_t* const restrict sock,
@@ -1158,9 +1489,13 @@ pgm_setsockopt (
 			    SOCKET_ERROR == pgm_sockaddr_multicast_loop (sock->send_with_router_alert_sock, sock->family, v))
 				break;
 #else		/* loop on receive */
-			if (SOCKET_ERROR == pgm_sockaddr_multicast_loop (sock->recv_sock, sock->family, v))
+			if (SOCKET_ERROR == pgm_sockaddr_multicast_loop (pgm_sock_ip_recv_sock (sock), sock->family, v))
 				break;
 #endif
+			sock->use_multicast_loop = v;
+/* packet ring sees local senders only as outgoing frames */
+			if (NULL != sock->packet_mmap && !pgm_packet_mmap_bind (sock))
+				break;
 		}
 		status = TRUE;
 		break;
@@ -1194,6 +1529,25 @@ pgm_setsockopt (
 			pgm_warn (_("ToS/DSCP setting requires CAP_NET_ADMIN or ADMIN capability."));
 			break;
 		}
+		sock->tos = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* RFC 3168 ECN, receivers read congestion experienced marks, fed back to the
+ * source with PGMCC ACKs.  Only ODATA is marked ECN-capable: pgm_connect() sets
+ * ECT(0) on the regular send socket of a sending socket and pgm_sendtov_hops()
+ * sends anything else leaving that socket Not-ECT with per-datagram ancillary
+ * data.  SPM, NCF, RDATA and NAK on the router alert socket are never marked.
+ */
+	case PGM_USE_ECN:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		{
+			const bool use_ecn = (0 != *(const int*)optval);
+			if (SOCKET_ERROR == pgm_sockaddr_recv_tos (pgm_sock_ip_recv_sock (sock), sock->family, use_ecn))
+				break;
+			sock->use_ecn = use_ecn;
+		}
 		status = TRUE;
 		break;
 
@@ -1608,11 +1962,11 @@ pgm_setsockopt (
 		status = TRUE;
 		break;
 
-/* for any-source applications (ASM), join a new group
+/* for any-source applications (ASM), join a new group.
+ *
+ * Groups beyond the kernel per-socket limit are joined on membership sockets.
  */
 	case PGM_JOIN_GROUP:
-		if (PGM_UNLIKELY(sock->recv_gsr_len >= IP_MAX_MEMBERSHIPS))
-			break;
 	{
 		void*	  restrict tmp_optval = optval;
 		socklen_t	   tmp_optlen = optlen;
@@ -1632,33 +1986,29 @@ pgm_setsockopt (
 		if (tmp_optlen == sizeof(struct group_req))
 		{
 			const struct group_req* gr = tmp_optval;
+			struct group_source_req gsr;
+			memset (&gsr, 0, sizeof(gsr));
+			gsr.gsr_interface = gr->gr_interface;
+			memcpy (&gsr.gsr_group, &gr->gr_group, pgm_sockaddr_len ((const struct sockaddr*)&gr->gr_group));
+			if (sock->udp_encap_mcast_port)
+				((struct sockaddr_in*)&gsr.gsr_group)->sin_port = htons (sock->udp_encap_mcast_port);
+			memcpy (&gsr.gsr_source, &gr->gr_group, pgm_sockaddr_len ((const struct sockaddr*)&gr->gr_group));
 /* verify not duplicate group/interface pairing */
-			for (unsigned i = 0; i < sock->recv_gsr_len; i++)
+			if (pgm_membership_is_duplicate (sock, &gsr))
 			{
-				if (pgm_sockaddr_cmp ((const struct sockaddr*)&gr->gr_group, (struct sockaddr*)&sock->recv_gsr[i].gsr_group)  == 0 &&
-				    pgm_sockaddr_cmp ((const struct sockaddr*)&gr->gr_group, (struct sockaddr*)&sock->recv_gsr[i].gsr_source) == 0 &&
-					(gr->gr_interface == sock->recv_gsr[i].gsr_interface ||
-					                0 == sock->recv_gsr[i].gsr_interface   ))
-				{
 #ifdef SOCK_DEBUG
-					char s[INET6_ADDRSTRLEN];
-					pgm_sockaddr_ntop ((const struct sockaddr*)&gr->gr_group, s, sizeof(s));
-					if (sock->recv_gsr[i].gsr_interface) {
-						pgm_warn(_("Socket has already joined group %s on interface %u"), s, gr->gr_interface);
-					} else {
-						pgm_warn(_("Socket has already joined group %s on all interfaces."), s);
-					}
-#endif
-					break;
+				char s[INET6_ADDRSTRLEN];
+				pgm_sockaddr_ntop ((const struct sockaddr*)&gr->gr_group, s, sizeof(s));
+				if (gr->gr_interface) {
+					pgm_warn(_("Socket has already joined group %s on interface %u"), s, gr->gr_interface);
+				} else {
+					pgm_warn(_("Socket has already joined group %s on all interfaces."), s);
 				}
+#endif
+				break;
 			}
-			sock->recv_gsr[sock->recv_gsr_len].gsr_interface = gr->gr_interface;
-			memcpy (&sock->recv_gsr[sock->recv_gsr_len].gsr_group, &gr->gr_group, pgm_sockaddr_len ((const struct sockaddr*)&gr->gr_group));
-			if (sock->udp_encap_mcast_port)
-				((struct sockaddr_in*)&sock->recv_gsr[sock->recv_gsr_len].gsr_group)->sin_port = htons (sock->udp_encap_mcast_port);
-			memcpy (&sock->recv_gsr[sock->recv_gsr_len].gsr_source, &gr->gr_group, pgm_sockaddr_len ((const struct sockaddr*)&gr->gr_group));
 /* Resolved address family gr->gr_group.ss_family can be different from sock->family = AF_UNSPEC */
-			if (SOCKET_ERROR == pgm_sockaddr_join_group (sock->recv_sock, gr->gr_group.ss_family, gr)) {
+			if (SOCKET_ERROR == pgm_membership_join (sock, &gsr, FALSE)) {
 #ifdef SOCK_DEBUG
 				const int save_errno = pgm_get_last_sock_error();
 				char errbuf[1024];
@@ -1678,7 +2028,6 @@ pgm_setsockopt (
 					addr,
 					(unsigned)gr->gr_interface);
 			}
-			sock->recv_gsr_len++;
 		}
 	}
 		status = TRUE;
@@ -1689,30 +2038,16 @@ pgm_setsockopt (
 	case PGM_LEAVE_GROUP:
 		if (PGM_UNLIKELY(optlen != sizeof(struct group_req)))
 			break;
-		if (PGM_UNLIKELY(0 == sock->recv_gsr_len))
-			break;
 		{
 			const struct group_req* gr = optval;
-			for (unsigned i = 0; i < sock->recv_gsr_len;)
-			{
-				if ((pgm_sockaddr_cmp ((const struct sockaddr*)&gr->gr_group, (struct sockaddr*)&sock->recv_gsr[i].gsr_group) == 0) &&
-/* drop all matching receiver entries */
-				            (gr->gr_interface == 0 ||
-/* drop all sources with matching interface */
-					     gr->gr_interface == sock->recv_gsr[i].gsr_interface) )
-				{
-					sock->recv_gsr_len--;
-					if (i < (IP_MAX_MEMBERSHIPS - 1))
-					{
-						memmove (&sock->recv_gsr[i], &sock->recv_gsr[i+1], (sock->recv_gsr_len - i) * sizeof(struct group_source_req));
-						continue;
-					}
-				}
-				i++;
-			}
+			struct group_source_req gsr;
 			if (PGM_UNLIKELY(sock->family != gr->gr_group.ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_leave_group (sock->recv_sock, sock->family, gr))
+			memset (&gsr, 0, sizeof(gsr));
+			gsr.gsr_interface = gr->gr_interface;
+			memcpy (&gsr.gsr_group, &gr->gr_group, pgm_sockaddr_len ((const struct sockaddr*)&gr->gr_group));
+/* drop all sources with matching interface, all interfaces if zero */
+			if (SOCKET_ERROR == pgm_membership_leave (sock, &gsr, FALSE))
 				break;
 			else if (PGM_UNLIKELY(pgm_log_mask & PGM_LOG_ROLE_NETWORK))
 			{
@@ -1735,7 +2070,7 @@ pgm_setsockopt (
 			const struct group_source_req* gsr = optval;
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_group.ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_block_source (sock->recv_sock, sock->family, gsr))
+			if (SOCKET_ERROR == pgm_sockaddr_block_source (pgm_membership_sock (sock, (const struct sockaddr*)&gsr->gsr_group), sock->family, gsr))
 				break;
 		}
 		status = TRUE;
@@ -1750,7 +2085,7 @@ pgm_setsockopt (
 			const struct group_source_req* gsr = optval;
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_group.ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_unblock_source (sock->recv_sock, sock->family, gsr))
+			if (SOCKET_ERROR == pgm_sockaddr_unblock_source (pgm_membership_sock (sock, (const struct sockaddr*)&gsr->gsr_group), sock->family, gsr))
 				break;
 		}
 		status = TRUE;
@@ -1763,44 +2098,31 @@ pgm_setsockopt (
 	case PGM_JOIN_SOURCE_GROUP:
 		if (PGM_UNLIKELY(optlen != sizeof(struct group_source_req)))
 			break;
-		if (PGM_UNLIKELY(sock->recv_gsr_len >= IP_MAX_MEMBERSHIPS))
-			break;
 		{
 			const struct group_source_req* gsr = optval;
-/* verify if existing group/interface pairing */
-			for (unsigned i = 0; i < sock->recv_gsr_len; i++)
+/* verify if existing group/source/interface pairing */
+			if (pgm_membership_is_duplicate (sock, gsr))
 			{
-				if (pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_group, (struct sockaddr*)&sock->recv_gsr[i].gsr_group) == 0 &&
-					(gsr->gsr_interface == sock->recv_gsr[i].gsr_interface ||
-					                  0 == sock->recv_gsr[i].gsr_interface   ))
-				{
-					if (pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_source, (struct sockaddr*)&sock->recv_gsr[i].gsr_source) == 0)
-					{
 #ifdef SOCK_DEBUG
-						char s1[INET6_ADDRSTRLEN], s2[INET6_ADDRSTRLEN];
-						pgm_sockaddr_ntop ((const struct sockaddr*)&gsr->gsr_group, s1, sizeof(s1));
-						pgm_sockaddr_ntop ((const struct sockaddr*)&gsr->gsr_source, s2, sizeof(s2));
-						if (sock->recv_gsr[i].gsr_interface) {
-							pgm_warn(_("Socket has already joined group %s from source %s on interface %d"),
-								s1, s2, (unsigned)gsr->gsr_interface);
-						} else {
-							pgm_warn(_("Socket has already joined group %s from source %s on all interfaces"),
-								s1, s2);
-						}
-#endif
-						break;
-					}
-					break;
+				char s1[INET6_ADDRSTRLEN], s2[INET6_ADDRSTRLEN];
+				pgm_sockaddr_ntop ((const struct sockaddr*)&gsr->gsr_group, s1, sizeof(s1));
+				pgm_sockaddr_ntop ((const struct sockaddr*)&gsr->gsr_source, s2, sizeof(s2));
+				if (gsr->gsr_interface) {
+					pgm_warn(_("Socket has already joined group %s from source %s on interface %d"),
+						s1, s2, (unsigned)gsr->gsr_interface);
+				} else {
+					pgm_warn(_("Socket has already joined group %s from source %s on all interfaces"),
+						s1, s2);
 				}
+#endif
+				break;
 			}
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_group.ss_family))
 				break;
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_source.ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_join_source_group (sock->recv_sock, sock->family, gsr))
+			if (SOCKET_ERROR == pgm_membership_join (sock, gsr, TRUE))
 				break;
-			memcpy (&sock->recv_gsr[sock->recv_gsr_len], gsr, sizeof(struct group_source_req));
-			sock->recv_gsr_len++;
 		}
 		status = TRUE;
 		break;
@@ -1810,30 +2132,13 @@ pgm_setsockopt (
 	case PGM_LEAVE_SOURCE_GROUP:
 		if (PGM_UNLIKELY(optlen != sizeof(struct group_source_req)))
 			break;
-		if (PGM_UNLIKELY(0 == sock->recv_gsr_len))
-			break;
 		{
 			const struct group_source_req* gsr = optval;
-/* verify if existing group/interface pairing */
-			for (unsigned i = 0; i < sock->recv_gsr_len; i++)
-			{
-				if (pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_group, (struct sockaddr*)&sock->recv_gsr[i].gsr_group)   == 0 &&
-				    pgm_sockaddr_cmp ((const struct sockaddr*)&gsr->gsr_source, (struct sockaddr*)&sock->recv_gsr[i].gsr_source) == 0 &&
-				    gsr->gsr_interface == sock->recv_gsr[i].gsr_interface)
-				{
-					sock->recv_gsr_len--;
-					if (i < (IP_MAX_MEMBERSHIPS - 1))
-					{
-						memmove (&sock->recv_gsr[i], &sock->recv_gsr[i+1], (sock->recv_gsr_len - i) * sizeof(struct group_source_req));
-						break;
-					}
-				}
-			}
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_group.ss_family))
 				break;
 			if (PGM_UNLIKELY(sock->family != gsr->gsr_source.ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_leave_source_group (sock->recv_sock, sock->family, gsr))
+			if (SOCKET_ERROR == pgm_membership_leave (sock, gsr, TRUE))
 				break;
 		}
 		status = TRUE;
@@ -1853,7 +2158,7 @@ pgm_setsockopt (
 /* check only first */
 			if (PGM_UNLIKELY(sock->family != gf_list->gf_slist[0].ss_family))
 				break;
-			if (SOCKET_ERROR == pgm_sockaddr_msfilter (sock->recv_sock, sock->family, gf_list))
+			if (SOCKET_ERROR == pgm_sockaddr_msfilter (pgm_membership_sock (sock, (const struct sockaddr*)&gf_list->gf_group), sock->family, gf_list))
 				break;
 		}
 		status = TRUE;
@@ -1875,65 +2180,473 @@ pgm_setsockopt (
 		status = TRUE;
 		break;
 
-/** read-only options **/
-	case PGM_MSSS:
-	case PGM_MSS:
-	case PGM_PDU:
-	case PGM_SEND_SOCK:
-	case PGM_RECV_SOCK:
-	case PGM_REPAIR_SOCK:
-	case PGM_PENDING_SOCK:
-	case PGM_ACK_SOCK:
-	case PGM_TIME_REMAIN:
-	case PGM_RATE_REMAIN:
-	default:
+/* processors for servicing the socket, determines the NUMA node when none is
+ * specified and is applied to library service threads.
+ */
+	case PGM_CPU_AFFINITY:
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_cpuset_t)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		memcpy (&sock->cpu_affinity, optval, sizeof (struct pgm_cpuset_t));
+		sock->use_cpu_affinity = TRUE;
+		status = TRUE;
 		break;
-	}
-	break;
 
-	default:
-	break;
-	}
+/* NUMA node for transmit and receive window storage.
+ * PGM_NUMA_NODE_LOCAL selects the node of the bound interface.
+ */
+	case PGM_NUMA_NODE:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < PGM_NUMA_NODE_LOCAL ||
+				 *(const int*)optval >= PGM_NUMA_MAX_NODES))
+			break;
+		sock->numa_node = *(const int*)optval;
+		status = TRUE;
+		break;
 
-	pgm_rwlock_reader_unlock (&sock->lock);
-	return status;
-}
+/* deliver contiguous fragments of large APDUs as they arrive, lifting the
+ * PGM_MAX_APDU limit on receive.  applies to peers discovered after setting.
+ */
+	case PGM_STREAMING_READ:
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		sock->use_streaming_read = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
 
-bool
-pgm_bind (
-	pgm_sock_t*                       restrict sock,
-	const struct pgm_sockaddr_t*const restrict sockaddr,
-	const socklen_t			           sockaddrlen,
-	pgm_error_t**	                  restrict error
-	)
-{
-	struct pgm_interface_req_t null_req;
-	memset (&null_req, 0, sizeof(null_req));
-	return pgm_bind3 (sock, sockaddr, sockaddrlen, &null_req, sizeof(null_req), &null_req, sizeof(null_req), error);
-}
+/* replace PGMCC window tokens with equation-based rate control of ODATA,
+ * feedback still elected and carried by PGMCC so PGM_USE_PGMCC is required.
+ */
+	case PGM_USE_RATE_CC:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		sock->use_rate_cc = (0 != *(const int*)optval);
+		status = TRUE;
+		break;
 
-/* bind the sockets to the link layer to start receiving data.
- *
- * returns TRUE on success, or FALSE on error and sets error appropriately,
+/* attach to a rate limit shared with other sockets, ODATA and RDATA each take
+ * a weighted share of their class of the group rate.  NULL group detaches.
  */
+	case PGM_RATE_GROUP:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_rate_groupinfo_t)))
+			break;
+		{
+			const struct pgm_rate_groupinfo_t* rg = optval;
+			if (NULL != rg->rg_group && PGM_UNLIKELY(0 == rg->rg_weight))
+				break;
+			if (NULL != sock->rate_group)
+				pgm_rate_group_unref (sock->rate_group);
+			sock->rate_group	= (NULL != rg->rg_group) ? pgm_rate_group_ref (rg->rg_group) : NULL;
+			sock->rate_group_weight	= rg->rg_weight;
+		}
+		status = TRUE;
+		break;
 
-bool
-pgm_bind3 (
-	pgm_sock_t*		      restrict sock,
-	const struct pgm_sockaddr_t*const restrict sockaddr,
-	const socklen_t			       sockaddrlen,
-	const struct pgm_interface_req_t*const send_req,		/* only use gr_interface and gr_group::sin6_scope */
-	const socklen_t			       send_req_len,
-	const struct pgm_interface_req_t*const recv_req,
-	const socklen_t			       recv_req_len,
-	pgm_error_t**		      restrict error			/* maybe NULL */
-	)
-{
-	pgm_return_val_if_fail (NULL != sock, FALSE);
-	pgm_return_val_if_fail (NULL != sockaddr, FALSE);
-	pgm_return_val_if_fail (0 != sockaddrlen, FALSE);
-	if (sockaddr->sa_addr.sport) pgm_return_val_if_fail (sockaddr->sa_addr.sport != sockaddr->sa_port, FALSE);
-	pgm_return_val_if_fail (NULL != send_req, FALSE);
+/* transmit timestamping of data packets into per socket latency histograms,
+ * enabled at bind as numbering must start with the first packet.
+ */
+	case PGM_TX_TIMESTAMPING:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		{
+			const int flags = *(const int*)optval;
+			if (PGM_UNLIKELY(0 != (flags & ~(PGM_TX_TIMESTAMPING_SOFTWARE | PGM_TX_TIMESTAMPING_HARDWARE))))
+				break;
+			sock->tx_tstamp_flags = flags;
+		}
+		status = TRUE;
+		break;
+
+/* receive raw IPv4 PGM through a TPACKET_V3 memory-mapped ring instead of one
+ * recvmsg() per packet, created at bind.
+ */
+	case PGM_PACKET_MMAP:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_packet_mmapinfo_t)))
+			break;
+		memcpy (&sock->packet_mmap_info, optval, sizeof (struct pgm_packet_mmapinfo_t));
+		sock->use_packet_mmap = TRUE;
+		status = TRUE;
+		break;
+
+/* bypass the stack for UDP encapsulated IPv4 through an AF_XDP socket, the
+ * redirect program is attached at bind and detached on close.  multicast is
+ * sent through the socket while PGM_MULTICAST_LOOP is enabled.
+ */
+	case PGM_XDP:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_xdpinfo_t)))
+			break;
+		memcpy (&sock->xdp_info, optval, sizeof (struct pgm_xdpinfo_t));
+		sock->use_xdp = TRUE;
+		status = TRUE;
+		break;
+
+/* transmit window references application memory passed to pgm_send_retained()
+ * instead of copying, the release function returns each payload.
+ */
+	case PGM_TXW_RETAIN:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_retaininfo_t)))
+			break;
+		if (PGM_UNLIKELY(NULL == ((const struct pgm_retaininfo_t*)optval)->ri_release))
+			break;
+		memcpy (&sock->retain_info, optval, sizeof (struct pgm_retaininfo_t));
+		status = TRUE;
+		break;
+
+/* packets leaving the transmit window are kept in a memory-mapped file and
+ * remain repairable, the advertised trail covers the archive.
+ */
+	case PGM_TXW_ARCHIVE:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_txwarchiveinfo_t)))
+			break;
+		{
+			const struct pgm_txwarchiveinfo_t* info = optval;
+			if (PGM_UNLIKELY(NULL == info->ta_path))
+				break;
+			if (PGM_UNLIKELY(info->ta_sqns & PGM_UINT32_SIGN_BIT))
+				break;
+			pgm_free ((char*)sock->txw_archive_info.ta_path);
+			sock->txw_archive_info.ta_path = pgm_strdup (info->ta_path);
+			sock->txw_archive_info.ta_sqns = info->ta_sqns;
+			sock->txw_archive_info.ta_secs = info->ta_secs;
+		}
+		status = TRUE;
+		break;
+
+/* delivered APDUs are appended to a memory-mapped file, after a restart each
+ * source resumes from its last journalled sequence.
+ */
+	case PGM_RXW_JOURNAL:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_journalinfo_t)))
+			break;
+		{
+			const struct pgm_journalinfo_t* info = optval;
+			if (PGM_UNLIKELY(NULL == info->jl_path))
+				break;
+			if (PGM_UNLIKELY(info->jl_flags & ~PGM_JOURNAL_REPLAY))
+				break;
+			pgm_free ((char*)sock->journal_info.jl_path);
+			sock->journal_info.jl_path  = pgm_strdup (info->jl_path);
+			sock->journal_info.jl_size  = info->jl_size ? info->jl_size : PGM_JOURNAL_DEFAULT_SIZE;
+			sock->journal_info.jl_flags = info->jl_flags;
+		}
+		status = TRUE;
+		break;
+
+/* SPMs carry OPT_JOIN, receivers joining late do not request repairs of
+ * sequences older than this many behind the lead.
+ * 0 < sqns < txw_sqns, 0 disables.
+ */
+	case PGM_LATE_JOIN:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval >= (int)((UINT32_MAX/2)-1)))
+			break;
+/* window sized by time is checked on bind */
+		if (PGM_UNLIKELY(sock->txw_sqns && (unsigned)*(const int*)optval >= sock->txw_sqns))
+			break;
+		sock->late_join_sqns = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* expected number of receivers, randomises SPMR back-off over SPMR_EXPIRY
+ * scaled by log2 of the group size.
+ * 0 < group_size <= PGM_MAX_SPMR_GROUP, 0 for fixed back-off.
+ */
+	case PGM_SPMR_GROUP_SIZE:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval > PGM_MAX_SPMR_GROUP))
+			break;
+		sock->spmr_group_size = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* maximum rate of new peers per second, packets from further new sources
+ * are discarded.
+ * 0 < peer_rate <= 1000000, 0 for unlimited.
+ */
+	case PGM_PEER_RATE:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval > 1000000))
+			break;
+		sock->peer_rate = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* number of peers with receive windows preallocated on bind.
+ * 0 < peer_pool, 0 disables.
+ */
+	case PGM_PEER_POOL:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		sock->peer_pool_size = *(const int*)optval;
+		status = TRUE;
+		break;
+
+/* source port of a companion session for urgent messages, see
+ * pgm_send_priority().  receivers deliver its data before other sources.
+ * 0 < port <= UINT16_MAX, 0 disables.
+ */
+	case PGM_PRIORITY_LANE:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (int)))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval < 0))
+			break;
+		if (PGM_UNLIKELY(*(const int*)optval > UINT16_MAX))
+			break;
+		sock->priority_lane = (uint16_t)*(const int*)optval;
+		status = TRUE;
+		break;
+
+/* unicast receiver for networks without multicast routing, once any are
+ * added data and SPMs addressed to the send group go to each instead and
+ * repairs only to the NAKing receiver.  port defaults to the UDP
+ * encapsulation multicast port.
+ */
+	case PGM_ADD_DESTINATION:
+	{
+		const struct sockaddr* sa = optval;
+		if (PGM_UNLIKELY(optlen < (socklen_t)sizeof (struct sockaddr_in)))
+			break;
+		if (PGM_UNLIKELY(sock->family != sa->sa_family))
+			break;
+		if (PGM_UNLIKELY(optlen < (socklen_t)pgm_sockaddr_len (sa)))
+			break;
+		if (PGM_UNLIKELY(pgm_sockaddr_is_addr_multicast (sa)))
+			break;
+		struct sockaddr_storage addr;
+		pgm_mutex_lock (&sock->destination_mutex);
+		if (find_destination (sock, sa, &addr) < sock->destinations_len ||
+		    PGM_UNLIKELY(sock->destinations_len == PGM_MAX_DESTINATIONS))
+		{
+			pgm_mutex_unlock (&sock->destination_mutex);
+			break;
+		}
+		if (sock->destinations_len == sock->destinations_alloc) {
+			sock->destinations_alloc = sock->destinations_alloc ? 2 * sock->destinations_alloc : 8;
+			sock->destinations = pgm_realloc (sock->destinations, sock->destinations_alloc * sizeof (struct sockaddr_storage));
+		}
+		memcpy (&sock->destinations[ sock->destinations_len ], &addr, sizeof (struct sockaddr_storage));
+		sock->destinations_len++;
+		pgm_mutex_unlock (&sock->destination_mutex);
+		status = TRUE;
+		break;
+	}
+
+/* remove a unicast receiver, the last restores the send group */
+	case PGM_DEL_DESTINATION:
+	{
+		const struct sockaddr* sa = optval;
+		if (PGM_UNLIKELY(optlen < (socklen_t)sizeof (struct sockaddr_in)))
+			break;
+		if (PGM_UNLIKELY(sock->family != sa->sa_family))
+			break;
+		if (PGM_UNLIKELY(optlen < (socklen_t)pgm_sockaddr_len (sa)))
+			break;
+		struct sockaddr_storage addr;
+		pgm_mutex_lock (&sock->destination_mutex);
+		const unsigned i = find_destination (sock, sa, &addr);
+		if (i < sock->destinations_len) {
+			if (i != --sock->destinations_len)
+				memcpy (&sock->destinations[i], &sock->destinations[ sock->destinations_len ], sizeof (struct sockaddr_storage));
+			status = TRUE;
+		}
+		pgm_mutex_unlock (&sock->destination_mutex);
+		break;
+	}
+
+/* cumulative enhancement layers, see pgm_send_layer().  sources send each on
+ * its group at lr_max_rte, receivers join and leave them on loss.
+ * 0 < li_count <= PGM_MAX_LAYERS, li_loss_threshold <= 1000 permille.
+ */
+	case PGM_LAYERS:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_layerinfo_t)))
+			break;
+		{
+			const struct pgm_layerinfo_t* info = optval;
+			if (PGM_UNLIKELY(0 == info->li_count || info->li_count > PGM_MAX_LAYERS))
+				break;
+			if (PGM_UNLIKELY(info->li_loss_threshold > 1000))
+				break;
+			unsigned i;
+			for (i = 0; i < info->li_count; i++) {
+				const struct sockaddr* group = (const struct sockaddr*)&info->li_layers[i].lr_group.gr_group;
+				if (PGM_UNLIKELY(sock->family != group->sa_family ||
+						 !pgm_sockaddr_is_addr_multicast (group)))
+					break;
+			}
+			if (PGM_UNLIKELY(i < info->li_count))
+				break;
+			for (i = 0; i < sock->layers_len; i++)
+				pgm_mutex_free (&sock->layers[i].mutex);
+			pgm_free (sock->layers);
+			sock->layers = pgm_new0 (pgm_layer_t, info->li_count);
+			sock->layers_len = info->li_count;
+			sock->layer_loss_threshold = info->li_loss_threshold ? info->li_loss_threshold : PGM_LAYER_DEFAULT_LOSS;
+			for (i = 0; i < info->li_count; i++) {
+				memcpy (&sock->layers[i].gr, &info->li_layers[i].lr_group, sizeof (struct group_req));
+				sock->layers[i].max_rte = info->li_layers[i].lr_max_rte;
+				pgm_mutex_init (&sock->layers[i].mutex);
+			}
+		}
+		status = TRUE;
+		break;
+
+/* encode each APDU before fragmentation, APDUs shorter than ci_min_length or
+ * that do not shrink are sent unchanged.  Receivers decode the built-in codec
+ * without setting this option.
+ */
+	case PGM_COMPRESS:
+		if (PGM_UNLIKELY(sock->is_bound))
+			break;
+		if (PGM_UNLIKELY(optlen != sizeof (struct pgm_compressinfo_t)))
+			break;
+		{
+			const struct pgm_compressinfo_t* info = optval;
+			if (PGM_UNLIKELY(PGM_CODEC_NONE != info->ci_codec &&
+					 PGM_CODEC_LZ != info->ci_codec &&
+					 (info->ci_codec < PGM_CODEC_USER || info->ci_codec > UINT8_MAX ||
+					  NULL == info->ci_encode || NULL == info->ci_decode)))
+				break;
+			memcpy (&sock->compress_info, info, sizeof (struct pgm_compressinfo_t));
+			if (0 == sock->compress_info.ci_min_length)
+				sock->compress_info.ci_min_length = PGM_COMPRESS_DEFAULT_MIN;
+		}
+		status = TRUE;
+		break;
+
+/** read-only options **/
+	case PGM_MSSS:
+	case PGM_MSS:
+	case PGM_PDU:
+	case PGM_SEND_SOCK:
+	case PGM_RECV_SOCK:
+	case PGM_REPAIR_SOCK:
+	case PGM_PENDING_SOCK:
+	case PGM_ACK_SOCK:
+	case PGM_TIME_REMAIN:
+	case PGM_RATE_REMAIN:
+	case PGM_LAYER_LEVEL:
+	case PGM_COMPRESS_STATS:
+	default:
+		break;
+	}
+	break;
+
+	default:
+	break;
+	}
+
+/* packet ring filter follows joined groups */
+	if (status && NULL != sock->packet_mmap && IPPROTO_PGM == level &&
+	    (PGM_JOIN_GROUP == optname || PGM_LEAVE_GROUP == optname ||
+	     PGM_JOIN_SOURCE_GROUP == optname || PGM_LEAVE_SOURCE_GROUP == optname))
+	{
+		status = pgm_packet_mmap_set_filter (sock);
+	}
+
+	pgm_rwlock_reader_unlock (&sock->lock);
+	return status;
+}
+
+/* enhancement layers take the source ports following the session.
+ *
+ * returns TRUE if a layer port wraps or collides with the data-destination
+ * port or the priority lane.
+ */
+
+static
+bool
+is_layer_port_conflict (
+	const pgm_sock_t* const	sock
+	)
+{
+	for (unsigned i = 1; i <= sock->layers_len; i++) {
+		const unsigned port = ntohs (sock->tsi.sport) + i;
+		if (port > UINT16_MAX ||
+		    htons ((uint16_t)port) == sock->dport ||
+		    port == sock->priority_lane)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+bool
+pgm_bind (
+	pgm_sock_t*                       restrict sock,
+	const struct pgm_sockaddr_t*const restrict sockaddr,
+	const socklen_t			           sockaddrlen,
+	pgm_error_t**	                  restrict error
+	)
+{
+	struct pgm_interface_req_t null_req;
+	memset (&null_req, 0, sizeof(null_req));
+	return pgm_bind3 (sock, sockaddr, sockaddrlen, &null_req, sizeof(null_req), &null_req, sizeof(null_req), error);
+}
+
+/* bind the sockets to the link layer to start receiving data.
+ *
+ * returns TRUE on success, or FALSE on error and sets error appropriately,
+ */
+
+bool
+pgm_bind3 (
+	pgm_sock_t*		      restrict sock,
+	const struct pgm_sockaddr_t*const restrict sockaddr,
+	const socklen_t			       sockaddrlen,
+	const struct pgm_interface_req_t*const send_req,		/* only use gr_interface and gr_group::sin6_scope */
+	const socklen_t			       send_req_len,
+	const struct pgm_interface_req_t*const recv_req,
+	const socklen_t			       recv_req_len,
+	pgm_error_t**		      restrict error			/* maybe NULL */
+	)
+{
+	pgm_return_val_if_fail (NULL != sock, FALSE);
+	pgm_return_val_if_fail (NULL != sockaddr, FALSE);
+	pgm_return_val_if_fail (0 != sockaddrlen, FALSE);
+	if (sockaddr->sa_addr.sport) pgm_return_val_if_fail (sockaddr->sa_addr.sport != sockaddr->sa_port, FALSE);
+	pgm_return_val_if_fail (NULL != send_req, FALSE);
 	pgm_return_val_if_fail (sizeof(struct pgm_interface_req_t) == send_req_len, FALSE);
 	pgm_return_val_if_fail (NULL != recv_req, FALSE);
 	pgm_return_val_if_fail (sizeof(struct pgm_interface_req_t) == recv_req_len, FALSE);
@@ -1989,6 +2702,85 @@ pgm_bind3 (
 			pgm_rwlock_writer_unlock (&sock->lock);
 			return FALSE;
 		}
+/* parity zero-pads and encodes in place, congestion control options vary per packet */
+		if (PGM_UNLIKELY(NULL != sock->retain_info.ri_release &&
+				 (sock->use_ondemand_parity || sock->use_proactive_parity || sock->use_pgmcc)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("TXW_RETAIN incompatible with FEC and PGMCC."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+/* late join horizon must lie within the transmit window */
+		if (PGM_UNLIKELY(sock->late_join_sqns &&
+				 sock->late_join_sqns >= (sock->txw_sqns ? sock->txw_sqns : (unsigned)( (sock->txw_secs * sock->txw_max_rte) / sock->max_tpdu ))))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("LATE_JOIN not smaller than the transmit window."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+/* parity encodes from in-memory transmission groups only */
+		if (PGM_UNLIKELY(NULL != sock->txw_archive_info.ta_path &&
+				 (sock->use_ondemand_parity || sock->use_proactive_parity)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("TXW_ARCHIVE incompatible with FEC."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+/* parity packets do not carry OPT_TRANSFORM */
+		if (PGM_UNLIKELY(PGM_CODEC_NONE != sock->compress_info.ci_codec &&
+				 (sock->use_ondemand_parity || sock->use_proactive_parity)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("COMPRESS incompatible with FEC."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		if (PGM_UNLIKELY(NULL != sock->txw_archive_info.ta_path &&
+				 0 == sock->txw_archive_info.ta_sqns &&
+				 (0 == sock->txw_archive_info.ta_secs || 0 == sock->txw_max_rte)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_FAILED,
+				       _("TXW_ARCHIVE requires sequences, or seconds with TXW_MAX_RTE."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		if (PGM_UNLIKELY(sock->use_rate_cc && !sock->use_pgmcc)) {
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_FAILED,
+				       _("Rate congestion control requires PGMCC feedback."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		if (PGM_UNLIKELY(sock->use_ecn && !sock->use_pgmcc)) {
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_FAILED,
+				       _("ECN requires PGMCC feedback."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		if (PGM_UNLIKELY(NULL != sock->rate_group && sock->rate_group->bucket.rate_per_sec < sock->max_tpdu)) {
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("Rate group limit less than maximum TPDU."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
 	}
 	if (sock->can_recv_data) {
 		if (PGM_UNLIKELY(0 == sock->rxw_sqns && 0 == sock->rxw_secs)) {
@@ -2007,6 +2799,15 @@ pgm_bind3 (
 			pgm_rwlock_writer_unlock (&sock->lock);
 			return FALSE;
 		}
+/* stream fragments do not form APDUs to journal */
+		if (PGM_UNLIKELY(NULL != sock->journal_info.jl_path && sock->use_streaming_read)) {
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("RXW_JOURNAL incompatible with streaming read."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
 		if (PGM_UNLIKELY(0 == sock->peer_expiry)) {
 			pgm_set_error (error,
 				       PGM_ERROR_DOMAIN_SOCKET,
@@ -2075,7 +2876,52 @@ pgm_bind3 (
 	} else {
 		do {
 			sock->tsi.sport = htons (pgm_random_int_range (0, UINT16_MAX));
-		} while (sock->tsi.sport == sock->dport);
+		} while (sock->tsi.sport == sock->dport ||
+			 sock->tsi.sport == htons (sock->priority_lane) ||
+			 (sock->can_send_data && is_layer_port_conflict (sock)));
+	}
+	if (sock->priority_lane) {
+		if (PGM_UNLIKELY(sock->can_send_data &&
+				 (htons (sock->priority_lane) == sock->tsi.sport ||
+				  htons (sock->priority_lane) == sock->dport)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("PRIORITY_LANE port conflicts with session ports."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		memcpy (&sock->lane.tsi.gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+		sock->lane.tsi.sport = htons (sock->priority_lane);
+	}
+	if (sock->layers_len) {
+		if (PGM_UNLIKELY(sock->can_send_data && is_layer_port_conflict (sock)))
+		{
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       PGM_ERROR_INVAL,
+				       _("LAYERS ports conflict with session ports."));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
+		for (unsigned i = 0; i < sock->layers_len; i++) {
+			pgm_layer_t* layer = &sock->layers[i];
+			if (PGM_UNLIKELY(sock->can_send_data && layer->max_rte < (ssize_t)sock->max_tpdu))
+			{
+				pgm_set_error (error,
+					       PGM_ERROR_DOMAIN_SOCKET,
+					       PGM_ERROR_INVAL,
+					       _("LAYERS maximum rate below one packet per second."));
+				pgm_rwlock_writer_unlock (&sock->lock);
+				return FALSE;
+			}
+			memcpy (&layer->tsi.gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+			layer->tsi.sport = htons ((uint16_t)(ntohs (sock->tsi.sport) + i + 1));
+/* port at same location for sin/sin6 */
+			if (sock->udp_encap_mcast_port)
+				((struct sockaddr_in*)&layer->gr.gr_group)->sin_port = htons (sock->udp_encap_mcast_port);
+		}
 	}
 
 /* pseudo-random number generator for back-off intervals */
@@ -2130,6 +2976,15 @@ pgm_bind3 (
 		return FALSE;
 	}
 
+/* resolve NUMA node for window storage */
+	if (PGM_NUMA_NODE_LOCAL == sock->numa_node) {
+		sock->numa_node = pgm_numa_node_of_ifindex (send_req->ir_interface ? send_req->ir_interface : recv_req->ir_interface);
+	} else if (PGM_NUMA_NODE_ANY == sock->numa_node && sock->use_cpu_affinity) {
+		sock->numa_node = pgm_numa_node_of_cpuset (&sock->cpu_affinity);
+	}
+	if (sock->numa_node >= 0)
+		pgm_trace (PGM_LOG_ROLE_MEMORY,_("Placing windows on NUMA node %d."), sock->numa_node);
+
 /* determine IP header size for rate regulation engine & stats */
 	sock->iphdr_len = (AF_INET == sock->family) ? sizeof(struct pgm_ip) : sizeof(struct pgm_ip6_hdr);
 	pgm_trace (PGM_LOG_ROLE_NETWORK,"Assuming IP header size of %" PRIzu " bytes", sock->iphdr_len);
@@ -2167,12 +3022,105 @@ pgm_bind3 (
 							sock->rs_n,
 							sock->rs_k);
 		pgm_assert (NULL != sock->window);
+		pgm_source_build_templates (sock);
+		if (NULL != sock->txw_archive_info.ta_path) {
+			const uint32_t archive_sqns = sock->txw_archive_info.ta_sqns ?
+						      sock->txw_archive_info.ta_sqns :
+						      (uint32_t)( ((uint64_t)sock->txw_archive_info.ta_secs * sock->txw_max_rte) / sock->max_tpdu );
+			pgm_txw_archive_t* archive = archive_sqns ?
+						     pgm_txw_archive_create (sock->txw_archive_info.ta_path, archive_sqns, sock->max_tpdu, error) :
+						     NULL;
+			if (PGM_UNLIKELY(NULL == archive)) {
+				if (0 == archive_sqns)
+					pgm_set_error (error,
+						       PGM_ERROR_DOMAIN_SOCKET,
+						       PGM_ERROR_INVAL,
+						       _("TXW_ARCHIVE smaller than one packet."));
+				pgm_rwlock_writer_unlock (&sock->lock);
+				return FALSE;
+			}
+			pgm_txw_set_archive (sock->window, archive);
+		}
+		if (sock->numa_node >= 0)
+			pgm_numa_bind_memory (sock->window,
+					      sizeof(pgm_txw_t) + ( pgm_txw_max_length (sock->window) * sizeof(struct pgm_sk_buff_t*) ),
+					      sock->numa_node);
+/* priority lane window, sized as the session without FEC */
+		if (sock->priority_lane) {
+			pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Create priority lane transmit window."));
+			sock->lane.window = sock->txw_sqns ?
+						pgm_txw_create (&sock->lane.tsi,
+								0,			/* MAX_TPDU */
+								sock->txw_sqns,		/* TXW_SQNS */
+								0,			/* TXW_SECS */
+								0,			/* TXW_MAX_RTE */
+								FALSE,
+								0,
+								0) :
+						pgm_txw_create (&sock->lane.tsi,
+								sock->max_tpdu,		/* MAX_TPDU */
+								0,			/* TXW_SQNS */
+								sock->txw_secs,		/* TXW_SECS */
+								sock->txw_max_rte,	/* TXW_MAX_RTE */
+								FALSE,
+								0,
+								0);
+			pgm_assert (NULL != sock->lane.window);
+		}
+/* layer windows hold the same interval at each layer rate, without FEC */
+		for (unsigned i = 0; i < sock->layers_len; i++) {
+			pgm_layer_t* layer = &sock->layers[i];
+			pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Create layer %u transmit window."), i + 1);
+			layer->window = sock->txw_sqns ?
+						pgm_txw_create (&layer->tsi,
+								0,			/* MAX_TPDU */
+								sock->txw_sqns,		/* TXW_SQNS */
+								0,			/* TXW_SECS */
+								0,			/* TXW_MAX_RTE */
+								FALSE,
+								0,
+								0) :
+						pgm_txw_create (&layer->tsi,
+								sock->max_tpdu,		/* MAX_TPDU */
+								0,			/* TXW_SQNS */
+								sock->txw_secs,		/* TXW_SECS */
+								layer->max_rte,		/* TXW_MAX_RTE */
+								FALSE,
+								0,
+								0);
+			pgm_assert (NULL != layer->window);
+		}
 	}
 
+/* payload transform, receivers always decode the built-in codec.  Encoded
+ * APDUs give up OPT_TRANSFORM worth of payload in every fragment.
+ */
+	if (sock->can_recv_data || PGM_CODEC_NONE != sock->compress_info.ci_codec)
+		sock->compress = pgm_compress_create (&sock->compress_info,
+						      sock->can_send_data ? MIN( sock->max_apdu, max_fragments * (sock->max_tsdu_fragment - PGM_OPT_TRANSFORM_LEN) ) : 0);
+
 /* create peer list */
 	if (sock->can_recv_data) {
 		sock->peers_hashtable = pgm_hashtable_new (pgm_tsi_hash, pgm_tsi_equal);
 		pgm_assert (NULL != sock->peers_hashtable);
+		sock->spmr_group_estimate = sock->spmr_group_size;
+		if (sock->peer_pool_size)
+			pgm_peer_pool_create (sock, sock->peer_pool_size);
+		if (NULL != sock->journal_info.jl_path) {
+			sock->journal = pgm_journal_create (sock->journal_info.jl_path,
+							    sock->journal_info.jl_size,
+							    sock->journal_info.jl_flags & PGM_JOURNAL_REPLAY,
+							    error);
+			if (PGM_UNLIKELY(NULL == sock->journal)) {
+				pgm_rwlock_writer_unlock (&sock->lock);
+				return FALSE;
+			}
+/* journalled data is readable before any packet arrives */
+			if (pgm_journal_is_replaying (sock->journal)) {
+				pgm_notify_send (&sock->pending_notify);
+				sock->is_pending_read = TRUE;
+			}
+		}
 	}
 
 /* Bind UDP sockets to interfaces, note multicast on a bound interface is
@@ -2379,17 +3327,63 @@ pgm_bind3 (
 			pgm_rate_create (&sock->odata_rate_control, sock->odata_max_rte, sock->iphdr_len, sock->max_tpdu);
 			sock->is_controlled_odata = TRUE;
 		}
+/* congestion control starts the ODATA bucket low and walks it up to the configured ceiling */
+		if (sock->use_rate_cc) {
+			sock->cc_max_rate = sock->odata_max_rte > 0 ? sock->odata_max_rte :
+					    sock->txw_max_rte > 0 ? sock->txw_max_rte : INT32_MAX;
+			sock->cc_rate = PGM_RATE_CC_INITIAL_PACKETS * sock->max_tpdu;
+			if (sock->cc_rate > sock->cc_max_rate)
+				sock->cc_rate = sock->cc_max_rate;
+			pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Starting rate congestion control at %" PRIzd " bytes per second."),
+					sock->cc_rate);
+			if (sock->odata_max_rte > 0)
+				pgm_rate_set (&sock->odata_rate_control, sock->cc_rate, sock->max_tpdu);
+			else
+				pgm_rate_create (&sock->odata_rate_control, sock->cc_rate, sock->iphdr_len, sock->max_tpdu);
+			sock->is_controlled_odata = TRUE;
+		}
 		if (sock->rdata_max_rte > 0) {
 			pgm_trace (PGM_LOG_ROLE_RATE_CONTROL,_("Setting RDATA rate regulation to %" PRIzd " bytes per second."),
 					sock->rdata_max_rte);
 			pgm_rate_create (&sock->rdata_rate_control, sock->rdata_max_rte, sock->iphdr_len, sock->max_tpdu);
 			sock->is_controlled_rdata = TRUE;
 		}
+		for (unsigned i = 0; i < sock->layers_len; i++) {
+			pgm_trace (PGM_LOG_ROLE_RATE_CONTROL,_("Setting layer %u rate regulation to %" PRIzd " bytes per second."),
+					i + 1, sock->layers[i].max_rte);
+			pgm_rate_create (&sock->layers[i].rate_control, sock->layers[i].max_rte, sock->iphdr_len, sock->max_tpdu);
+		}
+		if (NULL != sock->rate_group) {
+			pgm_trace (PGM_LOG_ROLE_RATE_CONTROL,_("Joining rate group of %" PRIzd " bytes per second with weight %u."),
+					sock->rate_group->bucket.rate_per_sec, sock->rate_group_weight);
+			pgm_rate_share_attach (sock->rate_group, &sock->odata_share, FALSE, sock->rate_group_weight, sock->iphdr_len, sock->max_tpdu);
+			pgm_rate_share_attach (sock->rate_group, &sock->rdata_share, TRUE, sock->rate_group_weight, sock->iphdr_len, sock->max_tpdu);
+			sock->odata_rate_control.share = &sock->odata_share;
+			sock->rdata_rate_control.share = &sock->rdata_share;
+			sock->is_controlled_odata = TRUE;
+			sock->is_controlled_rdata = TRUE;
+		}
+		if (0 != sock->tx_tstamp_flags &&
+		    !pgm_tx_tstamp_enable (sock, sock->tx_tstamp_flags))
+		{
+			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Continuing without transmit timestamping."));
+		}
 	}
 
 /* allocate first incoming packet buffer */
 	sock->rx_buffer = pgm_alloc_skb (sock->max_tpdu);
 
+	if (sock->use_packet_mmap &&
+	    !pgm_packet_mmap_create (sock, &sock->packet_mmap_info))
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Continuing with socket receive."));
+	}
+	if (sock->use_xdp &&
+	    !pgm_xdp_create (sock, &sock->xdp_info))
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Continuing with socket datapath."));
+	}
+
 /* bind complete */
 	sock->is_bound = TRUE;
 
@@ -2428,6 +3422,20 @@ pgm_connect (
 /* rx to nak processor notify channel */
 	if (sock->can_send_data)
 	{
+/* original data is ECN-capable transport */
+		if (sock->use_ecn &&
+		    SOCKET_ERROR == pgm_sockaddr_tos (sock->send_sock, sock->family, (sock->tos & ~PGM_ECN_MASK) | PGM_ECN_ECT0))
+		{
+			const int save_errno = pgm_get_last_sock_error();
+			char errbuf[1024];
+			pgm_set_error (error,
+				       PGM_ERROR_DOMAIN_SOCKET,
+				       pgm_error_from_sock_errno (save_errno),
+				       _("Setting ECN-capable transport on send socket: %s"),
+				       pgm_sock_strerror_s (errbuf, sizeof (errbuf), save_errno));
+			pgm_rwlock_writer_unlock (&sock->lock);
+			return FALSE;
+		}
 /* announce new sock by sending out SPMs */
 		if (!pgm_send_spm (sock, PGM_OPT_SYN) ||
 		    !pgm_send_spm (sock, PGM_OPT_SYN) ||
@@ -2457,6 +3465,9 @@ pgm_connect (
 
 /* start full history */
 		sock->ack_bitmap = 0xffffffff;
+
+/* rate congestion control probes exponentially until first reported loss */
+		sock->is_rate_cc_slow_start = sock->use_rate_cc;
 	}
 	else
 	{
@@ -2464,6 +3475,14 @@ pgm_connect (
 		sock->next_poll = pgm_time_update_now() + pgm_secs( 30 );
 	}
 
+/* layered receivers start on the session alone */
+	if (sock->can_recv_data && sock->layers_len) {
+		sock->layer_join_ivl   = PGM_LAYER_JOIN_MIN_IVL;
+		sock->next_layer_join  = pgm_time_update_now();
+		sock->next_layer_check = sock->next_layer_join + PGM_LAYER_CHECK_IVL;
+		sock->next_poll = MIN(sock->next_poll, sock->next_layer_check);
+	}
+
 	sock->is_connected = TRUE;
 
 /* cleanup */
@@ -2497,6 +3516,74 @@ pgm_getsockname (
 	return TRUE;
 }
 
+/* add or remove a topic subscription, exact or prefix match.  messages tagged
+ * with OPT_TOPIC are delivered only when matching a subscription, untagged
+ * messages and sockets without subscriptions deliver everything.  may be
+ * called at any time, applies to the next read.
+ *
+ * returns TRUE if the subscription set changed.
+ */
+
+static
+bool
+_pgm_topic_subscription (
+	pgm_sock_t* const restrict sock,
+	const char*	  restrict topic,
+	const size_t		   topic_len,
+	const bool		   is_prefix,
+	const bool		   is_subscribe
+	)
+{
+	bool status;
+
+	pgm_return_val_if_fail (NULL != sock, FALSE);
+	if (PGM_UNLIKELY(!pgm_topic_is_valid (topic, topic_len))) {
+		pgm_set_last_sock_error (PGM_SOCK_EINVAL);
+		return FALSE;
+	}
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (FALSE);
+	if (PGM_UNLIKELY(sock->is_destroyed)) {
+		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_set_last_sock_error (PGM_SOCK_EINVAL);
+		return FALSE;
+	}
+	pgm_mutex_lock (&sock->receiver_mutex);
+	if (is_subscribe) {
+		if (NULL == sock->topic_filter)
+			sock->topic_filter = pgm_topic_filter_new ();
+		status = pgm_topic_filter_subscribe (sock->topic_filter, topic, topic_len, is_prefix);
+	} else {
+		status = (NULL != sock->topic_filter) &&
+			 pgm_topic_filter_unsubscribe (sock->topic_filter, topic, topic_len, is_prefix);
+	}
+	pgm_mutex_unlock (&sock->receiver_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	return status;
+}
+
+bool
+pgm_subscribe (
+	pgm_sock_t* const restrict sock,
+	const char*	  restrict topic,
+	const size_t		   topic_len,
+	const bool		   is_prefix
+	)
+{
+	return _pgm_topic_subscription (sock, topic, topic_len, is_prefix, TRUE);
+}
+
+bool
+pgm_unsubscribe (
+	pgm_sock_t* const restrict sock,
+	const char*	  restrict topic,
+	const size_t		   topic_len,
+	const bool		   is_prefix
+	)
+{
+	return _pgm_topic_subscription (sock, topic, topic_len, is_prefix, FALSE);
+}
+
 /* add select parameters for the receive socket(s)
  *
  * returns highest file descriptor used plus one.
@@ -2530,6 +3617,15 @@ pgm_select_info (
 #else
 		fds = 1;
 #endif
+/* AF_XDP only receives one queue, the remainder arrive on the UDP socket */
+		if (sock->xdp) {
+			FD_SET(sock->xdp->ip_sock, readfds);
+#ifndef _WIN32
+			fds = MAX(fds, sock->xdp->ip_sock + 1);
+#else
+			fds++;
+#endif
+		}
 		if (sock->can_send_data) {
 			const SOCKET rdata_fd = pgm_notify_get_socket (&sock->rdata_notify);
 			FD_SET(rdata_fd, readfds);
@@ -2624,13 +3720,19 @@ pgm_wsapoll_info (
 		return SOCKET_ERROR;
 	}
 
-/* we currently only support one incoming socket */
+/* one incoming socket, two with AF_XDP */
 	if (events & PGM_POLLIN)
 	{
 		pgm_assert ( (1 + nfds) <= *n_fds );
 		fds[nfds].fd = sock->recv_sock;
 		fds[nfds].events = PGM_POLLIN;
 		nfds++;
+		if (sock->xdp) {
+			pgm_assert ( (1 + nfds) <= *n_fds );
+			fds[nfds].fd = sock->xdp->ip_sock;
+			fds[nfds].events = PGM_POLLIN;
+			nfds++;
+		}
 		if (sock->can_send_data) {
 			pgm_assert ( (1 + nfds) <= *n_fds );
 			fds[nfds].fd = pgm_notify_get_socket (&sock->rdata_notify);
@@ -2699,6 +3801,11 @@ pgm_epoll_ctl (
 		retval = epoll_ctl (epfd, op, sock->recv_sock, &event);
 		if (retval)
 			goto out;
+		if (sock->xdp) {
+			retval = epoll_ctl (epfd, op, sock->xdp->ip_sock, &event);
+			if (retval)
+				goto out;
+		}
 		if (sock->can_send_data) {
 			retval = epoll_ctl (epfd, op, pgm_notify_get_socket (&sock->rdata_notify), &event);
 			if (retval)
@@ -55,15 +55,23 @@
 #define TEST_NAK_NCF_RETRIES	2
 
 #define pgm_ipproto_pgm		mock_pgm_ipproto_pgm
+#define pgm_resolve_ipproto_pgm	mock_pgm_resolve_ipproto_pgm
 #define pgm_peer_unref		mock_pgm_peer_unref
+#define pgm_peer_pool_create	mock_pgm_peer_pool_create
+#define pgm_peer_pool_destroy	mock_pgm_peer_pool_destroy
 #define pgm_on_nak_notify	mock_pgm_on_nak_notify
 #define pgm_send_spm		mock_pgm_send_spm
+#define pgm_source_build_templates	mock_pgm_source_build_templates
 #define pgm_timer_prepare	mock_pgm_timer_prepare
 #define pgm_timer_check		mock_pgm_timer_check
 #define pgm_timer_expiration	mock_pgm_timer_expiration
 #define pgm_timer_dispatch	mock_pgm_timer_dispatch
 #define pgm_txw_create		mock_pgm_txw_create
 #define pgm_txw_shutdown	mock_pgm_txw_shutdown
+#define pgm_txw_set_archive	mock_pgm_txw_set_archive
+#define pgm_txw_archive_create	mock_pgm_txw_archive_create
+#define pgm_journal_create	mock_pgm_journal_create
+#define pgm_journal_destroy	mock_pgm_journal_destroy
 #define pgm_rate_create		mock_pgm_rate_create
 #define pgm_rate_destroy	mock_pgm_rate_destroy
 #define pgm_rate_remaining	mock_pgm_rate_remaining
@@ -76,6 +84,13 @@
 
 int mock_pgm_ipproto_pgm = IPPROTO_PGM;
 
+PGM_GNUC_INTERNAL
+int
+mock_pgm_resolve_ipproto_pgm (void)
+{
+	return mock_pgm_ipproto_pgm;
+}
+
 
 static
 void
@@ -199,6 +214,23 @@ mock_pgm_peer_unref (
 {
 }
 
+PGM_GNUC_INTERNAL
+void
+mock_pgm_peer_pool_create (
+	pgm_sock_t* const	sock,
+	const unsigned		peer_count
+	)
+{
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_peer_pool_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+}
+
 /** source module */
 static
 bool
@@ -221,6 +253,14 @@ mock_pgm_send_spm (
 	return TRUE;
 }
 
+PGM_GNUC_INTERNAL
+void
+mock_pgm_source_build_templates (
+	pgm_sock_t*		sock
+	)
+{
+}
+
 /** timer module */
 PGM_GNUC_INTERNAL
 bool
@@ -283,6 +323,46 @@ mock_pgm_txw_shutdown (
 	g_free (window);
 }
 
+void
+mock_pgm_txw_set_archive (
+	pgm_txw_t* const	window,
+	pgm_txw_archive_t* const archive
+	)
+{
+	g_free (archive);
+}
+
+pgm_txw_archive_t*
+mock_pgm_txw_archive_create (
+	const char* const	path,
+	const uint32_t		sqns,
+	const uint16_t		max_tpdu,
+	pgm_error_t**		error
+	)
+{
+	return g_new0 (pgm_txw_archive_t, 1);
+}
+
+/** receiver journal module */
+pgm_journal_t*
+mock_pgm_journal_create (
+	const char* const	path,
+	const uint64_t		size,
+	const bool		is_replay,
+	pgm_error_t**		error
+	)
+{
+	return g_new0 (pgm_journal_t, 1);
+}
+
+void
+mock_pgm_journal_destroy (
+	pgm_journal_t* const	journal
+	)
+{
+	g_free (journal);
+}
+
 /** rate control module */
 PGM_GNUC_INTERNAL
 void
@@ -710,6 +790,170 @@ START_TEST (test_set_hops_fail_001)
 }
 END_TEST
 
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_LATE_JOIN,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(int)
+ *	)
+ */
+
+START_TEST (test_set_late_join_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_LATE_JOIN;
+	const int sqns		= 99;
+	const void* optval	= &sqns;
+	const socklen_t optlen	= sizeof(sqns);
+	sock->txw_sqns = 100;
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_late_join failed");
+	fail_unless (99 == sock->late_join_sqns, "late_join_sqns");
+	const int disable	= 0;
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, &disable, optlen), "set_late_join failed");
+	fail_unless (0 == sock->late_join_sqns, "late_join_sqns");
+}
+END_TEST
+
+/* not smaller than the transmit window */
+START_TEST (test_set_late_join_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_LATE_JOIN;
+	const int sqns		= 100;
+	const void* optval	= &sqns;
+	const socklen_t optlen	= sizeof(sqns);
+	sock->txw_sqns = 100;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, optval, optlen), "set_late_join succeeded");
+	const int negative	= -1;
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, &negative, optlen), "set_late_join succeeded");
+}
+END_TEST
+
+START_TEST (test_set_late_join_fail_002)
+{
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_LATE_JOIN;
+	const int sqns		= 10;
+	const void* optval	= &sqns;
+	const socklen_t optlen	= sizeof(sqns);
+	fail_unless (FALSE == pgm_setsockopt (NULL, level, optname, optval, optlen), "set_late_join failed");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_ADD_DESTINATION,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(struct sockaddr_in)
+ *	)
+ */
+
+/* receivers on one host are told apart by port, default port applied */
+START_TEST (test_add_destination_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	pgm_mutex_init (&sock->destination_mutex);
+	sock->udp_encap_mcast_port = TEST_PORT;
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_ADD_DESTINATION;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const socklen_t optlen	= sizeof(addr);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, &addr, optlen), "add_destination failed");
+	fail_unless (1 == sock->destinations_len, "destinations_len");
+	fail_unless (g_htons(TEST_PORT) == ((struct sockaddr_in*)&sock->destinations[0])->sin_port, "default port");
+/* same address and default port */
+	addr.sin_port = g_htons(TEST_PORT);
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, &addr, optlen), "duplicate destination added");
+/* second receiver on the same host */
+	addr.sin_port = g_htons(TEST_PORT + 1);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, optname, &addr, optlen), "add_destination failed");
+	fail_unless (2 == sock->destinations_len, "destinations_len");
+}
+END_TEST
+
+/* multicast and short addresses */
+START_TEST (test_add_destination_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	pgm_mutex_init (&sock->destination_mutex);
+	const int level		= IPPROTO_PGM;
+	const int optname	= PGM_ADD_DESTINATION;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("239.192.0.1")
+	};
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, &addr, sizeof(addr)), "multicast destination added");
+	addr.sin_addr.s_addr = inet_addr ("172.12.90.1");
+	fail_unless (FALSE == pgm_setsockopt (sock, level, optname, &addr, sizeof(addr) - 1), "short destination added");
+	fail_unless (0 == sock->destinations_len, "destinations_len");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_setsockopt (
+ *		pgm_sock_t* const	sock,
+ *		const int		level = IPPROTO_PGM,
+ *		const int		optname = PGM_DEL_DESTINATION,
+ *		const void*		optval,
+ *		const socklen_t		optlen = sizeof(struct sockaddr_in)
+ *	)
+ */
+
+/* only the receiver with a matching port is removed */
+START_TEST (test_del_destination_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	pgm_mutex_init (&sock->destination_mutex);
+	sock->udp_encap_mcast_port = TEST_PORT;
+	const int level		= IPPROTO_PGM;
+	struct sockaddr_in addr = {
+		.sin_family		= AF_INET,
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	};
+	const socklen_t optlen	= sizeof(addr);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, PGM_ADD_DESTINATION, &addr, optlen), "add_destination failed");
+	addr.sin_port = g_htons(TEST_PORT + 1);
+	fail_unless (TRUE == pgm_setsockopt (sock, level, PGM_ADD_DESTINATION, &addr, optlen), "add_destination failed");
+	addr.sin_port = g_htons(TEST_PORT + 2);
+	fail_unless (FALSE == pgm_setsockopt (sock, level, PGM_DEL_DESTINATION, &addr, optlen), "unknown port removed");
+	addr.sin_port = 0;
+	fail_unless (TRUE == pgm_setsockopt (sock, level, PGM_DEL_DESTINATION, &addr, optlen), "del_destination failed");
+	fail_unless (1 == sock->destinations_len, "destinations_len");
+	fail_unless (g_htons(TEST_PORT + 1) == ((struct sockaddr_in*)&sock->destinations[0])->sin_port, "wrong destination removed");
+}
+END_TEST
+
+/* short address */
+START_TEST (test_del_destination_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	pgm_mutex_init (&sock->destination_mutex);
+	struct sockaddr_in6 addr = {
+		.sin6_family		= AF_INET6
+	};
+	sock->family = AF_INET6;
+	fail_unless (FALSE == pgm_setsockopt (sock, IPPROTO_PGM, PGM_DEL_DESTINATION, &addr, sizeof(struct sockaddr_in)), "short destination removed");
+}
+END_TEST
+
 /* target:
  *	bool
  *	pgm_setsockopt (
@@ -1207,6 +1451,25 @@ make_test_suite (void)
 	tcase_add_test (tc_set_hops, test_set_hops_pass_001);
 	tcase_add_test (tc_set_hops, test_set_hops_fail_001);
 
+	TCase* tc_set_late_join = tcase_create ("set-late-join");
+	suite_add_tcase (s, tc_set_late_join);
+	tcase_add_checked_fixture (tc_set_late_join, mock_setup, mock_teardown);
+	tcase_add_test (tc_set_late_join, test_set_late_join_pass_001);
+	tcase_add_test (tc_set_late_join, test_set_late_join_fail_001);
+	tcase_add_test (tc_set_late_join, test_set_late_join_fail_002);
+
+	TCase* tc_add_destination = tcase_create ("add-destination");
+	suite_add_tcase (s, tc_add_destination);
+	tcase_add_checked_fixture (tc_add_destination, mock_setup, mock_teardown);
+	tcase_add_test (tc_add_destination, test_add_destination_pass_001);
+	tcase_add_test (tc_add_destination, test_add_destination_fail_001);
+
+	TCase* tc_del_destination = tcase_create ("del-destination");
+	suite_add_tcase (s, tc_del_destination);
+	tcase_add_checked_fixture (tc_del_destination, mock_setup, mock_teardown);
+	tcase_add_test (tc_del_destination, test_del_destination_pass_001);
+	tcase_add_test (tc_del_destination, test_del_destination_fail_001);
+
 	TCase* tc_set_sndbuf = tcase_create ("set-sndbuf");
 	suite_add_tcase (s, tc_set_sndbuf);
 	tcase_add_checked_fixture (tc_set_sndbuf, mock_setup, mock_teardown);
@@ -1300,7 +1563,7 @@ main (void)
 	g_assert (0 == WSAStartup (wVersionRequested, &wsaData));
 	g_assert (LOBYTE (wsaData.wVersion) == 2 && HIBYTE (wsaData.wVersion) == 2);
 #endif
-	g_assert (pgm_time_init (NULL));
+	g_assert (pgm_time_init (NULL, NULL));
 	pgm_messages_init();
 	pgm_rand_init();
 	pgm_thread_init();
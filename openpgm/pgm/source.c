@@ -23,6 +23,7 @@
 #	include <config.h>
 #endif
 #include <errno.h>
+#include <math.h>
 #include <impl/i18n.h>
 #include <impl/framework.h>
 #include <impl/socket.h>
@@ -43,12 +44,15 @@
 static inline bool peer_is_source (const pgm_peer_t*) PGM_GNUC_CONST;
 static inline bool peer_is_peer (const pgm_peer_t*) PGM_GNUC_CONST;
 static void reset_heartbeat_spm (pgm_sock_t*const, const pgm_time_t);
-static bool send_ncf (pgm_sock_t*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const uint32_t, const bool);
-static bool send_ncf_list (pgm_sock_t*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, struct pgm_sqn_list_t*const restrict, const bool);
+static bool send_spm (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, pgm_txw_t*const restrict, uint32_t*const restrict, const struct sockaddr*const restrict, const int);
+static bool find_destination (pgm_sock_t*const restrict, const struct sockaddr*const restrict, struct sockaddr_storage*const restrict);
+static bool send_ncf (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const uint32_t, const bool);
+static bool send_ncf_list (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, const struct sockaddr*const restrict, struct pgm_sqn_list_t*const restrict, const bool);
 static int send_odata (pgm_sock_t*const restrict, struct pgm_sk_buff_t*const restrict, size_t*restrict);
 static int send_odata_copy (pgm_sock_t*const restrict, const void*restrict, const uint16_t, size_t*restrict);
 static int send_odatav (pgm_sock_t*const restrict, const struct pgm_iovec*const restrict, const unsigned, size_t*restrict);
-static bool send_rdata (pgm_sock_t*restrict, struct pgm_sk_buff_t*restrict);
+static ssize_t send_companion_odata (pgm_sock_t*const restrict, const pgm_tsi_t*const restrict, pgm_txw_t*const restrict, const struct sockaddr*const restrict, const void*restrict, const uint16_t);
+static bool send_rdata (pgm_sock_t*restrict, pgm_txw_t*restrict, pgm_layer_t*restrict, struct pgm_sk_buff_t*restrict);
 
 
 static inline
@@ -110,6 +114,142 @@ source_max_tsdu (
 	return max_tsdu;
 }
 
+/* ODATA header templates.
+ *
+ * Apart from the sequence numbers, TSDU length and fragment offsets every
+ * header field is constant for a bound socket.  The header is built once with
+ * the variable fields zeroed so that each packet is stamped with one copy and
+ * the header checksum is completed from the template's partial sum by adding
+ * only the variable fields, all of which lie on even offsets.
+ */
+
+PGM_STATIC_ASSERT(0 == (PGM_OFFSETOF(struct pgm_header, pgm_tsdu_length) & 1));
+PGM_STATIC_ASSERT(0 == ((PGM_APDU_TEMPLATE_LEN - sizeof(struct pgm_opt_fragment) + PGM_OFFSETOF(struct pgm_opt_fragment, opt_sqn)) & 1));
+
+void
+pgm_source_build_templates (
+	pgm_sock_t*	const	sock
+	)
+{
+	struct pgm_header	*header;
+	struct pgm_opt_length	*opt_len;
+	struct pgm_opt_header	*opt_header;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	memset (sock->odata_template, 0, sizeof (sock->odata_template));
+	header = (struct pgm_header*)sock->odata_template;
+	memcpy (header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+	header->pgm_sport	= sock->tsi.sport;
+	header->pgm_dport	= sock->dport;
+	header->pgm_type	= PGM_ODATA;
+	sock->odata_template_csum = pgm_csum_partial (sock->odata_template, sizeof (sock->odata_template), 0);
+
+	memset (sock->apdu_template, 0, sizeof (sock->apdu_template));
+	memcpy (sock->apdu_template, sock->odata_template, sizeof (sock->odata_template));
+	header = (struct pgm_header*)sock->apdu_template;
+	header->pgm_options	= PGM_OPT_PRESENT;
+/* OPT_LENGTH */
+	opt_len			= (struct pgm_opt_length*)(sock->apdu_template + sizeof (sock->odata_template));
+	opt_len->opt_type	= PGM_OPT_LENGTH;
+	opt_len->opt_length	= sizeof(struct pgm_opt_length);
+	opt_len->opt_total_length = pgm_htons ((uint16_t)(sizeof(struct pgm_opt_length) +
+						sizeof(struct pgm_opt_header) +
+						sizeof(struct pgm_opt_fragment)));
+/* OPT_FRAGMENT */
+	opt_header		= (struct pgm_opt_header*)(opt_len + 1);
+	opt_header->opt_type	= PGM_OPT_FRAGMENT | PGM_OPT_END;
+	opt_header->opt_length	= sizeof(struct pgm_opt_header) +
+				  sizeof(struct pgm_opt_fragment);
+	sock->apdu_template_csum = pgm_csum_partial (sock->apdu_template, sizeof (sock->apdu_template), 0);
+
+	memcpy (sock->apdu_transform_template, sock->apdu_template, sizeof (sock->apdu_template));
+	opt_len			= (struct pgm_opt_length*)(sock->apdu_transform_template + sizeof (sock->odata_template));
+	opt_len->opt_total_length = pgm_htons ((uint16_t)(sizeof(struct pgm_opt_length) +
+						sizeof(struct pgm_opt_header) +
+						sizeof(struct pgm_opt_fragment) +
+						PGM_OPT_TRANSFORM_LEN));
+	opt_header		= (struct pgm_opt_header*)(opt_len + 1);
+	opt_header->opt_type	= PGM_OPT_FRAGMENT;
+/* OPT_TRANSFORM, receivers without the transform must discard the TPDU */
+	opt_header		= (struct pgm_opt_header*)(sock->apdu_transform_template + sizeof (sock->apdu_template));
+	opt_header->opt_type	= PGM_OPT_TRANSFORM | PGM_OPT_END;
+	opt_header->opt_length	= PGM_OPT_TRANSFORM_LEN;
+	opt_header->opt_reserved = PGM_OPX_DISCARD;
+	sock->apdu_transform_template_csum = pgm_csum_partial (sock->apdu_transform_template, sizeof (sock->apdu_transform_template), 0);
+}
+
+/* stamp the ODATA template into the skb headroom, returns unfolded header checksum.
+ */
+
+static inline
+uint32_t
+source_stamp_odata (
+	pgm_sock_t*	      const restrict sock,
+	struct pgm_sk_buff_t* const restrict skb,
+	const uint16_t			     tsdu_length
+	)
+{
+	uint32_t unfolded_header = sock->odata_template_csum;
+
+	memcpy (skb->head, sock->odata_template, sizeof (sock->odata_template));
+	skb->pgm_header			 = (struct pgm_header*)skb->head;
+	skb->pgm_data			 = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
+	skb->pgm_data->data_sqn		 = pgm_htonl (pgm_txw_next_lead(sock->window));
+	skb->pgm_data->data_trail	 = pgm_htonl (pgm_txw_trail(sock->window));
+
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_header->pgm_tsdu_length, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_data->data_sqn, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_data->data_trail, 0);
+	return unfolded_header;
+}
+
+/* as above with OPT_LENGTH and OPT_FRAGMENT for one fragment of an APDU,
+ * followed by OPT_TRANSFORM when the APDU is encoded by the payload transform.
+ */
+
+static inline
+uint32_t
+source_stamp_apdu (
+	pgm_sock_t*	      const restrict sock,
+	struct pgm_sk_buff_t* const restrict skb,
+	const bool			     is_transformed,
+	const uint16_t			     tsdu_length,
+	const uint32_t			     first_sqn,
+	const size_t			     frag_off,
+	const size_t			     apdu_length
+	)
+{
+	uint32_t unfolded_header;
+
+	if (is_transformed) {
+		memcpy (skb->head, sock->apdu_transform_template, sizeof (sock->apdu_transform_template));
+		unfolded_header = sock->apdu_transform_template_csum;
+	} else {
+		memcpy (skb->head, sock->apdu_template, sizeof (sock->apdu_template));
+		unfolded_header = sock->apdu_template_csum;
+	}
+	skb->pgm_header			 = (struct pgm_header*)skb->head;
+	skb->pgm_data			 = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_opt_fragment		 = (struct pgm_opt_fragment*)((char*)skb->head + sizeof (sock->apdu_template) - sizeof(struct pgm_opt_fragment));
+	skb->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
+	skb->pgm_data->data_sqn		 = pgm_htonl (pgm_txw_next_lead(sock->window));
+	skb->pgm_data->data_trail	 = pgm_htonl (pgm_txw_trail(sock->window));
+	skb->pgm_opt_fragment->opt_sqn	    = pgm_htonl (first_sqn);
+	skb->pgm_opt_fragment->opt_frag_off = pgm_htonl ((uint32_t)frag_off);
+	skb->pgm_opt_fragment->opt_frag_len = pgm_htonl ((uint32_t)apdu_length);
+
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_header->pgm_tsdu_length, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_data->data_sqn, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_data->data_trail, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_opt_fragment->opt_sqn, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_opt_fragment->opt_frag_off, 0);
+	unfolded_header = pgm_csum_block_add (unfolded_header, skb->pgm_opt_fragment->opt_frag_len, 0);
+	return unfolded_header;
+}
+
 /* prototype of function to send pro-active parity NAKs.
  */
 
@@ -124,7 +264,8 @@ pgm_schedule_proactive_nak (
 	const bool status = pgm_txw_retransmit_push (sock->window,
 						     nak_tg_sqn | sock->rs_proactive_h,
 						     TRUE /* is_parity */,
-						     sock->tg_sqn_shift);
+						     sock->tg_sqn_shift,
+						     NULL /* all receivers */);
 	return status;
 }
 
@@ -142,6 +283,8 @@ pgm_on_deferred_nak (
 	)
 {
 	struct pgm_sk_buff_t* skb;
+	pgm_txw_t* window;
+	pgm_layer_t* layer;
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
@@ -156,21 +299,35 @@ pgm_on_deferred_nak (
  */
 
 /* peek from the retransmit queue so we can eliminate duplicate NAKs up until the repair packet
- * has been retransmitted.
+ * has been retransmitted.  repairs for the priority lane go first, then the session and
+ * enhancement layers in order as each depends on those below.
  */
 	pgm_spinlock_lock (&sock->txw_spinlock);
-	skb = pgm_txw_retransmit_try_peek (sock->window);
+	window = sock->window;
+	layer = NULL;
+	if (NULL != sock->lane.window && !pgm_txw_retransmit_is_empty (sock->lane.window))
+		window = sock->lane.window;
+	else if (pgm_txw_retransmit_is_empty (sock->window)) {
+		for (unsigned i = 0; i < sock->layers_len; i++) {
+			if (NULL != sock->layers[i].window && !pgm_txw_retransmit_is_empty (sock->layers[i].window)) {
+				layer = &sock->layers[i];
+				window = layer->window;
+				break;
+			}
+		}
+	}
+	skb = pgm_txw_retransmit_try_peek (window);
 	if (skb) {
 		skb = pgm_skb_get (skb);
 		pgm_spinlock_unlock (&sock->txw_spinlock);
-		if (!send_rdata (sock, skb)) {
+		if (!send_rdata (sock, window, layer, skb)) {
 			pgm_free_skb (skb);
 			pgm_notify_send (&sock->rdata_notify);
 			return FALSE;
 		}
 		pgm_free_skb (skb);
 /* now remove sequence number from retransmit queue, re-enabling NAK processing for this sequence number */
-		pgm_txw_retransmit_remove_head (sock->window);
+		pgm_txw_retransmit_remove_head (window);
 	} else
 		pgm_spinlock_unlock (&sock->txw_spinlock);
 	return TRUE;
@@ -208,6 +365,12 @@ pgm_on_spmr (
 		if (PGM_UNLIKELY(!send_status)) {
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Failed to send SPM on SPM-Request."));
 		}
+	} else if (peer->spmr_tstamp && sock->spmr_group_size) {
+/* another receiver requested the SPM after we did, widen the back-off */
+		if (sock->spmr_group_estimate < PGM_MAX_SPMR_GROUP) {
+			sock->spmr_group_estimate *= 2;
+			pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Duplicate peer multicast SPMR, SPMR group estimate %u."), sock->spmr_group_estimate);
+		}
 	} else {
 		pgm_trace (PGM_LOG_ROLE_RX_WINDOW,_("Suppressing SPMR due to peer multicast SPMR."));
 		reset_spmr_timer (peer);
@@ -249,24 +412,76 @@ on_opt_pgmcc_feedback (
 	{
 		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Elected first ACKer"));
 		memcpy (&sock->acker_nla, &peer_nla, pgm_sockaddr_storage_len (&peer_nla));
+		sock->has_acker_ce_count = FALSE;
 	}
 	else if (peer_loss > sock->acker_loss &&
 		 0 != pgm_sockaddr_cmp ((const struct sockaddr*)&peer_nla, (const struct sockaddr*)&sock->acker_nla))
 	{
 		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Elected new ACKer"));
 		memcpy (&sock->acker_nla, &peer_nla, pgm_sockaddr_storage_len (&peer_nla));
+		sock->has_acker_ce_count = FALSE;
 	}
 
 /* update ACKer state */
 	if (0 == pgm_sockaddr_cmp ((const struct sockaddr*)&peer_nla, (const struct sockaddr*)&sock->acker_nla))
 	{
 		sock->acker_loss = peer_loss;
+		sock->acker_rtt = rtt;
+		sock->acker_loss_rate = opt_loss_rate;
 		return TRUE;
 	}
 
 	return FALSE;
 }
 
+/* unicast fan-out receivers name their own address as the NAK group.  the
+ * NAK group carries no port, so a single matching destination is copied to
+ * requester whilst several receivers on one host leave requester empty and
+ * are all repaired.  the copy is kept as the list may change before the send.
+ *
+ * returns TRUE if a fan-out receiver, FALSE otherwise.
+ */
+
+static
+bool
+find_destination (
+	pgm_sock_t*              const restrict sock,
+	const struct sockaddr*   const restrict addr,
+	struct sockaddr_storage* const restrict requester
+	)
+{
+	unsigned matches = 0;
+
+	requester->ss_family = 0;
+	if (0 == sock->destinations_len)
+		return FALSE;
+	pgm_mutex_lock (&sock->destination_mutex);
+	for (unsigned i = 0; i < sock->destinations_len; i++) {
+		if (0 == pgm_sockaddr_cmp (addr, (const struct sockaddr*)&sock->destinations[i])) {
+			if (0 == matches++)
+				memcpy (requester, &sock->destinations[i], sizeof (struct sockaddr_storage));
+			else
+				requester->ss_family = 0;
+		}
+	}
+	pgm_mutex_unlock (&sock->destination_mutex);
+	return (matches > 0);
+}
+
+/* address for a repair or NCF, the session or layer group unless a single
+ * fan-out receiver.
+ */
+
+static inline
+const struct sockaddr*
+repair_destination (
+	const struct sockaddr* const restrict group,
+	const struct sockaddr* const restrict requester
+	)
+{
+	return (NULL != requester) ? requester : group;
+}
+
 /* NAK requesting RDATA transmission for a sending sock, only valid if
  * sequence number(s) still in transmission window.
  *
@@ -274,7 +489,9 @@ on_opt_pgmcc_feedback (
  *
  * TODO: fix IPv6 AFIs
  *
- * take in a NAK and pass off to an asynchronous queue for another thread to process
+ * take in a NAK and pass off to an asynchronous queue for another thread to process,
+ * NAKs addressed to the priority lane or a layer source port repair that window.
+ * with unicast fan-out the NCF and repair go only to the NAKing receiver.
  *
  * if NAK is valid, returns TRUE.  on error, FALSE is returned.
  */
@@ -300,10 +517,16 @@ pgm_on_nak (
 	pgm_debug ("pgm_on_nak (sock:%p skb:%p)",
 		(const void*)sock, (const void*)skb);
 
+	const bool is_lane = (NULL != sock->lane.window && skb->pgm_header->pgm_dport == sock->lane.tsi.sport);
+	pgm_layer_t* layer = (!is_lane && sock->layers_len) ? pgm_layer_find (sock, skb->pgm_header->pgm_dport) : NULL;
+	const pgm_tsi_t* tsi = is_lane ? &sock->lane.tsi : (layer ? &layer->tsi : &sock->tsi);
+	pgm_txw_t* window = is_lane ? sock->lane.window : (layer ? layer->window : sock->window);
+	const struct sockaddr* group = layer ? (const struct sockaddr*)&layer->gr.gr_group : (const struct sockaddr*)&sock->send_gsr.gsr_group;
+
 	const bool is_parity = skb->pgm_header->pgm_options & PGM_OPT_PARITY;
 	if (is_parity) {
 		sock->cumulative_stats[PGM_PC_SOURCE_PARITY_NAKS_RECEIVED]++;
-		if (!sock->use_ondemand_parity) {
+		if (!sock->use_ondemand_parity || is_lane || layer) {
 			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Parity NAK rejected as on-demand parity is not enabled."));
 			sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
 			return FALSE;
@@ -347,7 +570,10 @@ pgm_on_nak (
 		((struct sockaddr_in6*)&nak_grp_nla)->sin6_scope_id = ((struct sockaddr_in6*)&sock->send_gsr.gsr_group)->sin6_scope_id;
 	}
 
-	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&nak_grp_nla, (struct sockaddr*)&sock->send_gsr.gsr_group) != 0))
+	struct sockaddr_storage requester_nla;
+	requester_nla.ss_family = 0;
+	if (PGM_UNLIKELY(pgm_sockaddr_cmp ((struct sockaddr*)&nak_grp_nla, group) != 0) &&
+	    (layer || !find_destination (sock, (struct sockaddr*)&nak_grp_nla, &requester_nla)))
 	{
 		char sgroup[INET6_ADDRSTRLEN];
 		pgm_sockaddr_ntop ((struct sockaddr*)&nak_src_nla, sgroup, sizeof(sgroup));
@@ -355,6 +581,7 @@ pgm_on_nak (
 		sock->cumulative_stats[PGM_PC_SOURCE_MALFORMED_NAKS]++;
 		return FALSE;
 	}
+	const struct sockaddr* requester = requester_nla.ss_family ? (const struct sockaddr*)&requester_nla : NULL;
 
 /* create queue object */
 	sqn_list.sqn[0] = pgm_ntohl (nak->nak_sqn);
@@ -410,13 +637,13 @@ pgm_on_nak (
  * broadcast will be sent later.
  */
 	if (nak_list_len)
-		send_ncf_list (sock, (struct sockaddr*)&nak_src_nla, (struct sockaddr*)&nak_grp_nla, &sqn_list, is_parity);
+		send_ncf_list (sock, tsi, group, (struct sockaddr*)&nak_src_nla, (struct sockaddr*)&nak_grp_nla, requester, &sqn_list, is_parity);
 	else
-		send_ncf (sock, (struct sockaddr*)&nak_src_nla, (struct sockaddr*)&nak_grp_nla, sqn_list.sqn[0], is_parity);
+		send_ncf (sock, tsi, group, (struct sockaddr*)&nak_src_nla, (struct sockaddr*)&nak_grp_nla, requester, sqn_list.sqn[0], is_parity);
 
 /* queue retransmit requests */
 	for (uint_fast8_t i = 0; i < sqn_list.len; i++) {
-		const bool push_status = pgm_txw_retransmit_push (sock->window, sqn_list.sqn[i], is_parity, sock->tg_sqn_shift);
+		const bool push_status = pgm_txw_retransmit_push (window, sqn_list.sqn[i], is_parity, sock->tg_sqn_shift, requester);
 		if (PGM_UNLIKELY(!push_status)) {
 			pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Failed to push retransmit request for #%" PRIu32), sqn_list.sqn[i]);
 		}
@@ -504,6 +731,111 @@ pgm_on_nnak (
 	return TRUE;
 }
 
+/* Equation-based rate control, TFMCC style, of the ODATA rate bucket from
+ * feedback of the elected ACKer.  Highest RTT²·loss is elected by PGMCC which
+ * matches the receiver with the lowest calculated rate.
+ *
+ * Before any loss is reported the rate doubles every RTT, afterwards the rate
+ * follows the TCP throughput equation with increases limited to one packet per
+ * RTT per RTT, decreases are applied immediately.
+ */
+
+static
+void
+on_rate_cc_feedback (
+	pgm_sock_t* const	sock,
+	const pgm_time_t	now
+	)
+{
+	ssize_t rate;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (sock->use_rate_cc);
+
+/* serialise with the ACK timeout in pgm_timer_dispatch() */
+	pgm_mutex_lock (&sock->timer_mutex);
+	rate = sock->cc_rate;
+
+/* ECN marks are treated as loss events without the loss */
+	const uint_fast32_t loss_rate = sock->use_ecn ? MAX(sock->acker_loss_rate, sock->acker_ce_rate) : sock->acker_loss_rate;
+
+/* smoothed RTT with gain of ⅛ */
+	const uint_fast32_t rtt = pgm_fp8 (MAX(sock->acker_rtt, 1));
+	if (0 == sock->cc_srtt)
+		sock->cc_srtt = rtt;
+	else
+		sock->cc_srtt = sock->cc_srtt - (sock->cc_srtt >> 3) + (rtt >> 3);
+	const pgm_time_t srtt = pgm_msecs (pgm_fp8tou (sock->cc_srtt) + 1);
+
+/* feedback received, re-arm timeout on next transmission */
+	sock->ack_expiry = 0;
+
+	if (sock->is_rate_cc_slow_start && 0 != loss_rate) {
+		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Rate congestion control leaving slow-start at %" PRIzd " bytes per second."),
+			   rate);
+		sock->is_rate_cc_slow_start = FALSE;
+	}
+
+	if (sock->is_rate_cc_slow_start)
+	{
+		if (pgm_time_after_eq (now, sock->cc_next_increase)) {
+			rate += rate;
+			sock->cc_next_increase = now + srtt;
+		}
+	}
+	else
+	{
+		double target = (double)sock->cc_max_rate;
+		if (0 != loss_rate) {
+			const double p = loss_rate / 65536.0;
+			const double r = sock->cc_srtt / (256.0 * 1000.0);
+			const double t_rto = 4.0 * r;
+			const double x = sock->max_tpdu / (r * sqrt (2.0 * p / 3.0) + t_rto * (3.0 * sqrt (3.0 * p / 8.0)) * p * (1.0 + 32.0 * p * p));
+			if (x < target)
+				target = x;
+		}
+		if (target < (double)rate) {
+			rate = (ssize_t)target;
+			pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("Rate congestion control decrease to %" PRIzd " bytes per second (RTT:%ums loss:%u)"),
+				   rate, pgm_fp8tou (sock->cc_srtt), (unsigned)loss_rate);
+		} else if (pgm_time_after_eq (now, sock->cc_next_increase)) {
+			const ssize_t inc = (ssize_t)(((uint64_t)sock->max_tpdu * 1000 * 256) / MAX(sock->cc_srtt, 1));
+			rate = (rate + inc < target) ? rate + inc : (ssize_t)target;
+			sock->cc_next_increase = now + srtt;
+		}
+	}
+
+	rate = MAX(rate, (ssize_t)sock->max_tpdu);
+	rate = MIN(rate, sock->cc_max_rate);
+	if (rate != sock->cc_rate) {
+		sock->cc_rate = rate;
+		pgm_rate_set (&sock->odata_rate_control, rate, sock->max_tpdu);
+	}
+	pgm_mutex_unlock (&sock->timer_mutex);
+}
+
+/* PGMCC reaction to a congestion event, halve the window and suspend further
+ * manipulation until feedback arrives for data sent after sequence number sqn.
+ */
+
+static
+void
+on_pgmcc_congestion (
+	pgm_sock_t* const	sock,
+	const uint32_t		sqn
+	)
+{
+	sock->suspended_sqn = sqn;
+	sock->is_congested = TRUE;
+	sock->cwnd_size = pgm_fp8div (sock->cwnd_size, pgm_fp8 (2));
+	if (sock->cwnd_size > sock->tokens)
+		sock->tokens = 0;
+	else
+		sock->tokens -= sock->cwnd_size;
+	sock->ack_bitmap = 0xffffffff;
+}
+
 /* ACK, sent upstream by one selected ACKER for congestion control feedback.
  *
  * if ACK is valid, returns TRUE.  on error, FALSE is returned.
@@ -517,7 +849,9 @@ pgm_on_ack (
 	)
 {
 	const struct pgm_ack	*ack;
+	const struct pgm_opt_ecn *opt_ecn = NULL;
 	bool			 is_acker = FALSE;
+	bool			 is_ce = FALSE;
 	uint32_t		 ack_bitmap;
 	unsigned		 new_acks;
 
@@ -540,7 +874,7 @@ pgm_on_ack (
 
 	ack = (struct pgm_ack*)skb->data;
 
-/* check PGMCC feedback option for new elections */
+/* check PGMCC feedback option for new elections and ECN feedback */
 	if (skb->pgm_header->pgm_options & PGM_OPT_PRESENT)
 	{
 		const struct pgm_opt_header *opt_header;
@@ -561,7 +895,9 @@ pgm_on_ack (
 			if ((opt_header->opt_type & PGM_OPT_MASK) == PGM_OPT_PGMCC_FEEDBACK) {
 				const struct pgm_opt_pgmcc_feedback* opt_pgmcc_feedback = (const struct pgm_opt_pgmcc_feedback*)(opt_header + 1);
 				is_acker = on_opt_pgmcc_feedback (sock, skb, opt_pgmcc_feedback);
-				break;	/* ignore other options */
+			}
+			else if ((opt_header->opt_type & PGM_OPT_MASK) == PGM_OPT_ECN) {
+				opt_ecn = (const struct pgm_opt_ecn*)(opt_header + 1);
 			}
 		} while (!(opt_header->opt_type & PGM_OPT_END));
 	}
@@ -573,6 +909,22 @@ pgm_on_ack (
 /* reset ACK expiration */
 	sock->next_crqst = 0;
 
+/* new congestion experienced marks since the last ACK, first report after election only primes the count */
+	if (sock->use_ecn && NULL != opt_ecn)
+	{
+		const uint32_t ce_count = pgm_ntohl (opt_ecn->opt_ce_count);
+		is_ce = sock->has_acker_ce_count && ce_count != sock->acker_ce_count;
+		sock->acker_ce_count = ce_count;
+		sock->acker_ce_rate = pgm_ntohs (opt_ecn->opt_ce_rate);
+		sock->has_acker_ce_count = TRUE;
+	}
+
+/* rate mode: feedback steers the ODATA bucket, tokens are not consumed */
+	if (sock->use_rate_cc) {
+		on_rate_cc_feedback (sock, skb->tstamp);
+		return TRUE;
+	}
+
 /* count new ACK sequences */
 	const uint32_t ack_rx_max = pgm_ntohl (ack->ack_rx_max);
 	const int32_t delta = ack_rx_max - sock->ack_rx_max;
@@ -608,6 +960,16 @@ pgm_on_ack (
 		sock->is_congested = FALSE;
 	}
 
+/* congestion experienced marks react as a loss without waiting for three further ACKs */
+	if (is_ce)
+	{
+		sock->acks_after_loss = 0;
+		on_pgmcc_congestion (sock, ack_rx_max);
+		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("PGMCC congestion experienced, half window size (T:%u W:%u)"),
+			   pgm_fp8tou (sock->tokens), pgm_fp8tou (sock->cwnd_size));
+		goto notify_tx;
+	}
+
 /* count outstanding lost sequences */
 	const unsigned total_lost = _pgm_popcount (~sock->ack_bitmap);
 
@@ -650,14 +1012,7 @@ pgm_on_ack (
 		if (sock->acks_after_loss >= 3)
 		{
 			sock->acks_after_loss = 0;
-			sock->suspended_sqn = ack_rx_max;
-			sock->is_congested = TRUE;
-			sock->cwnd_size = pgm_fp8div (sock->cwnd_size, pgm_fp8 (2));
-			if (sock->cwnd_size > sock->tokens)
-				sock->tokens = 0;
-			else
-				sock->tokens -= sock->cwnd_size;
-			sock->ack_bitmap = 0xffffffff;
+			on_pgmcc_congestion (sock, ack_rx_max);
 			pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("PGMCC congestion, half window size (T:%u W:%u)"),
 				   pgm_fp8tou (sock->tokens), pgm_fp8tou (sock->cwnd_size));
 		}
@@ -677,6 +1032,9 @@ notify_tx:
  *
  * heartbeat: ihb_tmr decaying between ihb_min and ihb_max 2x after last packet
  *
+ * the priority lane and layers follow each session SPM, a blocked companion
+ * SPM is left to the next heartbeat.
+ *
  * on success, TRUE is returned, if operation would block, FALSE is returned.
  */
 
@@ -686,6 +1044,46 @@ pgm_send_spm (
 	pgm_sock_t* const	sock,
 	const int		flags
 	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->window);
+
+	pgm_debug ("pgm_send_spm (sock:%p flags:%d)",
+		(const void*)sock, flags);
+
+	if (!send_spm (sock, &sock->tsi, sock->window, &sock->spm_sqn, (struct sockaddr*)&sock->send_gsr.gsr_group, flags))
+		return FALSE;
+	if (NULL != sock->lane.window &&
+	    !send_spm (sock, &sock->lane.tsi, sock->lane.window, &sock->lane.spm_sqn, (struct sockaddr*)&sock->send_gsr.gsr_group, flags))
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Failed to send priority lane SPM."));
+	}
+	for (unsigned i = 0; i < sock->layers_len; i++) {
+		pgm_layer_t* layer = &sock->layers[i];
+		if (NULL != layer->window &&
+		    !send_spm (sock, &layer->tsi, layer->window, &layer->spm_sqn, (struct sockaddr*)&layer->gr.gr_group, flags))
+		{
+			pgm_trace (PGM_LOG_ROLE_NETWORK,_("Failed to send layer %u SPM."), i + 1);
+		}
+	}
+	return TRUE;
+}
+
+/* SPM for the session, priority lane or a layer on its group, FEC and
+ * congestion report options apply to the session only.
+ */
+
+static
+bool
+send_spm (
+	pgm_sock_t*	       const restrict	sock,
+	const pgm_tsi_t*       const restrict	tsi,
+	pgm_txw_t*	       const restrict	window,
+	uint32_t*	       const restrict	spm_sqn,
+	const struct sockaddr* const restrict	group,
+	const int				flags
+	)
 {
 	size_t		   tpdu_length;
 	char		  *buf;
@@ -696,31 +1094,37 @@ pgm_send_spm (
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
-	pgm_assert (NULL != sock->window);
+	pgm_assert (NULL != tsi);
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != spm_sqn);
 
-	pgm_debug ("pgm_send_spm (sock:%p flags:%d)",
-		(const void*)sock, flags);
+	const bool use_parity = (window == sock->window) &&
+				(sock->use_proactive_parity || sock->use_ondemand_parity);
+	const bool use_crqst  = (window == sock->window) && sock->is_pending_crqst;
 
 	tpdu_length = sizeof(struct pgm_header);
 	if (AF_INET == sock->send_gsr.gsr_group.ss_family)
 		tpdu_length += sizeof(struct pgm_spm);
 	else
 		tpdu_length += sizeof(struct pgm_spm6);
-	if (sock->use_proactive_parity ||
-	    sock->use_ondemand_parity ||
-	    sock->is_pending_crqst ||
+	if (use_parity ||
+	    use_crqst ||
+	    sock->late_join_sqns ||
 	    PGM_OPT_FIN == flags)
 	{
 		tpdu_length += sizeof(struct pgm_opt_length);
 /* forward error correction */
-		if (sock->use_proactive_parity ||
-		    sock->use_ondemand_parity)
+		if (use_parity)
 			tpdu_length += sizeof(struct pgm_opt_header) +
 				       sizeof(struct pgm_opt_parity_prm);
 /* congestion report request */
-		if (sock->is_pending_crqst)
+		if (use_crqst)
 			tpdu_length += sizeof(struct pgm_opt_header) +
 				       sizeof(struct pgm_opt_crqst);
+/* late join */
+		if (sock->late_join_sqns)
+			tpdu_length += sizeof(struct pgm_opt_header) +
+				       sizeof(struct pgm_opt_join);
 /* end of session */
 		if (PGM_OPT_FIN == flags)
 			tpdu_length += sizeof(struct pgm_opt_header) +
@@ -730,25 +1134,25 @@ pgm_send_spm (
 	header = (struct pgm_header*)buf;
 	spm  = (struct pgm_spm *)(header + 1);
 	spm6 = (struct pgm_spm6*)(header + 1);
-	memcpy (header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	header->pgm_sport       = sock->tsi.sport;
+	memcpy (header->pgm_gsi, &tsi->gsi, sizeof(pgm_gsi_t));
+	header->pgm_sport       = tsi->sport;
 	header->pgm_dport       = sock->dport;
 	header->pgm_type        = PGM_SPM;
 	header->pgm_options     = 0;
 	header->pgm_tsdu_length = 0;
 
 /* SPM */
-	spm->spm_sqn		= pgm_htonl (sock->spm_sqn);
-	spm->spm_trail		= pgm_htonl (pgm_txw_trail_atomic (sock->window));
-	spm->spm_lead		= pgm_htonl (pgm_txw_lead_atomic (sock->window));
+	spm->spm_sqn		= pgm_htonl (*spm_sqn);
+	spm->spm_trail		= pgm_htonl (pgm_txw_trail_atomic (window));
+	spm->spm_lead		= pgm_htonl (pgm_txw_lead_atomic (window));
 	spm->spm_reserved	= 0;
 /* our nla */
 	pgm_sockaddr_to_nla ((struct sockaddr*)&sock->send_addr, (char*)&spm->spm_nla_afi);
 
 /* PGM options */
-	if (sock->use_proactive_parity ||
-	    sock->use_ondemand_parity ||
-	    sock->is_pending_crqst ||
+	if (use_parity ||
+	    use_crqst ||
+	    sock->late_join_sqns ||
 	    PGM_OPT_FIN == flags)
 	{
 		struct pgm_opt_header *opt_header, *last_opt_header;
@@ -767,8 +1171,7 @@ pgm_send_spm (
 		last_opt_header = opt_header = (struct pgm_opt_header*)(opt_len + 1);
 
 /* OPT_PARITY_PRM */
-		if (sock->use_proactive_parity ||
-		    sock->use_ondemand_parity)
+		if (use_parity)
 		{
 			struct pgm_opt_parity_prm *opt_parity_prm;
 
@@ -786,7 +1189,7 @@ pgm_send_spm (
 		}
 
 /* OPT_CRQST */
-		if (sock->is_pending_crqst)
+		if (use_crqst)
 		{
 			struct pgm_opt_crqst *opt_crqst;
 
@@ -803,6 +1206,26 @@ pgm_send_spm (
 			opt_header = (struct pgm_opt_header*)(opt_crqst + 1);
 		}
 
+/* OPT_JOIN, bounded by the window trail */
+		if (sock->late_join_sqns)
+		{
+			struct pgm_opt_join *opt_join;
+			const uint32_t trail = pgm_ntohl (spm->spm_trail);
+			uint32_t join_min = pgm_ntohl (spm->spm_lead) + 1 - sock->late_join_sqns;
+			if (pgm_uint32_lt (join_min, trail))
+				join_min = trail;
+
+			opt_total_length += sizeof(struct pgm_opt_header) +
+					    sizeof(struct pgm_opt_join);
+			opt_header->opt_type	= PGM_OPT_JOIN;
+			opt_header->opt_length	= sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_join);
+			opt_join = (struct pgm_opt_join*)(opt_header + 1);
+			opt_join->opt_reserved = 0;
+			opt_join->opt_join_min = pgm_htonl (join_min);
+			last_opt_header = opt_header;
+			opt_header = (struct pgm_opt_header*)(opt_join + 1);
+		}
+
 /* OPT_FIN */
 		if (PGM_OPT_FIN == flags)
 		{
@@ -832,8 +1255,8 @@ pgm_send_spm (
 			   TRUE,		/* with router alert */
 			   buf,
 			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+			   group,
+			   pgm_sockaddr_len(group));
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -845,7 +1268,7 @@ pgm_send_spm (
 	}
 
 /* advance SPM sequence only on successful transmission */
-	sock->spm_sqn++;
+	(*spm_sqn)++;
 	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)tpdu_length);
 	return TRUE;
 }
@@ -859,8 +1282,11 @@ static
 bool
 send_ncf (
 	pgm_sock_t*            const restrict sock,
+	const pgm_tsi_t*       const restrict tsi,		/* session, priority lane or layer */
+	const struct sockaddr* const restrict group,		/* session or layer group */
 	const struct sockaddr* const restrict nak_src_nla,
 	const struct sockaddr* const restrict nak_grp_nla,
+	const struct sockaddr* const restrict requester,	/* fan-out destination, NULL = group */
 	const uint32_t			      sequence,
 	const bool			      is_parity		/* send parity NCF */
 	)
@@ -874,6 +1300,7 @@ send_ncf (
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
+	pgm_assert (NULL != tsi);
 	pgm_assert (NULL != nak_src_nla);
 	pgm_assert (NULL != nak_grp_nla);
 	pgm_assert (nak_src_nla->sa_family == nak_grp_nla->sa_family);
@@ -899,8 +1326,8 @@ send_ncf (
 	header = (struct pgm_header*)buf;
 	ncf  = (struct pgm_nak *)(header + 1);
 	ncf6 = (struct pgm_nak6*)(header + 1);
-	memcpy (header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	header->pgm_sport	= sock->tsi.sport;
+	memcpy (header->pgm_gsi, &tsi->gsi, sizeof(pgm_gsi_t));
+	header->pgm_sport	= tsi->sport;
 	header->pgm_dport	= sock->dport;
 	header->pgm_type        = PGM_NCF;
         header->pgm_options     = is_parity ? PGM_OPT_PARITY : 0;
@@ -919,14 +1346,15 @@ send_ncf (
         header->pgm_checksum = 0;
         header->pgm_checksum = pgm_csum_fold (pgm_csum_partial (buf, (uint16_t)tpdu_length, 0));
 
+	const struct sockaddr* to = repair_destination (group, requester);
 	sent = pgm_sendto (sock,
 			   FALSE,			/* not rate limited */
 			   NULL,
 			   TRUE,			/* with router alert */
 			   buf,
 			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+			   to,
+			   pgm_sockaddr_len(to));
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 /* fall through silently on other errors */
@@ -944,8 +1372,11 @@ static
 bool
 send_ncf_list (
 	pgm_sock_t*            const restrict sock,
+	const pgm_tsi_t*       const restrict tsi,		/* session, priority lane or layer */
+	const struct sockaddr* const restrict group,		/* session or layer group */
 	const struct sockaddr* const restrict nak_src_nla,
 	const struct sockaddr* const restrict nak_grp_nla,
+	const struct sockaddr* const restrict requester,	/* fan-out destination, NULL = group */
 	struct pgm_sqn_list_t* const restrict sqn_list,		/* will change to network-order */
 	const bool			      is_parity		/* send parity NCF */
 	)
@@ -962,6 +1393,7 @@ send_ncf_list (
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
+	pgm_assert (NULL != tsi);
 	pgm_assert (NULL != nak_src_nla);
 	pgm_assert (NULL != nak_grp_nla);
 	pgm_assert (sqn_list->len > 1);
@@ -997,8 +1429,8 @@ send_ncf_list (
 	header = (struct pgm_header*)buf;
 	ncf  = (struct pgm_nak *)(header + 1);
 	ncf6 = (struct pgm_nak6*)(header + 1);
-	memcpy (header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	header->pgm_sport	= sock->tsi.sport;
+	memcpy (header->pgm_gsi, &tsi->gsi, sizeof(pgm_gsi_t));
+	header->pgm_sport	= tsi->sport;
 	header->pgm_dport	= sock->dport;
 	header->pgm_type        = PGM_NCF;
         header->pgm_options     = is_parity ? (PGM_OPT_PRESENT | PGM_OPT_NETWORK | PGM_OPT_PARITY) : (PGM_OPT_PRESENT | PGM_OPT_NETWORK);
@@ -1034,14 +1466,15 @@ send_ncf_list (
         header->pgm_checksum    = 0;
         header->pgm_checksum	= pgm_csum_fold (pgm_csum_partial (buf, (uint16_t)tpdu_length, 0));
 
+	const struct sockaddr* to = repair_destination (group, requester);
 	sent = pgm_sendto (sock,
 			   FALSE,			/* not rate limited */
 			   NULL,
 			   TRUE,			/* with router alert */
 			   buf,
 			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+			   to,
+			   pgm_sockaddr_len(to));
 	if (sent < 0 && PGM_LIKELY(PGM_SOCK_EAGAIN == pgm_get_last_sock_error()))
 		return FALSE;
 /* fall through silently on other errors */
@@ -1101,6 +1534,7 @@ send_odata (
 	)
 {
 	void	*data;
+	uint32_t unfolded_header;
 	ssize_t	 sent;
 
 /* pre-conditions */
@@ -1126,30 +1560,32 @@ send_odata (
 	STATE(skb)->sock = sock;
 	STATE(skb)->tstamp = pgm_time_update_now();
 
-	STATE(skb)->pgm_header = (struct pgm_header*)STATE(skb)->head;
-	STATE(skb)->pgm_data   = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-	memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-	STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-	STATE(skb)->pgm_header->pgm_type        = PGM_ODATA;
-        STATE(skb)->pgm_header->pgm_options     = sock->use_pgmcc ? PGM_OPT_PRESENT : 0;
-        STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
-
-/* ODATA */
-        STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-        STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-        STATE(skb)->pgm_header->pgm_checksum    = 0;
-	data = STATE(skb)->pgm_data + 1;
-/* congestion control option header indicating elected peer for ACKs. */
-	if (sock->use_pgmcc) {
+	if (PGM_LIKELY(!sock->use_pgmcc)) {
+		unfolded_header = source_stamp_odata (sock, STATE(skb), tsdu_length);
+		data = STATE(skb)->pgm_data + 1;
+	} else {
 		struct pgm_opt_header	   *opt_header;
 		struct pgm_opt_length	   *opt_len;
 		struct pgm_opt_pgmcc_data  *pgmcc_data;
 		const size_t opt_pgmcc_data_len = ((AF_INET6 == sock->acker_nla.ss_family) ?
 							sizeof (struct pgm_opt6_pgmcc_data) :
 							sizeof (struct pgm_opt_pgmcc_data));
-		opt_len = data;
+		STATE(skb)->pgm_header = (struct pgm_header*)STATE(skb)->head;
+		STATE(skb)->pgm_data   = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
+		memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+		STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
+		STATE(skb)->pgm_header->pgm_dport	= sock->dport;
+		STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
+		STATE(skb)->pgm_header->pgm_options	= PGM_OPT_PRESENT;
+		STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
+		STATE(skb)->pgm_header->pgm_checksum	= 0;
+
+/* ODATA */
+		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
+		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+
+/* congestion control option header indicating elected peer for ACKs. */
+		opt_len = (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
 		opt_len->opt_type	= PGM_OPT_LENGTH;
 		opt_len->opt_length	= sizeof(struct pgm_opt_length);
 		opt_len->opt_total_length = pgm_htons ((uint16_t)(sizeof (struct pgm_opt_length) +
@@ -1164,9 +1600,9 @@ send_odata (
 /* acker nla */
 		pgm_sockaddr_to_nla ((struct sockaddr*)&sock->acker_nla, (char*)&pgmcc_data->opt_nla_afi);
 		data = (char*)opt_header + opt_header->opt_length;
+		unfolded_header = pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)((char*)data - (char*)STATE(skb)->pgm_header), 0);
 	}
 	const size_t   pgm_header_len		= (char*)data - (char*)STATE(skb)->pgm_header;
-	const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
 	STATE(unfolded_odata)			= pgm_csum_partial (data, (uint16_t)tsdu_length, 0);
         STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
@@ -1206,14 +1642,14 @@ retry_send:
 		return PGM_IO_STATUS_CONGESTION;	/* peer expiration to re-elect ACKer */
 	}
 
-	sent = pgm_sendto (sock,
-			   !STATE(is_rate_limited),	/* rate limit on blocking */
-			   &sock->odata_rate_control,
-			   FALSE,			/* regular socket */
-			   STATE(skb)->head,
-			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	sent = pgm_sendto_skb (sock,
+			       !STATE(is_rate_limited),	/* rate limit on blocking */
+			       &sock->odata_rate_control,
+			       FALSE,			/* regular socket */
+			       STATE(skb),
+			       tpdu_length,
+			       (struct sockaddr*)&sock->send_gsr.gsr_group,
+			       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -1234,7 +1670,10 @@ retry_send:
 /* SPM heartbeats decay from last sent data packet */
 	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
 /* congestion control: remove token from bucket */
-	if (sock->use_pgmcc) {
+	if (sock->use_rate_cc) {
+		if (0 == sock->ack_expiry)
+			sock->ack_expiry = STATE(skb)->tstamp + sock->ack_expiry_ivl;
+	} else if (sock->use_pgmcc) {
 		sock->tokens -= pgm_fp8 (1);
 		sock->ack_expiry = STATE(skb)->tstamp + sock->ack_expiry_ivl;
 	}
@@ -1277,6 +1716,7 @@ send_odata_copy (
 	)
 {
 	void	*data;
+	uint32_t unfolded_header;
 	ssize_t	 sent;
 
 /* pre-conditions */
@@ -1302,30 +1742,32 @@ send_odata_copy (
 	pgm_skb_reserve (STATE(skb), (uint16_t)pgm_pkt_offset (FALSE, pgmcc_family));
 	pgm_skb_put (STATE(skb), (uint16_t)tsdu_length);
 
-	STATE(skb)->pgm_header	= (struct pgm_header*)STATE(skb)->head;
-	STATE(skb)->pgm_data	= (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-	memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-	STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-	STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
-	STATE(skb)->pgm_header->pgm_options	= sock->use_pgmcc ? PGM_OPT_PRESENT : 0;
-	STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
-
-/* ODATA */
-	STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-	STATE(skb)->pgm_header->pgm_checksum	= 0;
-	data = STATE(skb)->pgm_data + 1;
-/* congestion control option header indicating elected peer for ACKs. */
-	if (sock->use_pgmcc) {
+	if (PGM_LIKELY(!sock->use_pgmcc)) {
+		unfolded_header = source_stamp_odata (sock, STATE(skb), tsdu_length);
+		data = STATE(skb)->pgm_data + 1;
+	} else {
 		struct pgm_opt_header		*opt_header;
 		struct pgm_opt_length		*opt_len;
 		struct pgm_opt_pgmcc_data	*pgmcc_data;
 		const size_t opt_pgmcc_data_len = ((AF_INET6 == sock->acker_nla.ss_family) ?
 							sizeof (struct pgm_opt6_pgmcc_data) :
 							sizeof (struct pgm_opt_pgmcc_data));
-		opt_len = data;
+		STATE(skb)->pgm_header	= (struct pgm_header*)STATE(skb)->head;
+		STATE(skb)->pgm_data	= (struct pgm_data*)(STATE(skb)->pgm_header + 1);
+		memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+		STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
+		STATE(skb)->pgm_header->pgm_dport	= sock->dport;
+		STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
+		STATE(skb)->pgm_header->pgm_options	= PGM_OPT_PRESENT;
+		STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
+		STATE(skb)->pgm_header->pgm_checksum	= 0;
+
+/* ODATA */
+		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
+		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+
+/* congestion control option header indicating elected peer for ACKs. */
+		opt_len = (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
 		opt_len->opt_type	= PGM_OPT_LENGTH;
 		opt_len->opt_length	= sizeof (struct pgm_opt_length);
 		opt_len->opt_total_length = pgm_htons ((uint16_t)(sizeof (struct pgm_opt_length) +
@@ -1341,9 +1783,9 @@ send_odata_copy (
 /* acker nla */
 		pgm_sockaddr_to_nla ((struct sockaddr*)&sock->acker_nla, (char*)&pgmcc_data->opt_nla_afi);
 		data = (char*)opt_header + opt_header->opt_length;
+		unfolded_header = pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)((char*)data - (char*)STATE(skb)->pgm_header), 0);
 	}
 	const size_t   pgm_header_len		= (char*)data - (char*)STATE(skb)->pgm_header;
-	const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
 	STATE(unfolded_odata)			= pgm_csum_partial_copy (tsdu, data, (uint16_t)tsdu_length, 0);
 	STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
@@ -1379,14 +1821,14 @@ retry_send:
 		return PGM_IO_STATUS_CONGESTION;
 	}
 
-	sent = pgm_sendto (sock,
-			   !STATE(is_rate_limited),	/* rate limit on blocking */
-			   &sock->odata_rate_control,
-			   FALSE,			/* regular socket */
-			   STATE(skb)->head,
-			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	sent = pgm_sendto_skb (sock,
+			       !STATE(is_rate_limited),	/* rate limit on blocking */
+			       &sock->odata_rate_control,
+			       FALSE,			/* regular socket */
+			       STATE(skb),
+			       tpdu_length,
+			       (struct sockaddr*)&sock->send_gsr.gsr_group,
+			       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -1407,7 +1849,10 @@ retry_send:
 /* SPM heartbeats decay from last sent data packet */
 	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
 /* congestion control: remove token from bucket */
-	if (sock->use_pgmcc) {
+	if (sock->use_rate_cc) {
+		if (0 == sock->ack_expiry)
+			sock->ack_expiry = STATE(skb)->tstamp + sock->ack_expiry_ivl;
+	} else if (sock->use_pgmcc) {
 		sock->tokens -= pgm_fp8 (1);
 		pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("PGMCC tokens-- (T:%u W:%u)"),
 		 	   pgm_fp8tou (sock->tokens), pgm_fp8tou (sock->cwnd_size));
@@ -1496,22 +1941,8 @@ send_odatav (
 	pgm_skb_reserve (STATE(skb), (uint16_t)pgm_pkt_offset (FALSE, pgmcc_family));
 	pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
 
-	STATE(skb)->pgm_header  = (struct pgm_header*)STATE(skb)->data;
-	STATE(skb)->pgm_data    = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-	memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-	STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-	STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-	STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
-	STATE(skb)->pgm_header->pgm_options	= 0;
-	STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons ((uint16_t)STATE(tsdu_length));
-
-/* ODATA */
-	STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-	STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-	STATE(skb)->pgm_header->pgm_checksum	= 0;
+	const uint32_t unfolded_header		= source_stamp_odata (sock, STATE(skb), (uint16_t)STATE(tsdu_length));
 	const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_data + 1) - (char*)STATE(skb)->pgm_header;
-	const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
 
 /* unroll first iteration to make friendly branch prediction */
 	dst			= (char*)(STATE(skb)->pgm_data + 1);
@@ -1551,14 +1982,14 @@ send_odatav (
 	}
 
 retry_send:
-	sent = pgm_sendto (sock,
-			   !STATE(is_rate_limited),	/* rate limit on blocking */
-			   &sock->odata_rate_control,
-			   FALSE,			/* regular socket */
-			   STATE(skb)->head,
-			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	sent = pgm_sendto_skb (sock,
+			       !STATE(is_rate_limited),	/* rate limit on blocking */
+			       &sock->odata_rate_control,
+			       FALSE,			/* regular socket */
+			       STATE(skb),
+			       tpdu_length,
+			       (struct sockaddr*)&sock->send_gsr.gsr_group,
+			       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -1626,6 +2057,7 @@ send_apdu (
 	pgm_assert (NULL != apdu);
 
 	const sa_family_t pgmcc_family = sock->use_pgmcc ? sock->family : 0;
+	const size_t opt_transform_length = STATE(is_transformed) ? PGM_OPT_TRANSFORM_LEN : 0;
 
 /* continue if blocked mid-apdu */
 	if (sock->is_apdu_eagain)
@@ -1635,12 +2067,12 @@ send_apdu (
 	STATE(is_rate_limited) = FALSE;
 	if (sock->is_nonblocking && sock->is_controlled_odata)
 	{
-		const size_t header_length = pgm_pkt_offset (TRUE, pgmcc_family);
+		const size_t header_length = pgm_pkt_offset (TRUE, pgmcc_family) + opt_transform_length;
 		size_t tpdu_length = 0;
 		size_t offset_	   = 0;
 
 		do {
-			const uint_fast16_t tsdu_length = (uint_fast16_t)MIN( source_max_tsdu (sock, TRUE), apdu_length - offset_ );
+			const uint_fast16_t tsdu_length = (uint_fast16_t)MIN( source_max_tsdu (sock, TRUE) - opt_transform_length, apdu_length - offset_ );
 			tpdu_length += sock->iphdr_len + header_length + tsdu_length;
 			offset_ += tsdu_length;
 		} while (offset_ < apdu_length);
@@ -1661,13 +2093,11 @@ send_apdu (
 
 	do {
 		size_t			 tpdu_length, header_length;
-		struct pgm_opt_header	*opt_header;
-		struct pgm_opt_length	*opt_len;
 		ssize_t			 sent;
 
 /* retrieve packet storage from transmit window */
-		header_length = pgm_pkt_offset (TRUE, pgmcc_family);
-		STATE(tsdu_length) = MIN( source_max_tsdu (sock, TRUE), apdu_length - STATE(data_bytes_offset) );
+		header_length = pgm_pkt_offset (TRUE, pgmcc_family) + opt_transform_length;
+		STATE(tsdu_length) = MIN( source_max_tsdu (sock, TRUE) - opt_transform_length, apdu_length - STATE(data_bytes_offset) );
 
 		STATE(skb) = pgm_alloc_skb (sock->max_tpdu);
 		STATE(skb)->sock = sock;
@@ -1675,42 +2105,10 @@ send_apdu (
 		pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
 		pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
 
-		STATE(skb)->pgm_header  = (struct pgm_header*)STATE(skb)->head;
-		STATE(skb)->pgm_data    = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-		memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-		STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-		STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-		STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
-		STATE(skb)->pgm_header->pgm_options	= PGM_OPT_PRESENT;
-		STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons ((uint16_t)STATE(tsdu_length));
-
-/* ODATA */
-		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-/* OPT_LENGTH */
-		opt_len					= (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
-		opt_len->opt_type			= PGM_OPT_LENGTH;
-		opt_len->opt_length			= sizeof(struct pgm_opt_length);
-		opt_len->opt_total_length		= pgm_htons ((uint16_t)(sizeof(struct pgm_opt_length) +
-									sizeof(struct pgm_opt_header) +
-									sizeof(struct pgm_opt_fragment)));
-/* OPT_FRAGMENT */
-		opt_header				= (struct pgm_opt_header*)(opt_len + 1);
-		opt_header->opt_type			= PGM_OPT_FRAGMENT | PGM_OPT_END;
-		opt_header->opt_length			= sizeof(struct pgm_opt_header) +
-						  	  sizeof(struct pgm_opt_fragment);
-		STATE(skb)->pgm_opt_fragment			= (struct pgm_opt_fragment*)(opt_header + 1);
-		STATE(skb)->pgm_opt_fragment->opt_reserved	= 0;
-		STATE(skb)->pgm_opt_fragment->opt_sqn		= pgm_htonl (STATE(first_sqn));
-		STATE(skb)->pgm_opt_fragment->opt_frag_off	= pgm_htonl ((uint32_t)STATE(data_bytes_offset));
-		STATE(skb)->pgm_opt_fragment->opt_frag_len	= pgm_htonl ((uint32_t)apdu_length);
-
-/* TODO: the assembly checksum & copy routine is faster than memcpy & pgm_cksum on >= opteron hardware */
-		STATE(skb)->pgm_header->pgm_checksum	= 0;
-		const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_opt_fragment + 1) - (char*)STATE(skb)->pgm_header;
-		const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
-		STATE(unfolded_odata)			= pgm_csum_partial_copy ((const char*)apdu + STATE(data_bytes_offset), STATE(skb)->pgm_opt_fragment + 1, (uint16_t)STATE(tsdu_length), 0);
+		const uint32_t unfolded_header		= source_stamp_apdu (sock, STATE(skb), STATE(is_transformed), (uint16_t)STATE(tsdu_length),
+									     STATE(first_sqn), STATE(data_bytes_offset), apdu_length);
+		const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_opt_fragment + 1) - (char*)STATE(skb)->pgm_header + opt_transform_length;
+		STATE(unfolded_odata)			= pgm_csum_partial_copy ((const char*)apdu + STATE(data_bytes_offset), (char*)STATE(skb)->pgm_header + pgm_header_len, (uint16_t)STATE(tsdu_length), 0);
 		STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)pgm_header_len));
 
 /* add to transmit window, skb::data set to payload */
@@ -1721,14 +2119,14 @@ send_apdu (
 retry_send:
 		pgm_assert ((char*)STATE(skb)->tail > (char*)STATE(skb)->head);
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
-		sent = pgm_sendto (sock,
-				   !STATE(is_rate_limited),	/* rate limit on blocking */
-			   	   &sock->odata_rate_control,
-				   FALSE,			/* regular socket */
-				   STATE(skb)->head,
-				   tpdu_length,
-				   (struct sockaddr*)&sock->send_gsr.gsr_group,
-				   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+		sent = pgm_sendto_skb (sock,
+				       !STATE(is_rate_limited),	/* rate limit on blocking */
+			       	   &sock->odata_rate_control,
+				       FALSE,			/* regular socket */
+				       STATE(skb),
+				       tpdu_length,
+				       (struct sockaddr*)&sock->send_gsr.gsr_group,
+				       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 		if (sent < 0) {
 			save_errno = pgm_get_last_sock_error();
 			if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -1788,26 +2186,200 @@ blocked:
 	return PGM_IO_STATUS_WOULD_BLOCK;
 }
 
-/* Send one APDU, whether it fits within one TPDU or more.
+/* send the APDU held by the payload transform, bytes written are reported
+ * against the original APDU.
+ */
+
+static
+int
+send_transformed (
+	pgm_sock_t*	const restrict	sock,
+	const size_t			apdu_length,
+	size_t*		      restrict	bytes_written
+	)
+{
+	const int status = send_apdu (sock, sock->compress->buf, sock->compress->encoded_length, NULL);
+	if (PGM_IO_STATUS_NORMAL == status && bytes_written)
+		*bytes_written = apdu_length;
+	return status;
+}
+
+/* send one APDU from application-owned memory.  Each TPDU is a buffer holding
+ * only the PGM headers with skb::data and skb::tail referencing the APDU, the
+ * payload is checksummed in place and gathered with the headers at send time.
+ * The transmit window keeps the reference until the trail passes, when the
+ * socket release function hands the payload back.
  *
  * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
  * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
  * packet size exceeds the current rate limit.
  */
 
+static
 int
-pgm_send (
-	pgm_sock_t* 	 const restrict sock,
+send_retained (
+	pgm_sock_t* 	 const restrict	sock,
 	const void*	       restrict	apdu,
 	const size_t			apdu_length,
-	size_t*	       	       restrict	bytes_written
+	size_t*		       restrict	bytes_written
 	)
 {
-	pgm_debug ("pgm_send (sock:%p apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
-		(void*)sock, apdu, apdu_length, (void*)bytes_written);
-
-/* parameters */
-	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	size_t		bytes_sent = 0;		/* counted at IP layer */
+	unsigned	packets_sent = 0;	/* IP packets */
+	size_t		data_bytes_sent = 0;
+	int		save_errno;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != apdu);
+	pgm_assert (NULL != sock->retain_info.ri_release);
+
+	const bool   is_fragmented = apdu_length > source_max_tsdu (sock, FALSE);
+	const size_t header_length = is_fragmented ? PGM_APDU_TEMPLATE_LEN : PGM_ODATA_TEMPLATE_LEN;
+
+/* continue if blocked mid-apdu */
+	if (sock->is_apdu_eagain)
+		goto retry_send;
+
+/* if non-blocking calculate total wire size and check rate limit */
+	STATE(is_rate_limited) = FALSE;
+	if (sock->is_nonblocking && sock->is_controlled_odata)
+	{
+		size_t tpdu_length = 0;
+		size_t offset_	   = 0;
+
+		do {
+			const uint_fast16_t tsdu_length = (uint_fast16_t)MIN( source_max_tsdu (sock, is_fragmented), apdu_length - offset_ );
+			tpdu_length += sock->iphdr_len + header_length + tsdu_length;
+			offset_ += tsdu_length;
+		} while (offset_ < apdu_length);
+
+		if (!pgm_rate_check2 (&sock->rate_control,
+				      &sock->odata_rate_control,
+				      tpdu_length - sock->iphdr_len,	/* includes 1 × IP header len */
+				      sock->is_nonblocking))
+		{
+			sock->blocklen = tpdu_length;
+			return PGM_IO_STATUS_RATE_LIMITED;
+		}
+		STATE(is_rate_limited) = TRUE;
+	}
+
+	STATE(data_bytes_offset)	= 0;
+	STATE(first_sqn)		= pgm_txw_next_lead(sock->window);
+
+	do {
+		struct pgm_iovec	 vector[2];
+		size_t			 tpdu_length;
+		ssize_t			 sent;
+		uint32_t		 unfolded_header;
+
+		STATE(tsdu_length) = MIN( source_max_tsdu (sock, is_fragmented), apdu_length - STATE(data_bytes_offset) );
+
+		STATE(skb) = pgm_alloc_skb ((uint16_t)header_length);
+		STATE(skb)->sock = sock;
+		STATE(skb)->tstamp = pgm_time_update_now();
+		STATE(skb)->is_retained = 1;
+		if (is_fragmented)
+			unfolded_header = source_stamp_apdu (sock, STATE(skb), FALSE, (uint16_t)STATE(tsdu_length),
+							     STATE(first_sqn), STATE(data_bytes_offset), apdu_length);
+		else
+			unfolded_header = source_stamp_odata (sock, STATE(skb), (uint16_t)STATE(tsdu_length));
+		STATE(skb)->data	= (char*)apdu + STATE(data_bytes_offset);
+		STATE(skb)->tail	= (char*)STATE(skb)->data + STATE(tsdu_length);
+		STATE(skb)->len		= (uint16_t)STATE(tsdu_length);
+
+		STATE(unfolded_odata)			= pgm_csum_partial (STATE(skb)->data, (uint16_t)STATE(tsdu_length), 0);
+		STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)header_length));
+
+/* add to transmit window */
+		pgm_spinlock_lock (&sock->txw_spinlock);
+		pgm_txw_add (sock->window, STATE(skb));
+		pgm_spinlock_unlock (&sock->txw_spinlock);
+
+retry_send:
+		vector[0].iov_base	= STATE(skb)->head;
+		vector[0].iov_len	= (char*)STATE(skb)->end - (char*)STATE(skb)->head;
+		vector[1].iov_base	= STATE(skb)->data;
+		vector[1].iov_len	= STATE(skb)->len;
+		tpdu_length = vector[0].iov_len + vector[1].iov_len;
+		sent = pgm_sendtov_skb (sock,
+					!STATE(is_rate_limited),	/* rate limit on blocking */
+					&sock->odata_rate_control,
+					FALSE,			/* regular socket */
+					STATE(skb),
+					vector,
+					PGM_N_ELEMENTS(vector),
+					(struct sockaddr*)&sock->send_gsr.gsr_group,
+					pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+		if (sent < 0) {
+			save_errno = pgm_get_last_sock_error();
+			if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
+			{
+				sock->is_apdu_eagain = TRUE;
+				sock->blocklen = tpdu_length + sock->iphdr_len;
+				goto blocked;
+			}
+/* fall through silently on other errors */
+		}
+
+/* save unfolded odata for retransmissions */
+		pgm_txw_set_unfolded_checksum (STATE(skb), STATE(unfolded_odata));
+
+		if (PGM_LIKELY((size_t)sent == tpdu_length)) {
+			bytes_sent += tpdu_length + sock->iphdr_len;	/* as counted at IP layer */
+			packets_sent++;					/* IP packets */
+			data_bytes_sent += STATE(tsdu_length);
+		}
+
+		STATE(data_bytes_offset) += STATE(tsdu_length);
+
+	} while ( STATE(data_bytes_offset)  < apdu_length);
+	pgm_assert( STATE(data_bytes_offset) == apdu_length );
+
+/* success */
+	sock->is_apdu_eagain = FALSE;
+/* SPM heartbeats decay from last sent data packet */
+	reset_heartbeat_spm (sock, STATE(skb)->tstamp);
+/* increment socket statistics */
+	pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
+	sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
+	sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+	if (bytes_written)
+		*bytes_written = apdu_length;
+	return PGM_IO_STATUS_NORMAL;
+
+blocked:
+	if (bytes_sent) {
+		reset_heartbeat_spm (sock, STATE(skb)->tstamp);
+		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)bytes_sent);
+		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  += packets_sent;
+		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += data_bytes_sent;
+	}
+	if (PGM_SOCK_ENOBUFS == save_errno)
+		return PGM_IO_STATUS_RATE_LIMITED;
+	return PGM_IO_STATUS_WOULD_BLOCK;
+}
+
+/* Send one APDU, whether it fits within one TPDU or more.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
+ * packet size exceeds the current rate limit.
+ */
+
+int
+pgm_send (
+	pgm_sock_t* 	 const restrict sock,
+	const void*	       restrict	apdu,
+	const size_t			apdu_length,
+	size_t*	       	       restrict	bytes_written
+	)
+{
+	pgm_debug ("pgm_send (sock:%p apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
+		(void*)sock, apdu, apdu_length, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
 	if (PGM_LIKELY(apdu_length)) pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
 
 /* shutdown */
@@ -1817,30 +2389,897 @@ pgm_send (
 /* state */
 	if (PGM_UNLIKELY(!sock->is_bound ||
 	    sock->is_destroyed ||
-	    apdu_length > sock->max_apdu))
+	    apdu_length > sock->max_apdu))
+	{
+		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+/* source */
+	pgm_mutex_lock (&sock->source_mutex);
+
+/* streamed APDU in progress */
+	if (PGM_UNLIKELY(sock->stream_state.is_active)) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
+/* payload transform, a resumed send continues with the encoded APDU */
+	if (sock->compress && !sock->is_apdu_eagain)
+		STATE(is_transformed) = pgm_compress_encode (sock->compress, apdu, apdu_length);
+	if (STATE(is_transformed))
+	{
+		const int status = send_transformed (sock, apdu_length, bytes_written);
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return status;
+	}
+
+/* pass on non-fragment calls */
+	if (apdu_length <= sock->max_tsdu)
+	{
+		const int status = send_odata_copy (sock, apdu, (uint16_t)apdu_length, bytes_written);
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return status;
+	}
+	else
+	{
+		const int status = send_apdu (sock, apdu, (uint16_t)apdu_length, bytes_written);
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return status;
+	}
+}
+
+/* Send one APDU from application-owned memory without copying, see
+ * PGM_TXW_RETAIN.  The buffer must remain unchanged until the release
+ * function has been called for every packet of the APDU.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
+ * packet size exceeds the current rate limit.
+ */
+
+int
+pgm_send_retained (
+	pgm_sock_t* 	 const restrict sock,
+	const void*	       restrict	apdu,
+	const size_t			apdu_length,
+	size_t*	       	       restrict	bytes_written
+	)
+{
+	pgm_debug ("pgm_send_retained (sock:%p apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
+		(void*)sock, apdu, apdu_length, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (apdu_length > 0, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    NULL == sock->retain_info.ri_release ||
+	    apdu_length > sock->max_apdu))
+	{
+		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+/* source */
+	pgm_mutex_lock (&sock->source_mutex);
+
+/* streamed APDU in progress */
+	if (PGM_UNLIKELY(sock->stream_state.is_active)) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
+	const int status = send_retained (sock, apdu, apdu_length, bytes_written);
+	pgm_mutex_unlock (&sock->source_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	return status;
+}
+
+/* Streaming APDU transmission.  The application declares the total APDU
+ * length up front so that each fragment carries the final OPT_FRAGMENT
+ * header, then appends payload in arbitrary pieces.  Each fragment is
+ * checksummed while copied and transmitted as soon as it is full, only one
+ * TPDU is held outside the transmit window at any time.
+ *
+ *    ⎢ begin(len) ⎢   ⎢ append ⎢ … ⎢ append ⎢   ⎢ end ⎢
+ *                   → ⎢ ⋯ TSDU₁ TSDU₀ ⎢ → libc
+ *
+ * pgm_send(), pgm_sendv() and pgm_send_skbv() are refused while a stream is
+ * open as fragments of one APDU must occupy consecutive sequence numbers.
+ * Receivers discard APDUs larger than PGM_MAX_APDU unless the receiving
+ * socket sets PGM_STREAMING_READ.
+ */
+
+#define STREAM(x) (sock->stream_state.x)
+
+/* OPT_TOPIC including option header, padded to 32-bit boundary.
+ */
+
+#define STREAM_OPT_TOPIC_LENGTH(topic_len) \
+	((sizeof(struct pgm_opt_header) + offsetof(struct pgm_opt_topic, opt_topic) + (topic_len) + 3) & ~(size_t)3)
+
+/* total option length, zero when no options are present.
+ */
+
+static inline
+size_t
+stream_opt_total_length (
+	const bool		is_fragmented,
+	const size_t		topic_len
+	)
+{
+	size_t opt_total_length = 0;
+	if (is_fragmented)
+		opt_total_length += sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_fragment);
+	if (topic_len)
+		opt_total_length += STREAM_OPT_TOPIC_LENGTH(topic_len);
+	if (opt_total_length)
+		opt_total_length += sizeof(struct pgm_opt_length);
+	return opt_total_length;
+}
+
+/* allocate and pre-fill the headers of the next fragment.
+ */
+
+static
+void
+stream_new_fragment (
+	pgm_sock_t*	const	sock
+	)
+{
+	struct pgm_opt_header	*opt_header;
+	struct pgm_opt_length	*opt_len;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL == STREAM(skb));
+
+	const size_t opt_total_length = stream_opt_total_length (STREAM(is_fragmented), STREAM(topic_len));
+	const size_t header_length = pgm_pkt_offset (FALSE, 0) + opt_total_length;
+	STREAM(tsdu_length) = (uint16_t)MIN( source_max_tsdu (sock, FALSE) - opt_total_length, STREAM(apdu_length) - STREAM(data_bytes_offset) );
+	STREAM(tsdu_offset) = 0;
+	STREAM(unfolded_odata) = 0;
+
+	STREAM(skb) = pgm_alloc_skb (sock->max_tpdu);
+	STREAM(skb)->sock = sock;
+	pgm_skb_reserve (STREAM(skb), (uint16_t)header_length);
+	pgm_skb_put (STREAM(skb), STREAM(tsdu_length));
+
+	STREAM(skb)->pgm_header  = (struct pgm_header*)STREAM(skb)->head;
+	STREAM(skb)->pgm_data    = (struct pgm_data*)(STREAM(skb)->pgm_header + 1);
+	memcpy (STREAM(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
+	STREAM(skb)->pgm_header->pgm_sport	 = sock->tsi.sport;
+	STREAM(skb)->pgm_header->pgm_dport	 = sock->dport;
+	STREAM(skb)->pgm_header->pgm_type	 = PGM_ODATA;
+	STREAM(skb)->pgm_header->pgm_options	 = opt_total_length ? PGM_OPT_PRESENT : 0;
+	STREAM(skb)->pgm_header->pgm_tsdu_length = pgm_htons (STREAM(tsdu_length));
+	STREAM(skb)->pgm_opt_fragment		 = NULL;
+	if (0 == opt_total_length)
+		return;
+
+/* OPT_LENGTH */
+	opt_len					= (struct pgm_opt_length*)(STREAM(skb)->pgm_data + 1);
+	opt_len->opt_type			= PGM_OPT_LENGTH;
+	opt_len->opt_length			= sizeof(struct pgm_opt_length);
+	opt_len->opt_total_length		= pgm_htons ((uint16_t)opt_total_length);
+	opt_header				= (struct pgm_opt_header*)(opt_len + 1);
+/* OPT_FRAGMENT */
+	if (STREAM(is_fragmented)) {
+		opt_header->opt_type			= PGM_OPT_FRAGMENT;
+		opt_header->opt_length			= sizeof(struct pgm_opt_header) +
+							  sizeof(struct pgm_opt_fragment);
+		STREAM(skb)->pgm_opt_fragment			= (struct pgm_opt_fragment*)(opt_header + 1);
+		STREAM(skb)->pgm_opt_fragment->opt_reserved	= 0;
+		STREAM(skb)->pgm_opt_fragment->opt_sqn		= pgm_htonl (STREAM(first_sqn));
+		STREAM(skb)->pgm_opt_fragment->opt_frag_off	= pgm_htonl ((uint32_t)STREAM(data_bytes_offset));
+		STREAM(skb)->pgm_opt_fragment->opt_frag_len	= pgm_htonl ((uint32_t)STREAM(apdu_length));
+		if (0 == STREAM(topic_len)) {
+			opt_header->opt_type		|= PGM_OPT_END;
+			return;
+		}
+		opt_header				= (struct pgm_opt_header*)(STREAM(skb)->pgm_opt_fragment + 1);
+	}
+/* OPT_TOPIC */
+	{
+		const size_t opt_topic_length		= STREAM_OPT_TOPIC_LENGTH(STREAM(topic_len));
+		struct pgm_opt_topic* opt_topic		= (struct pgm_opt_topic*)(opt_header + 1);
+		memset (opt_header, 0, opt_topic_length);
+		opt_header->opt_type			= PGM_OPT_TOPIC | PGM_OPT_END;
+		opt_header->opt_length			= (uint8_t)opt_topic_length;
+		opt_topic->opt_topic_len		= STREAM(topic_len);
+		memcpy (opt_topic->opt_topic, STREAM(topic), STREAM(topic_len));
+	}
+}
+
+/* trim the fragment being filled to the payload copied so far.
+ */
+
+static
+void
+stream_shorten_fragment (
+	pgm_sock_t*	const	sock
+	)
+{
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != STREAM(skb));
+	pgm_assert (STREAM(tsdu_offset) < STREAM(tsdu_length));
+
+	const uint16_t excess = STREAM(tsdu_length) - STREAM(tsdu_offset);
+	STREAM(skb)->tail = (char*)STREAM(skb)->tail - excess;
+	STREAM(skb)->len -= excess;
+	STREAM(tsdu_length) = STREAM(tsdu_offset);
+	STREAM(skb)->pgm_header->pgm_tsdu_length = pgm_htons (STREAM(tsdu_length));
+}
+
+/* complete the header checksum of a full fragment and add to the transmit window.
+ */
+
+static
+void
+stream_commit_fragment (
+	pgm_sock_t*	const	sock
+	)
+{
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != STREAM(skb));
+	pgm_assert (STREAM(tsdu_offset) == STREAM(tsdu_length));
+
+	STREAM(skb)->tstamp = pgm_time_update_now();
+	STREAM(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
+	STREAM(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
+	STREAM(skb)->pgm_header->pgm_checksum	= 0;
+	const size_t   pgm_header_len		= (char*)STREAM(skb)->data - (char*)STREAM(skb)->pgm_header;
+	const uint32_t unfolded_header		= pgm_csum_partial (STREAM(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
+	STREAM(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STREAM(unfolded_odata), (uint16_t)pgm_header_len));
+
+/* add to transmit window, skb::data set to payload */
+	pgm_spinlock_lock (&sock->txw_spinlock);
+	pgm_txw_add (sock->window, STREAM(skb));
+	pgm_txw_set_unfolded_checksum (STREAM(skb), STREAM(unfolded_odata));
+	pgm_spinlock_unlock (&sock->txw_spinlock);
+
+	STREAM(is_pending)	= TRUE;
+	STREAM(is_rate_limited)	= FALSE;
+}
+
+/* transmit the pending fragment.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
+ * packet size exceeds the current rate limit.
+ */
+
+static
+int
+stream_send_fragment (
+	pgm_sock_t*	const	sock
+	)
+{
+	pgm_assert (NULL != sock);
+	pgm_assert (STREAM(is_pending));
+
+	const size_t tpdu_length = (char*)STREAM(skb)->tail - (char*)STREAM(skb)->head;
+
+/* check rate limit once per fragment */
+	if (sock->is_nonblocking && sock->is_controlled_odata && !STREAM(is_rate_limited))
+	{
+		if (!pgm_rate_check2 (&sock->rate_control,
+				      &sock->odata_rate_control,
+				      tpdu_length,		/* excludes IP header len */
+				      sock->is_nonblocking))
+		{
+			sock->blocklen = tpdu_length + sock->iphdr_len;
+			return PGM_IO_STATUS_RATE_LIMITED;
+		}
+		STREAM(is_rate_limited) = TRUE;
+	}
+
+	const ssize_t sent = pgm_sendto_skb (sock,
+					     !STREAM(is_rate_limited),	/* rate limit on blocking */
+					     &sock->odata_rate_control,
+					     FALSE,				/* regular socket */
+					     STREAM(skb),
+					     tpdu_length,
+					     (struct sockaddr*)&sock->send_gsr.gsr_group,
+					     pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+	if (sent < 0) {
+		const int save_errno = pgm_get_last_sock_error();
+		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
+		{
+			sock->blocklen = tpdu_length + sock->iphdr_len;
+			if (PGM_SOCK_ENOBUFS == save_errno)
+				return PGM_IO_STATUS_RATE_LIMITED;
+			return PGM_IO_STATUS_WOULD_BLOCK;
+		}
+/* fall through silently on other errors */
+	}
+
+/* SPM heartbeats decay from last sent data packet */
+	reset_heartbeat_spm (sock, STREAM(skb)->tstamp);
+/* increment socket statistics */
+	if (PGM_LIKELY((size_t)sent == tpdu_length)) {
+		sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT] += STREAM(tsdu_length);
+		sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]  ++;
+		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+	}
+/* check for end of transmission group */
+	if (sock->use_proactive_parity) {
+		const uint32_t odata_sqn = pgm_ntohl (STREAM(skb)->pgm_data->data_sqn);
+		const uint32_t tg_sqn_mask = 0xffffffff << sock->tg_sqn_shift;
+		if (!((odata_sqn + 1) & ~tg_sqn_mask))
+			pgm_schedule_proactive_nak (sock, odata_sqn & tg_sqn_mask);
+	}
+
+/* window owns the skb */
+	STREAM(skb)		= NULL;
+	STREAM(is_pending)	= FALSE;
+	return PGM_IO_STATUS_NORMAL;
+}
+
+/* copy payload into fragments, transmitting each as it fills.  a pending
+ * fragment blocked by a previous call is sent first.
+ */
+
+static
+int
+stream_append (
+	pgm_sock_t*	const restrict	sock,
+	const void*	      restrict	buf,
+	const size_t			len,
+	size_t*		      restrict	bytes_accepted
+	)
+{
+	int status = PGM_IO_STATUS_NORMAL;
+
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != bytes_accepted);
+
+	*bytes_accepted = 0;
+
+/* continue if blocked mid-stream */
+	if (STREAM(is_pending)) {
+		status = stream_send_fragment (sock);
+		if (PGM_IO_STATUS_NORMAL != status)
+			return status;
+	}
+
+	while (*bytes_accepted < len)
+	{
+		if (NULL == STREAM(skb))
+			stream_new_fragment (sock);
+
+		const uint16_t copy_len = (uint16_t)MIN( len - *bytes_accepted, (size_t)(STREAM(tsdu_length) - STREAM(tsdu_offset)) );
+		char* dst = (char*)STREAM(skb)->data + STREAM(tsdu_offset);
+/* application pieces have arbitrary alignment against the fragment, the
+ * vectorised copy-and-checksum requires matching alignment.
+ */
+		memcpy (dst, (const char*)buf + *bytes_accepted, copy_len);
+		const uint32_t unfolded_copy = pgm_csum_partial (dst, copy_len, 0);
+		STREAM(unfolded_odata)	   = pgm_csum_block_add (STREAM(unfolded_odata), unfolded_copy, STREAM(tsdu_offset));
+		STREAM(tsdu_offset)	  += copy_len;
+		STREAM(data_bytes_offset) += copy_len;
+		*bytes_accepted		  += copy_len;
+
+		if (STREAM(tsdu_offset) == STREAM(tsdu_length)) {
+			stream_commit_fragment (sock);
+			status = stream_send_fragment (sock);
+			if (PGM_IO_STATUS_NORMAL != status)
+				break;
+		}
+	}
+	return status;
+}
+
+/* open a streaming APDU of apdu_length bytes, up to the 32-bit limit of
+ * OPT_FRAGMENT.
+ *
+ * returns PGM_IO_STATUS_NORMAL on success, or PGM_IO_STATUS_ERROR if the
+ * socket cannot send or a stream is already open.
+ */
+
+int
+pgm_send_begin (
+	pgm_sock_t*	const	sock,
+	const size_t		apdu_length
+	)
+{
+	pgm_debug ("pgm_send_begin (sock:%p apdu-length:%" PRIzu ")",
+		(void*)sock, apdu_length);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (apdu_length > 0, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (apdu_length <= UINT32_MAX, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    !sock->can_send_data))
+	{
+		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+	pgm_mutex_lock (&sock->source_mutex);
+	if (PGM_UNLIKELY(STREAM(is_active) || sock->is_apdu_eagain)) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+	STREAM(is_active)		= TRUE;
+	STREAM(is_pending)		= FALSE;
+	STREAM(is_topic)		= FALSE;
+	STREAM(is_fragmented)		= TRUE;
+	STREAM(topic_len)		= 0;
+	STREAM(apdu_length)		= apdu_length;
+	STREAM(data_bytes_offset)	= 0;
+	STREAM(first_sqn)		= pgm_txw_next_lead(sock->window);
+	STREAM(skb)			= NULL;
+	pgm_mutex_unlock (&sock->source_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	return PGM_IO_STATUS_NORMAL;
+}
+
+/* append payload to the open stream, transmitting each fragment as it fills.
+ * A blocked fragment is retried by the next call to pgm_send_append() or
+ * pgm_send_end(), bytes_written reports the payload accepted before blocking.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK, returns PGM_IO_STATUS_RATE_LIMITED if
+ * packet size exceeds the current rate limit, returns PGM_IO_STATUS_ERROR if
+ * no stream is open or the payload exceeds the declared length.
+ */
+
+int
+pgm_send_append (
+	pgm_sock_t*	const restrict	sock,
+	const void*	      restrict	buf,
+	const size_t			len,
+	size_t*		      restrict	bytes_written
+	)
+{
+	size_t	bytes_accepted = 0;
+	int	status = PGM_IO_STATUS_NORMAL;
+
+	pgm_debug ("pgm_send_append (sock:%p buf:%p len:%" PRIzu " bytes-written:%p)",
+		(void*)sock, buf, len, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	if (PGM_LIKELY(len)) pgm_return_val_if_fail (NULL != buf, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	if (PGM_UNLIKELY(sock->is_destroyed)) {
+		pgm_rwlock_reader_unlock (&sock->lock);
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+	pgm_mutex_lock (&sock->source_mutex);
+	if (PGM_UNLIKELY(!STREAM(is_active) ||
+			 STREAM(is_topic) ||
+			 len > STREAM(apdu_length) - STREAM(data_bytes_offset)))
+	{
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
+	status = stream_append (sock, buf, len, &bytes_accepted);
+
+	pgm_mutex_unlock (&sock->source_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	if (bytes_written)
+		*bytes_written = bytes_accepted;
+	return status;
+}
+
+/* close the open stream, flushing any blocked fragment.  Closing before the
+ * declared length has been appended abandons the APDU: the partially filled
+ * fragment is shortened and sent so that all accepted payload reaches the
+ * wire, receivers then see an incomplete APDU which is delivered as lost data,
+ * or in part with PGM_STREAMING_READ.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK or PGM_IO_STATUS_RATE_LIMITED and should
+ * be repeated, returns PGM_IO_STATUS_ERROR if no stream is open or the stream
+ * was truncated.
+ */
+
+int
+pgm_send_end (
+	pgm_sock_t*	const	sock
+	)
+{
+	int status = PGM_IO_STATUS_NORMAL;
+
+	pgm_debug ("pgm_send_end (sock:%p)", (void*)sock);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+	pgm_mutex_lock (&sock->source_mutex);
+	if (PGM_UNLIKELY(!STREAM(is_active) || STREAM(is_topic))) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
+	if (STREAM(is_pending)) {
+		status = stream_send_fragment (sock);
+		if (PGM_IO_STATUS_NORMAL != status) {
+			pgm_mutex_unlock (&sock->source_mutex);
+			pgm_rwlock_reader_unlock (&sock->lock);
+			return status;
+		}
+	}
+
+/* truncated stream, send partially filled fragment */
+	if (PGM_UNLIKELY(STREAM(data_bytes_offset) != STREAM(apdu_length))) {
+		if (NULL != STREAM(skb)) {
+			stream_shorten_fragment (sock);
+			stream_commit_fragment (sock);
+			status = stream_send_fragment (sock);
+			if (PGM_IO_STATUS_NORMAL != status) {
+				pgm_mutex_unlock (&sock->source_mutex);
+				pgm_rwlock_reader_unlock (&sock->lock);
+				return status;
+			}
+		}
+		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Abandoning streamed APDU after %" PRIzu " of %" PRIzu " bytes."),
+			STREAM(data_bytes_offset), STREAM(apdu_length));
+		status = PGM_IO_STATUS_ERROR;
+	}
+
+	STREAM(is_active) = FALSE;
+	pgm_mutex_unlock (&sock->source_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	return status;
+}
+
+/* send PGM original data tagged with a topic, callee owned memory.  every
+ * TPDU of the APDU carries OPT_TOPIC so receivers may filter without
+ * reassembly, OPT_FRAGMENT is added only when the APDU exceeds one TPDU.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on block for non-blocking sockets
+ * returns PGM_IO_STATUS_WOULD_BLOCK or PGM_IO_STATUS_RATE_LIMITED and the call
+ * should be repeated with the same arguments, returns PGM_IO_STATUS_ERROR on
+ * invalid topic or if a stream is open.
+ */
+
+int
+pgm_send_topic (
+	pgm_sock_t*	const restrict	sock,
+	const char*	      restrict	topic,
+	const void*	      restrict	apdu,
+	const size_t			apdu_length,
+	size_t*		      restrict	bytes_written
+	)
+{
+	size_t	topic_len, bytes_accepted;
+	int	status;
+
+	pgm_debug ("pgm_send_topic (sock:%p topic:\"%s\" apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
+		(void*)sock, topic ? topic : "(null)", apdu, apdu_length, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (NULL != topic, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (apdu_length > 0, PGM_IO_STATUS_ERROR);
+	pgm_return_val_if_fail (apdu_length <= UINT32_MAX, PGM_IO_STATUS_ERROR);
+	topic_len = strlen (topic);
+	pgm_return_val_if_fail (pgm_topic_is_valid (topic, topic_len), PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    !sock->can_send_data))
 	{
 		pgm_rwlock_reader_unlock (&sock->lock);
 		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
 
-/* source */
 	pgm_mutex_lock (&sock->source_mutex);
+	if (STREAM(is_active))
+	{
+/* resume only the same blocked topic APDU */
+		if (PGM_UNLIKELY(!STREAM(is_topic) ||
+				 STREAM(apdu_length) != apdu_length ||
+				 STREAM(topic_len) != topic_len ||
+				 0 != memcmp (STREAM(topic), topic, topic_len)))
+		{
+			pgm_mutex_unlock (&sock->source_mutex);
+			pgm_rwlock_reader_unlock (&sock->lock);
+			return PGM_IO_STATUS_ERROR;
+		}
+	}
+	else
+	{
+		if (PGM_UNLIKELY(sock->is_apdu_eagain)) {
+			pgm_mutex_unlock (&sock->source_mutex);
+			pgm_rwlock_reader_unlock (&sock->lock);
+			return PGM_IO_STATUS_ERROR;
+		}
+		STREAM(is_active)		= TRUE;
+		STREAM(is_pending)		= FALSE;
+		STREAM(is_topic)		= TRUE;
+		STREAM(topic_len)		= (uint8_t)topic_len;
+		memcpy (STREAM(topic), topic, topic_len);
+		STREAM(apdu_length)		= apdu_length;
+/* capacity of a single unfragmented TPDU decides whether OPT_FRAGMENT is required */
+		STREAM(is_fragmented)		= (apdu_length > source_max_tsdu (sock, FALSE) - stream_opt_total_length (FALSE, topic_len));
+		STREAM(data_bytes_offset)	= 0;
+		STREAM(first_sqn)		= pgm_txw_next_lead(sock->window);
+		STREAM(skb)			= NULL;
+	}
+
+	status = stream_append (sock,
+				(const char*)apdu + STREAM(data_bytes_offset),
+				apdu_length - STREAM(data_bytes_offset),
+				&bytes_accepted);
+	if (PGM_IO_STATUS_NORMAL == status) {
+		pgm_assert (NULL == STREAM(skb));
+		STREAM(is_active)	= FALSE;
+		STREAM(is_topic)	= FALSE;
+		STREAM(topic_len)	= 0;
+	}
 
-/* pass on non-fragment calls */
-	if (apdu_length <= sock->max_tsdu)
+	pgm_mutex_unlock (&sock->source_mutex);
+	pgm_rwlock_reader_unlock (&sock->lock);
+	if (PGM_IO_STATUS_NORMAL == status && bytes_written)
+		*bytes_written = apdu_length;
+	return status;
+}
+
+#undef STREAM_OPT_TOPIC_LENGTH
+#undef STREAM
+
+/* build one unfragmented ODATA for a companion session sharing the GSI,
+ * the priority lane or an enhancement layer, add it to the session window
+ * and send it to group without rate regulation.  caller holds the companion
+ * session mutex.
+ *
+ * returns bytes sent, or -1 on error when the message is still held in the
+ * window for receiver repair requests.
+ */
+
+static
+ssize_t
+send_companion_odata (
+	pgm_sock_t*	       const restrict sock,
+	const pgm_tsi_t*       const restrict tsi,
+	pgm_txw_t*	       const restrict window,
+	const struct sockaddr* const restrict group,
+	const void*		     restrict apdu,
+	const uint16_t			      tsdu_length
+	)
+{
+	struct pgm_sk_buff_t	*skb;
+	uint32_t		 unfolded_header, unfolded_odata;
+	ssize_t			 sent;
+
+	const size_t tpdu_length = tsdu_length + pgm_pkt_offset (FALSE, 0);
+
+	skb = pgm_alloc_skb (sock->max_tpdu);
+	skb->sock = sock;
+	skb->tstamp = pgm_time_update_now();
+	pgm_skb_reserve (skb, (uint16_t)pgm_pkt_offset (FALSE, 0));
+	pgm_skb_put (skb, tsdu_length);
+
+	skb->pgm_header	= (struct pgm_header*)skb->head;
+	skb->pgm_data	= (struct pgm_data*)(skb->pgm_header + 1);
+	memcpy (skb->pgm_header->pgm_gsi, &tsi->gsi, sizeof(pgm_gsi_t));
+	skb->pgm_header->pgm_sport	 = tsi->sport;
+	skb->pgm_header->pgm_dport	 = sock->dport;
+	skb->pgm_header->pgm_type	 = PGM_ODATA;
+	skb->pgm_header->pgm_options	 = 0;
+	skb->pgm_header->pgm_tsdu_length = pgm_htons (tsdu_length);
+	skb->pgm_header->pgm_checksum	 = 0;
+
+/* ODATA */
+	skb->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(window));
+	skb->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(window));
+
+	unfolded_header = pgm_csum_partial (skb->pgm_header, (uint16_t)PGM_ODATA_TEMPLATE_LEN, 0);
+	unfolded_odata  = pgm_csum_partial_copy (apdu, skb->pgm_data + 1, tsdu_length, 0);
+	skb->pgm_header->pgm_checksum = pgm_csum_fold (pgm_csum_block_add (unfolded_header, unfolded_odata, (uint16_t)PGM_ODATA_TEMPLATE_LEN));
+
+/* add to transmit window, skb::data set to payload */
+	pgm_spinlock_lock (&sock->txw_spinlock);
+	pgm_txw_add (window, skb);
+	pgm_spinlock_unlock (&sock->txw_spinlock);
+
+	sent = pgm_sendto_skb (sock,
+			       FALSE,			/* regulated by caller */
+			       NULL,
+			       FALSE,			/* regular socket */
+			       skb,
+			       tpdu_length,
+			       group,
+			       pgm_sockaddr_len(group));
+/* save unfolded odata for retransmissions */
+	pgm_txw_set_unfolded_checksum (skb, unfolded_odata);
+	if (sent < 0)
+		return sent;
+
+/* SPM heartbeats decay from last sent data packet */
+	reset_heartbeat_spm (sock, skb->tstamp);
+
+	if (PGM_LIKELY((size_t)sent == tpdu_length)) {
+		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_BYTES_SENT], tsdu_length);
+		pgm_atomic_inc32 (&sock->cumulative_stats[PGM_PC_SOURCE_DATA_MSGS_SENT]);
+		pgm_atomic_add32 (&sock->cumulative_stats[PGM_PC_SOURCE_BYTES_SENT], (uint32_t)(tpdu_length + sock->iphdr_len));
+	}
+	return sent;
+}
+
+/* Send one urgent message on the priority lane, a companion session sharing
+ * the GSI with source port PGM_PRIORITY_LANE.  The message is sent at once
+ * between fragments of any APDU in progress, the rate limit is charged after
+ * the fact so that bulk data pays the debt.  Messages are not fragmented.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL.  returns PGM_IO_STATUS_ERROR if the
+ * packet could not be sent, the message is still held in the lane window for
+ * receiver repair requests and must not be sent again.
+ */
+
+int
+pgm_send_priority (
+	pgm_sock_t*	const restrict	sock,
+	const void*	      restrict	apdu,
+	const size_t			apdu_length,
+	size_t*		      restrict	bytes_written
+	)
+{
+	ssize_t			 sent;
+
+	pgm_debug ("pgm_send_priority (sock:%p apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
+		(void*)sock, apdu, apdu_length, (void*)bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	if (PGM_LIKELY(apdu_length)) pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    NULL == sock->lane.window ||
+	    apdu_length > sock->max_tsdu))
 	{
-		const int status = send_odata_copy (sock, apdu, (uint16_t)apdu_length, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
 		pgm_rwlock_reader_unlock (&sock->lock);
-		return status;
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
 	}
-	else
+
+	const uint16_t tsdu_length = (uint16_t)apdu_length;
+	const size_t   tpdu_length = tsdu_length + pgm_pkt_offset (FALSE, 0);
+
+/* lane serialised independently of the session source mutex */
+	pgm_mutex_lock (&sock->lane.mutex);
+	sent = send_companion_odata (sock,
+				     &sock->lane.tsi,
+				     sock->lane.window,
+				     (struct sockaddr*)&sock->send_gsr.gsr_group,
+				     apdu,
+				     tsdu_length);
+	if (sent < 0) {
+		pgm_mutex_unlock (&sock->lane.mutex);
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Priority lane send failed, deferring to repair."));
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+	pgm_rate_debit (&sock->rate_control, tpdu_length);
+	pgm_rate_debit (&sock->odata_rate_control, tpdu_length);
+	pgm_mutex_unlock (&sock->lane.mutex);
+
+	pgm_rwlock_reader_unlock (&sock->lock);
+	if (bytes_written)
+		*bytes_written = tsdu_length;
+	return PGM_IO_STATUS_NORMAL;
+}
+
+/* Send one message on a cumulative layer, layer 0 is the session and larger
+ * APDUs are fragmented as pgm_send().  Enhancement layers 1 … li_count of
+ * PGM_LAYERS are companion sessions sharing the GSI with source port
+ * tsi.sport + layer, each sent on its group at its own rate.  Enhancement
+ * layer messages are not fragmented.
+ *
+ * on success, returns PGM_IO_STATUS_NORMAL, on exceeding the layer rate with
+ * non-blocking sockets PGM_IO_STATUS_RATE_LIMITED is returned.
+ */
+
+int
+pgm_send_layer (
+	pgm_sock_t*	const restrict	sock,
+	const unsigned			layer_index,
+	const void*	      restrict	apdu,
+	const size_t			apdu_length,
+	size_t*		      restrict	bytes_written
+	)
+{
+	pgm_layer_t		*layer;
+	ssize_t			 sent;
+
+	pgm_debug ("pgm_send_layer (sock:%p layer:%u apdu:%p apdu-length:%" PRIzu " bytes-written:%p)",
+		(void*)sock, layer_index, apdu, apdu_length, (void*)bytes_written);
+
+	if (0 == layer_index)
+		return pgm_send (sock, apdu, apdu_length, bytes_written);
+
+/* parameters */
+	pgm_return_val_if_fail (NULL != sock, PGM_IO_STATUS_ERROR);
+	if (PGM_LIKELY(apdu_length)) pgm_return_val_if_fail (NULL != apdu, PGM_IO_STATUS_ERROR);
+
+/* shutdown */
+	if (PGM_UNLIKELY(!pgm_rwlock_reader_trylock (&sock->lock)))
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+
+/* state */
+	if (PGM_UNLIKELY(!sock->is_bound ||
+	    sock->is_destroyed ||
+	    layer_index > sock->layers_len ||
+	    NULL == sock->layers[ layer_index - 1 ].window ||
+	    apdu_length > sock->max_tsdu))
 	{
-		const int status = send_apdu (sock, apdu, (uint16_t)apdu_length, bytes_written);
-		pgm_mutex_unlock (&sock->source_mutex);
 		pgm_rwlock_reader_unlock (&sock->lock);
-		return status;
+		pgm_return_val_if_reached (PGM_IO_STATUS_ERROR);
+	}
+
+	layer = &sock->layers[ layer_index - 1 ];
+	const uint16_t tsdu_length = (uint16_t)apdu_length;
+	const size_t   tpdu_length = tsdu_length + pgm_pkt_offset (FALSE, 0);
+
+/* layer serialised independently of the session source mutex */
+	pgm_mutex_lock (&layer->mutex);
+	if (!pgm_rate_check (&layer->rate_control, tpdu_length, sock->is_nonblocking)) {
+		pgm_mutex_unlock (&layer->mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_RATE_LIMITED;
 	}
+	sent = send_companion_odata (sock,
+				     &layer->tsi,
+				     layer->window,
+				     (struct sockaddr*)&layer->gr.gr_group,
+				     apdu,
+				     tsdu_length);
+	if (sent < 0) {
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Layer %u send failed, deferring to repair."), layer_index);
+	}
+	pgm_mutex_unlock (&layer->mutex);
+
+	pgm_rwlock_reader_unlock (&sock->lock);
+	if (bytes_written)
+		*bytes_written = tsdu_length;
+	return PGM_IO_STATUS_NORMAL;
 }
 
 /* send PGM original data, callee owned scatter/gather IO vector.  if larger than maximum TPDU
@@ -1898,6 +3337,13 @@ pgm_sendv (
 
 	pgm_mutex_lock (&sock->source_mutex);
 
+/* streamed APDU in progress */
+	if (PGM_UNLIKELY(sock->stream_state.is_active)) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
 /* pass on zero length as cannot count vector lengths */
 	if (PGM_UNLIKELY(0 == count))
 	{
@@ -1912,7 +3358,14 @@ pgm_sendv (
 /* continue if blocked mid-apdu */
 	if (sock->is_apdu_eagain) {
 		if (is_one_apdu) {
-			if (STATE(apdu_length) <= sock->max_tsdu)
+			if (STATE(is_transformed))
+			{
+				const int status = send_transformed (sock, STATE(apdu_length), bytes_written);
+				pgm_mutex_unlock (&sock->source_mutex);
+				pgm_rwlock_reader_unlock (&sock->lock);
+				return status;
+			}
+			else if (STATE(apdu_length) <= sock->max_tsdu)
 			{
 				const int status = send_odatav (sock, vector, count, bytes_written);
 				pgm_mutex_unlock (&sock->source_mutex);
@@ -1945,6 +3398,18 @@ pgm_sendv (
 		STATE(apdu_length) += vector[i].iov_len;
 	}
 
+/* payload transform of the gathered APDU */
+	if (is_one_apdu && sock->compress) {
+		STATE(is_transformed) = STATE(apdu_length) <= sock->max_apdu &&
+					pgm_compress_encodev (sock->compress, vector, count, STATE(apdu_length));
+		if (STATE(is_transformed)) {
+			const int status = send_transformed (sock, STATE(apdu_length), bytes_written);
+			pgm_mutex_unlock (&sock->source_mutex);
+			pgm_rwlock_reader_unlock (&sock->lock);
+			return status;
+		}
+	}
+
 /* pass on non-fragment calls */
 	if (is_one_apdu) {
 		if (STATE(apdu_length) <= sock->max_tsdu) {
@@ -1966,11 +3431,18 @@ pgm_sendv (
 		{
 			int	status;
 			size_t	wrote_bytes;
+			if (sock->compress)
+				STATE(is_transformed) = pgm_compress_encode (sock->compress,
+									     vector[STATE(data_pkt_offset)].iov_base,
+									     vector[STATE(data_pkt_offset)].iov_len);
 retry_send:
-			status = send_apdu (sock,
-					    vector[STATE(data_pkt_offset)].iov_base,
-					    vector[STATE(data_pkt_offset)].iov_len,
-					    &wrote_bytes);
+			if (STATE(is_transformed))
+				status = send_transformed (sock, vector[STATE(data_pkt_offset)].iov_len, &wrote_bytes);
+			else
+				status = send_apdu (sock,
+						    vector[STATE(data_pkt_offset)].iov_base,
+						    vector[STATE(data_pkt_offset)].iov_len,
+						    &wrote_bytes);
 			switch (status) {
 			case PGM_IO_STATUS_NORMAL:
 				break;
@@ -2033,8 +3505,6 @@ retry_send:
 
 	do {
 		size_t			 tpdu_length, header_length;
-		struct pgm_opt_header	*opt_header;
-		struct pgm_opt_length	*opt_len;
 		const char		*src;
 		char			*dst;
 		size_t			 src_length, dst_length, copy_length;
@@ -2049,41 +3519,9 @@ retry_send:
 		pgm_skb_reserve (STATE(skb), (uint16_t)header_length);
 		pgm_skb_put (STATE(skb), (uint16_t)STATE(tsdu_length));
 
-		STATE(skb)->pgm_header  = (struct pgm_header*)STATE(skb)->head;
-		STATE(skb)->pgm_data    = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-		memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-		STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-		STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-		STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
-		STATE(skb)->pgm_header->pgm_options	= PGM_OPT_PRESENT;
-		STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons ((uint16_t)STATE(tsdu_length));
-
-/* ODATA */
-		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-/* OPT_LENGTH */
-		opt_len					= (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
-		opt_len->opt_type			= PGM_OPT_LENGTH;
-		opt_len->opt_length			= sizeof(struct pgm_opt_length);
-		opt_len->opt_total_length		= pgm_htons ((uint16_t)(sizeof(struct pgm_opt_length) +
-									sizeof(struct pgm_opt_header) +
-									sizeof(struct pgm_opt_fragment)));
-/* OPT_FRAGMENT */
-		opt_header				= (struct pgm_opt_header*)(opt_len + 1);
-		opt_header->opt_type			= PGM_OPT_FRAGMENT | PGM_OPT_END;
-		opt_header->opt_length			= sizeof(struct pgm_opt_header) +
-							  sizeof(struct pgm_opt_fragment);
-		STATE(skb)->pgm_opt_fragment			= (struct pgm_opt_fragment*)(opt_header + 1);
-		STATE(skb)->pgm_opt_fragment->opt_reserved	= 0;
-		STATE(skb)->pgm_opt_fragment->opt_sqn		= pgm_htonl (STATE(first_sqn));
-		STATE(skb)->pgm_opt_fragment->opt_frag_off	= pgm_htonl ((uint32_t)STATE(data_bytes_offset));
-		STATE(skb)->pgm_opt_fragment->opt_frag_len	= pgm_htonl ((uint32_t)STATE(apdu_length));
-
-/* checksum & copy */
-		STATE(skb)->pgm_header->pgm_checksum	= 0;
+		const uint32_t unfolded_header		= source_stamp_apdu (sock, STATE(skb), FALSE, (uint16_t)STATE(tsdu_length),
+									     STATE(first_sqn), STATE(data_bytes_offset), STATE(apdu_length));
 		const size_t   pgm_header_len		= (char*)(STATE(skb)->pgm_opt_fragment + 1) - (char*)STATE(skb)->pgm_header;
-		const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)pgm_header_len, 0);
 
 /* iterate over one or more vector elements to perform scatter/gather checksum & copy
  *
@@ -2132,14 +3570,14 @@ retry_send:
 
 retry_one_apdu_send:
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
-		sent = pgm_sendto (sock,
-				   !STATE(is_rate_limited),	/* rate limited on blocking */
-			   	   &sock->odata_rate_control,
-				   FALSE,			/* regular socket */
-				   STATE(skb)->head,
-				   tpdu_length,
-				   (struct sockaddr*)&sock->send_gsr.gsr_group,
-				   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+		sent = pgm_sendto_skb (sock,
+				       !STATE(is_rate_limited),	/* rate limited on blocking */
+			       	   &sock->odata_rate_control,
+				       FALSE,			/* regular socket */
+				       STATE(skb),
+				       tpdu_length,
+				       (struct sockaddr*)&sock->send_gsr.gsr_group,
+				       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 		if (sent < 0) {
 			save_errno = pgm_get_last_sock_error();
 			if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -2249,6 +3687,13 @@ pgm_send_skbv (
 
 	pgm_mutex_lock (&sock->source_mutex);
 
+/* streamed APDU in progress */
+	if (PGM_UNLIKELY(sock->stream_state.is_active)) {
+		pgm_mutex_unlock (&sock->source_mutex);
+		pgm_rwlock_reader_unlock (&sock->lock);
+		return PGM_IO_STATUS_ERROR;
+	}
+
 /* pass on zero length as cannot count vector lengths */
 	if (PGM_UNLIKELY(0 == count))
 	{
@@ -2323,54 +3768,18 @@ pgm_send_skbv (
 		STATE(skb)->sock = sock;
 		STATE(skb)->tstamp = pgm_time_update_now();
 
-		STATE(skb)->pgm_header = (struct pgm_header*)STATE(skb)->head;
-		STATE(skb)->pgm_data   = (struct pgm_data*)(STATE(skb)->pgm_header + 1);
-		memcpy (STATE(skb)->pgm_header->pgm_gsi, &sock->tsi.gsi, sizeof(pgm_gsi_t));
-		STATE(skb)->pgm_header->pgm_sport	= sock->tsi.sport;
-		STATE(skb)->pgm_header->pgm_dport	= sock->dport;
-		STATE(skb)->pgm_header->pgm_type	= PGM_ODATA;
-		STATE(skb)->pgm_header->pgm_options	= is_one_apdu ? PGM_OPT_PRESENT : 0;
-		STATE(skb)->pgm_header->pgm_tsdu_length = pgm_htons ((uint16_t)STATE(tsdu_length));
-
-/* ODATA */
-		STATE(skb)->pgm_data->data_sqn		= pgm_htonl (pgm_txw_next_lead(sock->window));
-		STATE(skb)->pgm_data->data_trail	= pgm_htonl (pgm_txw_trail(sock->window));
-
-		if (is_one_apdu)
-		{
-			struct pgm_opt_header	*opt_header;
-			struct pgm_opt_length	*opt_len;
-
-/* OPT_LENGTH */
-			opt_len					= (struct pgm_opt_length*)(STATE(skb)->pgm_data + 1);
-			opt_len->opt_type			= PGM_OPT_LENGTH;
-			opt_len->opt_length			= sizeof(struct pgm_opt_length);
-			opt_len->opt_total_length		= pgm_htons ((uint16_t)(sizeof(struct pgm_opt_length) +
-										sizeof(struct pgm_opt_header) +
-										sizeof(struct pgm_opt_fragment)));
-/* OPT_FRAGMENT */
-			opt_header				= (struct pgm_opt_header*)(opt_len + 1);
-			opt_header->opt_type			= PGM_OPT_FRAGMENT | PGM_OPT_END;
-			opt_header->opt_length			= sizeof(struct pgm_opt_header) +
-								  sizeof(struct pgm_opt_fragment);
-			STATE(skb)->pgm_opt_fragment			= (struct pgm_opt_fragment*)(opt_header + 1);
-			STATE(skb)->pgm_opt_fragment->opt_reserved	= 0;
-			STATE(skb)->pgm_opt_fragment->opt_sqn		= pgm_htonl (STATE(first_sqn));
-			STATE(skb)->pgm_opt_fragment->opt_frag_off	= pgm_htonl ((uint32_t)STATE(data_bytes_offset));
-			STATE(skb)->pgm_opt_fragment->opt_frag_len	= pgm_htonl ((uint32_t)STATE(apdu_length));
-
+		uint32_t unfolded_header;
+		if (is_one_apdu) {
+			unfolded_header = source_stamp_apdu (sock, STATE(skb), FALSE, (uint16_t)STATE(tsdu_length),
+							     STATE(first_sqn), STATE(data_bytes_offset), STATE(apdu_length));
 			pgm_assert (STATE(skb)->data == (STATE(skb)->pgm_opt_fragment + 1));
-		}
-		else
-		{
+		} else {
+			unfolded_header = source_stamp_odata (sock, STATE(skb), (uint16_t)STATE(tsdu_length));
 			pgm_assert (STATE(skb)->data == (STATE(skb)->pgm_data + 1));
 		}
 
-/* TODO: the assembly checksum & copy routine is faster than memcpy & pgm_cksum on >= opteron hardware */
-		STATE(skb)->pgm_header->pgm_checksum	= 0;
 		pgm_assert ((char*)STATE(skb)->data > (char*)STATE(skb)->pgm_header);
 		const size_t header_length		= (char*)STATE(skb)->data - (char*)STATE(skb)->pgm_header;
-		const uint32_t unfolded_header		= pgm_csum_partial (STATE(skb)->pgm_header, (uint16_t)header_length, 0);
 		STATE(unfolded_odata)			= pgm_csum_partial ((char*)STATE(skb)->data, (uint16_t)STATE(tsdu_length), 0);
 		STATE(skb)->pgm_header->pgm_checksum	= pgm_csum_fold (pgm_csum_block_add (unfolded_header, STATE(unfolded_odata), (uint16_t)header_length));
 
@@ -2381,14 +3790,14 @@ pgm_send_skbv (
 retry_send:
 		pgm_assert ((char*)STATE(skb)->tail > (char*)STATE(skb)->head);
 		tpdu_length = (char*)STATE(skb)->tail - (char*)STATE(skb)->head;
-		sent = pgm_sendto (sock,
-				   !STATE(is_rate_limited),	/* rate limited on blocking */
-			   	   &sock->odata_rate_control,
-				   FALSE,			/* regular socket */
-				   STATE(skb)->head,
-				   tpdu_length,
-				   (struct sockaddr*)&sock->send_gsr.gsr_group,
-				   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+		sent = pgm_sendto_skb (sock,
+				       !STATE(is_rate_limited),	/* rate limited on blocking */
+			       	   &sock->odata_rate_control,
+				       FALSE,			/* regular socket */
+				       STATE(skb),
+				       tpdu_length,
+				       (struct sockaddr*)&sock->send_gsr.gsr_group,
+				       pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
 		if (sent < 0) {
 			save_errno = pgm_get_last_sock_error();
 			if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -2471,6 +3880,8 @@ static
 bool
 send_rdata (
 	pgm_sock_t*	      restrict sock,
+	pgm_txw_t*	      restrict window,		/* session, priority lane or layer */
+	pgm_layer_t*	      restrict layer,		/* NULL for the session group */
 	struct pgm_sk_buff_t* restrict skb
 	)
 {
@@ -2481,17 +3892,28 @@ send_rdata (
 
 /* pre-conditions */
 	pgm_assert (NULL != sock);
+	pgm_assert (NULL != window);
 	pgm_assert (NULL != skb);
-	pgm_assert ((char*)skb->tail > (char*)skb->head);
 
-	tpdu_length = (char*)skb->tail - (char*)skb->head;
+/* retained payload follows headers occupying head … end */
+	if (PGM_UNLIKELY(skb->is_retained)) {
+		tpdu_length = ((char*)skb->end - (char*)skb->head) + skb->len;
+	} else {
+		pgm_assert ((char*)skb->tail > (char*)skb->head);
+		tpdu_length = (char*)skb->tail - (char*)skb->head;
+	}
 
-/* rate check including rdata specific limits */
-	if (sock->is_controlled_rdata &&
-	    !pgm_rate_check2 (&sock->rate_control,		/* total rate limit */
-			      &sock->rdata_rate_control,	/* repair data limit */
-			      tpdu_length,			/* excludes IP header len */
-			      sock->is_nonblocking))
+/* rate check including rdata specific limits, layer repairs share the layer rate */
+	if (NULL != layer) {
+		if (!pgm_rate_check (&layer->rate_control, tpdu_length, sock->is_nonblocking)) {
+			sock->blocklen = tpdu_length + sock->iphdr_len;
+			return FALSE;
+		}
+	} else if (sock->is_controlled_rdata &&
+		   !pgm_rate_check2 (&sock->rate_control,		/* total rate limit */
+				     &sock->rdata_rate_control,		/* repair data limit */
+				     tpdu_length,			/* excludes IP header len */
+				     sock->is_nonblocking))
 	{
 		sock->blocklen = tpdu_length + sock->iphdr_len;
 		return FALSE;
@@ -2502,7 +3924,7 @@ send_rdata (
 	rdata				= skb->pgm_data;
 	header->pgm_type		= PGM_RDATA;
 /* RDATA */
-        rdata->data_trail		= pgm_htonl (pgm_txw_trail(sock->window));
+        rdata->data_trail		= pgm_htonl (pgm_txw_trail(window));
 
         header->pgm_checksum		= 0;
 	const size_t header_length	= tpdu_length - pgm_ntohs(header->pgm_tsdu_length);
@@ -2519,14 +3941,32 @@ send_rdata (
 		return FALSE;
 	}
 
-	sent = pgm_sendto (sock,
-			   FALSE,			/* already rate limited */
-			   &sock->rdata_rate_control,
-			   TRUE,			/* with router alert */
-			   header,
-			   tpdu_length,
-			   (struct sockaddr*)&sock->send_gsr.gsr_group,
-			   pgm_sockaddr_len((struct sockaddr*)&sock->send_gsr.gsr_group));
+/* unicast fan-out repairs only the NAKing receiver, parity serves them all */
+	const struct sockaddr* to = repair_destination (layer ? (const struct sockaddr*)&layer->gr.gr_group : (const struct sockaddr*)&sock->send_gsr.gsr_group,
+							(header->pgm_options & PGM_OPT_PARITY) ? NULL : pgm_txw_get_requester (skb));
+	if (PGM_UNLIKELY(skb->is_retained)) {
+		struct pgm_iovec vector[2];
+		vector[0].iov_base	= (void*)header;
+		vector[0].iov_len	= header_length;
+		vector[1].iov_base	= skb->data;
+		vector[1].iov_len	= skb->len;
+		sent = pgm_sendtov (sock,
+				    FALSE,			/* already rate limited */
+				    &sock->rdata_rate_control,
+				    TRUE,			/* with router alert */
+				    vector,
+				    PGM_N_ELEMENTS(vector),
+				    to,
+				    pgm_sockaddr_len(to));
+	} else
+		sent = pgm_sendto (sock,
+				   FALSE,			/* already rate limited */
+				   &sock->rdata_rate_control,
+				   TRUE,			/* with router alert */
+				   header,
+				   tpdu_length,
+				   to,
+				   pgm_sockaddr_len(to));
 	if (sent < 0) {
 		const int save_errno = pgm_get_last_sock_error();
 		if (PGM_LIKELY(PGM_SOCK_EAGAIN == save_errno || PGM_SOCK_ENOBUFS == save_errno))
@@ -2539,7 +3979,10 @@ send_rdata (
 
 	const pgm_time_t now = pgm_time_update_now();
 
-	if (sock->use_pgmcc) {
+	if (sock->use_rate_cc) {
+		if (0 == sock->ack_expiry)
+			sock->ack_expiry = now + sock->ack_expiry_ivl;
+	} else if (sock->use_pgmcc) {
 		sock->tokens -= pgm_fp8 (1);
 		sock->ack_expiry = now + sock->ack_expiry_ivl;
 	}
@@ -63,18 +63,29 @@ static gboolean mock_is_valid_spmr = TRUE;
 static gboolean mock_is_valid_ack = TRUE;
 static gboolean mock_is_valid_nak = TRUE;
 static gboolean mock_is_valid_nnak = TRUE;
+static ssize_t mock_rate_per_sec = 0;
+static int mock_sendto_errno = 0;
+static unsigned mock_debit_count = 0;
+#define MOCK_MAX_SENT		64
+static guint8 mock_sent[MOCK_MAX_SENT][TEST_MAX_TPDU];
+static gsize mock_sent_len[MOCK_MAX_SENT];
+static guint mock_sent_count = 0;
 
 
 #define pgm_txw_get_unfolded_checksum	mock_pgm_txw_get_unfolded_checksum
 #define pgm_txw_set_unfolded_checksum	mock_pgm_txw_set_unfolded_checksum
 #define pgm_txw_inc_retransmit_count	mock_pgm_txw_inc_retransmit_count
+#define pgm_txw_get_requester		mock_pgm_txw_get_requester
 #define pgm_txw_add			mock_pgm_txw_add
 #define pgm_txw_peek			mock_pgm_txw_peek
 #define pgm_txw_retransmit_push		mock_pgm_txw_retransmit_push
 #define pgm_txw_retransmit_try_peek	mock_pgm_txw_retransmit_try_peek
 #define pgm_txw_retransmit_remove_head	mock_pgm_txw_retransmit_remove_head
+#define pgm_txw_retransmit_is_empty	mock_pgm_txw_retransmit_is_empty
 #define pgm_rs_encode			mock_pgm_rs_encode
 #define pgm_rate_check			mock_pgm_rate_check
+#define pgm_rate_set			mock_pgm_rate_set
+#define pgm_rate_debit			mock_pgm_rate_debit
 #define pgm_verify_spmr			mock_pgm_verify_spmr
 #define pgm_verify_ack			mock_pgm_verify_ack
 #define pgm_verify_nak			mock_pgm_verify_nak
@@ -84,8 +95,10 @@ static gboolean mock_is_valid_nnak = TRUE;
 #define pgm_csum_block_add		mock_pgm_csum_block_add
 #define pgm_csum_fold			mock_pgm_csum_fold
 #define pgm_sendto_hops			mock_pgm_sendto_hops
+#define pgm_sendtov_hops		mock_pgm_sendtov_hops
 #define pgm_time_update_now		mock_pgm_time_update_now
 #define pgm_setsockopt			mock_pgm_setsockopt
+#define pgm_compress_encode		mock_pgm_compress_encode
 
 
 #define SOURCE_DEBUG
@@ -97,6 +110,9 @@ void
 mock_setup (void)
 {
 	if (!g_thread_supported ()) g_thread_init (NULL);
+	mock_sendto_errno = 0;
+	mock_sent_count = 0;
+	mock_debit_count = 0;
 }
 
 static
@@ -124,8 +140,10 @@ generate_sock (void)
 	sock->spm_heartbeat_interval[0] = pgm_secs(1);
 	pgm_spinlock_init (&sock->txw_spinlock);
 	pgm_mutex_init (&sock->source_mutex);
+	pgm_mutex_init (&sock->lane.mutex);
 	pgm_mutex_init (&sock->timer_mutex);
 	pgm_rwlock_init (&sock->lock);
+	pgm_source_build_templates (sock);
 	return sock;
 }
 
@@ -316,14 +334,16 @@ mock_pgm_txw_retransmit_push (
 	pgm_txw_t* const		window,
 	const uint32_t			sequence,
 	const bool			is_parity,
-	const uint8_t			tg_sqn_shift
+	const uint8_t			tg_sqn_shift,
+	const struct sockaddr*		requester
 	)
 {
-	g_debug ("mock_pgm_txw_retransmit_push (window:%p sequence:%" G_GUINT32_FORMAT " is-parity:%s tg-sqn-shift:%d)",
+	g_debug ("mock_pgm_txw_retransmit_push (window:%p sequence:%" G_GUINT32_FORMAT " is-parity:%s tg-sqn-shift:%d requester:%p)",
 		(gpointer)window,
 		sequence,
 		is_parity ? "YES" : "NO",
-		tg_sqn_shift);
+		tg_sqn_shift,
+		(gconstpointer)requester);
 	return TRUE;
 }
 
@@ -350,6 +370,14 @@ mock_pgm_txw_inc_retransmit_count (
 {
 }
 
+const struct sockaddr*
+mock_pgm_txw_get_requester (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	return NULL;
+}
+
 struct pgm_sk_buff_t*
 mock_pgm_txw_retransmit_try_peek (
 	pgm_txw_t* const		window
@@ -369,6 +397,16 @@ mock_pgm_txw_retransmit_remove_head (
 		(gpointer)window);
 }
 
+bool
+mock_pgm_txw_retransmit_is_empty (
+	const pgm_txw_t* const		window
+	)
+{
+	g_debug ("mock_pgm_txw_retransmit_is_empty (window:%p)",
+		(gconstpointer)window);
+	return TRUE;
+}
+
 void
 mock_pgm_rs_encode (
 	pgm_rs_t*			rs,
@@ -395,6 +433,31 @@ mock_pgm_rate_check (
 	return TRUE;
 }
 
+PGM_GNUC_INTERNAL
+void
+mock_pgm_rate_set (
+	pgm_rate_t*			bucket,
+	const ssize_t			rate_per_sec,
+	const uint16_t			max_tpdu
+	)
+{
+	g_debug ("mock_pgm_rate_set (bucket:%p rate-per-sec:%ld max-tpdu:%u)",
+		bucket, (long)rate_per_sec, (unsigned)max_tpdu);
+	mock_rate_per_sec = rate_per_sec;
+}
+
+PGM_GNUC_INTERNAL
+void
+mock_pgm_rate_debit (
+	pgm_rate_t*			bucket,
+	const size_t			data_size
+	)
+{
+	g_debug ("mock_pgm_rate_debit (bucket:%p data-size:%u)",
+		bucket, (unsigned)data_size);
+	mock_debit_count++;
+}
+
 bool
 mock_pgm_verify_spmr (
 	const struct pgm_sk_buff_t* const	skb
@@ -492,6 +555,104 @@ mock_pgm_sendto_hops (
 		(unsigned)len,
 		saddr,
 		tolen);
+	if (mock_sendto_errno) {
+		errno = mock_sendto_errno;
+		return -1;
+	}
+	if (mock_sent_count < MOCK_MAX_SENT && len <= TEST_MAX_TPDU) {
+		memcpy (mock_sent[mock_sent_count], buf, len);
+		mock_sent_len[mock_sent_count++] = len;
+	}
+	return len;
+}
+
+/* concatenate the payload of captured ODATA fragments into dst, checking
+ * every fragment references apdu_length and follows its predecessor.
+ *
+ * returns bytes of payload, or -1 on invalid framing.
+ */
+
+static
+gssize
+mock_sent_payload (
+	guint8*				dst,
+	gsize				dstlen,
+	guint32				apdu_length
+	)
+{
+	gsize offset = 0;
+	for (guint i = 0; i < mock_sent_count; i++)
+	{
+		const struct pgm_header* header = (const struct pgm_header*)mock_sent[i];
+		const struct pgm_data* data = (const struct pgm_data*)(header + 1);
+		const gsize tsdu_length = g_ntohs (header->pgm_tsdu_length);
+		if (PGM_ODATA != header->pgm_type || !(header->pgm_options & PGM_OPT_PRESENT))
+			return -1;
+		const struct pgm_opt_length* opt_len = (const struct pgm_opt_length*)(data + 1);
+		const struct pgm_opt_header* opt_header = (const struct pgm_opt_header*)(opt_len + 1);
+		if (PGM_OPT_FRAGMENT != (opt_header->opt_type & PGM_OPT_MASK))
+			return -1;
+		const struct pgm_opt_fragment* opt_fragment = (const struct pgm_opt_fragment*)(opt_header + 1);
+		if (g_ntohl (opt_fragment->opt_frag_off) != offset ||
+		    g_ntohl (opt_fragment->opt_frag_len) != apdu_length ||
+		    offset + tsdu_length > dstlen)
+			return -1;
+		memcpy (dst + offset, mock_sent[i] + mock_sent_len[i] - tsdu_length, tsdu_length);
+		offset += tsdu_length;
+	}
+	return offset;
+}
+
+/* pass the APDU through as its own encoding, framing is under test not the codec.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+mock_pgm_compress_encode (
+	pgm_compress_t* const restrict	compress,
+	const void*	      restrict	apdu,
+	const size_t			apdu_length
+	)
+{
+	memcpy (compress->buf, apdu, apdu_length);
+	compress->encoded_length = apdu_length;
+	return TRUE;
+}
+
+PGM_GNUC_INTERNAL
+ssize_t
+mock_pgm_sendtov_hops (
+	pgm_sock_t*			sock,
+	bool				use_rate_limit,
+	pgm_rate_t*			minor_rate_control,
+	bool				use_router_alert,
+	int				level,
+	const struct pgm_iovec*		vector,
+	unsigned			count,
+	const struct pgm_sk_buff_t*	skb,
+	const struct sockaddr*		to,
+	socklen_t			tolen
+	)
+{
+	size_t len = 0;
+	for (unsigned i = 0; i < count; i++)
+		len += vector[i].iov_len;
+	g_debug ("mock_pgm_sendtov (sock:%p vector:%p count:%u skb:%p len:%u)",
+		(gpointer)sock, (gconstpointer)vector, count, (gconstpointer)skb, (unsigned)len);
+	if (NULL != skb)
+		fail_unless (vector[0].iov_base == skb->head, "vector not from skb");
+	if (mock_sendto_errno) {
+		errno = mock_sendto_errno;
+		return -1;
+	}
+	if (mock_sent_count < MOCK_MAX_SENT && len <= TEST_MAX_TPDU) {
+		size_t offset = 0;
+		for (unsigned i = 0; i < count; i++) {
+			memcpy (mock_sent[mock_sent_count] + offset, vector[i].iov_base, vector[i].iov_len);
+			offset += vector[i].iov_len;
+		}
+		mock_sent_len[mock_sent_count++] = len;
+	}
 	return len;
 }
 
@@ -583,6 +744,36 @@ START_TEST (test_send_pass_002)
 }
 END_TEST
 
+/* transformed apdu, every fragment carries OPT_TRANSFORM with OPX_DISCARD */
+START_TEST (test_send_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->compress = g_new0 (pgm_compress_t, 1);
+	sock->compress->buf_len = sock->max_apdu;
+	sock->compress->buf = g_malloc (sock->compress->buf_len);
+	const gsize apdu_length = 4000;
+	guint8 buffer[ apdu_length ], sent[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+	fail_unless (mock_sent_count > 1, "not fragmented");
+	for (guint i = 0; i < mock_sent_count; i++)
+	{
+		const struct pgm_header* header = (const struct pgm_header*)mock_sent[i];
+		const struct pgm_opt_length* opt_len = (const struct pgm_opt_length*)((const struct pgm_data*)(header + 1) + 1);
+		const struct pgm_opt_header* opt_header = (const struct pgm_opt_header*)(opt_len + 1);
+		fail_unless (sizeof(struct pgm_opt_length) + sizeof(struct pgm_opt_header) + sizeof(struct pgm_opt_fragment) + PGM_OPT_TRANSFORM_LEN == g_ntohs (opt_len->opt_total_length), "OPT_LENGTH mismatch");
+		fail_unless (PGM_OPT_FRAGMENT == opt_header->opt_type, "OPT_FRAGMENT not first");
+		opt_header = (const struct pgm_opt_header*)((const char*)opt_header + opt_header->opt_length);
+		fail_unless ((PGM_OPT_TRANSFORM | PGM_OPT_END) == opt_header->opt_type, "OPT_TRANSFORM missing");
+		fail_unless (PGM_OPX_DISCARD == (opt_header->opt_reserved & PGM_OPX_MASK), "OPT_TRANSFORM not OPX_DISCARD");
+	}
+	fail_unless ((gssize)apdu_length == mock_sent_payload (sent, sizeof(sent), apdu_length), "payload length mismatch");
+}
+END_TEST
+
 START_TEST (test_send_fail_001)
 {
 	guint8 buffer[ TEST_TXW_SQNS * TEST_MAX_TPDU ];
@@ -592,6 +783,391 @@ START_TEST (test_send_fail_001)
 }
 END_TEST
 
+/* target:
+ *	int
+ *	pgm_send_retained (
+ *		pgm_sock_t*	sock,
+ *		const void*	apdu,
+ *		size_t		apdu_length,
+ *		size_t*		bytes_written
+ *		)
+ */
+
+static
+void
+mock_retain_release (
+	const void*		buf,
+	size_t			len,
+	void*			user_data
+	)
+{
+	g_debug ("mock_retain_release (buf:%p len:%u user-data:%p)", buf, (unsigned)len, user_data);
+}
+
+START_TEST (test_send_retained_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->retain_info.ri_release = mock_retain_release;
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_retained (sock, buffer, apdu_length, &bytes_written), "send_retained not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send_retained underrun");
+}
+END_TEST
+
+/* large apdu */
+START_TEST (test_send_retained_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->retain_info.ri_release = mock_retain_release;
+	const gsize apdu_length = 16000;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_retained (sock, buffer, apdu_length, &bytes_written), "send_retained not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send_retained underrun");
+}
+END_TEST
+
+/* PGM_TXW_RETAIN not set */
+START_TEST (test_send_retained_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_retained (sock, buffer, apdu_length, &bytes_written), "send_retained not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_retained (NULL, buffer, apdu_length, &bytes_written), "send_retained not error");
+}
+END_TEST
+
+/* target:
+ *	int
+ *	pgm_send_begin (
+ *		pgm_sock_t*	sock,
+ *		size_t		apdu_length
+ *		)
+ *	int
+ *	pgm_send_append (
+ *		pgm_sock_t*	sock,
+ *		const void*	buf,
+ *		size_t		len,
+ *		size_t*		bytes_written
+ *		)
+ *	int
+ *	pgm_send_end (
+ *		pgm_sock_t*	sock
+ *		)
+ */
+
+/* apdu larger than max_apdu in uneven pieces */
+START_TEST (test_send_stream_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = sock->max_apdu + 1000;
+	guint8* buffer = g_malloc0 (apdu_length);
+	gsize offset = 0, bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, apdu_length), "begin not normal");
+	while (offset < apdu_length) {
+		const gsize len = MIN(333, apdu_length - offset);
+		fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_append (sock, buffer + offset, len, &bytes_written), "append not normal");
+		fail_unless (len == bytes_written, "append underrun");
+		offset += len;
+	}
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_end (sock), "end not normal");
+	g_free (buffer);
+}
+END_TEST
+
+/* regular sends refused while stream open, overrun and truncation */
+START_TEST (test_send_stream_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	guint8 buffer[ 200 ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, 100), "begin not normal");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_begin (sock, 100), "nested begin not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send (sock, buffer, 100, &bytes_written), "send not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_append (sock, buffer, 200, &bytes_written), "overrun not error");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_append (sock, buffer, 50, &bytes_written), "append not normal");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_end (sock), "truncated end not error");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, 100, &bytes_written), "send not normal");
+}
+END_TEST
+
+/* payload and fragment framing on the wire */
+START_TEST (test_send_stream_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = 4000;
+	guint8 buffer[ apdu_length ], sent[ apdu_length ];
+	gsize offset = 0, bytes_written;
+	for (gsize i = 0; i < apdu_length; i++)
+		buffer[i] = (guint8)(i * 7);
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, apdu_length), "begin not normal");
+	while (offset < apdu_length) {
+		const gsize len = MIN(333, apdu_length - offset);
+		fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_append (sock, buffer + offset, len, &bytes_written), "append not normal");
+		offset += len;
+	}
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_end (sock), "end not normal");
+	fail_unless (mock_sent_count > 1, "not fragmented");
+	fail_unless ((gssize)apdu_length == mock_sent_payload (sent, sizeof(sent), apdu_length), "payload length mismatch");
+	fail_unless (0 == memcmp (buffer, sent, apdu_length), "payload mismatch");
+}
+END_TEST
+
+/* truncated stream sends the partially filled fragment */
+START_TEST (test_send_stream_pass_004)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = 4000, truncated_length = 2000;
+	guint8 buffer[ apdu_length ], sent[ apdu_length ];
+	gsize bytes_written;
+	for (gsize i = 0; i < apdu_length; i++)
+		buffer[i] = (guint8)(i * 7);
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, apdu_length), "begin not normal");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_append (sock, buffer, truncated_length, &bytes_written), "append not normal");
+	fail_unless (truncated_length == bytes_written, "append underrun");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_end (sock), "truncated end not error");
+	fail_if (sock->stream_state.is_active, "stream left open");
+	fail_unless ((gssize)truncated_length == mock_sent_payload (sent, sizeof(sent), apdu_length), "payload length mismatch");
+	fail_unless (0 == memcmp (buffer, sent, truncated_length), "payload mismatch");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, 100, &bytes_written), "send not normal");
+}
+END_TEST
+
+/* truncated stream blocked on the final fragment */
+START_TEST (test_send_stream_pass_005)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = 4000, truncated_length = 2000;
+	guint8 buffer[ apdu_length ], sent[ apdu_length ];
+	gsize bytes_written;
+	for (gsize i = 0; i < apdu_length; i++)
+		buffer[i] = (guint8)(i * 7);
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, apdu_length), "begin not normal");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_append (sock, buffer, truncated_length, &bytes_written), "append not normal");
+	mock_sendto_errno = PGM_SOCK_EAGAIN;
+	fail_unless (PGM_IO_STATUS_WOULD_BLOCK == pgm_send_end (sock), "end not would-block");
+	fail_unless (sock->stream_state.is_active, "stream closed");
+	mock_sendto_errno = 0;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_end (sock), "truncated end not error");
+	fail_if (sock->stream_state.is_active, "stream left open");
+	fail_unless ((gssize)truncated_length == mock_sent_payload (sent, sizeof(sent), apdu_length), "payload length mismatch");
+	fail_unless (0 == memcmp (buffer, sent, truncated_length), "payload mismatch");
+}
+END_TEST
+
+START_TEST (test_send_stream_fail_001)
+{
+	guint8 buffer[ 100 ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_begin (NULL, sizeof(buffer)), "begin not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_append (NULL, buffer, sizeof(buffer), &bytes_written), "append not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_end (NULL), "end not error");
+}
+END_TEST
+
+/* target:
+ *	int
+ *	pgm_send_topic (
+ *		pgm_sock_t*	sock,
+ *		const char*	topic,
+ *		const void*	apdu,
+ *		size_t		apdu_length,
+ *		size_t*		bytes_written
+ *		)
+ */
+
+START_TEST (test_send_topic_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_topic (sock, "market.42", buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+	fail_if (sock->stream_state.is_active, "stream left open");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send (sock, buffer, apdu_length, &bytes_written), "send not normal");
+}
+END_TEST
+
+/* large apdu, fragmented with topic on every TPDU */
+START_TEST (test_send_topic_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	const gsize apdu_length = 16000;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_topic (sock, "market.42", buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+}
+END_TEST
+
+START_TEST (test_send_topic_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->can_send_data = TRUE;
+	char topic[ PGM_MAX_TOPIC + 2 ];
+	guint8 buffer[ 100 ];
+	gsize bytes_written;
+	memset (topic, 'a', sizeof(topic) - 1);
+	topic[ sizeof(topic) - 1 ] = '\0';
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_topic (NULL, "market", buffer, sizeof(buffer), &bytes_written), "send not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_topic (sock, "", buffer, sizeof(buffer), &bytes_written), "empty topic not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_topic (sock, topic, buffer, sizeof(buffer), &bytes_written), "long topic not error");
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_begin (sock, 100), "begin not normal");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_topic (sock, "market", buffer, sizeof(buffer), &bytes_written), "send during stream not error");
+}
+END_TEST
+
+/* target:
+ *	int
+ *	pgm_send_priority (
+ *		pgm_sock_t*	sock,
+ *		const void*	apdu,
+ *		size_t		apdu_length,
+ *		size_t*		bytes_written
+ *		)
+ */
+
+START_TEST (test_send_priority_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->lane.tsi.sport = g_htons(1001);
+	sock->lane.window = g_malloc0 (sizeof(pgm_txw_t));
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_priority (sock, buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+/* socket and original data buckets */
+	fail_unless (2 == mock_debit_count, "debit count");
+}
+END_TEST
+
+/* no lane, or message larger than one TPDU */
+START_TEST (test_send_priority_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	guint8 buffer[ 16000 ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_priority (sock, buffer, 100, &bytes_written), "send not error");
+	sock->lane.window = g_malloc0 (sizeof(pgm_txw_t));
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_priority (sock, buffer, sizeof(buffer), &bytes_written), "send not error");
+}
+END_TEST
+
+/* failed send */
+START_TEST (test_send_priority_fail_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->lane.tsi.sport = g_htons(1001);
+	sock->lane.window = g_malloc0 (sizeof(pgm_txw_t));
+	guint8 buffer[ 100 ];
+	gsize bytes_written = 0;
+	mock_sendto_errno = PGM_SOCK_EAGAIN;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_priority (sock, buffer, sizeof(buffer), &bytes_written), "send not error");
+	fail_unless (0 == bytes_written, "bytes written");
+	fail_unless (0 == mock_debit_count, "debit count");
+}
+END_TEST
+
+/* target:
+ *	int
+ *	pgm_send_layer (
+ *		pgm_sock_t*	sock,
+ *		unsigned	layer_index,
+ *		const void*	apdu,
+ *		size_t		apdu_length,
+ *		size_t*		bytes_written
+ *		)
+ */
+
+/* enhancement layer companion session on its own group */
+START_TEST (test_send_layer_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	sock->layers_len = 1;
+	sock->layers = g_malloc0 (sizeof(pgm_layer_t));
+	pgm_layer_t* layer = &sock->layers[0];
+	memcpy (&layer->tsi, &sock->tsi, sizeof(pgm_tsi_t));
+	layer->tsi.sport = g_htons(1001);
+	((struct sockaddr*)&layer->gr.gr_group)->sa_family = AF_INET;
+	((struct sockaddr_in*)&layer->gr.gr_group)->sin_addr.s_addr = inet_addr ("239.192.0.2");
+	layer->window = g_malloc0 (sizeof(pgm_txw_t));
+	pgm_mutex_init (&layer->mutex);
+	const gsize apdu_length = 100;
+	guint8 buffer[ apdu_length ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_NORMAL == pgm_send_layer (sock, 1, buffer, apdu_length, &bytes_written), "send not normal");
+	fail_unless ((gssize)apdu_length == bytes_written, "send underrun");
+	fail_unless (1 == mock_sent_count, "sent count");
+	const struct pgm_header* header = (const struct pgm_header*)mock_sent[0];
+	fail_unless (PGM_ODATA == header->pgm_type, "not ODATA");
+	fail_unless (g_htons(1001) == header->pgm_sport, "not layer source port");
+	fail_unless (0 == header->pgm_options, "options set");
+	fail_unless (g_htons(apdu_length) == header->pgm_tsdu_length, "tsdu length");
+}
+END_TEST
+
+/* unknown layer, or message larger than one TPDU */
+START_TEST (test_send_layer_fail_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->is_bound = TRUE;
+	guint8 buffer[ 16000 ];
+	gsize bytes_written;
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_layer (sock, 1, buffer, 100, &bytes_written), "send not error");
+	sock->layers_len = 1;
+	sock->layers = g_malloc0 (sizeof(pgm_layer_t));
+	sock->layers[0].window = g_malloc0 (sizeof(pgm_txw_t));
+	pgm_mutex_init (&sock->layers[0].mutex);
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_layer (sock, 2, buffer, 100, &bytes_written), "send not error");
+	fail_unless (PGM_IO_STATUS_ERROR == pgm_send_layer (sock, 1, buffer, sizeof(buffer), &bytes_written), "send not error");
+	fail_unless (0 == mock_sent_count, "sent count");
+}
+END_TEST
+
 /* target:
  *	PGMIOStatus
  *	pgm_sendv (
@@ -768,6 +1344,16 @@ START_TEST (test_send_spm_pass_001)
 }
 END_TEST
 
+/* with OPT_JOIN */
+START_TEST (test_send_spm_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->late_join_sqns = 100;
+	fail_unless (TRUE == pgm_send_spm (sock, 0), "send_spm failed");
+}
+END_TEST
+
 START_TEST (test_send_spm_fail_001)
 {
 	pgm_send_spm (NULL, 0);
@@ -969,6 +1555,102 @@ START_TEST (test_on_nnak_fail_002)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	on_rate_cc_feedback (
+ *		pgm_sock_t* const	sock,
+ *		const pgm_time_t	now
+ *	)
+ *
+ * 001: slow-start doubles the rate at most once per RTT.
+ */
+
+START_TEST (test_on_rate_cc_feedback_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->use_rate_cc = TRUE;
+	sock->is_rate_cc_slow_start = TRUE;
+	sock->cc_rate = PGM_RATE_CC_INITIAL_PACKETS * sock->max_tpdu;
+	sock->cc_max_rate = 1000 * 1000;
+	sock->acker_rtt = 10;
+	on_rate_cc_feedback (sock, pgm_secs(1));
+	fail_unless (2 * PGM_RATE_CC_INITIAL_PACKETS * sock->max_tpdu == sock->cc_rate, "slow-start failed");
+	fail_unless (sock->cc_rate == mock_rate_per_sec, "rate_set failed");
+	on_rate_cc_feedback (sock, pgm_secs(1) + pgm_msecs(1));
+	fail_unless (2 * PGM_RATE_CC_INITIAL_PACKETS * sock->max_tpdu == sock->cc_rate, "increase per RTT failed");
+	on_rate_cc_feedback (sock, pgm_secs(1) + pgm_msecs(20));
+	fail_unless (4 * PGM_RATE_CC_INITIAL_PACKETS * sock->max_tpdu == sock->cc_rate, "slow-start failed");
+	fail_unless (TRUE == sock->is_rate_cc_slow_start, "slow-start failed");
+}
+END_TEST
+
+/* 002: reported loss leaves slow-start and drops to the equation rate.
+ */
+
+START_TEST (test_on_rate_cc_feedback_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->use_rate_cc = TRUE;
+	sock->is_rate_cc_slow_start = TRUE;
+	sock->cc_rate = 1000 * 1000;
+	sock->cc_max_rate = 1000 * 1000;
+	sock->acker_rtt = 100;
+	sock->acker_loss_rate = 6554;		/* 10% */
+	on_rate_cc_feedback (sock, pgm_secs(1));
+	fail_unless (FALSE == sock->is_rate_cc_slow_start, "slow-start failed");
+	fail_unless (sock->cc_rate < 100 * 1000, "decrease failed");
+	fail_unless (sock->cc_rate >= sock->max_tpdu, "minimum rate failed");
+	fail_unless (sock->cc_rate == mock_rate_per_sec, "rate_set failed");
+}
+END_TEST
+
+/* 003: without loss the rate increases by one packet per RTT upto the ceiling.
+ */
+
+START_TEST (test_on_rate_cc_feedback_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->use_rate_cc = TRUE;
+	sock->is_rate_cc_slow_start = FALSE;
+	sock->cc_rate = 100 * 1000;
+	sock->cc_max_rate = 100 * 1000 + 1000;
+	sock->acker_rtt = 100;
+	on_rate_cc_feedback (sock, pgm_secs(1));
+	fail_unless (100 * 1000 + 1000 == sock->cc_rate, "maximum rate failed");
+}
+END_TEST
+
+/* 004: congestion experienced marks without loss decrease the rate.
+ */
+
+START_TEST (test_on_rate_cc_feedback_pass_004)
+{
+	pgm_sock_t* sock = generate_sock ();
+	fail_if (NULL == sock, "generate_sock failed");
+	sock->use_rate_cc = TRUE;
+	sock->use_ecn = TRUE;
+	sock->is_rate_cc_slow_start = TRUE;
+	sock->cc_rate = 1000 * 1000;
+	sock->cc_max_rate = 1000 * 1000;
+	sock->acker_rtt = 100;
+	sock->acker_loss_rate = 0;
+	sock->acker_ce_rate = 6554;		/* 10% */
+	on_rate_cc_feedback (sock, pgm_secs(1));
+	fail_unless (FALSE == sock->is_rate_cc_slow_start, "slow-start failed");
+	fail_unless (sock->cc_rate < 100 * 1000, "decrease failed");
+}
+END_TEST
+
+START_TEST (test_on_rate_cc_feedback_fail_001)
+{
+	on_rate_cc_feedback (NULL, 0);
+	fail ("reached");
+}
+END_TEST
+
 /* target:
  *	bool
  *	pgm_setsockopt (
@@ -1158,8 +1840,46 @@ make_test_suite (void)
 	tcase_add_checked_fixture (tc_send, mock_setup, NULL);
 	tcase_add_test (tc_send, test_send_pass_001);
 	tcase_add_test (tc_send, test_send_pass_002);
+	tcase_add_test (tc_send, test_send_pass_003);
 	tcase_add_test (tc_send, test_send_fail_001);
 
+	TCase* tc_send_retained = tcase_create ("send-retained");
+	suite_add_tcase (s, tc_send_retained);
+	tcase_add_checked_fixture (tc_send_retained, mock_setup, NULL);
+	tcase_add_test (tc_send_retained, test_send_retained_pass_001);
+	tcase_add_test (tc_send_retained, test_send_retained_pass_002);
+	tcase_add_test (tc_send_retained, test_send_retained_fail_001);
+
+	TCase* tc_send_stream = tcase_create ("send-stream");
+	suite_add_tcase (s, tc_send_stream);
+	tcase_add_checked_fixture (tc_send_stream, mock_setup, NULL);
+	tcase_add_test (tc_send_stream, test_send_stream_pass_001);
+	tcase_add_test (tc_send_stream, test_send_stream_pass_002);
+	tcase_add_test (tc_send_stream, test_send_stream_pass_003);
+	tcase_add_test (tc_send_stream, test_send_stream_pass_004);
+	tcase_add_test (tc_send_stream, test_send_stream_pass_005);
+	tcase_add_test (tc_send_stream, test_send_stream_fail_001);
+
+	TCase* tc_send_topic = tcase_create ("send-topic");
+	suite_add_tcase (s, tc_send_topic);
+	tcase_add_checked_fixture (tc_send_topic, mock_setup, NULL);
+	tcase_add_test (tc_send_topic, test_send_topic_pass_001);
+	tcase_add_test (tc_send_topic, test_send_topic_pass_002);
+	tcase_add_test (tc_send_topic, test_send_topic_fail_001);
+
+	TCase* tc_send_priority = tcase_create ("send-priority");
+	suite_add_tcase (s, tc_send_priority);
+	tcase_add_checked_fixture (tc_send_priority, mock_setup, NULL);
+	tcase_add_test (tc_send_priority, test_send_priority_pass_001);
+	tcase_add_test (tc_send_priority, test_send_priority_fail_001);
+	tcase_add_test (tc_send_priority, test_send_priority_fail_002);
+
+	TCase* tc_send_layer = tcase_create ("send-layer");
+	suite_add_tcase (s, tc_send_layer);
+	tcase_add_checked_fixture (tc_send_layer, mock_setup, NULL);
+	tcase_add_test (tc_send_layer, test_send_layer_pass_001);
+	tcase_add_test (tc_send_layer, test_send_layer_fail_001);
+
 	TCase* tc_sendv = tcase_create ("sendv");
 	suite_add_tcase (s, tc_sendv);
 	tcase_add_checked_fixture (tc_sendv, mock_setup, NULL);
@@ -1180,6 +1900,7 @@ make_test_suite (void)
 	suite_add_tcase (s, tc_send_spm);
 	tcase_add_checked_fixture (tc_send_spm, mock_setup, NULL);
 	tcase_add_test (tc_send_spm, test_send_spm_pass_001);
+	tcase_add_test (tc_send_spm, test_send_spm_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_send_spm, test_send_spm_fail_001, SIGABRT);
 #endif
@@ -1223,6 +1944,17 @@ make_test_suite (void)
 	tcase_add_test_raise_signal (tc_on_nnak, test_on_nnak_fail_002, SIGABRT);
 #endif
 
+	TCase* tc_on_rate_cc_feedback = tcase_create ("on-rate-cc-feedback");
+	suite_add_tcase (s, tc_on_rate_cc_feedback);
+	tcase_add_checked_fixture (tc_on_rate_cc_feedback, mock_setup, NULL);
+	tcase_add_test (tc_on_rate_cc_feedback, test_on_rate_cc_feedback_pass_001);
+	tcase_add_test (tc_on_rate_cc_feedback, test_on_rate_cc_feedback_pass_002);
+	tcase_add_test (tc_on_rate_cc_feedback, test_on_rate_cc_feedback_pass_003);
+	tcase_add_test (tc_on_rate_cc_feedback, test_on_rate_cc_feedback_pass_004);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_on_rate_cc_feedback, test_on_rate_cc_feedback_fail_001, SIGABRT);
+#endif
+
 	TCase* tc_set_ambient_spm = tcase_create ("set-ambient-spm");
 	suite_add_tcase (s, tc_set_ambient_spm);
 	tcase_add_checked_fixture (tc_set_ambient_spm, mock_setup, NULL);
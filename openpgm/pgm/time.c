@@ -170,8 +170,12 @@ static pgm_time_t		pgm_rtc_update (void);
 #	elif defined(_MSC_VER)
 #		include <intrin.h>
 #	endif
+#	ifndef _WIN32
+#		include <unistd.h>
+#	endif
 #	define TSC_NS_SCALE	10 /* 2^10, carefully chosen */
 #	define TSC_US_SCALE	20
+#	define TSC_CALIBRATION_MSECS	100
 static uint_fast32_t		tsc_khz PGM_GNUC_READ_MOSTLY = 0;
 static uint_fast32_t		tsc_ns_mul PGM_GNUC_READ_MOSTLY = 0;
 static uint_fast32_t		tsc_us_mul PGM_GNUC_READ_MOSTLY = 0;
@@ -224,12 +228,15 @@ us_to_tsc (
 
 #	ifndef _WIN32
 static bool			pgm_tsc_init (pgm_error_t**);
+static uint_fast32_t		pgm_tsc_read_calibration (const char*restrict, const uint32_t);
+static void			pgm_tsc_write_calibration (const char*restrict, const uint32_t, const uint_fast32_t);
 #	endif
 static pgm_time_t		pgm_tsc_update (void);
 #endif
 
 
-/* initialize time system.
+/* initialize time system, cpu is the run-time platform information captured by
+ * the engine, or NULL to query the processor here.
  *
  * returns TRUE on success, returns FALSE on error such as being unable to open
  * the RTC device, an unstable TSC, or system already initialized.
@@ -238,7 +245,8 @@ static pgm_time_t		pgm_tsc_update (void);
 PGM_GNUC_INTERNAL
 bool
 pgm_time_init (
-	pgm_error_t**	error
+	const pgm_cpu_t*	cpu,
+	pgm_error_t**		error
 	)
 {
 	char	*pgm_timer;
@@ -371,6 +379,12 @@ pgm_time_init (
 	if (pgm_time_update_now == pgm_tsc_update)
 	{
 		char	*rdtsc_frequency;
+		pgm_cpu_t local_cpu;
+
+		if (NULL == cpu) {
+			pgm_cpuid (&local_cpu);
+			cpu = &local_cpu;
+		}
 
 #ifdef HAVE_PROC_CPUINFO
 /* attempt to parse clock ticks from kernel
@@ -473,6 +487,15 @@ pgm_time_init (
 		}
 #endif /* !_WIN32 */
 
+/* processor reported TSC frequency in preference to the current core frequency
+ * reported by the kernel.  Only sources that define the TSC rate are reported
+ * by pgm_cpuid(), the base frequency is not.
+ */
+		if (cpu->tsc_khz > 0) {
+			tsc_khz = cpu->tsc_khz;
+			pgm_minor (_("CPUID reports TSC frequency %u KHz"), (unsigned)(tsc_khz));
+		}
+
 /* e.g. export RDTSC_FREQUENCY=3200.000000
  *
  * Value can be used to override kernel tick rate as well as internal calibration
@@ -484,14 +507,29 @@ pgm_time_init (
 		}
 
 #ifndef _WIN32
+/* e.g. export PGM_TSC_CALIBRATION=/var/tmp/pgm-tsc
+ *
+ * Persist the benchmark result across process restarts.
+ */
+		char	*tsc_calibration = NULL;
+		err = pgm_dupenv_s (&tsc_calibration, &envlen, "PGM_TSC_CALIBRATION");
+		if (0 != err || 0 == envlen)
+			tsc_calibration = NULL;
+		if (0 >= tsc_khz && NULL != tsc_calibration)
+			tsc_khz = pgm_tsc_read_calibration (tsc_calibration, cpu->signature);
+
 /* calibrate */
 		if (0 >= tsc_khz) {
 			pgm_error_t* sub_error = NULL;
 			if (!pgm_tsc_init (&sub_error)) {
 				pgm_propagate_error (error, sub_error);
+				pgm_free (tsc_calibration);
 				goto err_cleanup;
 			}
+			if (NULL != tsc_calibration && tsc_khz > 0 && pgm_time_update_now == pgm_tsc_update)
+				pgm_tsc_write_calibration (tsc_calibration, cpu->signature, tsc_khz);
 		}
+		pgm_free (tsc_calibration);
 #endif
 		pgm_minor (_("TSC frequency set at %u KHz"), (unsigned)(tsc_khz));
 		set_tsc_mul (tsc_khz);
@@ -851,20 +889,22 @@ pgm_tsc_init (
 
 #		endif /* HAVE_PROC_CPUINFO */
 
-	pgm_time_t		start, stop, elapsed;
-	const pgm_time_t	calibration_usec = secs_to_usecs (4);
+	pgm_time_t		start, stop, elapsed, start_usec, elapsed_usec;
 	struct timespec		req = {
-					.tv_sec  = 4,
-					.tv_nsec = 0
+					.tv_sec  = 0,
+					.tv_nsec = msecs_to_nsecs (TSC_CALIBRATION_MSECS)
 				};
 
 	pgm_info (_("Running a benchmark to measure system clock frequency..."));
 
+/* measure the elapsed wall time rather than trust the sleep duration */
+	start_usec = pgm_gettimeofday_update();
 	start = pgm_rdtsc();
 	while (-1 == nanosleep (&req, &req) && EINTR == errno);
 	stop = pgm_rdtsc();
+	elapsed_usec = pgm_gettimeofday_update() - start_usec;
 
-	if (stop < start)
+	if (stop < start || 0 == elapsed_usec)
 	{
 		pgm_warn (_("Finished RDTSC test.  Unstable TSC detected.  The benchmark resulted in a "
 			   "non-monotonic time response rendering the TSC unsuitable for high resolution "
@@ -875,23 +915,77 @@ pgm_tsc_init (
 		return TRUE;
 	}
 
-/* TODO: this math needs to be scaled to reduce rounding errors */
+/* ticks per millisecond */
 	elapsed = stop - start;
-	if (elapsed > calibration_usec) {
-/* cpu > 1 Ghz */
-		tsc_khz = (elapsed * 1000) / calibration_usec;
-	} else {
-/* cpu < 1 Ghz */
-		tsc_khz = -( (calibration_usec * 1000) / elapsed );
-	}
+	tsc_khz = (uint_fast32_t)((elapsed * 1000) / elapsed_usec);
 
 	pgm_info (_("Finished RDTSC test. To prevent the startup delay from this benchmark, "
 		   "set the environment variable RDTSC_FREQUENCY to %" PRIuFAST32 " on this "
-		   "system. This value is dependent upon the CPU clock speed and "
-		   "architecture and should be determined separately for each server."),
-		   tsc_khz);
+		   "system, or PGM_TSC_CALIBRATION to a file to keep the result. This value "
+		   "is dependent upon the CPU clock speed and architecture and should be "
+		   "determined separately for each server."),
+		   tsc_khz / 1000);
 	return TRUE;
 }
+
+/* calibration file holds the processor signature and TSC frequency in KHz,
+ * e.g. "000c06f2 2100094".  A different processor invalidates the result.
+ *
+ * returns TSC frequency, or 0 if none is recorded for this processor.
+ */
+
+static
+uint_fast32_t
+pgm_tsc_read_calibration (
+	const char*restrict	path,
+	const uint32_t		signature
+	)
+{
+	FILE		*fp = fopen (path, "r");
+	unsigned	 file_signature = 0, file_khz = 0;
+
+	if (NULL == fp)
+		return 0;
+	if (2 != fscanf (fp, "%x %u", &file_signature, &file_khz))
+		file_khz = 0;
+	fclose (fp);
+	if (file_signature != signature || 0 == file_khz) {
+		pgm_minor (_("Ignoring TSC calibration in \"%s\"."), path);
+		return 0;
+	}
+	pgm_minor (_("TSC calibration read from \"%s\"."), path);
+	return file_khz;
+}
+
+/* replace the file atomically as concurrently starting processes may read it.
+ */
+
+static
+void
+pgm_tsc_write_calibration (
+	const char*restrict	path,
+	const uint32_t		signature,
+	const uint_fast32_t	khz
+	)
+{
+	char	 tmp_path[1024], errbuf[1024];
+	FILE	*fp;
+
+	if ((size_t)pgm_snprintf_s (tmp_path, sizeof (tmp_path), _TRUNCATE, "%s.%ld", path, (long)getpid()) >= sizeof (tmp_path))
+		return;
+	fp = fopen (tmp_path, "w");
+	if (NULL == fp) {
+		pgm_warn (_("Cannot save TSC calibration to \"%s\": %s"), path,
+			pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+		return;
+	}
+	fprintf (fp, "%08x %u\n", (unsigned)signature, (unsigned)khz);
+	if (0 != fclose (fp) || 0 != rename (tmp_path, path)) {
+		pgm_warn (_("Cannot save TSC calibration to \"%s\": %s"), path,
+			pgm_strerror_s (errbuf, sizeof (errbuf), errno));
+		unlink (tmp_path);
+	}
+}
 #	endif
 
 /* TSC is monotonic on the same core but we do neither force the same core or save the count
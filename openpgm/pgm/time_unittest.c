@@ -57,15 +57,18 @@ pgm_get_nprocs (void)
 
 /* target:
  *	boolean
- *	pgm_time_init (pgm_error_t** error)
+ *	pgm_time_init (
+ *		const pgm_cpu_t*	cpu,
+ *		pgm_error_t**		error
+ *	)
  */
 
 /* time initialisation uses reference counting */
 
 START_TEST (test_init_pass_001)
 {
-	fail_unless (TRUE == pgm_time_init (NULL), "init #1 failed");
-	fail_unless (TRUE == pgm_time_init (NULL), "init #2 failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init #1 failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init #2 failed");
 #ifdef PGM_CHECK_NOFORK
 	fail_unless (TRUE == pgm_time_shutdown (), "shutdown #1 failed");
 	fail_unless (TRUE == pgm_time_shutdown (), "shutdown #2 failed");
@@ -73,6 +76,24 @@ START_TEST (test_init_pass_001)
 }
 END_TEST
 
+/* TSC frequency taken from the engine captured processor information */
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+START_TEST (test_init_pass_002)
+{
+	pgm_cpu_t cpu;
+	memset (&cpu, 0, sizeof(cpu));
+	cpu.tsc_khz = 2100000;
+	setenv ("PGM_TIMER", "TSC", 1);
+	unsetenv ("RDTSC_FREQUENCY");
+	unsetenv ("PGM_TSC_CALIBRATION");
+	fail_unless (TRUE == pgm_time_init (&cpu, NULL), "init failed");
+	fail_unless (pgm_tsc_update == pgm_time_update_now, "timer not TSC");
+	fail_unless (2100000 == tsc_khz, "tsc_khz %u", (unsigned)tsc_khz);
+	fail_unless (TRUE == pgm_time_shutdown (), "shutdown failed");
+}
+END_TEST
+#endif
+
 /* target:
  *	bool
  *	pgm_time_shutdown (void)
@@ -80,7 +101,7 @@ END_TEST
 
 START_TEST (test_shutdown_pass_001)
 {
-	fail_unless (TRUE == pgm_time_init (NULL), "init failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init failed");
 	fail_unless (TRUE == pgm_time_shutdown (), "shutdown #1 failed");
 	fail_unless (FALSE == pgm_time_shutdown (), "shutdown #2 failed");
 }
@@ -88,8 +109,8 @@ END_TEST
 
 START_TEST (test_shutdown_pass_002)
 {
-	fail_unless (TRUE == pgm_time_init (NULL), "init #1 failed");
-	fail_unless (TRUE == pgm_time_init (NULL), "init #2 failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init #1 failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init #2 failed");
 	fail_unless (TRUE == pgm_time_shutdown (), "shutdown #1 failed");
 	fail_unless (TRUE == pgm_time_shutdown (), "shutdown #2 failed");
 	fail_unless (FALSE == pgm_time_shutdown (), "shutdown #3 failed");
@@ -104,7 +125,7 @@ END_TEST
 START_TEST (test_update_now_pass_001)
 {
 	pgm_time_t tstamps[11];
-	fail_unless (TRUE == pgm_time_init (NULL), "init failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init failed");
 	const pgm_time_t start_time = pgm_time_update_now ();
 	for (unsigned i = 1; i <= 10; i++)
 	{
@@ -131,7 +152,7 @@ END_TEST
  *	pgm_time_since_epoch (
  *		pgm_time_t*	pgm_time,
  *		time_t*		epoch_time
- *		)
+ *	)
  */
 
 START_TEST (test_since_epoch_pass_001)
@@ -139,7 +160,7 @@ START_TEST (test_since_epoch_pass_001)
 	char stime[1024];
 	time_t t;
 	struct tm* tmp;
-	fail_unless (TRUE == pgm_time_init (NULL), "init failed");
+	fail_unless (TRUE == pgm_time_init (NULL, NULL), "init failed");
 	pgm_time_t pgm_now = pgm_time_update_now ();
 	pgm_time_since_epoch (&pgm_now, &t);
 	tmp = localtime (&t);
@@ -151,6 +172,41 @@ START_TEST (test_since_epoch_pass_001)
 }
 END_TEST
 
+/* target:
+ *	uint_fast32_t
+ *	pgm_tsc_read_calibration (
+ *		const char*	path,
+ *		const uint32_t	signature
+ *	)
+ */
+
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+START_TEST (test_tsc_calibration_pass_001)
+{
+	char path[] = "/tmp/pgm_tsc_XXXXXX";
+	const int fd = mkstemp (path);
+	fail_unless (-1 != fd, "mkstemp failed");
+	close (fd);
+	pgm_tsc_write_calibration (path, 0x000c06f2, 2100094);
+	fail_unless (2100094 == pgm_tsc_read_calibration (path, 0x000c06f2), "read failed");
+	unlink (path);
+}
+END_TEST
+
+/* different processor */
+START_TEST (test_tsc_calibration_fail_001)
+{
+	char path[] = "/tmp/pgm_tsc_XXXXXX";
+	const int fd = mkstemp (path);
+	fail_unless (-1 != fd, "mkstemp failed");
+	close (fd);
+	pgm_tsc_write_calibration (path, 0x000c06f2, 2100094);
+	fail_unless (0 == pgm_tsc_read_calibration (path, 0x000906ea), "read failed");
+	unlink (path);
+	fail_unless (0 == pgm_tsc_read_calibration (path, 0x000c06f2), "read failed");
+}
+END_TEST
+#endif
 
 static
 Suite*
@@ -163,6 +219,9 @@ make_test_suite (void)
 	TCase* tc_init = tcase_create ("init");
 	suite_add_tcase (s, tc_init);
 	tcase_add_test (tc_init, test_init_pass_001);
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+	tcase_add_test (tc_init, test_init_pass_002);
+#endif
 
 	TCase* tc_shutdown = tcase_create ("shutdown");
 	suite_add_tcase (s, tc_shutdown);
@@ -176,6 +235,13 @@ make_test_suite (void)
 	TCase* tc_since_epoch = tcase_create ("since-epoch");
 	suite_add_tcase (s, tc_since_epoch);
 	tcase_add_test (tc_since_epoch, test_since_epoch_pass_001);
+
+#if defined(HAVE_RDTSC) && !defined(_WIN32)
+	TCase* tc_tsc_calibration = tcase_create ("tsc-calibration");
+	suite_add_tcase (s, tc_tsc_calibration);
+	tcase_add_test (tc_tsc_calibration, test_tsc_calibration_pass_001);
+	tcase_add_test (tc_tsc_calibration, test_tsc_calibration_fail_001);
+#endif
 	return s;
 }
 
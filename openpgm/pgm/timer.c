@@ -57,6 +57,8 @@ pgm_timer_prepare (
 		expiration = sock->next_ambient_spm;
 	else
 		expiration = now + sock->peer_expiry;
+	if (sock->can_recv_data && sock->layers_len)
+		expiration = MIN(expiration, sock->next_layer_check);
 
 	sock->next_poll = expiration;
 
@@ -137,6 +139,12 @@ pgm_timer_dispatch (
 		if (!pgm_check_peer_state (sock, now))
 			return FALSE;
 		next_expiration = pgm_min_receiver_expiry (sock, now + sock->peer_expiry);
+/* layered receivers join and leave on sampled loss */
+		if (sock->layers_len) {
+			if (pgm_time_after_eq (now, sock->next_layer_check))
+				pgm_layer_check (sock, now);
+			next_expiration = MIN(next_expiration, sock->next_layer_check);
+		}
 	}
 
 	if (sock->can_send_data)
@@ -165,6 +173,24 @@ printf ("ACK timeout, T:%u W:%u\n", pgm_fp8tou(sock->tokens), pgm_fp8tou(sock->c
 			next_expiration = next_expiration > 0 ? MIN(next_expiration, sock->ack_expiry) : sock->ack_expiry;
 		}
 
+/* halve rate on feedback timeout, re-armed by next transmission */
+		if (sock->use_rate_cc &&
+		    0 != sock->ack_expiry)
+		{
+			if (pgm_time_after_eq (now, sock->ack_expiry))
+			{
+				pgm_mutex_lock (&sock->timer_mutex);
+				sock->cc_rate = MAX(sock->cc_rate / 2, (ssize_t)sock->max_tpdu);
+				pgm_trace (PGM_LOG_ROLE_CONGESTION_CONTROL,_("ACK timeout, halve rate to %" PRIzd " bytes per second."),
+					   sock->cc_rate);
+				pgm_rate_set (&sock->odata_rate_control, sock->cc_rate, sock->max_tpdu);
+				sock->ack_expiry = 0;
+				pgm_mutex_unlock (&sock->timer_mutex);
+			}
+			else
+				next_expiration = next_expiration > 0 ? MIN(next_expiration, sock->ack_expiry) : sock->ack_expiry;
+		}
+
 /* SPM broadcast */
 		pgm_mutex_lock (&sock->timer_mutex);
 		const unsigned spm_heartbeat_state = sock->spm_heartbeat_state;
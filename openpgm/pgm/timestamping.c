@@ -0,0 +1,413 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Transmit timestamping, kernel software and NIC hardware stamps reaped from
+ * the socket error queue and recorded as per socket latency histograms.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#	include <sys/socket.h>
+#	if defined( __linux__ )
+#		include <net/if.h>
+#		include <sys/ioctl.h>
+#		include <linux/errqueue.h>
+#		include <linux/net_tstamp.h>
+#		include <linux/sockios.h>
+#	endif
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+
+
+//#define TIMESTAMPING_DEBUG
+
+/* SOF_TIMESTAMPING_* are enumerations, errqueue timestamp origin arrived alongside OPT_ID */
+#if defined( SO_TIMESTAMPING ) && defined( SO_EE_ORIGIN_TIMESTAMPING )
+#	define USE_TX_TIMESTAMPING
+#endif
+
+#ifdef USE_TX_TIMESTAMPING
+static
+int64_t
+_pgm_timespec_to_nsecs (
+	const struct timespec*	ts
+	)
+{
+	return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static
+void
+_pgm_tx_tstamp_add_sample (
+	pgm_tx_tstamp_t*	tx_tstamp,
+	const unsigned		histogram,
+	const int64_t		nsecs
+	)
+{
+	if (PGM_UNLIKELY(nsecs < 0))
+		return;
+	pgm_histogram_add (&tx_tstamp->histogram[ histogram ], (int)MIN(nsecs / 1000, INT_MAX - 1));
+}
+
+#	ifdef SIOCSHWTSTAMP
+/* name of the interface holding addr, the default send interface when none
+ * was bound.
+ */
+
+static
+bool
+_pgm_tx_tstamp_ifname_of_addr (
+	const struct sockaddr* restrict	addr,
+	char*		       restrict	ifname
+	)
+{
+	struct pgm_ifaddrs_t *ifap, *ifa;
+	bool found = FALSE;
+
+	if (!pgm_getifaddrs (&ifap, NULL))
+		return FALSE;
+	for (ifa = ifap; ifa; ifa = ifa->ifa_next)
+	{
+		if (NULL == ifa->ifa_addr ||
+		    ifa->ifa_addr->sa_family != addr->sa_family ||
+		    0 != pgm_sockaddr_cmp (ifa->ifa_addr, addr))
+			continue;
+		strncpy (ifname, ifa->ifa_name, IF_NAMESIZE - 1);
+		ifname[ IF_NAMESIZE - 1 ] = '\0';
+		found = TRUE;
+		break;
+	}
+	pgm_freeifaddrs (ifap);
+	return found;
+}
+
+/* NICs only stamp transmitted packets once enabled on the device with
+ * SIOCSHWTSTAMP.  the setting is device wide, needs CAP_NET_ADMIN, keeps the
+ * current receive filter, and is left on at close as a PTP daemon may share it.
+ *
+ * returns TRUE if the send interface stamps transmitted packets.
+ */
+
+static
+bool
+_pgm_tx_tstamp_enable_hardware (
+	const pgm_sock_t* const	sock
+	)
+{
+	struct ifreq ifr;
+	struct hwtstamp_config config;
+	char errbuf[1024];
+
+	memset (&ifr, 0, sizeof (ifr));
+	if ((0 == sock->send_gsr.gsr_interface ||
+	     NULL == pgm_if_indextoname (sock->send_gsr.gsr_interface, ifr.ifr_name)) &&
+	    !_pgm_tx_tstamp_ifname_of_addr ((const struct sockaddr*)&sock->send_addr, ifr.ifr_name))
+	{
+		pgm_warn (_("Hardware transmit timestamping requires a bound interface."));
+		return FALSE;
+	}
+	memset (&config, 0, sizeof (config));
+	ifr.ifr_data = (void*)&config;
+#		ifdef SIOCGHWTSTAMP
+	if (0 == ioctl (sock->send_sock, SIOCGHWTSTAMP, &ifr) &&
+	    HWTSTAMP_TX_ON == config.tx_type)
+	{
+		return TRUE;
+	}
+#		endif
+	config.flags	= 0;
+	config.tx_type	= HWTSTAMP_TX_ON;
+	if (0 != ioctl (sock->send_sock, SIOCSHWTSTAMP, &ifr)) {
+		pgm_warn (_("SIOCSHWTSTAMP on %s failed, no hardware transmit timestamps: %s"),
+			  ifr.ifr_name,
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+	pgm_trace (PGM_LOG_ROLE_NETWORK,_("Hardware transmit timestamping enabled on %s."), ifr.ifr_name);
+	return TRUE;
+}
+#	else
+static
+bool
+_pgm_tx_tstamp_enable_hardware (
+	PGM_GNUC_UNUSED const pgm_sock_t* const	sock
+	)
+{
+	pgm_warn (_("Hardware transmit timestamping not supported on this platform."));
+	return FALSE;
+}
+#	endif /* SIOCSHWTSTAMP */
+#endif /* USE_TX_TIMESTAMPING */
+
+/* request SO_TIMESTAMPING on both send sockets, flags are PGM_TX_TIMESTAMPING_*.
+ * must be called before any packet is sent so kernel and library datagram
+ * numbering agree.  hardware stamps fall back to software with a warning when
+ * the send interface cannot be enabled.
+ *
+ * returns TRUE on success, FALSE if unsupported by the platform or socket.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_tx_tstamp_enable (
+	pgm_sock_t* const	sock,
+	const int		flags
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL == sock->tx_tstamp);
+
+#ifdef USE_TX_TIMESTAMPING
+	pgm_tx_tstamp_t* tx_tstamp;
+	char tsi[ PGM_TSISTRLEN ];
+	static const char* names[ PGM_TX_TSTAMP_MAX ] = {
+		"Tx.LibraryLatencyUsecs",
+		"Tx.KernelLatencyUsecs",
+		"Tx.WireLatencyUsecs"
+	};
+	int tstamp_flags = flags;
+	if ((tstamp_flags & PGM_TX_TIMESTAMPING_HARDWARE) &&
+	    !_pgm_tx_tstamp_enable_hardware (sock))
+	{
+		pgm_trace (PGM_LOG_ROLE_NETWORK,_("Continuing with software transmit timestamps."));
+		tstamp_flags &= ~PGM_TX_TIMESTAMPING_HARDWARE;
+	}
+
+	int so_flags = SOF_TIMESTAMPING_TX_SOFTWARE |
+		       SOF_TIMESTAMPING_SOFTWARE |
+		       SOF_TIMESTAMPING_OPT_ID |
+		       SOF_TIMESTAMPING_OPT_TSONLY;
+	if (tstamp_flags & PGM_TX_TIMESTAMPING_HARDWARE)
+		so_flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+
+	if (0 != setsockopt (sock->send_sock, SOL_SOCKET, SO_TIMESTAMPING, (const char*)&so_flags, sizeof(so_flags)) ||
+	    0 != setsockopt (sock->send_with_router_alert_sock, SOL_SOCKET, SO_TIMESTAMPING, (const char*)&so_flags, sizeof(so_flags)))
+	{
+		char errbuf[1024];
+		pgm_warn (_("SO_TIMESTAMPING failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+
+	tx_tstamp = pgm_new0 (pgm_tx_tstamp_t, 1);
+	pgm_mutex_init (&tx_tstamp->mutex);
+	tx_tstamp->flags = tstamp_flags;
+	tx_tstamp->socket[ 0 ].fd = sock->send_sock;
+	tx_tstamp->socket[ 1 ].fd = sock->send_with_router_alert_sock;
+	pgm_tsi_print_r (&sock->tsi, tsi, sizeof (tsi));
+	for (unsigned i = 0; i < PGM_TX_TSTAMP_MAX; i++)
+	{
+		pgm_histogram_t* histogram = &tx_tstamp->histogram[ i ];
+		snprintf (tx_tstamp->names[ i ], sizeof (tx_tstamp->names[ i ]), "%s %s", names[ i ], tsi);
+		histogram->histogram_name	= tx_tstamp->names[ i ];
+		histogram->bucket_count		= PGM_TX_TSTAMP_BUCKETS;
+		histogram->declared_min		= 1;
+		histogram->ranges		= tx_tstamp->ranges[ i ];
+		histogram->sample.counts	= tx_tstamp->counts[ i ];
+		histogram->sample.counts_len	= PGM_TX_TSTAMP_BUCKETS;
+		pgm_histogram_init (histogram);
+	}
+	pgm_trace (PGM_LOG_ROLE_NETWORK,_("Transmit timestamping enabled%s."),
+		   (tstamp_flags & PGM_TX_TIMESTAMPING_HARDWARE) ? " with hardware stamps" : "");
+	sock->tx_tstamp = tx_tstamp;
+	return TRUE;
+#else
+	pgm_warn (_("Transmit timestamping not supported on this platform."));
+	return FALSE;
+#endif /* USE_TX_TIMESTAMPING */
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_tx_tstamp_disable (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_tx_tstamp_t* tx_tstamp;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	tx_tstamp = sock->tx_tstamp;
+	if (NULL == tx_tstamp)
+		return;
+	sock->tx_tstamp = NULL;
+	for (unsigned i = 0; i < PGM_TX_TSTAMP_MAX; i++)
+		pgm_histogram_unregister (&tx_tstamp->histogram[ i ]);
+	pgm_mutex_free (&tx_tstamp->mutex);
+	pgm_free (tx_tstamp);
+}
+
+/* record the datagram about to be handed to sendto(), the kernel software stamp
+ * may be taken before sendto() returns.  caller holds the mutex across the send
+ * so numbering follows kernel order.  skb is the ODATA packet buf was built
+ * from, or NULL, the library stamp is the skb time set by send_apdu().
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_tx_tstamp_prepare (
+	pgm_tx_tstamp_t* const restrict		tx_tstamp,
+	const bool				use_router_alert,
+	const void*		      restrict	buf,
+	const struct pgm_sk_buff_t*   restrict	skb
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != tx_tstamp);
+	pgm_assert (NULL != buf);
+
+#ifdef USE_TX_TIMESTAMPING
+	struct pgm_tx_tstamp_socket_t* tx_socket = &tx_tstamp->socket[ use_router_alert ? 1 : 0 ];
+	struct pgm_tx_tstamp_entry_t* entry = &tx_socket->ring[ tx_socket->next_id & (PGM_TX_TSTAMP_RING - 1) ];
+	const struct pgm_header* header = buf;
+
+	entry->id	= tx_socket->next_id;
+	entry->sent	= 0;
+	entry->software	= 0;
+	entry->library	= -1;
+	if (PGM_ODATA == header->pgm_type || PGM_RDATA == header->pgm_type)
+	{
+		struct timespec ts;
+		clock_gettime (CLOCK_REALTIME, &ts);
+		entry->sent = _pgm_timespec_to_nsecs (&ts);
+/* repairs carry the original transmit time */
+		if (PGM_ODATA == header->pgm_type && NULL != skb)
+			entry->library = (int64_t)pgm_to_nsecs (pgm_time_update_now() - skb->tstamp);
+	}
+#else
+	(void)tx_tstamp;
+	(void)use_router_alert;
+	(void)buf;
+	(void)skb;
+#endif /* USE_TX_TIMESTAMPING */
+}
+
+/* the prepared datagram was accepted by the kernel and consumed a timestamp id.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_tx_tstamp_commit (
+	pgm_tx_tstamp_t* const	tx_tstamp,
+	const bool		use_router_alert
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != tx_tstamp);
+
+#ifdef USE_TX_TIMESTAMPING
+	struct pgm_tx_tstamp_socket_t* tx_socket = &tx_tstamp->socket[ use_router_alert ? 1 : 0 ];
+	const struct pgm_tx_tstamp_entry_t* entry = &tx_socket->ring[ tx_socket->next_id & (PGM_TX_TSTAMP_RING - 1) ];
+
+	if (entry->library >= 0)
+		_pgm_tx_tstamp_add_sample (tx_tstamp, PGM_TX_TSTAMP_LIBRARY, entry->library);
+	tx_socket->next_id++;
+
+/* keep the error queue shallow */
+	if ((uint32_t)(tx_socket->next_id - tx_socket->reap_id) >= PGM_TX_TSTAMP_RING / 4)
+		pgm_tx_tstamp_reap (tx_tstamp);
+#else
+	(void)tx_tstamp;
+	(void)use_router_alert;
+#endif /* USE_TX_TIMESTAMPING */
+}
+
+/* drain both error queues, matching stamps to recorded datagrams by id.
+ * caller holds the mutex.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_tx_tstamp_reap (
+	pgm_tx_tstamp_t* const	tx_tstamp
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != tx_tstamp);
+
+#ifdef USE_TX_TIMESTAMPING
+	for (unsigned i = 0; i < PGM_N_ELEMENTS(tx_tstamp->socket); i++)
+	{
+		struct pgm_tx_tstamp_socket_t* tx_socket = &tx_tstamp->socket[ i ];
+		if (tx_socket->reap_id == tx_socket->next_id)
+			continue;
+		for (;;)
+		{
+			char aux[ 512 ];
+			struct msghdr msg = {
+				.msg_control	= aux,
+				.msg_controllen	= sizeof(aux)
+			};
+			const struct scm_timestamping* tss = NULL;
+			const struct sock_extended_err* serr = NULL;
+
+			if (recvmsg (tx_socket->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+				break;
+			for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+			     NULL != cmsg;
+			     cmsg = CMSG_NXTHDR(&msg, cmsg))
+			{
+				if (SOL_SOCKET == cmsg->cmsg_level && SCM_TIMESTAMPING == cmsg->cmsg_type)
+					tss = (const void*)CMSG_DATA(cmsg);
+				else if ((IPPROTO_IP == cmsg->cmsg_level && IP_RECVERR == cmsg->cmsg_type) ||
+					 (IPPROTO_IPV6 == cmsg->cmsg_level && IPV6_RECVERR == cmsg->cmsg_type))
+					serr = (const void*)CMSG_DATA(cmsg);
+			}
+			if (NULL == tss || NULL == serr ||
+			    ENOMSG != serr->ee_errno ||
+			    SO_EE_ORIGIN_TIMESTAMPING != serr->ee_origin)
+				continue;
+
+			struct pgm_tx_tstamp_entry_t* entry = &tx_socket->ring[ serr->ee_data & (PGM_TX_TSTAMP_RING - 1) ];
+			tx_socket->reap_id = serr->ee_data + 1;
+/* stale, overwritten, or not a data packet */
+			if (entry->id != serr->ee_data || 0 == entry->sent)
+				continue;
+
+			const int64_t hardware = _pgm_timespec_to_nsecs (&tss->ts[2]);
+			const int64_t software = _pgm_timespec_to_nsecs (&tss->ts[0]);
+/* NIC clock assumed disciplined to system time, e.g. phc2sys */
+			if (0 != hardware)
+				_pgm_tx_tstamp_add_sample (tx_tstamp, PGM_TX_TSTAMP_WIRE,
+							   hardware - (entry->software ? entry->software : entry->sent));
+			else if (0 != software) {
+				entry->software = software;
+				_pgm_tx_tstamp_add_sample (tx_tstamp, PGM_TX_TSTAMP_KERNEL, software - entry->sent);
+			}
+#ifdef TIMESTAMPING_DEBUG
+			pgm_debug ("tx timestamp id %" PRIu32 " software %" PRIi64 " hardware %" PRIi64,
+				   serr->ee_data, software, hardware);
+#endif
+		}
+	}
+#else
+	(void)tx_tstamp;
+#endif /* USE_TX_TIMESTAMPING */
+}
+
+/* eof */
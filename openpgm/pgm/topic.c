@@ -0,0 +1,307 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Topic subscription filter, messages tagged with OPT_TOPIC are matched
+ * against exact and prefix subscription sets before delivery.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <string.h>
+#include <impl/framework.h>
+
+
+//#define TOPIC_DEBUG
+
+
+/* topics are arbitrary octets without embedded NUL so they can key the string hashtable.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_topic_is_valid (
+	const char*	topic,
+	const size_t	topic_len
+	)
+{
+	if (PGM_UNLIKELY(NULL == topic || 0 == topic_len || topic_len > PGM_MAX_TOPIC))
+		return FALSE;
+	return (NULL == memchr (topic, '\0', topic_len));
+}
+
+PGM_GNUC_INTERNAL
+pgm_topic_filter_t*
+pgm_topic_filter_new (void)
+{
+	pgm_topic_filter_t* filter;
+
+	filter = pgm_new0 (pgm_topic_filter_t, 1);
+	filter->exact_hashtable  = pgm_hashtable_new (pgm_str_hash, pgm_str_equal);
+	filter->prefix_hashtable = pgm_hashtable_new (pgm_str_hash, pgm_str_equal);
+	return filter;
+}
+
+static
+void
+_pgm_topic_list_free (
+	pgm_list_t*	list
+	)
+{
+	while (list) {
+		pgm_list_t* next = list->next;
+		pgm_free (list->data);
+		pgm_free (list);
+		list = next;
+	}
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_topic_filter_destroy (
+	pgm_topic_filter_t*	filter
+	)
+{
+	pgm_return_if_fail (NULL != filter);
+
+	pgm_hashtable_destroy (filter->exact_hashtable);
+	pgm_hashtable_destroy (filter->prefix_hashtable);
+	_pgm_topic_list_free (filter->exact_list);
+	_pgm_topic_list_free (filter->prefix_list);
+	pgm_free (filter);
+}
+
+/* returns TRUE if the subscription set changed.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_topic_filter_subscribe (
+	pgm_topic_filter_t* restrict filter,
+	const char*	    restrict topic,
+	const size_t		     topic_len,
+	const bool		     is_prefix
+	)
+{
+	pgm_hashtable_t* hashtable;
+	pgm_list_t** list;
+	pgm_list_t* link_;
+	char key[ PGM_MAX_TOPIC + 1 ];
+
+	pgm_return_val_if_fail (NULL != filter, FALSE);
+	pgm_return_val_if_fail (pgm_topic_is_valid (topic, topic_len), FALSE);
+
+	memcpy (key, topic, topic_len);
+	key[ topic_len ] = '\0';
+
+	hashtable = is_prefix ? filter->prefix_hashtable : filter->exact_hashtable;
+	list      = is_prefix ? &filter->prefix_list : &filter->exact_list;
+	if (NULL != pgm_hashtable_lookup (hashtable, key))
+		return FALSE;
+
+	link_ = pgm_new (pgm_list_t, 1);
+	link_->data = pgm_strdup (key);
+	*list = pgm_list_prepend_link (*list, link_);
+	pgm_hashtable_insert (hashtable, link_->data, link_);
+	if (is_prefix) {
+		filter->prefix_len_count[ topic_len ]++;
+		if (topic_len > filter->prefix_len_max)
+			filter->prefix_len_max = topic_len;
+	}
+#ifdef TOPIC_DEBUG
+	pgm_debug ("subscribe %s \"%s\"", is_prefix ? "prefix" : "topic", key);
+#endif
+	return TRUE;
+}
+
+PGM_GNUC_INTERNAL
+bool
+pgm_topic_filter_unsubscribe (
+	pgm_topic_filter_t* restrict filter,
+	const char*	    restrict topic,
+	const size_t		     topic_len,
+	const bool		     is_prefix
+	)
+{
+	pgm_hashtable_t* hashtable;
+	pgm_list_t** list;
+	pgm_list_t* link_;
+	char key[ PGM_MAX_TOPIC + 1 ];
+
+	pgm_return_val_if_fail (NULL != filter, FALSE);
+	pgm_return_val_if_fail (pgm_topic_is_valid (topic, topic_len), FALSE);
+
+	memcpy (key, topic, topic_len);
+	key[ topic_len ] = '\0';
+
+	hashtable = is_prefix ? filter->prefix_hashtable : filter->exact_hashtable;
+	list      = is_prefix ? &filter->prefix_list : &filter->exact_list;
+	link_ = pgm_hashtable_lookup (hashtable, key);
+	if (NULL == link_)
+		return FALSE;
+
+	pgm_hashtable_remove (hashtable, key);
+	pgm_free (link_->data);
+	*list = pgm_list_delete_link (*list, link_);
+	if (is_prefix) {
+		filter->prefix_len_count[ topic_len ]--;
+		while (filter->prefix_len_max > 0 &&
+		       0 == filter->prefix_len_count[ filter->prefix_len_max ])
+			filter->prefix_len_max--;
+	}
+	return TRUE;
+}
+
+/* an empty filter delivers everything.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_topic_filter_is_empty (
+	const pgm_topic_filter_t*	filter
+	)
+{
+	return (NULL == filter || (NULL == filter->exact_list && NULL == filter->prefix_list));
+}
+
+/* locate OPT_TOPIC in the received option chain, returns NULL for untagged packets.
+ */
+
+static
+const struct pgm_opt_topic*
+_pgm_topic_get_option (
+	const struct pgm_sk_buff_t*	skb
+	)
+{
+	const struct pgm_opt_header* opt_header;
+
+	if (NULL == skb->pgm_header ||
+	    NULL == skb->pgm_data ||
+	    !(skb->pgm_header->pgm_options & PGM_OPT_PRESENT))
+		return NULL;
+
+	opt_header = (const struct pgm_opt_header*)(skb->pgm_data + 1);
+	if (PGM_UNLIKELY(opt_header->opt_type != PGM_OPT_LENGTH))
+		return NULL;
+
+	do {
+		if (PGM_UNLIKELY(0 == opt_header->opt_length))
+			return NULL;
+		opt_header = (const struct pgm_opt_header*)((const char*)opt_header + opt_header->opt_length);
+/* option overflow */
+		if (PGM_UNLIKELY((const char*)(opt_header + 1) > (const char*)skb->data))
+			return NULL;
+		if (PGM_OPT_TOPIC == (opt_header->opt_type & PGM_OPT_MASK)) {
+			const struct pgm_opt_topic* opt_topic = (const struct pgm_opt_topic*)(opt_header + 1);
+			if (PGM_UNLIKELY(0 == opt_topic->opt_topic_len ||
+					 opt_topic->opt_topic_len > PGM_MAX_TOPIC ||
+					 (const char*)opt_topic->opt_topic + opt_topic->opt_topic_len > (const char*)skb->data))
+				return NULL;
+			return opt_topic;
+		}
+	} while (!(opt_header->opt_type & PGM_OPT_END));
+	return NULL;
+}
+
+/* returns TRUE if the skb should be delivered: untagged, no subscriptions, an exact
+ * match, or any subscribed prefix of the topic.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_topic_filter_match (
+	const pgm_topic_filter_t*   restrict filter,
+	const struct pgm_sk_buff_t* restrict skb
+	)
+{
+	const struct pgm_opt_topic* opt_topic;
+	char key[ PGM_MAX_TOPIC + 1 ];
+	unsigned topic_len, len;
+
+	if (pgm_topic_filter_is_empty (filter))
+		return TRUE;
+	opt_topic = _pgm_topic_get_option (skb);
+	if (NULL == opt_topic)
+		return TRUE;
+
+	topic_len = opt_topic->opt_topic_len;
+	memcpy (key, opt_topic->opt_topic, topic_len);
+	key[ topic_len ] = '\0';
+
+	if (NULL != filter->exact_list &&
+	    NULL != pgm_hashtable_lookup (filter->exact_hashtable, key))
+		return TRUE;
+
+/* one probe per distinct subscribed prefix length, longest first */
+	for (len = MIN(topic_len, filter->prefix_len_max); len > 0; len--)
+	{
+		char c;
+		bool found;
+		if (0 == filter->prefix_len_count[ len ])
+			continue;
+		c = key[ len ];
+		key[ len ] = '\0';
+		found = (NULL != pgm_hashtable_lookup (filter->prefix_hashtable, key));
+		key[ len ] = c;
+		if (found)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* compact messages [msg_first, *pmsg) removing those the filter rejects,
+ * returns count of bytes dropped.  skbs remain owned by the receive window.
+ */
+
+PGM_GNUC_INTERNAL
+size_t
+pgm_topic_filter_msgv (
+	const pgm_topic_filter_t* restrict filter,
+	struct pgm_msgv_t*	  restrict msg_first,
+	struct pgm_msgv_t**	  restrict pmsg
+	)
+{
+	struct pgm_msgv_t *src, *dst;
+	size_t dropped = 0;
+
+	pgm_assert (NULL != msg_first);
+	pgm_assert (NULL != pmsg);
+
+	if (pgm_topic_filter_is_empty (filter))
+		return 0;
+
+	for (src = dst = msg_first; src < *pmsg; src++)
+	{
+		if (PGM_LIKELY(src->msgv_len > 0) &&
+		    !pgm_topic_filter_match (filter, src->msgv_skb[0]))
+		{
+			for (unsigned i = 0; i < src->msgv_len; i++)
+				dropped += src->msgv_skb[i]->len;
+			continue;
+		}
+		if (dst != src) {
+			dst->msgv_len = src->msgv_len;
+			memcpy (dst->msgv_skb, src->msgv_skb, src->msgv_len * sizeof(struct pgm_sk_buff_t*));
+		}
+		dst++;
+	}
+	*pmsg = dst;
+	return dropped;
+}
+
+/* eof */
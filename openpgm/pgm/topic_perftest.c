@@ -0,0 +1,336 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * performance tests for topic subscription filter
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+
+#define TOPIC_DEBUG
+#include "topic.c"
+
+
+/* mock state */
+
+static unsigned perf_subscriptions	= 0;
+static pgm_topic_filter_t* perf_filter	= NULL;
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+/* tagged ODATA skb as presented by the receive window.
+ */
+
+static
+struct pgm_sk_buff_t*
+generate_topic_skb (
+	const char*	topic
+	)
+{
+	const size_t topic_len = strlen (topic);
+	const size_t opt_topic_length = (sizeof(struct pgm_opt_header) + offsetof(struct pgm_opt_topic, opt_topic) + topic_len + 3) & ~(size_t)3;
+	const size_t opt_total_length = sizeof(struct pgm_opt_length) + opt_topic_length;
+	const char payload[] = "hello world";
+	struct pgm_sk_buff_t* skb;
+	struct pgm_opt_length* opt_len;
+	struct pgm_opt_header* opt_header;
+	struct pgm_opt_topic* opt_topic;
+
+	skb = pgm_alloc_skb (1500);
+	skb->pgm_header = skb->data;
+	skb->pgm_data = (void*)(skb->pgm_header + 1);
+	memset (skb->pgm_header, 0, sizeof(struct pgm_header) + sizeof(struct pgm_data) + opt_total_length);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_options = PGM_OPT_PRESENT;
+	opt_len = (void*)(skb->pgm_data + 1);
+	opt_len->opt_type = PGM_OPT_LENGTH;
+	opt_len->opt_length = sizeof(struct pgm_opt_length);
+	opt_len->opt_total_length = g_htons (opt_total_length);
+	opt_header = (void*)(opt_len + 1);
+	opt_header->opt_type = PGM_OPT_TOPIC | PGM_OPT_END;
+	opt_header->opt_length = opt_topic_length;
+	opt_topic = (void*)(opt_header + 1);
+	opt_topic->opt_topic_len = topic_len;
+	memcpy (opt_topic->opt_topic, topic, topic_len);
+	pgm_skb_reserve (skb, sizeof(struct pgm_header) + sizeof(struct pgm_data) + opt_total_length);
+	pgm_skb_put (skb, sizeof(payload));
+	memcpy (skb->data, payload, sizeof(payload));
+	return skb;
+}
+
+static
+void
+mock_setup (void)
+{
+	g_assert (pgm_time_init (NULL, NULL));
+	perf_filter = pgm_topic_filter_new ();
+}
+
+static
+void
+mock_teardown (void)
+{
+	pgm_topic_filter_destroy (perf_filter);
+	perf_filter = NULL;
+	g_assert (pgm_time_shutdown ());
+}
+
+static
+void
+mock_setup_100 (void)
+{
+	perf_subscriptions = 100;
+}
+
+static
+void
+mock_setup_10k (void)
+{
+	perf_subscriptions = 10000;
+}
+
+/* subscribe "market.<n>" exactly, or "market.<n>." as prefix.
+ */
+
+static
+void
+subscribe_all (
+	const bool	is_prefix
+	)
+{
+	char topic[ PGM_MAX_TOPIC ];
+	for (unsigned i = 0; i < perf_subscriptions; i++) {
+		const int len = snprintf (topic, sizeof(topic), is_prefix ? "market.%u." : "market.%u", i);
+		fail_unless (pgm_topic_filter_subscribe (perf_filter, topic, len, is_prefix), "subscribe failed");
+	}
+}
+
+/* target:
+ *	bool
+ *	pgm_topic_filter_match (
+ *		const pgm_topic_filter_t*	filter,
+ *		const struct pgm_sk_buff_t*	skb
+ *	)
+ */
+
+START_TEST (test_exact_hit)
+{
+	const unsigned iterations = 100000;
+	struct pgm_sk_buff_t* skb;
+	pgm_time_t start, check;
+
+	subscribe_all (FALSE);
+	skb = generate_topic_skb ("market.42");
+
+	start = pgm_time_update_now();
+	for (unsigned i = iterations; i; i--)
+		fail_unless (pgm_topic_filter_match (perf_filter, skb), "match failed");
+	check = pgm_time_update_now();
+	g_message ("exact-hit/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns",
+		perf_subscriptions,
+		(guint64)(check - start),
+		(guint64)((check - start) * 1000 / iterations));
+	pgm_free_skb (skb);
+}
+END_TEST
+
+START_TEST (test_exact_miss)
+{
+	const unsigned iterations = 100000;
+	struct pgm_sk_buff_t* skb;
+	pgm_time_t start, check;
+
+	subscribe_all (FALSE);
+	skb = generate_topic_skb ("market.unsubscribed");
+
+	start = pgm_time_update_now();
+	for (unsigned i = iterations; i; i--)
+		fail_if (pgm_topic_filter_match (perf_filter, skb), "match succeeded");
+	check = pgm_time_update_now();
+	g_message ("exact-miss/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns",
+		perf_subscriptions,
+		(guint64)(check - start),
+		(guint64)((check - start) * 1000 / iterations));
+	pgm_free_skb (skb);
+}
+END_TEST
+
+START_TEST (test_prefix_hit)
+{
+	const unsigned iterations = 100000;
+	struct pgm_sk_buff_t* skb;
+	pgm_time_t start, check;
+
+	subscribe_all (TRUE);
+	skb = generate_topic_skb ("market.42.bid.level2");
+
+	start = pgm_time_update_now();
+	for (unsigned i = iterations; i; i--)
+		fail_unless (pgm_topic_filter_match (perf_filter, skb), "match failed");
+	check = pgm_time_update_now();
+	g_message ("prefix-hit/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns",
+		perf_subscriptions,
+		(guint64)(check - start),
+		(guint64)((check - start) * 1000 / iterations));
+	pgm_free_skb (skb);
+}
+END_TEST
+
+START_TEST (test_prefix_miss)
+{
+	const unsigned iterations = 100000;
+	struct pgm_sk_buff_t* skb;
+	pgm_time_t start, check;
+
+	subscribe_all (TRUE);
+	skb = generate_topic_skb ("market.unsubscribed.bid.level2");
+
+	start = pgm_time_update_now();
+	for (unsigned i = iterations; i; i--)
+		fail_if (pgm_topic_filter_match (perf_filter, skb), "match succeeded");
+	check = pgm_time_update_now();
+	g_message ("prefix-miss/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns",
+		perf_subscriptions,
+		(guint64)(check - start),
+		(guint64)((check - start) * 1000 / iterations));
+	pgm_free_skb (skb);
+}
+END_TEST
+
+/* target:
+ *	size_t
+ *	pgm_topic_filter_msgv (
+ *		const pgm_topic_filter_t*	filter,
+ *		struct pgm_msgv_t*		msg_first,
+ *		struct pgm_msgv_t**		pmsg
+ *	)
+ */
+
+START_TEST (test_msgv)
+{
+	const unsigned iterations = 10000;
+	const unsigned msgv_len = 20;
+	struct pgm_msgv_t msgv[ msgv_len ];
+	struct pgm_sk_buff_t* skb[ msgv_len ];
+	char topic[ PGM_MAX_TOPIC ];
+	pgm_time_t start, check;
+
+	subscribe_all (FALSE);
+/* half of each vector is subscribed */
+	for (unsigned i = 0; i < msgv_len; i++) {
+		snprintf (topic, sizeof(topic), (i & 1) ? "market.%u" : "other.%u", i);
+		skb[i] = generate_topic_skb (topic);
+	}
+
+	start = pgm_time_update_now();
+	for (unsigned i = iterations; i; i--) {
+		struct pgm_msgv_t* pmsg = msgv + msgv_len;
+		for (unsigned j = 0; j < msgv_len; j++) {
+			msgv[j].msgv_len = 1;
+			msgv[j].msgv_skb[0] = skb[j];
+		}
+		fail_unless (0 != pgm_topic_filter_msgv (perf_filter, msgv, &pmsg), "filter failed");
+		fail_unless (msgv_len / 2 == (unsigned)(pmsg - msgv), "filter mismatch");
+	}
+	check = pgm_time_update_now();
+	g_message ("msgv/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns/msg",
+		perf_subscriptions,
+		(guint64)(check - start),
+		(guint64)((check - start) * 1000 / (iterations * msgv_len)));
+	for (unsigned i = 0; i < msgv_len; i++)
+		pgm_free_skb (skb[i]);
+}
+END_TEST
+
+static
+Suite*
+make_match_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Topic match performance");
+
+	TCase* tc_100 = tcase_create ("100");
+	suite_add_tcase (s, tc_100);
+	tcase_add_checked_fixture (tc_100, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_100, mock_setup_100, NULL);
+	tcase_add_test (tc_100, test_exact_hit);
+	tcase_add_test (tc_100, test_exact_miss);
+	tcase_add_test (tc_100, test_prefix_hit);
+	tcase_add_test (tc_100, test_prefix_miss);
+
+	TCase* tc_10k = tcase_create ("10k");
+	suite_add_tcase (s, tc_10k);
+	tcase_add_checked_fixture (tc_10k, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_10k, mock_setup_10k, NULL);
+	tcase_add_test (tc_10k, test_exact_hit);
+	tcase_add_test (tc_10k, test_exact_miss);
+	tcase_add_test (tc_10k, test_prefix_hit);
+	tcase_add_test (tc_10k, test_prefix_miss);
+	return s;
+}
+
+static
+Suite*
+make_msgv_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Topic msgv filter performance");
+
+	TCase* tc_10k = tcase_create ("10k");
+	suite_add_tcase (s, tc_10k);
+	tcase_add_checked_fixture (tc_10k, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_10k, mock_setup_10k, NULL);
+	tcase_add_test (tc_10k, test_msgv);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_match_performance_suite ());
+	srunner_add_suite (sr, make_msgv_performance_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
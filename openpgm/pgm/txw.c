@@ -138,6 +138,55 @@ pgm_txw_inc_retransmit_count (
 	state->retransmit_count++;
 }
 
+/* returns the only fan-out receiver to repair, or NULL for all.
+ */
+
+PGM_GNUC_INTERNAL
+const struct sockaddr*
+pgm_txw_get_requester (
+	const struct pgm_sk_buff_t*const skb
+	)
+{
+	const pgm_txw_state_t*const state = (const pgm_txw_state_t*const)&skb->cb;
+	return (0 == state->requester.sa.sa_family) ? NULL : &state->requester.sa;
+}
+
+/* record the requester of a new repair, NULL for all.
+ */
+
+static inline
+void
+_pgm_txw_set_requester (
+	pgm_txw_state_t*       const restrict state,
+	const struct sockaddr* const restrict requester
+	)
+{
+	if (NULL == requester)
+		state->requester.sa.sa_family = 0;
+	else
+		memcpy (&state->requester, requester, pgm_sockaddr_len (requester));
+}
+
+/* a different requester for a queued repair widens it to all receivers.
+ */
+
+static inline
+void
+_pgm_txw_merge_requester (
+	pgm_txw_state_t*       const restrict state,
+	const struct sockaddr* const restrict requester
+	)
+{
+	if (0 == state->requester.sa.sa_family)
+		return;
+	if (NULL == requester ||
+	    0 != pgm_sockaddr_cmp (&state->requester.sa, requester) ||
+	    pgm_sockaddr_port (&state->requester.sa) != pgm_sockaddr_port (requester))
+	{
+		state->requester.sa.sa_family = 0;
+	}
+}
+
 PGM_GNUC_INTERNAL
 bool
 pgm_txw_retransmit_is_empty (
@@ -153,7 +202,8 @@ pgm_txw_retransmit_is_empty (
 
 static void pgm_txw_remove_tail (pgm_txw_t*const);
 static bool pgm_txw_retransmit_push_parity (pgm_txw_t*const, const uint32_t, const uint8_t);
-static bool pgm_txw_retransmit_push_selective (pgm_txw_t*const, const uint32_t);
+static bool pgm_txw_retransmit_push_selective (pgm_txw_t*const restrict, const uint32_t, const struct sockaddr*const restrict);
+static bool pgm_txw_retransmit_push_archived (pgm_txw_t*const restrict, const uint32_t, const struct sockaddr*const restrict);
 
 
 /* constructor for transmit window.  zero-length windows are not permitted.
@@ -250,11 +300,29 @@ pgm_txw_shutdown (
 
 	pgm_debug ("shutdown (window:%p)", (const void*)window);
 
+/* nothing further to spill */
+	if (window->archive) {
+		pgm_txw_archive_destroy (window->archive);
+		window->archive = NULL;
+	}
+
 /* contents of window */
 	while (!pgm_txw_is_empty (window)) {
 		pgm_txw_remove_tail (window);
 	}
 
+/* pending repairs read back from the archive */
+	while (!pgm_queue_is_empty (&window->retransmit_queue)) {
+		struct pgm_sk_buff_t* skb = (struct pgm_sk_buff_t*)pgm_queue_pop_tail_link (&window->retransmit_queue);
+		pgm_assert (((pgm_txw_state_t*)&skb->cb)->is_archived);
+		pgm_hashtable_remove (window->archive_pending, &skb->sequence);
+		pgm_free_skb (skb);
+	}
+	if (window->archive_pending) {
+		pgm_hashtable_destroy (window->archive_pending);
+		window->archive_pending = NULL;
+	}
+
 /* window must now be empty */
 	pgm_assert_cmpuint (pgm_txw_length (window), ==, 0);
 	pgm_assert_cmpuint (pgm_txw_size (window), ==, 0);
@@ -274,6 +342,30 @@ pgm_txw_shutdown (
 	pgm_free (window);
 }
 
+/* extend the repair horizon beyond the window with archive, taking
+ * ownership.  must be set before the first packet is added.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_txw_set_archive (
+	pgm_txw_t*	   const restrict window,
+	pgm_txw_archive_t* const restrict archive
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != archive);
+	pgm_assert (NULL == window->archive);
+	pgm_assert (pgm_txw_is_empty (window));
+	pgm_assert (!window->is_fec_enabled);
+
+	window->archive = archive;
+	window->archive_trail = window->trail;
+	window->archive_prefetch_lead = window->trail;
+	window->archive_pending = pgm_hashtable_new (pgm_int_hash, pgm_int_equal);
+}
+
 /* add skb to transmit window, taking ownership.  window does not grow.
  * PGM skbuff data/tail pointers must point to the PGM payload, and hence skb->len
  * is allowed to be zero.
@@ -304,8 +396,13 @@ pgm_txw_add (
 	pgm_assert (((const pgm_list_t*)skb)->next == NULL);
 	pgm_assert (((const pgm_list_t*)skb)->prev == NULL);
 	pgm_assert (pgm_tsi_is_null (&skb->tsi));
-	pgm_assert ((char*)skb->data > (char*)skb->head);
-	pgm_assert ((sizeof(struct pgm_header) + sizeof(struct pgm_data)) <= (size_t)((char*)skb->data - (char*)skb->head));
+	if (skb->is_retained) {
+/* headers only, payload in application memory */
+		pgm_assert ((sizeof(struct pgm_header) + sizeof(struct pgm_data)) <= (size_t)((char*)skb->end - (char*)skb->head));
+	} else {
+		pgm_assert ((char*)skb->data > (char*)skb->head);
+		pgm_assert ((sizeof(struct pgm_header) + sizeof(struct pgm_data)) <= (size_t)((char*)skb->data - (char*)skb->head));
+	}
 
 	pgm_debug ("add (window:%p skb:%p)", (const char*)window, (const char*)skb);
 
@@ -348,7 +445,9 @@ pgm_txw_peek (
 	return _pgm_txw_peek (window, sequence);
 }
 
-/* remove an entry from the trailing edge of the transmit window.
+/* remove an entry from the trailing edge of the transmit window, with an
+ * archive the entry is copied out first and a pending repair re-queued from
+ * the archive copy.
  */
 
 static
@@ -359,6 +458,8 @@ pgm_txw_remove_tail (
 {
 	struct pgm_sk_buff_t	*skb;
 	pgm_txw_state_t		*state;
+	bool			 was_waiting_retransmit = FALSE;
+	struct sockaddr_storage	 requester;
 
 	pgm_debug ("pgm_txw_remove_tail (window:%p)", (const void*)window);
 
@@ -366,7 +467,7 @@ pgm_txw_remove_tail (
 	pgm_assert (NULL != window);
 	pgm_assert (!pgm_txw_is_empty (window));
 
-	skb = _pgm_txw_peek (window, pgm_txw_trail (window));
+	skb = _pgm_txw_peek (window, window->trail);
 	pgm_assert (NULL != skb);
 	pgm_assert (pgm_skb_is_valid (skb));
 	pgm_assert (pgm_tsi_is_null (&skb->tsi));
@@ -375,6 +476,16 @@ pgm_txw_remove_tail (
 	if (state->waiting_retransmit) {
 		pgm_queue_unlink (&window->retransmit_queue, (pgm_list_t*)skb);
 		state->waiting_retransmit = 0;
+		was_waiting_retransmit = TRUE;
+		memset (&requester, 0, sizeof (requester));
+		memcpy (&requester, &state->requester, sizeof (state->requester));
+	}
+
+/* spill to the archive, dropping its oldest entry when full */
+	if (window->archive) {
+		if ((uint32_t)(window->trail - window->archive_trail) == pgm_txw_archive_max_length (window->archive))
+			pgm_atomic_inc32 (&window->archive_trail);
+		pgm_txw_archive_write (window->archive, skb, state->unfolded_checksum);
 	}
 
 /* statistics */
@@ -394,8 +505,14 @@ pgm_txw_remove_tail (
 	pgm_free_skb (skb);
 
 /* advance trailing pointer */
+	const uint32_t sequence = window->trail;
 	pgm_atomic_inc32 (&window->trail);
 
+	if (was_waiting_retransmit && window->archive)
+		pgm_txw_retransmit_push_archived (window,
+						  sequence,
+						  requester.ss_family ? (const struct sockaddr*)&requester : NULL);
+
 /* post-conditions */
 	pgm_assert (!pgm_txw_is_full (window));
 }
@@ -409,6 +526,9 @@ pgm_txw_remove_tail (
  * transmisison group.  Parity NAKs are ignored if the packet count is
  * less than or equal to the count already queued for retransmission.
  *
+ * Selective requests remember a single requester for unicast fan-out, a
+ * second requester for the same packet widens the repair to everyone.
+ *
  * returns FALSE if request was eliminated, returns TRUE if request was
  * added to queue.
  */
@@ -416,18 +536,19 @@ pgm_txw_remove_tail (
 PGM_GNUC_INTERNAL
 bool
 pgm_txw_retransmit_push (
-	pgm_txw_t* const	window,
-	const uint32_t		sequence,
-	const bool		is_parity,	/* parity NAK ⇒ sequence_number = transmission group | packet count */
-	const uint8_t		tg_sqn_shift
+	pgm_txw_t*	       const restrict window,
+	const uint32_t			      sequence,
+	const bool			      is_parity,	/* parity NAK ⇒ sequence_number = transmission group | packet count */
+	const uint8_t			      tg_sqn_shift,
+	const struct sockaddr* const restrict requester		/* fan-out destination, NULL = all */
 	)
 {
 /* pre-conditions */
 	pgm_assert (NULL != window);
 	pgm_assert_cmpuint (tg_sqn_shift, <, 8 * sizeof(uint32_t));
 
-	pgm_debug ("retransmit_push (window:%p sequence:%" PRIu32 " is_parity:%s tg_sqn_shift:%u)",
-		(const void*)window, sequence, is_parity ? "TRUE" : "FALSE", tg_sqn_shift);
+	pgm_debug ("retransmit_push (window:%p sequence:%" PRIu32 " is_parity:%s tg_sqn_shift:%u requester:%p)",
+		(const void*)window, sequence, is_parity ? "TRUE" : "FALSE", tg_sqn_shift, (const void*)requester);
 
 /* early elimination */
 	if (pgm_txw_is_empty (window))
@@ -439,7 +560,7 @@ pgm_txw_retransmit_push (
 	}
 	else
 	{
-		return pgm_txw_retransmit_push_selective (window, sequence);
+		return pgm_txw_retransmit_push_selective (window, sequence, requester);
 	}
 }
 
@@ -495,14 +616,16 @@ pgm_txw_retransmit_push_parity (
 	pgm_queue_push_head_link (&window->retransmit_queue, (pgm_list_t*)skb);
 	pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
 	state->waiting_retransmit = 1;
+	pgm_hashtable_insert (window->archive_pending, &skb->sequence, skb);
 	return TRUE;
 }
 
 static
 bool
 pgm_txw_retransmit_push_selective (
-	pgm_txw_t* const	window,
-	const uint32_t		sequence
+	pgm_txw_t*	       const restrict window,
+	const uint32_t			      sequence,
+	const struct sockaddr* const restrict requester
 	)
 {
 	struct pgm_sk_buff_t	*skb;
@@ -513,6 +636,12 @@ pgm_txw_retransmit_push_selective (
 
 	skb = _pgm_txw_peek (window, sequence);
 	if (NULL == skb) {
+		if (NULL != window->archive &&
+		    pgm_uint32_gte (sequence, window->archive_trail) &&
+		    pgm_uint32_lt  (sequence, window->trail))
+		{
+			return pgm_txw_retransmit_push_archived (window, sequence, requester);
+		}
 		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Requested packet #%" PRIu32 " not in window."), sequence);
 		return FALSE;
 	}
@@ -524,6 +653,7 @@ pgm_txw_retransmit_push_selective (
 /* check if request can be eliminated */
 	if (state->waiting_retransmit) {
 		pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
+		_pgm_txw_merge_requester (state, requester);
 		state->nak_elimination_count++;
 		return FALSE;
 	}
@@ -535,6 +665,72 @@ pgm_txw_retransmit_push_selective (
 	pgm_queue_push_head_link (&window->retransmit_queue, (pgm_list_t*)skb);
 	pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
 	state->waiting_retransmit = 1;
+	_pgm_txw_set_requester (state, requester);
+	return TRUE;
+}
+
+/* read a request older than the window back from the archive.  the copy is
+ * referenced by the retransmit queue and indexed by sequence until dequeued,
+ * duplicates are eliminated on the copy's retransmit state.
+ *
+ * returns FALSE if request was eliminated or no longer archived, returns
+ * TRUE if request was added to queue.
+ */
+
+static
+bool
+pgm_txw_retransmit_push_archived (
+	pgm_txw_t*	       const restrict window,
+	const uint32_t			      sequence,
+	const struct sockaddr* const restrict requester
+	)
+{
+	struct pgm_sk_buff_t	*skb;
+	pgm_txw_state_t		*state;
+	uint32_t		 unfolded_checksum;
+
+/* pre-conditions */
+	pgm_assert (NULL != window);
+	pgm_assert (NULL != window->archive);
+
+/* check if request can be eliminated */
+	skb = pgm_hashtable_lookup (window->archive_pending, &sequence);
+	if (NULL != skb) {
+		state = (pgm_txw_state_t*)&skb->cb;
+		pgm_assert (state->is_archived);
+		pgm_assert (state->waiting_retransmit);
+		_pgm_txw_merge_requester (state, requester);
+		state->nak_elimination_count++;
+		return FALSE;
+	}
+
+	skb = pgm_txw_archive_read (window->archive, sequence, &unfolded_checksum);
+	if (NULL == skb) {
+		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Requested packet #%" PRIu32 " overwritten in archive."), sequence);
+		return FALSE;
+	}
+
+/* NAKs arrive in runs, read ahead of the next unless already issued */
+	if (!(pgm_uint32_lt  (sequence, window->archive_prefetch_lead) &&
+	      pgm_uint32_gte (sequence, window->archive_prefetch_lead - PGM_TXW_ARCHIVE_PREFETCH)))
+	{
+		const uint32_t count = MIN( PGM_TXW_ARCHIVE_PREFETCH, (uint32_t)(window->trail - sequence - 1) );
+		if (count > 0)
+			pgm_txw_archive_prefetch (window->archive, sequence + 1, count);
+		window->archive_prefetch_lead = sequence + 1 + count;
+	}
+
+	pgm_assert (pgm_skb_is_valid (skb));
+	state = (pgm_txw_state_t*)&skb->cb;
+	state->unfolded_checksum = unfolded_checksum;
+	state->is_archived = 1;
+	_pgm_txw_set_requester (state, requester);
+
+/* new request */
+	pgm_queue_push_head_link (&window->retransmit_queue, (pgm_list_t*)skb);
+	pgm_assert (!pgm_queue_is_empty (&window->retransmit_queue));
+	state->waiting_retransmit = 1;
+	pgm_hashtable_insert (window->archive_pending, &skb->sequence, skb);
 	return TRUE;
 }
 
@@ -782,6 +978,10 @@ pgm_txw_retransmit_remove_head (
 	{
 		pgm_queue_pop_tail_link (&window->retransmit_queue);
 		state->waiting_retransmit = 0;
+		if (state->is_archived) {
+			pgm_hashtable_remove (window->archive_pending, &skb->sequence);
+			pgm_free_skb (skb);
+		}
 	}
 }
 
@@ -0,0 +1,347 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * Memory-mapped archive of packets dropped from the transmit window.  One
+ * fixed size slot per sequence number, written in sequence order as the
+ * window trail advances so the file is filled sequentially, and read back
+ * by index for repairs beyond the in-memory window.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <stdlib.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+
+
+//#define TXW_ARCHIVE_DEBUG
+
+#ifndef TXW_ARCHIVE_DEBUG
+#	define PGM_DISABLE_ASSERT
+#endif
+
+#define PGM_TXW_ARCHIVE_SLOT_ALIGN	64
+
+static inline
+struct pgm_txw_archive_slot_t*
+_pgm_txw_archive_slot (
+	const pgm_txw_archive_t*const	archive,
+	const uint32_t			sequence
+	)
+{
+	const uint_fast32_t index_ = sequence & (archive->slot_nr - 1);
+	return (struct pgm_txw_archive_slot_t*)(archive->map + (index_ * archive->slot_size));
+}
+
+/* create an unlinked archive file in directory path holding sqns packets of
+ * up to max_tpdu bytes, rounded up to a power of two so that slots stay
+ * consistent across sequence number wrap.  the file is removed on close or
+ * process exit.
+ *
+ * returns pointer to archive on success, returns NULL on failure and sets error.
+ */
+
+PGM_GNUC_INTERNAL
+pgm_txw_archive_t*
+pgm_txw_archive_create (
+	const char*	const restrict path,
+	const uint32_t		   sqns,
+	const uint16_t		   max_tpdu,
+	pgm_error_t**	      restrict error
+	)
+{
+	pgm_txw_archive_t* archive;
+
+/* pre-conditions */
+	pgm_assert (NULL != path);
+	pgm_assert_cmpuint (sqns, >, 0);
+	pgm_assert_cmpuint (max_tpdu, >, 0);
+
+	archive = pgm_new0 (pgm_txw_archive_t, 1);
+	archive->max_tpdu	= max_tpdu;
+	archive->slot_nr	= (uint32_t)pgm_nearest_power (1, sqns);
+	archive->slot_size	= (sizeof(struct pgm_txw_archive_slot_t) + max_tpdu + PGM_TXW_ARCHIVE_SLOT_ALIGN - 1) & ~(PGM_TXW_ARCHIVE_SLOT_ALIGN - 1);
+	if (PGM_UNLIKELY(sqns > (UINT32_C(1) << 31) ||
+			 archive->slot_nr > (SIZE_MAX / archive->slot_size)))
+	{
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       PGM_ERROR_INVAL,
+			       _("Transmit window archive of %" PRIu32 " packets exceeds address space."),
+			       sqns);
+		pgm_free (archive);
+		return NULL;
+	}
+	archive->map_len	= (size_t)archive->slot_nr * archive->slot_size;
+
+#ifndef _WIN32
+	char errbuf[1024];
+	char* template_ = pgm_strconcat (path, "/pgm-txw-XXXXXX", NULL);
+	archive->fd = mkstemp (template_);
+	if (-1 == archive->fd) {
+		const int save_errno = errno;
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Creating transmit window archive in %s: %s"),
+			       path,
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		pgm_free (template_);
+		pgm_free (archive);
+		return NULL;
+	}
+	unlink (template_);
+	pgm_free (template_);
+	if (0 != ftruncate (archive->fd, (off_t)archive->map_len)) {
+		const int save_errno = errno;
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Sizing transmit window archive to %" PRIzu " bytes: %s"),
+			       archive->map_len,
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_close;
+	}
+	archive->map = mmap (NULL, archive->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, archive->fd, 0);
+	if (MAP_FAILED == archive->map) {
+		const int save_errno = errno;
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_errno (save_errno),
+			       _("Mapping transmit window archive: %s"),
+			       pgm_strerror_s (errbuf, sizeof (errbuf), save_errno));
+		goto err_close;
+	}
+#else
+	char winstr[1024];
+	char filename[MAX_PATH];
+	if (0 == GetTempFileNameA (path, "pgm", 0, filename)) {
+		const DWORD save_errno = GetLastError();
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_win_errno (save_errno),
+			       _("Creating transmit window archive in %s: %s"),
+			       path,
+			       pgm_win_strerror (winstr, sizeof (winstr), save_errno));
+		pgm_free (archive);
+		return NULL;
+	}
+	archive->file = CreateFileA (filename,
+				     GENERIC_READ | GENERIC_WRITE,
+				     0,
+				     NULL,
+				     CREATE_ALWAYS,
+				     FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+				     NULL);
+	if (INVALID_HANDLE_VALUE == archive->file) {
+		const DWORD save_errno = GetLastError();
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_win_errno (save_errno),
+			       _("Creating transmit window archive in %s: %s"),
+			       path,
+			       pgm_win_strerror (winstr, sizeof (winstr), save_errno));
+		DeleteFileA (filename);
+		pgm_free (archive);
+		return NULL;
+	}
+	archive->mapping = CreateFileMappingA (archive->file,
+					       NULL,
+					       PAGE_READWRITE,
+					       (DWORD)((uint64_t)archive->map_len >> 32),
+					       (DWORD)(archive->map_len & 0xffffffff),
+					       NULL);
+	if (NULL == archive->mapping ||
+	    NULL == (archive->map = MapViewOfFile (archive->mapping, FILE_MAP_ALL_ACCESS, 0, 0, archive->map_len)))
+	{
+		const DWORD save_errno = GetLastError();
+		pgm_set_error (error,
+			       PGM_ERROR_DOMAIN_SOCKET,
+			       pgm_error_from_win_errno (save_errno),
+			       _("Mapping transmit window archive: %s"),
+			       pgm_win_strerror (winstr, sizeof (winstr), save_errno));
+		if (NULL != archive->mapping)
+			CloseHandle (archive->mapping);
+		goto err_close;
+	}
+#endif
+
+	pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Archiving %" PRIu32 " packets in %" PRIzu " bytes under %s."),
+		   archive->slot_nr, archive->map_len, path);
+	return archive;
+
+err_close:
+#ifndef _WIN32
+	close (archive->fd);
+#else
+	CloseHandle (archive->file);
+#endif
+	pgm_free (archive);
+	return NULL;
+}
+
+PGM_GNUC_INTERNAL
+void
+pgm_txw_archive_destroy (
+	pgm_txw_archive_t* const	archive
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != archive);
+
+#ifndef _WIN32
+	munmap (archive->map, archive->map_len);
+	close (archive->fd);
+#else
+	UnmapViewOfFile (archive->map);
+	CloseHandle (archive->mapping);
+	CloseHandle (archive->file);
+#endif
+	pgm_free (archive);
+}
+
+/* copy a packet leaving the in-memory window into its slot, replacing the
+ * packet one archive length older.  headers are taken from skb::head, the
+ * payload from skb::data so retained application memory is copied too.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_txw_archive_write (
+	pgm_txw_archive_t*	    const restrict archive,
+	const struct pgm_sk_buff_t* const restrict skb,
+	const uint32_t			       unfolded_checksum
+	)
+{
+	struct pgm_txw_archive_slot_t* slot;
+	size_t header_length;
+
+/* pre-conditions */
+	pgm_assert (NULL != archive);
+	pgm_assert (NULL != skb);
+
+	header_length = skb->is_retained ? (size_t)((char*)skb->end - (char*)skb->head)
+					 : (size_t)((char*)skb->data - (char*)skb->head);
+	pgm_assert_cmpuint (header_length + skb->len, <=, archive->max_tpdu);
+
+	slot = _pgm_txw_archive_slot (archive, skb->sequence);
+	pgm_atomic_inc32 (&slot->version);
+	slot->sequence		= skb->sequence;
+	slot->unfolded_checksum	= unfolded_checksum;
+	slot->header_length	= (uint16_t)header_length;
+	slot->tsdu_length	= skb->len;
+	slot->sock		= skb->sock;
+	slot->tstamp		= skb->tstamp;
+	memcpy (slot + 1, skb->head, header_length);
+	memcpy ((char*)(slot + 1) + header_length, skb->data, skb->len);
+	pgm_atomic_inc32 (&slot->version);
+}
+
+/* rebuild a packet from the archive into a new skb owned by the caller,
+ * the writer may overwrite the slot concurrently when the archive wraps.
+ *
+ * returns pointer to skb on success, returns NULL if sequence is no longer held.
+ */
+
+PGM_GNUC_INTERNAL
+struct pgm_sk_buff_t*
+pgm_txw_archive_read (
+	pgm_txw_archive_t* const restrict archive,
+	const uint32_t			  sequence,
+	uint32_t*	   restrict	  unfolded_checksum
+	)
+{
+	const struct pgm_txw_archive_slot_t* slot;
+	struct pgm_sk_buff_t* skb;
+	uint32_t version;
+
+/* pre-conditions */
+	pgm_assert (NULL != archive);
+	pgm_assert (NULL != unfolded_checksum);
+
+	slot = _pgm_txw_archive_slot (archive, sequence);
+	version = pgm_atomic_read32 (&slot->version);
+	if (PGM_UNLIKELY((version & 1) || slot->sequence != sequence))
+		return NULL;
+
+	const uint16_t header_length = slot->header_length;
+	const uint16_t tsdu_length = slot->tsdu_length;
+	if (PGM_UNLIKELY(header_length < (sizeof(struct pgm_header) + sizeof(struct pgm_data)) ||
+			 header_length + tsdu_length > archive->max_tpdu))
+		return NULL;
+
+	skb = pgm_alloc_skb (archive->max_tpdu);
+	pgm_skb_put (skb, header_length + tsdu_length);
+	memcpy (skb->head, slot + 1, header_length + tsdu_length);
+	skb->sock	= slot->sock;
+	skb->tstamp	= slot->tstamp;
+	*unfolded_checksum = slot->unfolded_checksum;
+
+/* discard if overwritten whilst copying */
+	if (PGM_UNLIKELY(version != pgm_atomic_read32 (&slot->version))) {
+		pgm_free_skb (skb);
+		return NULL;
+	}
+
+	skb->sequence	= sequence;
+	skb->pgm_header	= skb->head;
+	skb->pgm_data	= (void*)( skb->pgm_header + 1 );
+	pgm_skb_pull (skb, header_length);
+	return skb;
+}
+
+/* start reading count slots from sequence into the page cache without
+ * waiting, a repair run continuing into these sequences will not block on
+ * the disk.  Windows has no portable asynchronous read-ahead of a view.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_txw_archive_prefetch (
+	pgm_txw_archive_t* const	archive,
+	const uint32_t			sequence,
+	const uint32_t			count
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != archive);
+
+#ifndef _WIN32
+	const long page_size = sysconf (_SC_PAGESIZE);
+	const uint_fast32_t first = sequence & (archive->slot_nr - 1);
+	const uint_fast32_t n = MIN( count, archive->slot_nr - first );	/* stop at the wrap */
+	const uintptr_t begin = (uintptr_t)(archive->map + (first * archive->slot_size)) & ~(uintptr_t)(page_size - 1);
+	const uintptr_t end = (uintptr_t)(archive->map + ((first + n) * archive->slot_size));
+	if (0 != madvise ((void*)begin, end - begin, MADV_WILLNEED))
+		pgm_trace (PGM_LOG_ROLE_TX_WINDOW,_("Archive read-ahead failed: %s"), strerror (errno));
+#else
+	(void)sequence;
+	(void)count;
+#endif
+}
+
+/* eof */
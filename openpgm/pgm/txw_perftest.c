@@ -0,0 +1,244 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * performance tests for transmit window
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+
+#define pgm_histogram_add		mock_pgm_histogram_add
+#define pgm_histogram_init		mock_pgm_histogram_init
+#define pgm_compat_csum_partial		mock_pgm_compat_csum_partial
+
+#define TXW_DEBUG
+#include "txw.c"
+
+
+/* mock state */
+
+#define PERF_PACKETS		16384
+#define PERF_ROUNDS		8
+#define PERF_TXW_SQNS		2048
+
+static unsigned perf_lag = 0;
+static struct pgm_sk_buff_t* perf_skb[ PERF_PACKETS ];
+
+size_t
+pgm_pkt_offset (
+        const bool                      can_fragment,
+        const sa_family_t		pgmcc_family	/* 0 = disable */
+        )
+{
+        return 0;
+}
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+void
+mock_pgm_histogram_init (
+	pgm_histogram_t*	histogram
+	)
+{
+}
+
+void
+mock_pgm_histogram_add (
+	pgm_histogram_t*	histogram,
+	int			value
+	)
+{
+}
+
+uint32_t
+mock_pgm_compat_csum_partial (
+	const void*		addr,
+	uint16_t		len,
+	uint32_t		csum
+	)
+{
+	return 0x0;
+}
+
+/* ODATA skb as built by the send path, sequence is assigned by the window.
+ */
+
+static
+struct pgm_sk_buff_t*
+generate_odata_skb (void)
+{
+	const uint16_t tsdu_length = 1000;
+	const uint16_t header_length = sizeof(struct pgm_header) + sizeof(struct pgm_data);
+	struct pgm_sk_buff_t* skb = pgm_alloc_skb (1500);
+	skb->sock = (pgm_sock_t*)0x1;
+	skb->tstamp = 1;
+	pgm_skb_reserve (skb, header_length);
+	memset (skb->head, 0, header_length);
+	skb->pgm_header = (struct pgm_header*)skb->head;
+	skb->pgm_data   = (struct pgm_data*)(skb->pgm_header + 1);
+	skb->pgm_header->pgm_type = PGM_ODATA;
+	skb->pgm_header->pgm_tsdu_length = g_htons (tsdu_length);
+	pgm_skb_put (skb, tsdu_length);
+	return skb;
+}
+
+static
+void
+mock_setup (void)
+{
+	g_assert (pgm_time_init (NULL, NULL));
+}
+
+static
+void
+mock_teardown (void)
+{
+	g_assert (pgm_time_shutdown ());
+}
+
+static
+void
+mock_setup_1 (void)
+{
+	perf_lag = 1;
+}
+
+static
+void
+mock_setup_64 (void)
+{
+	perf_lag = 64;
+}
+
+static
+void
+mock_setup_1024 (void)
+{
+	perf_lag = 1024;
+}
+
+/* target:
+ *	void
+ *	pgm_txw_add (
+ *		pgm_txw_t* const		window,
+ *		struct pgm_sk_buff_t* const	skb
+ *	)
+ *
+ *	struct pgm_sk_buff_t*
+ *	pgm_txw_peek (
+ *		const pgm_txw_t* const	window,
+ *		const uint32_t		sequence
+ *	)
+ */
+
+/* each add is followed by a peek lagging the lead as a repair would, the
+ * full window releases its trailing buffer on every add.  Buffers are
+ * allocated outside the timed region.
+ */
+
+START_TEST (test_add_peek)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_time_t elapsed = 0;
+
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, PERF_TXW_SQNS, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+
+	for (unsigned round = 0; round < PERF_ROUNDS; round++)
+	{
+		for (unsigned i = 0; i < PERF_PACKETS; i++)
+			perf_skb[i] = generate_odata_skb ();
+
+		const pgm_time_t start = pgm_time_update_now();
+		for (unsigned i = 0; i < PERF_PACKETS; i++)
+		{
+			pgm_txw_add (window, perf_skb[i]);
+			const uint32_t lead = pgm_txw_lead (window);
+			if (pgm_txw_length (window) > perf_lag)
+				fail_if (NULL == pgm_txw_peek (window, lead - perf_lag), "peek failed");
+		}
+		elapsed += pgm_time_update_now() - start;
+	}
+	g_message ("add-peek/%u: elapsed time %" PGM_TIME_FORMAT " us, unit time %" PGM_TIME_FORMAT " ns/pkt",
+		perf_lag,
+		(guint64)elapsed,
+		(guint64)(elapsed * 1000 / (PERF_ROUNDS * PERF_PACKETS)));
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+static
+Suite*
+make_add_peek_performance_suite (void)
+{
+	Suite* s;
+
+	s = suite_create ("Transmit window add and peek performance");
+
+	TCase* tc_1 = tcase_create ("1");
+	suite_add_tcase (s, tc_1);
+	tcase_add_checked_fixture (tc_1, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_1, mock_setup_1, NULL);
+	tcase_add_test (tc_1, test_add_peek);
+
+	TCase* tc_64 = tcase_create ("64");
+	suite_add_tcase (s, tc_64);
+	tcase_add_checked_fixture (tc_64, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_64, mock_setup_64, NULL);
+	tcase_add_test (tc_64, test_add_peek);
+
+	TCase* tc_1024 = tcase_create ("1024");
+	suite_add_tcase (s, tc_1024);
+	tcase_add_checked_fixture (tc_1024, mock_setup, mock_teardown);
+	tcase_add_checked_fixture (tc_1024, mock_setup_1024, NULL);
+	tcase_add_test (tc_1024, test_add_peek);
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_add_peek_performance_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
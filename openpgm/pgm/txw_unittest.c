@@ -536,7 +536,8 @@ END_TEST
  *		pgm_txw_t* const	window,
  *		const uint32_t		sequence,
  *		const bool		is_parity,
- *		const uint8_t		tg_sqn_shift
+ *		const uint8_t		tg_sqn_shift,
+ *		const struct sockaddr*	requester
  *		)
  */
 
@@ -546,21 +547,50 @@ START_TEST (test_retransmit_push_pass_001)
 	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 100, 0, 0, FALSE, 0, 0);
 	fail_if (NULL == window, "create failed");
 /* empty window invalidates all requests */
-	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, NULL), "retransmit_push failed");
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
 /* first request */
-	fail_unless (TRUE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, NULL), "retransmit_push failed");
 /* second request eliminated */
-	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, NULL), "retransmit_push failed");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* a second requester widens the repair to all fan-out receivers, including
+ * another receiver on the same host.
+ */
+START_TEST (test_retransmit_push_pass_002)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	struct sockaddr_in a = {
+		.sin_family		= AF_INET,
+		.sin_port		= htons (7500),
+		.sin_addr.s_addr	= inet_addr ("172.12.90.1")
+	}, b = a;
+	b.sin_port = htons (7501);
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 100, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	struct pgm_sk_buff_t* skb = generate_valid_skb ();
+	fail_if (NULL == skb, "generate_valid_skb failed");
+	pgm_txw_add (window, skb);
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, (struct sockaddr*)&a), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, (struct sockaddr*)&a), "retransmit_push failed");
+	const struct sockaddr* requester = pgm_txw_get_requester (skb);
+	fail_if (NULL == requester, "requester");
+	fail_unless (0 == pgm_sockaddr_cmp (requester, (struct sockaddr*)&a), "requester address");
+	fail_unless (htons (7500) == pgm_sockaddr_port (requester), "requester port");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, (struct sockaddr*)&b), "retransmit_push failed");
+	fail_unless (NULL == pgm_txw_get_requester (skb), "requester");
 	pgm_txw_shutdown (window);
 }
 END_TEST
 
 START_TEST (test_retransmit_push_fail_001)
 {
-	const bool answer = pgm_txw_retransmit_push (NULL, 0, FALSE, 0);
+	const bool answer = pgm_txw_retransmit_push (NULL, 0, FALSE, 0, NULL);
 	fail ("reached");
 }
 END_TEST
@@ -580,7 +610,7 @@ START_TEST (test_retransmit_try_peek_pass_001)
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
-	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, NULL), "retransmit_push failed");
 	fail_unless (NULL != pgm_txw_retransmit_try_peek (window), "retransmit_try_peek failed");
 	pgm_txw_shutdown (window);
 }
@@ -609,7 +639,7 @@ START_TEST (test_retransmit_remove_head_pass_001)
 	struct pgm_sk_buff_t* skb = generate_valid_skb ();
 	fail_if (NULL == skb, "generate_valid_skb failed");
 	pgm_txw_add (window, skb);
-	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0), "retransmit_push failed");
+	fail_unless (1 == pgm_txw_retransmit_push (window, window->trail, FALSE, 0, NULL), "retransmit_push failed");
 	fail_unless (NULL != pgm_txw_retransmit_try_peek (window), "retransmit_try_peek failed");
 	pgm_txw_retransmit_remove_head (window);
 	pgm_txw_shutdown (window);
@@ -635,6 +665,112 @@ START_TEST (test_retransmit_remove_head_fail_002)
 }
 END_TEST
 
+/* target:
+ *	void
+ *	pgm_txw_set_archive (
+ *		pgm_txw_t* const		window,
+ *		pgm_txw_archive_t* const	archive
+ *		)
+ */
+
+/* packets beyond the window repaired from the archive */
+START_TEST (test_set_archive_pass_001)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	pgm_txw_archive_t* archive = pgm_txw_archive_create (g_get_tmp_dir(), 8, 1500, NULL);
+	fail_if (NULL == archive, "archive_create failed");
+	pgm_txw_set_archive (window, archive);
+	for (unsigned i = 0; i < 6; i++) {
+		struct pgm_sk_buff_t* skb = generate_valid_skb ();
+		memset (skb->data, i, skb->len);
+		pgm_txw_set_unfolded_checksum (skb, 0x1000 + i);
+		pgm_txw_add (window, skb);
+	}
+/* two spilled, horizon includes them */
+	fail_unless (2 == window->trail, "trail");
+	fail_unless (0 == pgm_txw_trail (window), "trail");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, 1, FALSE, 0, NULL), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, 1, FALSE, 0, NULL), "retransmit_push not eliminated");
+	struct pgm_sk_buff_t* skb = pgm_txw_retransmit_try_peek (window);
+	fail_unless (NULL != skb, "retransmit_try_peek failed");
+	fail_unless (1 == skb->sequence, "sequence");
+	fail_unless (1000 == skb->len, "len");
+	fail_unless (1 == ((const guint8*)skb->data)[999], "payload");
+	fail_unless (0x1001 == pgm_txw_get_unfolded_checksum (skb), "checksum");
+	fail_unless (g_htons (1000) == skb->pgm_header->pgm_tsdu_length, "header");
+	pgm_txw_retransmit_remove_head (window);
+	fail_unless (pgm_txw_retransmit_is_empty (window), "retransmit queue not empty");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* archive wraps, oldest sequences no longer repairable */
+START_TEST (test_set_archive_pass_002)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	pgm_txw_archive_t* archive = pgm_txw_archive_create (g_get_tmp_dir(), 2, 1500, NULL);
+	fail_if (NULL == archive, "archive_create failed");
+	pgm_txw_set_archive (window, archive);
+	for (unsigned i = 0; i < 10; i++)
+		pgm_txw_add (window, generate_valid_skb ());
+	fail_unless (6 == window->trail, "trail");
+	fail_unless (4 == pgm_txw_trail (window), "trail");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, 3, FALSE, 0, NULL), "retransmit_push beyond archive");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, 4, FALSE, 0, NULL), "retransmit_push failed");
+/* pending archived repair released on shutdown */
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+/* archive rounded to a power of two stays consistent across sequence wrap,
+ * a repair dequeued may be requested again.
+ */
+START_TEST (test_set_archive_pass_003)
+{
+	const pgm_tsi_t tsi = { { 1, 2, 3, 4, 5, 6 }, 1000 };
+	pgm_txw_t* window = pgm_txw_create (&tsi, 0, 4, 0, 0, FALSE, 0, 0);
+	fail_if (NULL == window, "create failed");
+	window->lead  = -4;
+	window->trail = -3;
+	pgm_txw_archive_t* archive = pgm_txw_archive_create (g_get_tmp_dir(), 3, 1500, NULL);
+	fail_if (NULL == archive, "archive_create failed");
+	fail_unless (4 == pgm_txw_archive_max_length (archive), "archive length");
+	pgm_txw_set_archive (window, archive);
+	for (unsigned i = 0; i < 10; i++) {
+		struct pgm_sk_buff_t* skb = generate_valid_skb ();
+		memset (skb->data, i, skb->len);
+		pgm_txw_add (window, skb);
+	}
+	fail_unless (3 == window->trail, "trail");
+	fail_unless ((uint32_t)-1 == pgm_txw_trail (window), "trail");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, -1, FALSE, 0, NULL), "retransmit_push failed");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, 0, FALSE, 0, NULL), "retransmit_push failed");
+	fail_unless (FALSE == pgm_txw_retransmit_push (window, -1, FALSE, 0, NULL), "retransmit_push not eliminated");
+	struct pgm_sk_buff_t* skb = pgm_txw_retransmit_try_peek (window);
+	fail_unless (NULL != skb, "retransmit_try_peek failed");
+	fail_unless ((uint32_t)-1 == skb->sequence, "sequence");
+	fail_unless (2 == ((const guint8*)skb->data)[999], "payload");
+	pgm_txw_retransmit_remove_head (window);
+	skb = pgm_txw_retransmit_try_peek (window);
+	fail_unless (NULL != skb, "retransmit_try_peek failed");
+	fail_unless (0 == skb->sequence, "sequence");
+	fail_unless (3 == ((const guint8*)skb->data)[999], "payload");
+	fail_unless (TRUE == pgm_txw_retransmit_push (window, -1, FALSE, 0, NULL), "retransmit_push after dequeue failed");
+	pgm_txw_shutdown (window);
+}
+END_TEST
+
+START_TEST (test_set_archive_fail_001)
+{
+	pgm_txw_set_archive (NULL, NULL);
+	fail ("reached");
+}
+END_TEST
+
 static
 Suite*
 make_test_suite (void)
@@ -739,6 +875,7 @@ make_test_suite (void)
 	TCase* tc_retransmit_push = tcase_create ("retransmit-push");
 	suite_add_tcase (s, tc_retransmit_push);
 	tcase_add_test (tc_retransmit_push, test_retransmit_push_pass_001);
+	tcase_add_test (tc_retransmit_push, test_retransmit_push_pass_002);
 #ifndef PGM_CHECK_NOFORK
 	tcase_add_test_raise_signal (tc_retransmit_push, test_retransmit_push_fail_001, SIGABRT);
 #endif
@@ -758,6 +895,15 @@ make_test_suite (void)
 	tcase_add_test_raise_signal (tc_retransmit_remove_head, test_retransmit_remove_head_fail_002, SIGABRT);
 #endif
 
+	TCase* tc_set_archive = tcase_create ("set-archive");
+	suite_add_tcase (s, tc_set_archive);
+	tcase_add_test (tc_set_archive, test_set_archive_pass_001);
+	tcase_add_test (tc_set_archive, test_set_archive_pass_002);
+	tcase_add_test (tc_set_archive, test_set_archive_pass_003);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_set_archive, test_set_archive_fail_001, SIGABRT);
+#endif
+
 	return s;
 }
 
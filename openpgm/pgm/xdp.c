@@ -0,0 +1,757 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * AF_XDP datapath for UDP encapsulated PGM, a bundled XDP program redirects
+ * the session ports to an XSK socket whose UMEM frames are parsed directly,
+ * ODATA and RDATA are transmitted through the XSK transmit ring.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#	include <unistd.h>
+#	include <net/if.h>
+#	include <sys/ioctl.h>
+#	include <sys/mman.h>
+#	include <sys/socket.h>
+#	include <sys/syscall.h>
+#	if defined( __linux__ ) && defined( __has_include )
+#		if __has_include( <linux/if_xdp.h> )
+#			include <linux/bpf.h>
+#			include <linux/filter.h>
+#			include <linux/if_ether.h>
+#			include <linux/if_link.h>
+#			include <linux/if_xdp.h>
+#		endif
+#	endif
+#endif
+#include <impl/i18n.h>
+#include <impl/framework.h>
+#include <impl/socket.h>
+
+
+//#define XDP_DEBUG
+
+#if defined( XDP_USE_NEED_WAKEUP ) && defined( __NR_bpf )
+#	define USE_XDP
+#endif
+
+#ifdef USE_XDP
+/* Ethernet, IPv4 without options, UDP */
+#define PGM_XDP_HDR_LEN		(ETH_HLEN + sizeof(struct pgm_ip) + sizeof(struct pgm_udphdr))
+
+#define PGM_BPF_INSN(c,d,s,o,i)	((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+
+static
+int
+pgm_bpf (
+	const int		cmd,
+	union bpf_attr*		attr
+	)
+{
+	return (int)syscall (__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/* XSKMAP keyed by receive queue so that only the bound queue is redirected.
+ */
+
+static
+int
+_pgm_xdp_map_create (
+	const uint32_t		queue_id
+	)
+{
+	union bpf_attr attr;
+	memset (&attr, 0, sizeof(attr));
+	attr.map_type		= BPF_MAP_TYPE_XSKMAP;
+	attr.key_size		= sizeof(uint32_t);
+	attr.value_size		= sizeof(uint32_t);
+	attr.max_entries	= queue_id + 1;
+	return pgm_bpf (BPF_MAP_CREATE, &attr);
+}
+
+static
+int
+_pgm_xdp_map_update (
+	const int		map_fd,
+	const uint32_t		queue_id,
+	const int		xsk_fd
+	)
+{
+	union bpf_attr attr;
+	const uint32_t value = (uint32_t)xsk_fd;
+	memset (&attr, 0, sizeof(attr));
+	attr.map_fd		= (uint32_t)map_fd;
+	attr.key		= (uint64_t)(uintptr_t)&queue_id;
+	attr.value		= (uint64_t)(uintptr_t)&value;
+	attr.flags		= BPF_ANY;
+	return pgm_bpf (BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+/* redirect unfragmented IPv4 UDP to either encapsulation port, everything
+ * else and frames on other queues pass to the stack.
+ *
+ *	r6 = ctx
+ *	r2 = ctx->data, r3 = ctx->data_end
+ *	if data + eth + ip + udp > data_end goto pass
+ *	if eth.h_proto != ETH_P_IP goto pass
+ *	if ip.ver_ihl != 0x45 goto pass
+ *	if ip.protocol != UDP goto pass
+ *	if ip.frag_off & (MF|offset) goto pass
+ *	if udp.dest == mcast_port goto redirect
+ *	if udp.dest != ucast_port goto pass
+ * redirect:
+ *	return bpf_redirect_map (xskmap, ctx->rx_queue_index, XDP_PASS)
+ * pass:
+ *	return XDP_PASS
+ */
+
+#define PGM_XDP_PROG_REDIRECT	18
+#define PGM_XDP_PROG_PASS	24
+#define PGM_XDP_JUMP(pc,target)	((int16_t)((target) - (pc) - 1))
+
+static
+int
+_pgm_xdp_prog_load (
+	const pgm_sock_t* const	sock,
+	const int		map_fd
+	)
+{
+	const struct bpf_insn prog[] = {
+/*  0 */	PGM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+/*  1 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data), 0),
+/*  2 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end), 0),
+/*  3 */	PGM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+/*  4 */	PGM_BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, PGM_XDP_HDR_LEN),
+/*  5 */	PGM_BPF_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, PGM_XDP_JUMP(5, PGM_XDP_PROG_PASS), 0),
+/*  6 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0),
+/*  7 */	PGM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(7, PGM_XDP_PROG_PASS), htons (ETH_P_IP)),
+/*  8 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, ETH_HLEN, 0),
+/*  9 */	PGM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(9, PGM_XDP_PROG_PASS), 0x45),
+/* 10 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, ETH_HLEN + offsetof(struct pgm_ip, ip_p), 0),
+/* 11 */	PGM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(11, PGM_XDP_PROG_PASS), IPPROTO_UDP),
+/* 12 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, ETH_HLEN + offsetof(struct pgm_ip, ip_off), 0),
+/* 13 */	PGM_BPF_INSN(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, htons (0x3fff)),
+/* 14 */	PGM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(14, PGM_XDP_PROG_PASS), 0),
+/* 15 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, ETH_HLEN + sizeof(struct pgm_ip) + offsetof(struct pgm_udphdr, uh_dport), 0),
+/* 16 */	PGM_BPF_INSN(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(16, PGM_XDP_PROG_REDIRECT), htons (sock->udp_encap_mcast_port)),
+/* 17 */	PGM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, PGM_XDP_JUMP(17, PGM_XDP_PROG_PASS), htons (sock->udp_encap_ucast_port)),
+/* 18 */	PGM_BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0),
+/* 19 */	PGM_BPF_INSN(BPF_LD | BPF_IMM | BPF_DW, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd),
+/* 20 */	PGM_BPF_INSN(0, 0, 0, 0, 0),
+/* 21 */	PGM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+/* 22 */	PGM_BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+/* 23 */	PGM_BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+/* 24 */	PGM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+/* 25 */	PGM_BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+	};
+	static const char license[] = "LGPL";
+	char log[ 4096 ];
+	union bpf_attr attr;
+	int prog_fd;
+
+	memset (&attr, 0, sizeof(attr));
+	attr.prog_type		= BPF_PROG_TYPE_XDP;
+	attr.insn_cnt		= PGM_N_ELEMENTS(prog);
+	attr.insns		= (uint64_t)(uintptr_t)prog;
+	attr.license		= (uint64_t)(uintptr_t)license;
+	prog_fd = pgm_bpf (BPF_PROG_LOAD, &attr);
+	if (prog_fd < 0 && EACCES == errno) {
+/* repeat with verifier log for diagnosis */
+		log[0] = '\0';
+		attr.log_level	= 1;
+		attr.log_buf	= (uint64_t)(uintptr_t)log;
+		attr.log_size	= sizeof(log);
+		prog_fd = pgm_bpf (BPF_PROG_LOAD, &attr);
+		if (prog_fd < 0)
+			pgm_warn (_("XDP program rejected by verifier: %s"), log);
+	}
+	return prog_fd;
+}
+
+static
+int
+_pgm_xdp_link_create (
+	const int		prog_fd,
+	const unsigned		ifindex,
+	const uint32_t		flags
+	)
+{
+	union bpf_attr attr;
+	memset (&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd	= (uint32_t)prog_fd;
+	attr.link_create.target_ifindex	= ifindex;
+	attr.link_create.attach_type	= BPF_XDP;
+	attr.link_create.flags		= (flags & PGM_XDP_SKB_MODE) ? XDP_FLAGS_SKB_MODE : 0;
+	return pgm_bpf (BPF_LINK_CREATE, &attr);
+}
+
+static
+bool
+_pgm_xdp_ring_map (
+	struct pgm_xdp_ring_t* const restrict	ring,
+	const int				fd,
+	const struct xdp_ring_offset* const restrict off,
+	const uint32_t				nr,
+	const size_t				desc_size,
+	const off_t				pgoff
+	)
+{
+	ring->map_len	= off->desc + nr * desc_size;
+	ring->map	= mmap (NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+	if (MAP_FAILED == ring->map) {
+		ring->map = NULL;
+		return FALSE;
+	}
+	ring->producer	= (uint32_t*)((char*)ring->map + off->producer);
+	ring->consumer	= (uint32_t*)((char*)ring->map + off->consumer);
+	ring->flags	= (uint32_t*)((char*)ring->map + off->flags);
+	ring->desc	= (char*)ring->map + off->desc;
+	ring->mask	= nr - 1;
+	return TRUE;
+}
+
+static
+void
+_pgm_xdp_ring_unmap (
+	struct pgm_xdp_ring_t* const	ring
+	)
+{
+	if (NULL != ring->map) {
+		munmap (ring->map, ring->map_len);
+		ring->map = NULL;
+	}
+}
+
+/* interface carrying the bound send address when no index was requested.
+ */
+
+static
+unsigned
+_pgm_xdp_ifindex_of_addr (
+	const struct sockaddr_in* const	addr
+	)
+{
+	struct pgm_ifaddrs_t *ifap, *ifa;
+	unsigned ifindex = 0;
+
+	if (!pgm_getifaddrs (&ifap, NULL))
+		return 0;
+	for (ifa = ifap; ifa; ifa = ifa->ifa_next)
+	{
+		if (NULL == ifa->ifa_addr ||
+		    AF_INET != ifa->ifa_addr->sa_family ||
+		    ((const struct sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr != addr->sin_addr.s_addr)
+			continue;
+		ifindex = if_nametoindex (ifa->ifa_name);
+		break;
+	}
+	pgm_freeifaddrs (ifap);
+	return ifindex;
+}
+
+/* return a receive frame to the kernel.
+ */
+
+static inline
+void
+_pgm_xdp_fill (
+	pgm_sock_t* const	sock,
+	const uint64_t		addr
+	)
+{
+	pgm_xdp_t* xdp = sock->xdp;
+	const uint32_t prod = *xdp->fill.producer;
+	((uint64_t*)xdp->fill.desc)[ prod & xdp->fill.mask ] = addr & ~(uint64_t)(PGM_XDP_FRAME_SIZE - 1);
+	__sync_synchronize();
+	*(volatile uint32_t*)xdp->fill.producer = prod + 1;
+	if (PGM_UNLIKELY(*(volatile uint32_t*)xdp->fill.flags & XDP_RING_NEED_WAKEUP))
+		recvfrom (sock->recv_sock, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
+
+/* recycle completed transmit frames.
+ */
+
+static inline
+void
+_pgm_xdp_complete (
+	pgm_xdp_t* const	xdp
+	)
+{
+	const uint32_t prod = *(volatile uint32_t*)xdp->comp.producer;
+	uint32_t cons = *xdp->comp.consumer;
+	if (cons == prod)
+		return;
+	__sync_synchronize();
+	while (cons != prod)
+		xdp->tx_free[ xdp->tx_free_len++ ] = ((const uint64_t*)xdp->comp.desc)[ cons++ & xdp->comp.mask ];
+	__sync_synchronize();
+	*(volatile uint32_t*)xdp->comp.consumer = cons;
+}
+#endif /* USE_XDP */
+
+/* attach an XSK socket and redirect program to the interface, the half of
+ * the UMEM posted to the fill ring receives and the other half transmits.
+ * the UDP socket is retained for multicast membership and as a second
+ * receive path: frames arriving on queues other than the bound one pass to
+ * the stack and are read from it, sock::recv_sock
+ * becomes the XSK socket.
+ *
+ * returns TRUE on success, FALSE if unsupported or on failure.
+ */
+
+PGM_GNUC_INTERNAL
+bool
+pgm_xdp_create (
+	pgm_sock_t*		    const restrict sock,
+	const struct pgm_xdpinfo_t* const restrict info
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != info);
+	pgm_assert (NULL == sock->xdp);
+
+#ifdef USE_XDP
+	pgm_xdp_t* xdp;
+	struct xdp_umem_reg mr;
+	struct xdp_mmap_offsets off;
+	struct sockaddr_xdp sxdp;
+	struct ifreq ifr;
+	socklen_t optlen = sizeof(off);
+	char errbuf[1024];
+	SOCKET fd;
+
+	unsigned ifindex	= info->xi_ifindex ? info->xi_ifindex : sock->send_gsr.gsr_interface;
+	const uint32_t frame_nr	= info->xi_frame_nr ? info->xi_frame_nr : PGM_XDP_FRAME_NR;
+	const uint32_t ring_nr	= frame_nr / 2;
+
+	if (0 == sock->udp_encap_ucast_port || AF_INET != sock->family) {
+		pgm_warn (_("AF_XDP requires UDP encapsulated IPv4 sockets."));
+		return FALSE;
+	}
+	if (0 == ifindex)
+		ifindex = _pgm_xdp_ifindex_of_addr ((const struct sockaddr_in*)&sock->send_addr);
+	if (0 == ifindex || NULL == if_indextoname (ifindex, ifr.ifr_name)) {
+		pgm_warn (_("AF_XDP requires a bound interface."));
+		return FALSE;
+	}
+	if (frame_nr < 2 || 0 != (frame_nr & (frame_nr - 1))) {
+		pgm_warn (_("AF_XDP frame count %u is not a power of two."), frame_nr);
+		return FALSE;
+	}
+	if (PGM_XDP_HDR_LEN + sock->max_tpdu + XDP_PACKET_HEADROOM > PGM_XDP_FRAME_SIZE) {
+		pgm_warn (_("Maximum TPDU %u exceeds AF_XDP frame size."), (unsigned)sock->max_tpdu);
+		return FALSE;
+	}
+
+	if (INVALID_SOCKET == (fd = socket (AF_XDP, SOCK_RAW, 0))) {
+		pgm_warn (_("Creating AF_XDP socket failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		return FALSE;
+	}
+
+	xdp = pgm_new0 (pgm_xdp_t, 1);
+	xdp->map_fd = xdp->prog_fd = xdp->link_fd = -1;
+	xdp->use_tx = !(info->xi_flags & PGM_XDP_RECV_ONLY);
+	xdp->umem_len = (size_t)frame_nr * PGM_XDP_FRAME_SIZE;
+	xdp->umem = mmap (NULL, xdp->umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (MAP_FAILED == xdp->umem) {
+		pgm_warn (_("Allocating AF_XDP UMEM failed: %s"), strerror (errno));
+		xdp->umem = NULL;
+		goto err_destroy;
+	}
+
+	memset (&mr, 0, sizeof(mr));
+	mr.addr		= (uint64_t)(uintptr_t)xdp->umem;
+	mr.len		= xdp->umem_len;
+	mr.chunk_size	= PGM_XDP_FRAME_SIZE;
+	if (SOCKET_ERROR == setsockopt (fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr)) ||
+	    SOCKET_ERROR == setsockopt (fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_nr, sizeof(ring_nr)) ||
+	    SOCKET_ERROR == setsockopt (fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_nr, sizeof(ring_nr)) ||
+	    SOCKET_ERROR == setsockopt (fd, SOL_XDP, XDP_RX_RING, &ring_nr, sizeof(ring_nr)) ||
+	    SOCKET_ERROR == setsockopt (fd, SOL_XDP, XDP_TX_RING, &ring_nr, sizeof(ring_nr)) ||
+	    SOCKET_ERROR == getsockopt (fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen))
+	{
+		pgm_warn (_("Configuring AF_XDP rings failed: %s"),
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		goto err_destroy;
+	}
+	if (!_pgm_xdp_ring_map (&xdp->fill, fd, &off.fr, ring_nr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) ||
+	    !_pgm_xdp_ring_map (&xdp->comp, fd, &off.cr, ring_nr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) ||
+	    !_pgm_xdp_ring_map (&xdp->rx,   fd, &off.rx, ring_nr, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+	    !_pgm_xdp_ring_map (&xdp->tx,   fd, &off.tx, ring_nr, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING))
+	{
+		pgm_warn (_("Mapping AF_XDP rings failed: %s"), strerror (errno));
+		goto err_destroy;
+	}
+
+/* first half of the UMEM receives, second half transmits */
+	for (uint32_t i = 0; i < ring_nr; i++)
+		((uint64_t*)xdp->fill.desc)[ i ] = (uint64_t)i * PGM_XDP_FRAME_SIZE;
+	*xdp->fill.producer = ring_nr;
+	xdp->tx_free = pgm_new (uint64_t, ring_nr);
+	for (uint32_t i = 0; i < ring_nr; i++)
+		xdp->tx_free[ xdp->tx_free_len++ ] = (uint64_t)(ring_nr + i) * PGM_XDP_FRAME_SIZE;
+
+	memset (&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family	= AF_XDP;
+	sxdp.sxdp_ifindex	= ifindex;
+	sxdp.sxdp_queue_id	= info->xi_queue_id;
+	sxdp.sxdp_flags		= XDP_USE_NEED_WAKEUP;
+	if (info->xi_flags & PGM_XDP_ZEROCOPY)
+		sxdp.sxdp_flags |= XDP_ZEROCOPY;
+	else if (info->xi_flags & PGM_XDP_SKB_MODE)
+		sxdp.sxdp_flags |= XDP_COPY;
+	if (SOCKET_ERROR == bind (fd, (const struct sockaddr*)&sxdp, sizeof(sxdp))) {
+		pgm_warn (_("Binding AF_XDP socket to %s queue %u failed: %s"),
+			  ifr.ifr_name, info->xi_queue_id,
+			  pgm_sock_strerror_s (errbuf, sizeof (errbuf), pgm_get_last_sock_error()));
+		goto err_destroy;
+	}
+
+	if ((xdp->map_fd = _pgm_xdp_map_create (info->xi_queue_id)) < 0 ||
+	    _pgm_xdp_map_update (xdp->map_fd, info->xi_queue_id, fd) < 0 ||
+	    (xdp->prog_fd = _pgm_xdp_prog_load (sock, xdp->map_fd)) < 0)
+	{
+		pgm_warn (_("Loading XDP program failed: %s"), strerror (errno));
+		goto err_destroy;
+	}
+	if ((xdp->link_fd = _pgm_xdp_link_create (xdp->prog_fd, ifindex, info->xi_flags)) < 0) {
+		pgm_warn (_("Attaching XDP program to %s failed: %s"), ifr.ifr_name, strerror (errno));
+		goto err_destroy;
+	}
+
+/* source hardware address for transmit */
+	if (xdp->use_tx) {
+		if (SOCKET_ERROR == ioctl (sock->send_sock, SIOCGIFHWADDR, &ifr)) {
+			pgm_warn (_("Reading hardware address of %s failed, transmitting through socket."), ifr.ifr_name);
+			xdp->use_tx = FALSE;
+		} else
+			memcpy (xdp->src_mac, ifr.ifr_hwaddr.sa_data, sizeof(xdp->src_mac));
+	}
+
+/* swap so polling and PGM_RECV_SOCK follow the XSK socket */
+	xdp->ip_sock	= sock->recv_sock;
+	sock->recv_sock	= fd;
+	sock->xdp	= xdp;
+	pgm_sockaddr_nonblocking (fd, TRUE);
+
+	pgm_trace (PGM_LOG_ROLE_NETWORK,_("AF_XDP datapath on %s queue %u with %u frames%s."),
+		   ifr.ifr_name, info->xi_queue_id, frame_nr,
+		   !xdp->use_tx ? ", receive only" : sock->use_multicast_loop ? ", multicast loop through socket" : "");
+	return TRUE;
+
+err_destroy:
+	if (xdp->link_fd >= 0)
+		close (xdp->link_fd);
+	if (xdp->prog_fd >= 0)
+		close (xdp->prog_fd);
+	if (xdp->map_fd >= 0)
+		close (xdp->map_fd);
+	_pgm_xdp_ring_unmap (&xdp->fill);
+	_pgm_xdp_ring_unmap (&xdp->comp);
+	_pgm_xdp_ring_unmap (&xdp->rx);
+	_pgm_xdp_ring_unmap (&xdp->tx);
+	if (NULL != xdp->umem)
+		munmap (xdp->umem, xdp->umem_len);
+	pgm_free (xdp->tx_free);
+	pgm_free (xdp);
+	closesocket (fd);
+	return FALSE;
+#else
+	pgm_warn (_("AF_XDP not supported on this platform."));
+	return FALSE;
+#endif /* USE_XDP */
+}
+
+/* detach the program and release the UMEM and membership socket,
+ * sock::recv_sock is the XSK socket and closed with the other transport
+ * sockets.
+ */
+
+PGM_GNUC_INTERNAL
+void
+pgm_xdp_destroy (
+	pgm_sock_t* const	sock
+	)
+{
+	pgm_xdp_t* xdp;
+
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+
+	xdp = sock->xdp;
+	if (NULL == xdp)
+		return;
+	sock->xdp = NULL;
+#ifdef USE_XDP
+	close (xdp->link_fd);
+	close (xdp->prog_fd);
+	close (xdp->map_fd);
+	_pgm_xdp_ring_unmap (&xdp->fill);
+	_pgm_xdp_ring_unmap (&xdp->comp);
+	_pgm_xdp_ring_unmap (&xdp->rx);
+	_pgm_xdp_ring_unmap (&xdp->tx);
+	munmap (xdp->umem, xdp->umem_len);
+	pgm_free (xdp->tx_free);
+#endif
+	closesocket (xdp->ip_sock);
+	pgm_free (xdp);
+}
+
+/* next PGM packet from the receive ring.  ODATA and RDATA are copied into
+ * sock::rx_buffer as the receive window keeps them and the frame is refilled
+ * immediately, other packets are presented in place in the UMEM and the frame
+ * refilled on the following call.
+ *
+ * on success returns PGM packet length and sets skb, returns -1 with EAGAIN
+ * when the ring is empty.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_xdp_recv (
+	pgm_sock_t*	       const restrict sock,
+	struct pgm_sk_buff_t**	     restrict pskb,
+	struct sockaddr*	     restrict src_addr,
+	const socklen_t			      src_addrlen,
+	struct sockaddr*	     restrict dst_addr,
+	const socklen_t			      dst_addrlen
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->xdp);
+	pgm_assert (NULL != pskb);
+	pgm_assert (NULL != src_addr);
+	pgm_assert (src_addrlen >= sizeof(struct sockaddr_in));
+	pgm_assert (NULL != dst_addr);
+	pgm_assert (dst_addrlen >= sizeof(struct sockaddr_in));
+
+#ifdef USE_XDP
+	pgm_xdp_t* xdp = sock->xdp;
+
+	if (PGM_UNLIKELY(sock->is_destroyed))
+		return 0;
+
+	if (xdp->has_held) {
+		_pgm_xdp_fill (sock, xdp->held_addr);
+		xdp->has_held = FALSE;
+	}
+
+	for (;;)
+	{
+		const uint32_t cons = *xdp->rx.consumer;
+		if (cons == *(volatile uint32_t*)xdp->rx.producer) {
+			pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+			return SOCKET_ERROR;
+		}
+		__sync_synchronize();
+		const struct xdp_desc desc = ((const struct xdp_desc*)xdp->rx.desc)[ cons & xdp->rx.mask ];
+		__sync_synchronize();
+		*(volatile uint32_t*)xdp->rx.consumer = cons + 1;
+
+		char* frame = xdp->umem + desc.addr;
+		const struct pgm_ip* ip = (const struct pgm_ip*)(frame + ETH_HLEN);
+		const struct pgm_udphdr* udp = (const struct pgm_udphdr*)(ip + 1);
+		char* packet = (char*)(udp + 1);
+		const unsigned udp_len = ntohs (udp->uh_ulen);
+/* the program guarantees IPv4 UDP without options */
+		if (PGM_UNLIKELY(desc.len < PGM_XDP_HDR_LEN ||
+				 udp_len < sizeof(struct pgm_udphdr) ||
+				 ETH_HLEN + sizeof(struct pgm_ip) + udp_len > desc.len ||
+				 udp_len - sizeof(struct pgm_udphdr) > sock->max_tpdu))
+		{
+			_pgm_xdp_fill (sock, desc.addr);
+			continue;
+		}
+		const unsigned len = udp_len - sizeof(struct pgm_udphdr);
+
+		struct pgm_sk_buff_t* skb;
+		if (len >= sizeof(struct pgm_header) &&
+		    (PGM_ODATA == ((const struct pgm_header*)packet)->pgm_type ||
+		     PGM_RDATA == ((const struct pgm_header*)packet)->pgm_type))
+		{
+			skb = sock->rx_buffer;
+			memcpy (skb->head, packet, len);
+		}
+		else
+		{
+			skb = &xdp->skb;
+			skb->head = packet;
+			skb->end  = packet + len;
+			xdp->held_addr = desc.addr;
+			xdp->has_held  = TRUE;
+		}
+
+		struct sockaddr_in* sin = (struct sockaddr_in*)src_addr;
+		memset (sin, 0, sizeof(struct sockaddr_in));
+		sin->sin_family		= AF_INET;
+		sin->sin_port		= udp->uh_sport;
+		sin->sin_addr.s_addr	= ip->ip_src.s_addr;
+		sin = (struct sockaddr_in*)dst_addr;
+		memset (sin, 0, sizeof(struct sockaddr_in));
+		sin->sin_family		= AF_INET;
+		sin->sin_addr.s_addr	= ip->ip_dst.s_addr;
+
+		skb->sock		= sock;
+		skb->tstamp		= pgm_time_update_now();
+		skb->data		= skb->head;
+		skb->len		= (uint16_t)len;
+		skb->zero_padded	= 0;
+		skb->is_ce		= sock->use_ecn && (PGM_ECN_CE == (ip->ip_tos & PGM_ECN_MASK));
+		skb->tail		= (char*)skb->data + len;
+
+		if (skb == sock->rx_buffer)
+			_pgm_xdp_fill (sock, desc.addr);
+#ifdef XDP_DEBUG
+		pgm_debug ("xdp frame %" PRIu64 " len %u%s",
+			   (uint64_t)desc.addr, len, (skb == sock->rx_buffer) ? " copied" : "");
+#endif
+		*pskb = skb;
+		return (ssize_t)len;
+	}
+#else
+	(void)pskb;
+	(void)src_addr;
+	(void)src_addrlen;
+	(void)dst_addr;
+	(void)dst_addrlen;
+	pgm_set_last_sock_error (PGM_SOCK_EAGAIN);
+	return SOCKET_ERROR;
+#endif /* USE_XDP */
+}
+
+/* transmit a PGM packet to an IPv4 group through the XSK transmit ring,
+ * the caller holds sock::send_mutex.  Ethernet, IP and UDP headers are built
+ * here as the stack is bypassed, UDP checksum is not used.
+ *
+ * returns packet length on success, -1 if the packet should take the socket
+ * path: transmit disabled, unicast destination, multicast loop enabled, or no
+ * idle frame.
+ */
+
+PGM_GNUC_INTERNAL
+ssize_t
+pgm_xdp_send (
+	pgm_sock_t*	       const restrict sock,
+	const struct pgm_iovec*	     restrict vector,
+	const unsigned			      count,
+	const size_t			      len,		/* total of vector */
+	const struct sockaddr*	     restrict to,
+	const int			      hops
+	)
+{
+/* pre-conditions */
+	pgm_assert (NULL != sock);
+	pgm_assert (NULL != sock->xdp);
+	pgm_assert (NULL != vector);
+	pgm_assert (NULL != to);
+
+#ifdef USE_XDP
+	pgm_xdp_t* xdp = sock->xdp;
+	const struct sockaddr_in* sin = (const struct sockaddr_in*)to;
+	const uint32_t group = ntohl (sin->sin_addr.s_addr);
+
+/* multicast group hardware address avoids neighbour resolution, the ring
+ * bypasses the kernel loopback so local receivers need the socket path.
+ */
+	if (!xdp->use_tx ||
+	    sock->use_multicast_loop ||
+	    AF_INET != sin->sin_family ||
+	    !IN_MULTICAST(group) ||
+	    PGM_XDP_HDR_LEN + len > PGM_XDP_FRAME_SIZE)
+	{
+		return SOCKET_ERROR;
+	}
+
+	_pgm_xdp_complete (xdp);
+	if (PGM_UNLIKELY(0 == xdp->tx_free_len)) {
+		sendto (sock->recv_sock, NULL, 0, MSG_DONTWAIT, NULL, 0);
+		_pgm_xdp_complete (xdp);
+		if (0 == xdp->tx_free_len)
+			return SOCKET_ERROR;
+	}
+
+	const uint64_t addr = xdp->tx_free[ --xdp->tx_free_len ];
+	char* frame = xdp->umem + addr;
+	struct ethhdr* eth = (struct ethhdr*)frame;
+	struct pgm_ip* ip = (struct pgm_ip*)(eth + 1);
+	struct pgm_udphdr* udp = (struct pgm_udphdr*)(ip + 1);
+
+	eth->h_dest[0]	= 0x01;
+	eth->h_dest[1]	= 0x00;
+	eth->h_dest[2]	= 0x5e;
+	eth->h_dest[3]	= (group >> 16) & 0x7f;
+	eth->h_dest[4]	= (group >>  8) & 0xff;
+	eth->h_dest[5]	=  group        & 0xff;
+	memcpy (eth->h_source, xdp->src_mac, ETH_ALEN);
+	eth->h_proto	= htons (ETH_P_IP);
+
+	ip->ip_v	= 4;
+	ip->ip_hl	= sizeof(struct pgm_ip) / 4;
+/* only original data is ECN-capable transport */
+	const bool is_odata = vector[0].iov_len >= sizeof (struct pgm_header) &&
+			      PGM_ODATA == ((const struct pgm_header*)vector[0].iov_base)->pgm_type;
+	ip->ip_tos	= !sock->use_ecn ? sock->tos :
+			  is_odata ? ((sock->tos & ~PGM_ECN_MASK) | PGM_ECN_ECT0) : (sock->tos & ~PGM_ECN_MASK);
+	ip->ip_len	= htons ((uint16_t)(sizeof(struct pgm_ip) + sizeof(struct pgm_udphdr) + len));
+	ip->ip_id	= htons (xdp->ip_id++);
+	ip->ip_off	= 0;
+	ip->ip_ttl	= (uint8_t)hops;
+	ip->ip_p	= IPPROTO_UDP;
+	ip->ip_sum	= 0;
+	ip->ip_src.s_addr = ((const struct sockaddr_in*)&sock->send_addr)->sin_addr.s_addr;
+	ip->ip_dst.s_addr = sin->sin_addr.s_addr;
+	ip->ip_sum	= pgm_inet_checksum (ip, sizeof(struct pgm_ip), 0);
+
+	udp->uh_sport	= htons (sock->udp_encap_ucast_port);
+	udp->uh_dport	= sin->sin_port;
+	udp->uh_ulen	= htons ((uint16_t)(sizeof(struct pgm_udphdr) + len));
+	udp->uh_sum	= 0;
+	char* dst = (char*)(udp + 1);
+	for (unsigned i = 0; i < count; i++) {
+		memcpy (dst, vector[i].iov_base, vector[i].iov_len);
+		dst += vector[i].iov_len;
+	}
+
+	const uint32_t prod = *xdp->tx.producer;
+	struct xdp_desc* desc = &((struct xdp_desc*)xdp->tx.desc)[ prod & xdp->tx.mask ];
+	desc->addr	= addr;
+	desc->len	= (uint32_t)(PGM_XDP_HDR_LEN + len);
+	desc->options	= 0;
+	__sync_synchronize();
+	*(volatile uint32_t*)xdp->tx.producer = prod + 1;
+	if (*(volatile uint32_t*)xdp->tx.flags & XDP_RING_NEED_WAKEUP)
+		sendto (sock->recv_sock, NULL, 0, MSG_DONTWAIT, NULL, 0);
+	return (ssize_t)len;
+#else
+	(void)vector;
+	(void)count;
+	(void)len;
+	(void)to;
+	(void)hops;
+	return SOCKET_ERROR;
+#endif /* USE_XDP */
+}
+
+/* eof */
@@ -0,0 +1,513 @@
+/* vim:ts=8:sts=8:sw=4:noai:noexpandtab
+ *
+ * unit tests for the AF_XDP datapath.
+ *
+ * Copyright (c) 2011 Miru Limited.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <check.h>
+
+
+/* mock state */
+
+#define TEST_MAX_TPDU		1500
+#define TEST_PORT		7500
+#define TEST_SRC_ADDR		"10.9.0.1"
+#define TEST_DST_ADDR		"10.9.0.2"
+#define TEST_GROUP_ADDR		"239.192.0.1"
+#define TEST_RING_NR		4
+
+ssize_t mock_recvfrom (int, void*, size_t, int, struct sockaddr*, socklen_t*);
+ssize_t mock_sendto (int, const void*, size_t, int, const struct sockaddr*, socklen_t);
+
+#define pgm_time_update_now	mock_pgm_time_update_now
+#define recvfrom		mock_recvfrom
+#define sendto			mock_sendto
+
+#define XDP_DEBUG
+#include "xdp.c"
+
+static pgm_time_t mock_pgm_time_now = 0x1;
+static pgm_time_t _mock_pgm_time_update_now (void);
+pgm_time_update_func mock_pgm_time_update_now = _mock_pgm_time_update_now;
+static unsigned mock_wakeups = 0;
+
+#ifdef USE_XDP
+/* ring producer, consumer and flags followed by descriptors as mapped */
+struct mock_ring_t {
+	uint32_t		producer;
+	uint32_t		consumer;
+	uint32_t		flags;
+	struct xdp_desc		desc[ TEST_RING_NR ];
+};
+
+static struct mock_ring_t mock_rings[ 4 ];
+
+static
+void
+mock_ring_init (
+	struct pgm_xdp_ring_t*	ring,
+	struct mock_ring_t*	mock
+	)
+{
+	memset (mock, 0, sizeof(struct mock_ring_t));
+	ring->producer	= &mock->producer;
+	ring->consumer	= &mock->consumer;
+	ring->flags	= &mock->flags;
+	ring->desc	= mock->desc;
+	ring->mask	= TEST_RING_NR - 1;
+	ring->map	= NULL;
+}
+
+/* socket with the XSK rings in memory, the first half of the UMEM receives
+ * and the second half transmits as pgm_xdp_create.
+ */
+
+static
+pgm_sock_t*
+generate_sock (void)
+{
+	pgm_sock_t* sock = g_new0 (pgm_sock_t, 1);
+	sock->max_tpdu = TEST_MAX_TPDU;
+	sock->rx_buffer = pgm_alloc_skb (TEST_MAX_TPDU);
+	sock->udp_encap_ucast_port = TEST_PORT;
+	sock->udp_encap_mcast_port = TEST_PORT;
+	sock->recv_sock = -1;
+	((struct sockaddr_in*)&sock->send_addr)->sin_family = AF_INET;
+	((struct sockaddr_in*)&sock->send_addr)->sin_addr.s_addr = inet_addr (TEST_SRC_ADDR);
+
+	pgm_xdp_t* xdp = g_new0 (pgm_xdp_t, 1);
+	xdp->ip_sock = -1;
+	xdp->umem_len = 2 * TEST_RING_NR * PGM_XDP_FRAME_SIZE;
+	xdp->umem = g_malloc0 (xdp->umem_len);
+	mock_ring_init (&xdp->fill, &mock_rings[0]);
+	mock_ring_init (&xdp->comp, &mock_rings[1]);
+	mock_ring_init (&xdp->rx,   &mock_rings[2]);
+	mock_ring_init (&xdp->tx,   &mock_rings[3]);
+	xdp->tx_free = g_new0 (uint64_t, TEST_RING_NR);
+	for (unsigned i = 0; i < TEST_RING_NR; i++)
+		xdp->tx_free[ xdp->tx_free_len++ ] = (uint64_t)(TEST_RING_NR + i) * PGM_XDP_FRAME_SIZE;
+	xdp->use_tx = TRUE;
+	sock->xdp = xdp;
+	return sock;
+}
+
+/* post a frame to the receive ring carrying a PGM packet of type and length
+ * len, udp_len overrides the UDP length field when non-zero.
+ */
+
+static
+uint64_t
+generate_frame (
+	pgm_sock_t*	sock,
+	const unsigned	frame,
+	const uint8_t	type,
+	const unsigned	len,
+	const unsigned	udp_len
+	)
+{
+	pgm_xdp_t* xdp = sock->xdp;
+	const uint64_t addr = (uint64_t)frame * PGM_XDP_FRAME_SIZE;
+	char* buf = xdp->umem + addr;
+	struct ethhdr* eth = (struct ethhdr*)buf;
+	struct pgm_ip* ip = (struct pgm_ip*)(eth + 1);
+	struct pgm_udphdr* udp = (struct pgm_udphdr*)(ip + 1);
+	struct pgm_header* header = (struct pgm_header*)(udp + 1);
+
+	eth->h_proto	= htons (ETH_P_IP);
+	ip->ip_v	= 4;
+	ip->ip_hl	= 5;
+	ip->ip_p	= IPPROTO_UDP;
+	ip->ip_src.s_addr = inet_addr (TEST_SRC_ADDR);
+	ip->ip_dst.s_addr = inet_addr (TEST_GROUP_ADDR);
+	udp->uh_sport	= htons (TEST_PORT);
+	udp->uh_dport	= htons (TEST_PORT);
+	udp->uh_ulen	= htons ((uint16_t)(udp_len ? udp_len : sizeof(struct pgm_udphdr) + len));
+	memset (header, 0, len);
+	header->pgm_type = type;
+
+	const uint32_t prod = *xdp->rx.producer;
+	((struct xdp_desc*)xdp->rx.desc)[ prod & xdp->rx.mask ].addr = addr;
+	((struct xdp_desc*)xdp->rx.desc)[ prod & xdp->rx.mask ].len = (uint32_t)(PGM_XDP_HDR_LEN + len);
+	*xdp->rx.producer = prod + 1;
+	return addr;
+}
+#endif /* USE_XDP */
+
+
+/* mock functions for external references */
+
+PGM_GNUC_INTERNAL
+int
+pgm_get_nprocs (void)
+{
+	return 1;
+}
+
+static
+pgm_time_t
+_mock_pgm_time_update_now (void)
+{
+	return mock_pgm_time_now;
+}
+
+ssize_t
+mock_recvfrom (
+	int			s,
+	void*			buf,
+	size_t			len,
+	int			flags,
+	struct sockaddr*	from,
+	socklen_t*		fromlen
+	)
+{
+	mock_wakeups++;
+	return 0;
+}
+
+ssize_t
+mock_sendto (
+	int			s,
+	const void*		buf,
+	size_t			len,
+	int			flags,
+	const struct sockaddr*	to,
+	socklen_t		tolen
+	)
+{
+	mock_wakeups++;
+	return 0;
+}
+
+
+/* target:
+ *	ssize_t
+ *	pgm_xdp_recv (
+ *		pgm_sock_t*		sock,
+ *		struct pgm_sk_buff_t**	pskb,
+ *		struct sockaddr*	src_addr,
+ *		const socklen_t		src_addrlen,
+ *		struct sockaddr*	dst_addr,
+ *		const socklen_t		dst_addrlen
+ *		)
+ */
+
+#ifdef USE_XDP
+/* ODATA is copied to the receive buffer and the frame refilled */
+START_TEST (test_recv_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skb = NULL;
+	struct sockaddr_storage src, dst;
+	const unsigned len = sizeof(struct pgm_header) + sizeof(struct pgm_data) + 100;
+	const uint64_t addr = generate_frame (sock, 1, PGM_ODATA, len, 0);
+	const ssize_t retval = pgm_xdp_recv (sock, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail_unless ((ssize_t)len == retval, "recv failed");
+	fail_unless (sock->rx_buffer == skb, "not copied");
+	fail_unless (len == skb->len, "length mismatch");
+	fail_unless (PGM_ODATA == ((const struct pgm_header*)skb->data)->pgm_type, "content mismatch");
+	fail_unless (inet_addr (TEST_SRC_ADDR) == ((struct sockaddr_in*)&src)->sin_addr.s_addr, "source mismatch");
+	fail_unless (htons (TEST_PORT) == ((struct sockaddr_in*)&src)->sin_port, "source port mismatch");
+	fail_unless (inet_addr (TEST_GROUP_ADDR) == ((struct sockaddr_in*)&dst)->sin_addr.s_addr, "destination mismatch");
+	fail_unless (FALSE == sock->xdp->has_held, "frame held");
+	fail_unless (1 == *sock->xdp->fill.producer, "frame not refilled");
+	fail_unless (addr == ((uint64_t*)sock->xdp->fill.desc)[ 0 ], "wrong frame refilled");
+}
+END_TEST
+
+/* control packets are presented in place and refilled on the next call */
+START_TEST (test_recv_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skb = NULL;
+	struct sockaddr_storage src, dst;
+	const unsigned len = sizeof(struct pgm_header) + sizeof(struct pgm_spm);
+	const uint64_t addr = generate_frame (sock, 2, PGM_SPM, len, 0);
+	ssize_t retval = pgm_xdp_recv (sock, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail_unless ((ssize_t)len == retval, "recv failed");
+	fail_unless (&sock->xdp->skb == skb, "copied");
+	fail_unless (sock->xdp->umem + addr + PGM_XDP_HDR_LEN == (char*)skb->data, "not in place");
+	fail_unless (TRUE == sock->xdp->has_held, "frame not held");
+	fail_unless (0 == *sock->xdp->fill.producer, "held frame refilled");
+	retval = pgm_xdp_recv (sock, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail_unless (SOCKET_ERROR == retval, "ring not empty");
+	fail_unless (PGM_SOCK_EAGAIN == pgm_get_last_sock_error(), "not EAGAIN");
+	fail_unless (FALSE == sock->xdp->has_held, "frame still held");
+	fail_unless (1 == *sock->xdp->fill.producer, "held frame not refilled");
+	fail_unless (addr == ((uint64_t*)sock->xdp->fill.desc)[ 0 ], "wrong frame refilled");
+}
+END_TEST
+
+/* malformed frames are refilled and skipped */
+START_TEST (test_recv_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skb = NULL;
+	struct sockaddr_storage src, dst;
+	const unsigned len = sizeof(struct pgm_header) + sizeof(struct pgm_data);
+	generate_frame (sock, 0, PGM_ODATA, len, 4 * len);
+	generate_frame (sock, 1, PGM_ODATA, len, sizeof(struct pgm_udphdr) - 1);
+	const ssize_t retval = pgm_xdp_recv (sock, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail_unless (SOCKET_ERROR == retval, "malformed frame accepted");
+	fail_unless (PGM_SOCK_EAGAIN == pgm_get_last_sock_error(), "not EAGAIN");
+	fail_unless (2 == *sock->xdp->fill.producer, "frames not refilled");
+	fail_unless (2 == *sock->xdp->rx.consumer, "frames not consumed");
+}
+END_TEST
+
+/* kernel is woken when the fill ring requests it */
+START_TEST (test_recv_pass_004)
+{
+	pgm_sock_t* sock = generate_sock ();
+	struct pgm_sk_buff_t* skb = NULL;
+	struct sockaddr_storage src, dst;
+	const unsigned len = sizeof(struct pgm_header) + sizeof(struct pgm_data);
+	generate_frame (sock, 0, PGM_RDATA, len, 0);
+	*sock->xdp->fill.flags = XDP_RING_NEED_WAKEUP;
+	mock_wakeups = 0;
+	const ssize_t retval = pgm_xdp_recv (sock, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail_unless ((ssize_t)len == retval, "recv failed");
+	fail_unless (1 == mock_wakeups, "kernel not woken");
+}
+END_TEST
+#endif /* USE_XDP */
+
+START_TEST (test_recv_fail_001)
+{
+	struct pgm_sk_buff_t* skb = NULL;
+	struct sockaddr_storage src, dst;
+	pgm_xdp_recv (NULL, &skb, (struct sockaddr*)&src, sizeof(src), (struct sockaddr*)&dst, sizeof(dst));
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	ssize_t
+ *	pgm_xdp_send (
+ *		pgm_sock_t*		sock,
+ *		const struct pgm_iovec*	vector,
+ *		const unsigned		count,
+ *		const size_t		len,
+ *		const struct sockaddr*	to,
+ *		const int		hops
+ *		)
+ */
+
+#ifdef USE_XDP
+/* multicast group is framed onto the transmit ring */
+START_TEST (test_send_pass_001)
+{
+	pgm_sock_t* sock = generate_sock ();
+	char header[ sizeof(struct pgm_header) ], payload[ 100 ];
+	memset (header, 0, sizeof(header));
+	((struct pgm_header*)header)->pgm_type = PGM_ODATA;
+	memset (payload, 'x', sizeof(payload));
+	const struct pgm_iovec vector[2] = {
+		{ .iov_base = header, .iov_len = sizeof(header) },
+		{ .iov_base = payload, .iov_len = sizeof(payload) }
+	};
+	const size_t len = sizeof(header) + sizeof(payload);
+	struct sockaddr_in to;
+	memset (&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons (TEST_PORT);
+	to.sin_addr.s_addr = inet_addr (TEST_GROUP_ADDR);
+	const ssize_t retval = pgm_xdp_send (sock, vector, 2, len, (const struct sockaddr*)&to, 16);
+	fail_unless ((ssize_t)len == retval, "send failed");
+	fail_unless (1 == *sock->xdp->tx.producer, "not on transmit ring");
+	fail_unless (TEST_RING_NR - 1 == sock->xdp->tx_free_len, "frame not taken");
+	const struct xdp_desc* desc = &((const struct xdp_desc*)sock->xdp->tx.desc)[ 0 ];
+	fail_unless (PGM_XDP_HDR_LEN + len == desc->len, "frame length mismatch");
+	const char* frame = sock->xdp->umem + desc->addr;
+	const struct ethhdr* eth = (const struct ethhdr*)frame;
+	const struct pgm_ip* ip = (const struct pgm_ip*)(eth + 1);
+	const struct pgm_udphdr* udp = (const struct pgm_udphdr*)(ip + 1);
+	fail_unless (0x01 == eth->h_dest[0] && 0x5e == eth->h_dest[2] && 0x01 == eth->h_dest[5], "group address mismatch");
+	fail_unless (htons (ETH_P_IP) == eth->h_proto, "protocol mismatch");
+	fail_unless (16 == ip->ip_ttl, "hops mismatch");
+	fail_unless (inet_addr (TEST_SRC_ADDR) == ip->ip_src.s_addr, "source mismatch");
+	fail_unless (inet_addr (TEST_GROUP_ADDR) == ip->ip_dst.s_addr, "destination mismatch");
+	fail_unless (0 == pgm_inet_checksum (ip, sizeof(struct pgm_ip), 0), "IP checksum invalid");
+	fail_unless (htons (TEST_PORT) == udp->uh_dport, "port mismatch");
+	fail_unless (htons (sizeof(struct pgm_udphdr) + len) == udp->uh_ulen, "UDP length mismatch");
+	fail_unless (0 == memcmp ((const char*)(udp + 1) + sizeof(header), payload, sizeof(payload)), "payload mismatch");
+}
+END_TEST
+
+/* socket path when transmit is disabled, unicast, looped multicast, or oversize */
+START_TEST (test_send_pass_002)
+{
+	pgm_sock_t* sock = generate_sock ();
+	char buf[ PGM_XDP_FRAME_SIZE ];
+	memset (buf, 0, sizeof(buf));
+	const struct pgm_iovec vector = { .iov_base = buf, .iov_len = 100 };
+	struct sockaddr_in to;
+	memset (&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons (TEST_PORT);
+	to.sin_addr.s_addr = inet_addr (TEST_DST_ADDR);
+	fail_unless (SOCKET_ERROR == pgm_xdp_send (sock, &vector, 1, 100, (const struct sockaddr*)&to, 16), "unicast framed");
+	to.sin_addr.s_addr = inet_addr (TEST_GROUP_ADDR);
+	fail_unless (SOCKET_ERROR == pgm_xdp_send (sock, &vector, 1, sizeof(buf), (const struct sockaddr*)&to, 16), "oversize framed");
+	sock->use_multicast_loop = TRUE;
+	fail_unless (SOCKET_ERROR == pgm_xdp_send (sock, &vector, 1, 100, (const struct sockaddr*)&to, 16), "looped multicast framed");
+	sock->use_multicast_loop = FALSE;
+	sock->xdp->use_tx = FALSE;
+	fail_unless (SOCKET_ERROR == pgm_xdp_send (sock, &vector, 1, 100, (const struct sockaddr*)&to, 16), "disabled transmit framed");
+	fail_unless (0 == *sock->xdp->tx.producer, "transmit ring used");
+	fail_unless (TEST_RING_NR == sock->xdp->tx_free_len, "frame taken");
+}
+END_TEST
+
+/* completed frames are recycled when none are idle */
+START_TEST (test_send_pass_003)
+{
+	pgm_sock_t* sock = generate_sock ();
+	char buf[ 100 ];
+	memset (buf, 0, sizeof(buf));
+	const struct pgm_iovec vector = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct sockaddr_in to;
+	memset (&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons (TEST_PORT);
+	to.sin_addr.s_addr = inet_addr (TEST_GROUP_ADDR);
+	for (unsigned i = 0; i < TEST_RING_NR; i++)
+		fail_unless ((ssize_t)sizeof(buf) == pgm_xdp_send (sock, &vector, 1, sizeof(buf), (const struct sockaddr*)&to, 16), "send failed");
+	fail_unless (0 == sock->xdp->tx_free_len, "frames idle");
+	fail_unless (SOCKET_ERROR == pgm_xdp_send (sock, &vector, 1, sizeof(buf), (const struct sockaddr*)&to, 16), "no idle frame framed");
+/* kernel completes one frame */
+	((uint64_t*)sock->xdp->comp.desc)[ 0 ] = (uint64_t)TEST_RING_NR * PGM_XDP_FRAME_SIZE;
+	*sock->xdp->comp.producer = 1;
+	fail_unless ((ssize_t)sizeof(buf) == pgm_xdp_send (sock, &vector, 1, sizeof(buf), (const struct sockaddr*)&to, 16), "completed frame not reused");
+	fail_unless (1 == *sock->xdp->comp.consumer, "completion not consumed");
+}
+END_TEST
+#endif /* USE_XDP */
+
+START_TEST (test_send_fail_001)
+{
+	char buf[ 100 ];
+	const struct pgm_iovec vector = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct sockaddr_in to;
+	memset (&to, 0, sizeof(to));
+	pgm_xdp_send (NULL, &vector, 1, sizeof(buf), (const struct sockaddr*)&to, 16);
+	fail ("reached");
+}
+END_TEST
+
+/* target:
+ *	bool
+ *	pgm_xdp_create (
+ *		pgm_sock_t*			sock,
+ *		const struct pgm_xdpinfo_t*	info
+ *		)
+ */
+
+/* requires UDP encapsulated IPv4 */
+START_TEST (test_create_pass_001)
+{
+	pgm_sock_t* sock = g_new0 (pgm_sock_t, 1);
+	struct pgm_xdpinfo_t info;
+	memset (&info, 0, sizeof(info));
+	sock->family = AF_INET;
+	fail_unless (FALSE == pgm_xdp_create (sock, &info), "PGM/IP accepted");
+	sock->family = AF_INET6;
+	sock->udp_encap_ucast_port = TEST_PORT;
+	fail_unless (FALSE == pgm_xdp_create (sock, &info), "IPv6 accepted");
+	fail_unless (NULL == sock->xdp, "datapath attached");
+}
+END_TEST
+
+START_TEST (test_create_fail_001)
+{
+	struct pgm_xdpinfo_t info;
+	memset (&info, 0, sizeof(info));
+	pgm_xdp_create (NULL, &info);
+	fail ("reached");
+}
+END_TEST
+
+
+static
+Suite*
+make_test_suite (void)
+{
+	Suite* s;
+
+	s = suite_create (__FILE__);
+
+	TCase* tc_recv = tcase_create ("recv");
+	suite_add_tcase (s, tc_recv);
+#ifdef USE_XDP
+	tcase_add_test (tc_recv, test_recv_pass_001);
+	tcase_add_test (tc_recv, test_recv_pass_002);
+	tcase_add_test (tc_recv, test_recv_pass_003);
+	tcase_add_test (tc_recv, test_recv_pass_004);
+#endif
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_recv, test_recv_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_send = tcase_create ("send");
+	suite_add_tcase (s, tc_send);
+#ifdef USE_XDP
+	tcase_add_test (tc_send, test_send_pass_001);
+	tcase_add_test (tc_send, test_send_pass_002);
+	tcase_add_test (tc_send, test_send_pass_003);
+#endif
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_send, test_send_fail_001, SIGABRT);
+#endif
+
+	TCase* tc_create = tcase_create ("create");
+	suite_add_tcase (s, tc_create);
+	tcase_add_test (tc_create, test_create_pass_001);
+#ifndef PGM_CHECK_NOFORK
+	tcase_add_test_raise_signal (tc_create, test_create_fail_001, SIGABRT);
+#endif
+	return s;
+}
+
+static
+Suite*
+make_master_suite (void)
+{
+	Suite* s = suite_create ("Master");
+	return s;
+}
+
+int
+main (void)
+{
+	pgm_messages_init();
+	const pgm_cpu_t cpu = { 0 };
+	pgm_checksum_init (&cpu);
+	SRunner* sr = srunner_create (make_master_suite ());
+	srunner_add_suite (sr, make_test_suite ());
+	srunner_run_all (sr, CK_ENV);
+	int number_failed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+	pgm_messages_shutdown();
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */